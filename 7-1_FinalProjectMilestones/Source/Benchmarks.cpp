@@ -0,0 +1,797 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.cpp
+// ==============
+// command line benchmark modes for the render loop
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmarks.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "SceneBVH.h"
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	// frames rendered before timing starts at each step
+	const int WARMUP_FRAMES = 30;
+	// frames timed at each step
+	const int TIMED_FRAMES = 200;
+	// point light counts, doubled up to the maximum
+	const int MIN_POINT_LIGHTS = 4;
+	const int MAX_POINT_LIGHTS = 1024;
+	// objects listed by the fill cost report
+	const size_t FILL_COST_ROWS = 20;
+
+	// box counts of the culling benchmark, multiplied by 10
+	const uint32_t MIN_CULL_OBJECTS = 100;
+	const uint32_t MAX_CULL_OBJECTS = 100000;
+	// views culled at each count, the camera turns between them
+	const int CULL_VIEWS = 100;
+	// half size of the cube the random boxes are placed in
+	const float CULL_WORLD_SIZE = 100.0f;
+
+	// box counts of the hierarchy benchmark, multiplied by 10
+	const uint32_t MIN_INDEX_OBJECTS = 1000;
+	const uint32_t MAX_INDEX_OBJECTS = 1000000;
+	// queries of each kind timed at each count
+	const int INDEX_QUERIES = 100000;
+
+	// results of one camera path, frame times in milliseconds
+	struct PATH_RESULT
+	{
+		int frames;
+		double p50;
+		double p95;
+		double p99;
+		double drawCalls;
+		double triangles;
+		double visibleObjects;
+		double occludedObjects;
+		double occlusionMilliseconds;
+	};
+
+	// nearest rank percentile of sorted values
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+		rank = std::min(std::max(rank, static_cast<size_t>(1)), sorted.size());
+		return(sorted[rank - 1]);
+	}
+
+	// read a baseline file of "name value" lines, false when
+	// there is none
+	bool ReadBaseline(const std::string& path, std::map<std::string, double>& values)
+	{
+		std::ifstream input(path);
+		if (!input)
+		{
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(input, line))
+		{
+			size_t comment = line.find('#');
+			if (comment != std::string::npos)
+			{
+				line.erase(comment);
+			}
+
+			std::istringstream tokens(line);
+			std::string name;
+			double value = 0.0;
+			if (tokens >> name >> value)
+			{
+				values[name] = value;
+			}
+		}
+		return true;
+	}
+
+	// write the results of a path as its baseline
+	bool WriteBaseline(const std::string& path, const PATH_RESULT& result)
+	{
+		std::ofstream output(path, std::ios::trunc);
+		output << "# camera path baseline, frame times in milliseconds" << std::endl;
+		output << "frames " << result.frames << std::endl;
+		output << std::fixed << std::setprecision(4);
+		output << "p50 " << result.p50 << std::endl;
+		output << "p95 " << result.p95 << std::endl;
+		output << "p99 " << result.p99 << std::endl;
+		output << std::setprecision(1);
+		output << "drawCalls " << result.drawCalls << std::endl;
+		output << "triangles " << result.triangles << std::endl;
+		if (!output)
+		{
+			std::cout << "ERROR: COULD NOT WRITE BASELINE: " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+/***********************************************************
+ *  RunLightCountBenchmark()
+ *
+ *  This function replaces the scene point lights with
+ *  randomly placed ones inside the room and times the
+ *  frame at each light count, forward and, when it is
+ *  available, deferred. The global lights of the scene
+ *  are kept, and the scene lights and shading path are
+ *  restored when the benchmark finishes.
+ ***********************************************************/
+int RunLightCountBenchmark(
+	SceneManager* pSceneManager,
+	const std::function<void()>& renderFrame)
+{
+	if (NULL == pSceneManager)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	const std::vector<LightClusters::LIGHT_SOURCE> sceneLights = pSceneManager->GetSceneLights();
+	std::vector<LightClusters::LIGHT_SOURCE> globalLights;
+	for (const LightClusters::LIGHT_SOURCE& light : sceneLights)
+	{
+		if (light.range <= 0.0f)
+		{
+			globalLights.push_back(light);
+		}
+	}
+
+	// fixed seed so every run places the same lights
+	std::mt19937 random(330);
+	std::uniform_real_distribution<float> roomXZ(-12.0f, 12.0f);
+	std::uniform_real_distribution<float> roomY(0.5f, 11.5f);
+	std::uniform_real_distribution<float> lightRange(2.0f, 5.0f);
+	std::uniform_real_distribution<float> lightColor(0.2f, 1.0f);
+
+	// present as fast as possible while timing
+	glfwSwapInterval(0);
+
+	// average milliseconds per frame after the warmup frames
+	auto timeFrames = [&renderFrame]()
+		{
+			for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+			{
+				renderFrame();
+			}
+
+			// wait for the GPU on both ends so the frames are fully timed
+			glFinish();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < TIMED_FRAMES; frame++)
+			{
+				renderFrame();
+			}
+			glFinish();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			return(std::chrono::duration<double, std::milli>(end - start).count() / TIMED_FRAMES);
+		};
+
+	const bool sceneDeferred = pSceneManager->IsDeferredShading();
+	pSceneManager->SetDeferredShading(true);
+	const bool deferredAvailable = pSceneManager->IsDeferredShading();
+
+	std::cout << "INFO: Light count benchmark, " << TIMED_FRAMES << " frames per step" << std::endl;
+	std::cout << std::setw(8) << "LIGHTS" << std::setw(12) << "MS/FRAME"
+		<< std::setw(10) << "FPS" << std::setw(14) << "REFERENCES"
+		<< std::setw(14) << "DEFERRED MS" << std::endl;
+
+	for (int pointLights = MIN_POINT_LIGHTS; pointLights <= MAX_POINT_LIGHTS; pointLights *= 2)
+	{
+		std::vector<LightClusters::LIGHT_SOURCE> lights = globalLights;
+		while (static_cast<int>(lights.size() - globalLights.size()) < pointLights)
+		{
+			LightClusters::LIGHT_SOURCE light;
+			light.position = glm::vec3(roomXZ(random), roomY(random), roomXZ(random));
+			light.range = lightRange(random);
+			light.diffuseColor = glm::vec3(lightColor(random), lightColor(random), lightColor(random));
+			light.ambientColor = light.diffuseColor * 0.05f;
+			light.specularColor = light.diffuseColor;
+			light.focalStrength = 16.0f;
+			light.specularIntensity = 0.2f;
+			light.shadowMap = -1.0f;
+			lights.push_back(light);
+		}
+		pSceneManager->SetSceneLights(lights);
+
+		pSceneManager->SetDeferredShading(false);
+		double frameMilliseconds = timeFrames();
+		uint32_t references = pSceneManager->GetLightClusters()->GetClusterLightReferences();
+
+		std::cout << std::setw(8) << pointLights
+			<< std::setw(12) << std::fixed << std::setprecision(3) << frameMilliseconds
+			<< std::setw(10) << std::setprecision(1) << 1000.0 / frameMilliseconds
+			<< std::setw(14) << references;
+		if (deferredAvailable)
+		{
+			pSceneManager->SetDeferredShading(true);
+			std::cout << std::setw(14) << std::setprecision(3) << timeFrames();
+		}
+		else
+		{
+			std::cout << std::setw(14) << "-";
+		}
+		std::cout << std::endl;
+	}
+
+	pSceneManager->SetSceneLights(sceneLights);
+	pSceneManager->SetDeferredShading(sceneDeferred);
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *  RunDepthPrepassBenchmark()
+ *
+ *  This function renders the same view without and then
+ *  with the depth pre-pass. The fragment counts are read
+ *  back after the timed frames, when the GPU has finished
+ *  them, and the pre-pass setting is restored at the end.
+ ***********************************************************/
+int RunDepthPrepassBenchmark(
+	SceneManager* pSceneManager,
+	const std::function<void()>& renderFrame)
+{
+	if (NULL == pSceneManager)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// present as fast as possible while timing
+	glfwSwapInterval(0);
+
+	const bool scenePrepass = pSceneManager->IsDepthPrepass();
+
+	std::cout << "INFO: Depth pre-pass benchmark, " << TIMED_FRAMES << " frames per step" << std::endl;
+	std::cout << std::setw(10) << "PRE-PASS" << std::setw(12) << "MS/FRAME"
+		<< std::setw(18) << "SHADED FRAGMENTS" << std::setw(20) << "PRE-PASS FRAGMENTS" << std::endl;
+
+	for (int step = 0; step < 2; step++)
+	{
+		pSceneManager->SetDepthPrepass(step == 1);
+		if (step == 1 && !pSceneManager->IsDepthPrepass())
+		{
+			std::cout << std::setw(10) << "on" << "  unavailable" << std::endl;
+			break;
+		}
+
+		for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+		{
+			renderFrame();
+		}
+
+		// wait for the GPU on both ends so the frames are fully timed
+		glFinish();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < TIMED_FRAMES; frame++)
+		{
+			renderFrame();
+		}
+		glFinish();
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		// one more frame picks up the counts of the finished ones
+		renderFrame();
+		const SceneManager::FRAME_STATS& stats = pSceneManager->GetFrameStats();
+
+		double frameMilliseconds =
+			std::chrono::duration<double, std::milli>(end - start).count() / TIMED_FRAMES;
+		std::cout << std::setw(10) << (step == 1 ? "on" : "off")
+			<< std::setw(12) << std::fixed << std::setprecision(3) << frameMilliseconds
+			<< std::setw(18) << stats.shadedFragments
+			<< std::setw(20) << stats.prepassFragments << std::endl;
+	}
+
+	pSceneManager->SetDepthPrepass(scenePrepass);
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *  RunFillCostReport()
+ *
+ *  This function lets the view settle for the warmup
+ *  frames, measures the next one and prints the result.
+ ***********************************************************/
+int RunFillCostReport(
+	SceneManager* pSceneManager,
+	const std::function<void()>& renderFrame)
+{
+	if (NULL == pSceneManager)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+	{
+		renderFrame();
+	}
+	pSceneManager->RequestFillCostMeasurement();
+	renderFrame();
+	PrintFillCostReport(pSceneManager);
+
+	return(pSceneManager->GetFillCosts().empty() ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *  PrintFillCostReport()
+ *
+ *  The share of each object is of all the fragments the
+ *  measurement shaded, and the running total shows how few
+ *  objects account for most of the fill cost.
+ ***********************************************************/
+void PrintFillCostReport(const SceneManager* pSceneManager)
+{
+	const std::vector<SceneManager::OBJECT_FILL_COST>& costs = pSceneManager->GetFillCosts();
+	const FillCostProfiler::OVERDRAW_SUMMARY& summary = pSceneManager->GetOverdrawSummary();
+	if (costs.empty() || summary.fragments == 0)
+	{
+		std::cout << "ERROR: NO FILL COST MEASURED" << std::endl;
+		return;
+	}
+
+	std::cout << "INFO: Fill cost of " << costs.size() << " objects, " << summary.fragments
+		<< " fragments over " << summary.coveredPixels << " of " << summary.pixels << " pixels, "
+		<< std::fixed << std::setprecision(2)
+		<< static_cast<double>(summary.fragments) / std::max(summary.coveredPixels, 1u)
+		<< " per covered pixel, at most " << summary.maxFragments << std::endl;
+
+	std::cout << "INFO: Pixels by fragments shaded:";
+	for (int level = 0; level < FillCostProfiler::HEATMAP_LEVELS; level++)
+	{
+		std::cout << "  " << level << (level == FillCostProfiler::HEATMAP_LEVELS - 1 ? "+ " : " ")
+			<< std::setprecision(1) << 100.0 * summary.levelPixels[level] / summary.pixels << "%";
+	}
+	std::cout << std::endl;
+
+	std::cout << std::setw(6) << "RANK" << "  " << std::left << std::setw(28) << "OBJECT" << std::right
+		<< std::setw(12) << "FRAGMENTS" << std::setw(10) << "SHARE" << std::setw(10) << "TOTAL" << std::endl;
+	uint64_t runningFragments = 0;
+	for (size_t i = 0; i < costs.size() && i < FILL_COST_ROWS; i++)
+	{
+		runningFragments += costs[i].fragments;
+		std::cout << std::setw(6) << (i + 1) << "  " << std::left << std::setw(28)
+			<< pSceneManager->GetObjectName(costs[i].object) << std::right
+			<< std::setw(12) << costs[i].fragments
+			<< std::setw(9) << 100.0 * costs[i].fragments / summary.fragments << "%"
+			<< std::setw(9) << 100.0 * runningFragments / summary.fragments << "%" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  RunCameraPathBenchmark()
+ *
+ *  This function drives the camera along each path with a
+ *  fixed timestep instead of live input, so every run
+ *  renders the same frames. Each frame is finished on the
+ *  GPU before the next one starts, which makes the frame
+ *  times comparable at the cost of pipelining. Frame times
+ *  regress when they grow by more than the threshold over
+ *  the baseline; draw calls and triangles do not depend on
+ *  the machine, so any growth is a regression. Paths
+ *  without a baseline record one.
+ ***********************************************************/
+int RunCameraPathBenchmark(
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager,
+	const PATH_BENCHMARK_OPTIONS& options,
+	const std::function<void()>& renderFrame)
+{
+	namespace fs = std::filesystem;
+
+	if (NULL == pViewManager || NULL == pSceneManager || options.timeStep <= 0.0f)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	std::vector<std::string> pathFiles;
+	std::error_code error;
+	for (const fs::directory_entry& entry : fs::directory_iterator(options.pathDirectory, error))
+	{
+		if (entry.is_regular_file() && entry.path().extension() == ".path")
+		{
+			pathFiles.push_back(entry.path().string());
+		}
+	}
+	if (pathFiles.empty())
+	{
+		std::cout << "ERROR: NO CAMERA PATHS FOUND IN: " << options.pathDirectory << std::endl;
+		return(EXIT_FAILURE);
+	}
+	// directory order is unspecified, keep the report stable
+	std::sort(pathFiles.begin(), pathFiles.end());
+	fs::create_directories(options.baselineDirectory, error);
+
+	// present as fast as possible and keep live input off the camera
+	glfwSwapInterval(0);
+	pViewManager->SetInputEnabled(false);
+	pViewManager->SetFixedTimeStep(options.timeStep);
+	CameraPath::CAMERA_POSE livePose = pViewManager->GetCameraPose();
+
+	std::cout << "INFO: Camera path benchmark, " << 1.0f / options.timeStep << " frames per path second, "
+		<< "regression threshold " << options.regressionThreshold * 100.0f << "%" << std::endl;
+	std::cout << std::left << std::setw(16) << "PATH" << std::right << std::setw(8) << "FRAMES"
+		<< std::setw(10) << "P50 MS" << std::setw(10) << "P95 MS" << std::setw(10) << "P99 MS"
+		<< std::setw(8) << "DRAWS" << std::setw(12) << "TRIANGLES" << std::setw(9) << "VISIBLE"
+		<< std::setw(10) << "OCCLUDED" << std::setw(10) << "OCC MS" << "  RESULT" << std::endl;
+
+	int exitCode = EXIT_SUCCESS;
+	for (const std::string& pathFile : pathFiles)
+	{
+		CameraPath path;
+		if (!path.Load(pathFile.c_str()))
+		{
+			exitCode = EXIT_FAILURE;
+			continue;
+		}
+
+		pViewManager->SetCameraPose(path.Sample(0.0f));
+		for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+		{
+			renderFrame();
+		}
+		glFinish();
+
+		int frameCount = static_cast<int>(path.GetDuration() / options.timeStep) + 1;
+		std::vector<double> frameMilliseconds;
+		frameMilliseconds.reserve(frameCount);
+		double totalDrawCalls = 0.0;
+		double totalTriangles = 0.0;
+		double totalVisible = 0.0;
+		double totalOccluded = 0.0;
+		double totalOcclusionTime = 0.0;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			pViewManager->SetCameraPose(path.Sample(frame * options.timeStep));
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			renderFrame();
+			glFinish();
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			frameMilliseconds.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			totalDrawCalls += pSceneManager->GetFrameStats().drawCalls;
+			totalTriangles += static_cast<double>(pSceneManager->GetFrameStats().triangles);
+			totalVisible += pSceneManager->GetFrameStats().visibleObjects;
+			totalOccluded += pSceneManager->GetFrameStats().occludedObjects;
+			totalOcclusionTime += pSceneManager->GetFrameStats().occlusionMilliseconds;
+		}
+		std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+
+		PATH_RESULT result;
+		result.frames = frameCount;
+		result.p50 = Percentile(frameMilliseconds, 0.50);
+		result.p95 = Percentile(frameMilliseconds, 0.95);
+		result.p99 = Percentile(frameMilliseconds, 0.99);
+		result.drawCalls = totalDrawCalls / frameCount;
+		result.triangles = totalTriangles / frameCount;
+		result.visibleObjects = totalVisible / frameCount;
+		result.occludedObjects = totalOccluded / frameCount;
+		result.occlusionMilliseconds = totalOcclusionTime / frameCount;
+
+		std::string baselinePath = (fs::path(options.baselineDirectory) / (path.GetName() + ".baseline")).string();
+		std::map<std::string, double> baseline;
+		std::string verdict = "ok";
+		std::vector<std::string> regressions;
+		if (options.updateBaselines || !ReadBaseline(baselinePath, baseline))
+		{
+			verdict = WriteBaseline(baselinePath, result) ? "baseline written" : "no baseline";
+		}
+		else
+		{
+			const double timeLimit = 1.0 + options.regressionThreshold;
+			const std::pair<const char*, double> times[] =
+			{
+				{ "p50", result.p50 }, { "p95", result.p95 }, { "p99", result.p99 }
+			};
+			for (const std::pair<const char*, double>& time : times)
+			{
+				if (baseline.count(time.first) && time.second > baseline[time.first] * timeLimit)
+				{
+					std::ostringstream message;
+					message << std::fixed << std::setprecision(3) << time.first << " "
+						<< baseline[time.first] << " -> " << time.second << " ms";
+					regressions.push_back(message.str());
+				}
+			}
+			// the averages are rounded when written
+			const std::pair<const char*, double> counts[] =
+			{
+				{ "drawCalls", result.drawCalls }, { "triangles", result.triangles }
+			};
+			for (const std::pair<const char*, double>& count : counts)
+			{
+				if (baseline.count(count.first) && count.second > baseline[count.first] + 0.05)
+				{
+					std::ostringstream message;
+					message << std::fixed << std::setprecision(1) << count.first << " "
+						<< baseline[count.first] << " -> " << count.second;
+					regressions.push_back(message.str());
+				}
+			}
+			if (!regressions.empty())
+			{
+				verdict = "REGRESSED";
+				exitCode = EXIT_FAILURE;
+			}
+		}
+
+		std::cout << std::left << std::setw(16) << path.GetName() << std::right << std::setw(8) << frameCount
+			<< std::fixed << std::setprecision(3)
+			<< std::setw(10) << result.p50 << std::setw(10) << result.p95 << std::setw(10) << result.p99
+			<< std::setprecision(0) << std::setw(8) << result.drawCalls << std::setw(12) << result.triangles
+			<< std::setw(9) << result.visibleObjects << std::setprecision(1) << std::setw(10) << result.occludedObjects
+			<< std::setprecision(3) << std::setw(10) << result.occlusionMilliseconds << "  " << verdict << std::endl;
+		for (const std::string& regression : regressions)
+		{
+			std::cout << "ERROR: " << path.GetName() << " REGRESSED: " << regression << std::endl;
+		}
+	}
+
+	pViewManager->SetCameraPose(livePose);
+	pViewManager->SetFixedTimeStep(0.0f);
+	pViewManager->SetInputEnabled(true);
+
+	return(exitCode);
+}
+
+/***********************************************************
+ *  RunCullingBenchmark()
+ *
+ *  This function places random boxes around a camera at
+ *  the world origin and culls them for a full turn of the
+ *  camera, first with the SIMD pass on one thread, then
+ *  split over a job system with a thread per core, and
+ *  then one box at a time.
+ ***********************************************************/
+int RunCullingBenchmark()
+{
+	// fixed seed so every run places the same boxes
+	std::mt19937 random(330);
+	std::uniform_real_distribution<float> position(-CULL_WORLD_SIZE, CULL_WORLD_SIZE);
+	std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+
+	std::vector<FrustumCuller::FRUSTUM> frustums;
+	glm::mat4 projection = glm::perspective(glm::radians(80.0f), 1000.0f / 800.0f, 0.1f, CULL_WORLD_SIZE);
+	for (int view = 0; view < CULL_VIEWS; view++)
+	{
+		float yaw = glm::radians(360.0f * view / CULL_VIEWS);
+		glm::vec3 front(cos(yaw), -0.2f, sin(yaw));
+		frustums.push_back(FrustumCuller::ExtractFrustum(
+			projection * glm::lookAt(glm::vec3(0.0f), front, glm::vec3(0.0f, 1.0f, 0.0f))));
+	}
+
+#if defined(__AVX__)
+	const char* simdName = "AVX";
+#else
+	const char* simdName = "SSE";
+#endif
+	JobSystem jobs(0);
+	std::cout << "INFO: Frustum culling benchmark, " << CULL_VIEWS << " views per count, "
+		<< simdName << " against scalar, " << jobs.GetThreadCount() << " job threads" << std::endl;
+	std::cout << std::setw(10) << "OBJECTS" << std::setw(12) << "VISIBLE"
+		<< std::setw(12) << "SIMD US" << std::setw(12) << "NS/OBJECT"
+		<< std::setw(12) << "JOBS US" << std::setw(12) << "SCALAR US" << std::setw(10) << "SPEEDUP" << std::endl;
+
+	int exitCode = EXIT_SUCCESS;
+	for (uint32_t objectCount = MIN_CULL_OBJECTS; objectCount <= MAX_CULL_OBJECTS; objectCount *= 10)
+	{
+		FrustumCuller culler;
+		culler.Resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			culler.SetBounds(i,
+				glm::vec3(position(random), position(random), position(random)),
+				glm::vec3(extent(random), extent(random), extent(random)));
+		}
+
+		uint64_t simdVisible = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (const FrustumCuller::FRUSTUM& frustum : frustums)
+		{
+			simdVisible += culler.Cull(frustum);
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		double simdMicroseconds = std::chrono::duration<double, std::micro>(end - start).count() / CULL_VIEWS;
+
+		uint64_t jobsVisible = 0;
+		start = std::chrono::steady_clock::now();
+		for (const FrustumCuller::FRUSTUM& frustum : frustums)
+		{
+			jobsVisible += culler.Cull(frustum, &jobs);
+		}
+		end = std::chrono::steady_clock::now();
+		double jobsMicroseconds = std::chrono::duration<double, std::micro>(end - start).count() / CULL_VIEWS;
+
+		uint64_t scalarVisible = 0;
+		start = std::chrono::steady_clock::now();
+		for (const FrustumCuller::FRUSTUM& frustum : frustums)
+		{
+			scalarVisible += culler.CullScalar(frustum);
+		}
+		end = std::chrono::steady_clock::now();
+		double scalarMicroseconds = std::chrono::duration<double, std::micro>(end - start).count() / CULL_VIEWS;
+
+		std::cout << std::setw(10) << objectCount << std::setw(12) << simdVisible / CULL_VIEWS
+			<< std::fixed << std::setprecision(2)
+			<< std::setw(12) << simdMicroseconds
+			<< std::setw(12) << simdMicroseconds * 1000.0 / objectCount
+			<< std::setw(12) << jobsMicroseconds
+			<< std::setw(12) << scalarMicroseconds
+			<< std::setw(9) << std::setprecision(1) << scalarMicroseconds / simdMicroseconds << "x" << std::endl;
+
+		if (simdVisible != scalarVisible || jobsVisible != scalarVisible)
+		{
+			std::cout << "ERROR: SIMD AND SCALAR CULLING DISAGREE AT " << objectCount << " OBJECTS: "
+				<< simdVisible << " / " << jobsVisible << " != " << scalarVisible << std::endl;
+			exitCode = EXIT_FAILURE;
+		}
+	}
+
+	return(exitCode);
+}
+
+/***********************************************************
+ *  RunSpatialIndexBenchmark()
+ *
+ *  This function fills a cube with random boxes at a fixed
+ *  density, so the count grows with the volume as it would
+ *  for a larger scene, and times each kind of query from
+ *  random points inside it. A tenth of the boxes are moved
+ *  between the refit timings.
+ ***********************************************************/
+int RunSpatialIndexBenchmark()
+{
+	// fixed seed so every run places the same boxes
+	std::mt19937 random(330);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 1.0f);
+
+	std::cout << "INFO: Spatial index benchmark, " << INDEX_QUERIES << " queries of each kind" << std::endl;
+	std::cout << std::setw(10) << "OBJECTS" << std::setw(10) << "BUILD MS" << std::setw(10) << "REFIT MS"
+		<< std::setw(10) << "RAY NS" << std::setw(10) << "HITS" << std::setw(12) << "SPHERE NS"
+		<< std::setw(10) << "BOX NS" << std::setw(10) << "FOUND" << std::endl;
+
+	for (uint32_t objectCount = MIN_INDEX_OBJECTS; objectCount <= MAX_INDEX_OBJECTS; objectCount *= 10)
+	{
+		// about one box per 8 cubic units
+		float worldSize = 0.5f * std::cbrt(8.0f * objectCount);
+
+		SceneBVH index;
+		index.Resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			glm::vec3 center = glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+			glm::vec3 halfSize(extent(random), extent(random), extent(random));
+			index.SetBounds(i, center - halfSize, center + halfSize);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		index.Build();
+		double buildMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+
+		for (uint32_t i = 0; i < objectCount; i += 10)
+		{
+			glm::vec3 offset = glm::vec3(unit(random), unit(random), unit(random)) * 0.5f;
+			index.SetBounds(i, index.GetBoundsMin(i) + offset, index.GetBoundsMax(i) + offset);
+		}
+		start = std::chrono::steady_clock::now();
+		index.Refit();
+		double refitMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+
+		std::vector<glm::vec3> origins(INDEX_QUERIES);
+		std::vector<glm::vec3> directions(INDEX_QUERIES);
+		for (int q = 0; q < INDEX_QUERIES; q++)
+		{
+			origins[q] = glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+			directions[q] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)));
+		}
+
+		// camera length rays, as picking and collision use
+		uint32_t hits = 0;
+		start = std::chrono::steady_clock::now();
+		for (int q = 0; q < INDEX_QUERIES; q++)
+		{
+			SceneBVH::RAY_HIT hit;
+			hits += index.RayCast(origins[q], directions[q], 100.0f, hit) ? 1 : 0;
+		}
+		double rayNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count() / INDEX_QUERIES;
+
+		std::vector<uint32_t> found;
+		size_t foundTotal = 0;
+		start = std::chrono::steady_clock::now();
+		for (int q = 0; q < INDEX_QUERIES; q++)
+		{
+			found.clear();
+			index.OverlapSphere(origins[q], 1.0f, found);
+			foundTotal += found.size();
+		}
+		double sphereNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count() / INDEX_QUERIES;
+
+		start = std::chrono::steady_clock::now();
+		for (int q = 0; q < INDEX_QUERIES; q++)
+		{
+			found.clear();
+			index.OverlapBox(origins[q] - glm::vec3(1.0f), origins[q] + glm::vec3(1.0f), found);
+			foundTotal += found.size();
+		}
+		double boxNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start).count() / INDEX_QUERIES;
+
+		std::cout << std::setw(10) << objectCount << std::fixed << std::setprecision(2)
+			<< std::setw(10) << buildMilliseconds << std::setw(10) << refitMilliseconds
+			<< std::setprecision(0) << std::setw(10) << rayNanoseconds << std::setw(10) << hits
+			<< std::setw(12) << sphereNanoseconds << std::setw(10) << boxNanoseconds
+			<< std::setw(10) << foundTotal << std::endl;
+	}
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *  RunFixedFrames()
+ *
+ *  This function is the headless main loop. Any OpenGL
+ *  error left after the last frame fails the run, so
+ *  broken rendering shows up in the exit code.
+ ***********************************************************/
+int RunFixedFrames(
+	int frameCount,
+	const std::function<void()>& renderFrame)
+{
+	// discard errors from startup, they were reported there
+	while (glGetError() != GL_NO_ERROR)
+	{
+	}
+
+	glFinish();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		renderFrame();
+	}
+	glFinish();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	double totalMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	double frameMilliseconds = (frameCount > 0) ? totalMilliseconds / frameCount : 0.0;
+	std::cout << "INFO: Rendered " << frameCount << " frames in " << std::fixed << std::setprecision(1)
+		<< totalMilliseconds << " ms (" << std::setprecision(3) << frameMilliseconds << " ms/frame, "
+		<< std::setprecision(1) << (frameMilliseconds > 0.0 ? 1000.0 / frameMilliseconds : 0.0)
+		<< " fps)" << std::endl;
+
+	int exitCode = EXIT_SUCCESS;
+	GLenum error = glGetError();
+	while (error != GL_NO_ERROR)
+	{
+		std::cout << "ERROR: OPENGL ERROR 0x" << std::hex << error << std::dec << std::endl;
+		exitCode = EXIT_FAILURE;
+		error = glGetError();
+	}
+
+	return(exitCode);
+}
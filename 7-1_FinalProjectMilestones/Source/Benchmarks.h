@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.h
+// ============
+// command line benchmark modes for the render loop
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneManager.h"
+#include "ViewManager.h"
+
+#include <functional>
+#include <string>
+
+// settings of the camera path replay benchmark
+struct PATH_BENCHMARK_OPTIONS
+{
+	// folder holding the *.path files to replay
+	std::string pathDirectory;
+	// folder holding one <path name>.baseline file per path
+	std::string baselineDirectory;
+	// seconds of path advanced by each frame
+	float timeStep;
+	// fraction a frame time may grow over its baseline
+	float regressionThreshold;
+	// overwrite the baselines with this run's results
+	bool updateBaselines;
+};
+
+// render the scene with a growing number of point lights and
+// report the frame time at each light count, returns the exit code
+int RunLightCountBenchmark(
+	SceneManager* pSceneManager,
+	const std::function<void()>& renderFrame);
+
+// render the current view with and without the depth pre-pass
+// and report the frame time and the fragments each pass shaded,
+// returns the exit code
+int RunDepthPrepassBenchmark(
+	SceneManager* pSceneManager,
+	const std::function<void()>& renderFrame);
+
+// measure the fragments each scene object shades in the current
+// view and print them ranked, returns the exit code
+int RunFillCostReport(
+	SceneManager* pSceneManager,
+	const std::function<void()>& renderFrame);
+
+// print the overdraw and the objects of the last fill cost
+// measurement, most fragments first
+void PrintFillCostReport(const SceneManager* pSceneManager);
+
+// replay every camera path with a fixed timestep, report the
+// frame time percentiles and submitted work of each path and
+// compare them with the stored baselines, returns a failure
+// exit code when any path regressed
+int RunCameraPathBenchmark(
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager,
+	const PATH_BENCHMARK_OPTIONS& options,
+	const std::function<void()>& renderFrame);
+
+// time the frustum culling pass over growing numbers of random
+// boxes with SIMD and scalar code, needs no OpenGL context,
+// returns a failure exit code when the two disagree
+int RunCullingBenchmark();
+
+// time building, refitting and querying the scene hierarchy over
+// growing numbers of random boxes, needs no OpenGL context
+int RunSpatialIndexBenchmark();
+
+// render a fixed number of frames and report the frame rate,
+// returns a failure exit code when OpenGL reported an error
+int RunFixedFrames(
+	int frameCount,
+	const std::function<void()>& renderFrame);
@@ -0,0 +1,188 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ==============
+// timed camera poses recorded from live input or scripted by hand
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	// Catmull-Rom spline through p1 and p2 with neighbours p0 and p3
+	glm::vec3 CatmullRom(
+		const glm::vec3& p0,
+		const glm::vec3& p1,
+		const glm::vec3& p2,
+		const glm::vec3& p3,
+		float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return(0.5f * ((2.0f * p1) +
+			(p2 - p0) * t +
+			(2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+			(3.0f * p1 - p0 - 3.0f * p2 + p3) * t3));
+	}
+}
+
+/***********************************************************
+ *  Load()
+ ***********************************************************/
+bool CameraPath::Load(const char* path)
+{
+	std::ifstream input(path);
+	if (!input)
+	{
+		std::cout << "ERROR: COULD NOT OPEN CAMERA PATH: " << path << std::endl;
+		return false;
+	}
+
+	m_keys.clear();
+	m_name = std::filesystem::path(path).stem().string();
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(input, line))
+	{
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream tokens(line);
+		CAMERA_KEY key;
+		if (!(tokens >> key.time))
+		{
+			continue;
+		}
+		if (!(tokens >> key.pose.position.x >> key.pose.position.y >> key.pose.position.z
+			>> key.pose.yaw >> key.pose.pitch))
+		{
+			std::cout << "ERROR: " << path << "(" << lineNumber << "): "
+				<< "expected time x y z yaw pitch" << std::endl;
+			return false;
+		}
+		if (!m_keys.empty() && key.time <= m_keys.back().time)
+		{
+			std::cout << "ERROR: " << path << "(" << lineNumber << "): "
+				<< "key times must increase" << std::endl;
+			return false;
+		}
+		m_keys.push_back(key);
+	}
+
+	if (m_keys.empty())
+	{
+		std::cout << "ERROR: CAMERA PATH HAS NO KEYS: " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Save()
+ ***********************************************************/
+bool CameraPath::Save(const char* path) const
+{
+	std::ofstream output(path, std::ios::trunc);
+	if (!output)
+	{
+		std::cout << "ERROR: COULD NOT WRITE CAMERA PATH: " << path << std::endl;
+		return false;
+	}
+
+	output << "# time x y z yaw pitch" << std::endl;
+	output << std::fixed;
+	for (const CAMERA_KEY& key : m_keys)
+	{
+		output << std::setprecision(4) << key.time << " "
+			<< key.pose.position.x << " " << key.pose.position.y << " " << key.pose.position.z << " "
+			<< std::setprecision(3) << key.pose.yaw << " " << key.pose.pitch << std::endl;
+	}
+
+	return static_cast<bool>(output);
+}
+
+/***********************************************************
+ *  AddKey()
+ *
+ *  Yaw is unwrapped against the previous key so recorded
+ *  turns past 180 degrees replay the short way.
+ ***********************************************************/
+void CameraPath::AddKey(float time, const CAMERA_POSE& pose)
+{
+	CAMERA_KEY key;
+	key.time = time;
+	key.pose = pose;
+
+	if (!m_keys.empty())
+	{
+		// frames can repeat a timer value, keep the first pose
+		if (time <= m_keys.back().time)
+		{
+			return;
+		}
+		while (key.pose.yaw - m_keys.back().pose.yaw > 180.0f)
+		{
+			key.pose.yaw -= 360.0f;
+		}
+		while (key.pose.yaw - m_keys.back().pose.yaw < -180.0f)
+		{
+			key.pose.yaw += 360.0f;
+		}
+	}
+
+	m_keys.push_back(key);
+}
+
+/***********************************************************
+ *  Sample()
+ *
+ *  The end keys are repeated as the outer neighbours of
+ *  the spline, so the path starts and stops on them.
+ ***********************************************************/
+CameraPath::CAMERA_POSE CameraPath::Sample(float time) const
+{
+	if (m_keys.empty())
+	{
+		return(CAMERA_POSE());
+	}
+	if (time <= m_keys.front().time)
+	{
+		return(m_keys.front().pose);
+	}
+	if (time >= m_keys.back().time)
+	{
+		return(m_keys.back().pose);
+	}
+
+	// last key at or before the time, recorded paths have a
+	// key per frame so the search is binary
+	std::vector<CAMERA_KEY>::const_iterator next = std::upper_bound(
+		m_keys.begin(), m_keys.end(), time,
+		[](float value, const CAMERA_KEY& key) { return(value < key.time); });
+	size_t index = static_cast<size_t>(next - m_keys.begin()) - 1;
+
+	const CAMERA_KEY& k1 = m_keys[index];
+	const CAMERA_KEY& k2 = m_keys[index + 1];
+	const CAMERA_KEY& k0 = m_keys[(index > 0) ? index - 1 : index];
+	const CAMERA_KEY& k3 = m_keys[(index + 2 < m_keys.size()) ? index + 2 : index + 1];
+	float t = (time - k1.time) / (k2.time - k1.time);
+
+	CAMERA_POSE pose;
+	pose.position = CatmullRom(k0.pose.position, k1.pose.position, k2.pose.position, k3.pose.position, t);
+	pose.yaw = k1.pose.yaw + (k2.pose.yaw - k1.pose.yaw) * t;
+	pose.pitch = k1.pose.pitch + (k2.pose.pitch - k1.pose.pitch) * t;
+	return(pose);
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// timed camera poses recorded from live input or scripted by hand
+//
+//  Text format, one key per line, '#' starts a comment:
+//
+//    <time> <x> <y> <z> <yaw> <pitch>
+//
+//  Times are in seconds and must increase, angles are in degrees. Between
+//  keys the position follows a Catmull-Rom spline through the keys and the
+//  angles are blended linearly, so yaw must be written without wrapping
+//  for the camera to turn the short way.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class holds one camera path and samples it at any
+ *  time along the path.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// camera position and direction
+	struct CAMERA_POSE
+	{
+		glm::vec3 position;
+		float yaw;
+		float pitch;
+	};
+
+	// pose reached at a time along the path
+	struct CAMERA_KEY
+	{
+		float time;
+		CAMERA_POSE pose;
+	};
+
+	// read a path file, false when it cannot be read or holds
+	// no keys
+	bool Load(const char* path);
+	// write the path in the text format
+	bool Save(const char* path) const;
+
+	// append a key, later than every key already added
+	void AddKey(float time, const CAMERA_POSE& pose);
+	void Clear() { m_keys.clear(); }
+
+	// pose at a time, clamped to the ends of the path
+	CAMERA_POSE Sample(float time) const;
+	// time of the last key
+	float GetDuration() const { return(m_keys.empty() ? 0.0f : m_keys.back().time); }
+	size_t GetKeyCount() const { return(m_keys.size()); }
+
+	// path name taken from the file name, without folder and extension
+	const std::string& GetName() const { return(m_name); }
+
+private:
+	std::vector<CAMERA_KEY> m_keys;
+	std::string m_name;
+};
@@ -0,0 +1,264 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredshading.cpp
+// ===================
+// deferred shading with the point lights culled per screen tile
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeferredShading.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+// scene shader uniform and the image units of the compute shader
+namespace
+{
+	const char* g_WriteGBufferName = "bWriteGBuffer";
+
+	const GLuint ALBEDO_IMAGE_UNIT = 0;
+	const GLuint NORMAL_IMAGE_UNIT = 1;
+	const GLuint VIEW_DEPTH_IMAGE_UNIT = 2;
+	const GLuint LIGHTING_IMAGE_UNIT = 3;
+}
+
+/***********************************************************
+ *  DeferredShading()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeferredShading::DeferredShading(ShaderUniformManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_program = 0;
+	m_screenSizeLocation = -1;
+	m_viewLocation = -1;
+	m_inverseViewLocation = -1;
+	m_inverseProjectionLocation = -1;
+	m_viewPositionLocation = -1;
+	m_globalLightCountLocation = -1;
+	m_lightCountLocation = -1;
+	m_shadowMapsLocation = -1;
+	m_shadowFarPlaneLocation = -1;
+	m_shadowBiasLocation = -1;
+	m_gBuffer = 0;
+	m_albedoTexture = 0;
+	m_normalTexture = 0;
+	m_viewDepthTexture = 0;
+	m_depthBuffer = 0;
+	m_lightingTexture = 0;
+	m_lightingFramebuffer = 0;
+	m_width = 0;
+	m_height = 0;
+	m_targetFramebuffer = 0;
+	m_blendEnabled = false;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->RegisterUniform(&m_writeGBufferHandle, g_WriteGBufferName);
+	}
+}
+
+/***********************************************************
+ *  ~DeferredShading()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeferredShading::~DeferredShading()
+{
+	m_pShaderManager = NULL;
+	DestroyTargets();
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  The targets are created by the first BeginGeometry(),
+ *  once the size of the view is known.
+ ***********************************************************/
+bool DeferredShading::Initialize(const char* computeShaderPath)
+{
+	m_program = ShaderUniformManager::LoadComputeProgram(computeShaderPath);
+	if (m_program == 0)
+	{
+		return false;
+	}
+
+	m_screenSizeLocation = glGetUniformLocation(m_program, "screenSize");
+	m_viewLocation = glGetUniformLocation(m_program, "view");
+	m_inverseViewLocation = glGetUniformLocation(m_program, "inverseView");
+	m_inverseProjectionLocation = glGetUniformLocation(m_program, "inverseProjection");
+	m_viewPositionLocation = glGetUniformLocation(m_program, "viewPosition");
+	m_globalLightCountLocation = glGetUniformLocation(m_program, "globalLightCount");
+	m_lightCountLocation = glGetUniformLocation(m_program, "lightCount");
+	m_shadowMapsLocation = glGetUniformLocation(m_program, "shadowMaps");
+	m_shadowFarPlaneLocation = glGetUniformLocation(m_program, "shadowFarPlane");
+	m_shadowBiasLocation = glGetUniformLocation(m_program, "shadowBias");
+	return true;
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  The albedo keeps 8 bits per channel with the material
+ *  index in alpha, and each normal fits in two 16 bit
+ *  floats. The view depth is kept at full precision, the
+ *  lighting pass rebuilds the positions from it.
+ ***********************************************************/
+void DeferredShading::CreateTargets(int width, int height)
+{
+	DestroyTargets();
+	m_width = width;
+	m_height = height;
+
+	GLuint textures[4];
+	glGenTextures(4, textures);
+	m_albedoTexture = textures[0];
+	m_normalTexture = textures[1];
+	m_viewDepthTexture = textures[2];
+	m_lightingTexture = textures[3];
+
+	const GLenum formats[4] = { GL_RGBA8, GL_RGBA16F, GL_R32F, GL_RGBA8 };
+	for (int i = 0; i < 4; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glGenFramebuffers(1, &m_gBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_albedoTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_normalTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, m_viewDepthTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	glGenFramebuffers(1, &m_lightingFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_lightingFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_lightingTexture, 0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ ***********************************************************/
+void DeferredShading::DestroyTargets()
+{
+	if (m_gBuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_gBuffer);
+		glDeleteFramebuffers(1, &m_lightingFramebuffer);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		GLuint textures[4] = { m_albedoTexture, m_normalTexture, m_viewDepthTexture, m_lightingTexture };
+		glDeleteTextures(4, textures);
+	}
+	m_gBuffer = 0;
+	m_lightingFramebuffer = 0;
+	m_depthBuffer = 0;
+	m_albedoTexture = 0;
+	m_normalTexture = 0;
+	m_viewDepthTexture = 0;
+	m_lightingTexture = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  BeginGeometry()
+ *
+ *  Blending is turned off while the G-buffer is drawn, as
+ *  the albedo target keeps the material index in alpha.
+ ***********************************************************/
+void DeferredShading::BeginGeometry(const SCENE_VIEW& view)
+{
+	if (m_program == 0)
+	{
+		return;
+	}
+
+	if (view.viewportWidth != m_width || view.viewportHeight != m_height)
+	{
+		CreateTargets(view.viewportWidth, view.viewportHeight);
+	}
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_targetFramebuffer);
+	m_blendEnabled = (glIsEnabled(GL_BLEND) == GL_TRUE);
+	glDisable(GL_BLEND);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_gBuffer);
+	const GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat clearDepth = 1.0f;
+	glClearBufferfv(GL_COLOR, 0, clearColor);
+	glClearBufferfv(GL_COLOR, 1, clearColor);
+	glClearBufferfv(GL_COLOR, 2, clearColor);
+	glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+
+	glUseProgram(m_pShaderManager->GetProgramID());
+	m_pShaderManager->setBoolValue(m_writeGBufferHandle, true);
+}
+
+/***********************************************************
+ *  Resolve()
+ *
+ *  The light buffer and materials stay bound from the
+ *  scene draws. Pixels nothing was drawn into come out
+ *  black, as the forward path clears them.
+ ***********************************************************/
+void DeferredShading::Resolve(const SCENE_VIEW& view, const LightClusters* pLights, const ShadowMaps* pShadows)
+{
+	if (m_program == 0)
+	{
+		return;
+	}
+
+	m_pShaderManager->setBoolValue(m_writeGBufferHandle, false);
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_targetFramebuffer));
+	if (m_blendEnabled)
+	{
+		glEnable(GL_BLEND);
+	}
+
+	glm::mat4 inverseView = glm::inverse(view.view);
+	glm::mat4 inverseProjection = glm::inverse(view.projection);
+	glProgramUniform2i(m_program, m_screenSizeLocation, m_width, m_height);
+	glProgramUniformMatrix4fv(m_program, m_viewLocation, 1, GL_FALSE, glm::value_ptr(view.view));
+	glProgramUniformMatrix4fv(m_program, m_inverseViewLocation, 1, GL_FALSE, glm::value_ptr(inverseView));
+	glProgramUniformMatrix4fv(m_program, m_inverseProjectionLocation, 1, GL_FALSE, glm::value_ptr(inverseProjection));
+	glProgramUniform3f(m_program, m_viewPositionLocation, view.position.x, view.position.y, view.position.z);
+	glProgramUniform1i(m_program, m_globalLightCountLocation, static_cast<GLint>(pLights->GetGlobalLightCount()));
+	glProgramUniform1i(m_program, m_lightCountLocation, static_cast<GLint>(pLights->GetLightCount()));
+	glProgramUniform1i(m_program, m_shadowMapsLocation, pShadows->GetTextureUnit());
+	glProgramUniform1f(m_program, m_shadowFarPlaneLocation, pShadows->GetFarPlane());
+	glProgramUniform1f(m_program, m_shadowBiasLocation, pShadows->GetBias());
+
+	glBindImageTexture(ALBEDO_IMAGE_UNIT, m_albedoTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+	glBindImageTexture(NORMAL_IMAGE_UNIT, m_normalTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+	glBindImageTexture(VIEW_DEPTH_IMAGE_UNIT, m_viewDepthTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+	glBindImageTexture(LIGHTING_IMAGE_UNIT, m_lightingTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	glUseProgram(m_program);
+	glDispatchCompute((m_width + TILE_SIZE - 1) / TILE_SIZE, (m_height + TILE_SIZE - 1) / TILE_SIZE, 1);
+	glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_lightingFramebuffer);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_targetFramebuffer));
+
+	glUseProgram(m_pShaderManager->GetProgramID());
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredshading.h
+// =================
+// deferred shading with the point lights culled per screen tile
+//
+//  The scene is drawn once into a G-buffer holding the albedo and
+//  material index, the shading and face normals, and the linear view
+//  depth of the nearest surface. A compute shader then lights every pixel
+//  once: each 16x16 tile finds the depth range of its pixels, lists the
+//  point lights whose range reaches into it, and its pixels evaluate only
+//  those lights and the global ones. The lighting cost follows the pixels
+//  on screen, not how many surfaces were drawn over each other. The lit
+//  image is copied to the framebuffer the scene was being drawn into.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderUniformManager.h"
+#include "LightClusters.h"
+#include "ShadowMaps.h"
+#include "SceneView.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  DeferredShading
+ *
+ *  This class owns the G-buffer and the tiled lighting
+ *  compute shader, and switches the scene shader between
+ *  lighting and writing the G-buffer.
+ ***********************************************************/
+class DeferredShading
+{
+public:
+	// constructor
+	DeferredShading(ShaderUniformManager* pShaderManager);
+	// destructor
+	~DeferredShading();
+
+	DeferredShading(const DeferredShading&) = delete;
+	DeferredShading& operator=(const DeferredShading&) = delete;
+
+	// pixels across a light culling tile, must match the
+	// local size of the compute shader
+	static const int TILE_SIZE = 16;
+
+	// compile the lighting compute shader, false when it fails
+	bool Initialize(const char* computeShaderPath);
+	bool IsInitialized() const { return(m_program != 0); }
+
+	// bind and clear the G-buffer, resized to the view, and
+	// set the scene shader to write it
+	void BeginGeometry(const SCENE_VIEW& view);
+	// light the G-buffer into the framebuffer that was bound
+	// before BeginGeometry(), and set the scene shader back
+	// to lighting
+	void Resolve(const SCENE_VIEW& view, const LightClusters* pLights, const ShadowMaps* pShadows);
+
+private:
+	// create the G-buffer and lighting targets for a size
+	void CreateTargets(int width, int height);
+	// delete the targets
+	void DestroyTargets();
+
+	// pointer to shader manager object
+	ShaderUniformManager* m_pShaderManager;
+	// scene shader switch to the G-buffer outputs
+	UniformHandle m_writeGBufferHandle;
+
+	GLuint m_program;
+	// uniform locations of the compute shader
+	GLint m_screenSizeLocation;
+	GLint m_viewLocation;
+	GLint m_inverseViewLocation;
+	GLint m_inverseProjectionLocation;
+	GLint m_viewPositionLocation;
+	GLint m_globalLightCountLocation;
+	GLint m_lightCountLocation;
+	GLint m_shadowMapsLocation;
+	GLint m_shadowFarPlaneLocation;
+	GLint m_shadowBiasLocation;
+
+	// G-buffer: albedo and material, normals, view depth, and
+	// the depth buffer the scene is tested against
+	GLuint m_gBuffer;
+	GLuint m_albedoTexture;
+	GLuint m_normalTexture;
+	GLuint m_viewDepthTexture;
+	GLuint m_depthBuffer;
+	// lit image written by the compute shader
+	GLuint m_lightingTexture;
+	GLuint m_lightingFramebuffer;
+	int m_width;
+	int m_height;
+
+	// framebuffer and blending of the frame, restored by
+	// Resolve()
+	GLint m_targetFramebuffer;
+	bool m_blendEnabled;
+};
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawqueue.cpp
+// =============
+// draw submission ordered by 64-bit state sort keys
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawQueue.h"
+
+#include <algorithm>
+
+namespace
+{
+	// bits of the key used for the quantized view depth
+	const int DEPTH_BITS = 24;
+	const uint32_t DEPTH_MAX = (1u << DEPTH_BITS) - 1;
+}
+
+/***********************************************************
+ *  DrawQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawQueue::DrawQueue()
+{
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  Fields wider than their bits are clamped, and the depth
+ *  is quantized over the range up to the far plane.
+ ***********************************************************/
+uint64_t DrawQueue::MakeKey(
+	uint32_t texture,
+	uint32_t material,
+	uint32_t mesh,
+	float depth,
+	float farPlane)
+{
+	uint32_t depthBits = 0;
+	if (depth > 0.0f && farPlane > 0.0f)
+	{
+		float scaled = std::min(depth / farPlane, 1.0f) * DEPTH_MAX;
+		depthBits = static_cast<uint32_t>(scaled);
+	}
+
+	return((static_cast<uint64_t>(std::min(texture, 0xFFu)) << 56) |
+		(static_cast<uint64_t>(std::min(material, 0xFFFFu)) << 40) |
+		(static_cast<uint64_t>(std::min(mesh, 0xFFFFu)) << 24) |
+		static_cast<uint64_t>(depthBits));
+}
+
+/***********************************************************
+ *  Clear()
+ ***********************************************************/
+void DrawQueue::Clear()
+{
+	m_keys.clear();
+	m_drawIndices.clear();
+}
+
+/***********************************************************
+ *  Add()
+ ***********************************************************/
+void DrawQueue::Add(uint64_t key, uint32_t drawIndex)
+{
+	m_keys.push_back(key);
+	m_drawIndices.push_back(drawIndex);
+}
+
+/***********************************************************
+ *  Append()
+ ***********************************************************/
+void DrawQueue::Append(const DrawQueue& other)
+{
+	m_keys.insert(m_keys.end(), other.m_keys.begin(), other.m_keys.end());
+	m_drawIndices.insert(m_drawIndices.end(), other.m_drawIndices.begin(), other.m_drawIndices.end());
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method sorts the draws with a least significant
+ *  digit radix sort, one byte per pass. Passes where every
+ *  key has the same byte are skipped, which is common for
+ *  the upper material and mesh bytes. The sort is
+ *  stable, so equal keys keep their recorded order.
+ ***********************************************************/
+void DrawQueue::Sort()
+{
+	const size_t count = m_keys.size();
+	if (count < 2)
+	{
+		return;
+	}
+
+	m_sortKeys.resize(count);
+	m_sortIndices.resize(count);
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t offsets[256] = { 0 };
+		for (size_t i = 0; i < count; i++)
+		{
+			offsets[(m_keys[i] >> shift) & 0xFF]++;
+		}
+		if (offsets[(m_keys[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		size_t total = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			size_t digitCount = offsets[digit];
+			offsets[digit] = total;
+			total += digitCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t position = offsets[(m_keys[i] >> shift) & 0xFF]++;
+			m_sortKeys[position] = m_keys[i];
+			m_sortIndices[position] = m_drawIndices[i];
+		}
+		m_keys.swap(m_sortKeys);
+		m_drawIndices.swap(m_sortIndices);
+	}
+}
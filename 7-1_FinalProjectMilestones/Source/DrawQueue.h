@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawqueue.h
+// ===========
+// draw submission ordered by 64-bit state sort keys
+//
+//  Each draw is recorded with a key packing, from the most significant
+//  bits down: texture, material, mesh and view depth. Every scene batch
+//  is drawn with the same program, so the program is not part of it.
+//  Sorting the keys groups draws that share state, so the state is set
+//  once per group, and orders each group front to back.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  DrawQueue
+ *
+ *  This class records draws with their sort keys and
+ *  orders them with a radix sort.
+ ***********************************************************/
+class DrawQueue
+{
+public:
+	// constructor
+	DrawQueue();
+
+	// pack the draw state into a sort key, the texture is
+	// the texture slot plus one so untextured draws sort first
+	static uint64_t MakeKey(
+		uint32_t texture,
+		uint32_t material,
+		uint32_t mesh,
+		float depth,
+		float farPlane);
+
+	// fields of a sort key
+	static uint32_t GetTexture(uint64_t key) { return(static_cast<uint32_t>(key >> 56) & 0xFF); }
+	static uint32_t GetMaterial(uint64_t key) { return(static_cast<uint32_t>(key >> 40) & 0xFFFF); }
+	static uint32_t GetMesh(uint64_t key) { return(static_cast<uint32_t>(key >> 24) & 0xFFFF); }
+	static uint32_t GetDepth(uint64_t key) { return(static_cast<uint32_t>(key) & 0xFFFFFF); }
+
+	// remove every recorded draw
+	void Clear();
+	// record a draw, drawIndex identifies it to the caller
+	void Add(uint64_t key, uint32_t drawIndex);
+	// record every draw of another queue after these, in its order
+	void Append(const DrawQueue& other);
+	// order the recorded draws by key
+	void Sort();
+
+	// recorded draws in their current order
+	size_t GetCount() const { return(m_keys.size()); }
+	uint64_t GetKey(size_t position) const { return(m_keys[position]); }
+	uint32_t GetDrawIndex(size_t position) const { return(m_drawIndices[position]); }
+
+private:
+	// recorded keys and draw indices, kept in matching order
+	std::vector<uint64_t> m_keys;
+	std::vector<uint32_t> m_drawIndices;
+	// scratch space for the radix sort passes
+	std::vector<uint64_t> m_sortKeys;
+	std::vector<uint32_t> m_sortIndices;
+};
@@ -0,0 +1,323 @@
+///////////////////////////////////////////////////////////////////////////////
+// fillcostprofiler.cpp
+// ====================
+// overdraw heatmap and per-object fill cost measurement
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FillCostProfiler.h"
+
+#include <algorithm>
+
+// scene shader uniform and the image units the counts are bound to
+namespace
+{
+	const char* g_CountOverdrawName = "bCountOverdraw";
+
+	// unit of the counts in the scene fragment shader, after the
+	// ones the deferred lighting pass binds
+	const GLuint SCENE_COUNT_IMAGE_UNIT = 4;
+	// units of the heatmap compute shader
+	const GLuint HEATMAP_COUNT_IMAGE_UNIT = 0;
+	const GLuint HEATMAP_IMAGE_UNIT = 1;
+}
+
+/***********************************************************
+ *  FillCostProfiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FillCostProfiler::FillCostProfiler(ShaderUniformManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_program = 0;
+	m_screenSizeLocation = -1;
+	m_countTexture = 0;
+	m_heatmapTexture = 0;
+	m_heatmapFramebuffer = 0;
+	m_measureFramebuffer = 0;
+	m_measureColorBuffer = 0;
+	m_measureDepthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+	m_measuredObjects = 0;
+	m_targetFramebuffer = 0;
+	m_targetViewport[0] = m_targetViewport[1] = m_targetViewport[2] = m_targetViewport[3] = 0;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->RegisterUniform(&m_countOverdrawHandle, g_CountOverdrawName);
+	}
+}
+
+/***********************************************************
+ *  ~FillCostProfiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FillCostProfiler::~FillCostProfiler()
+{
+	m_pShaderManager = NULL;
+	DestroyTargets();
+	if (!m_objectQueries.empty())
+	{
+		glDeleteQueries(static_cast<GLsizei>(m_objectQueries.size()), m_objectQueries.data());
+		m_objectQueries.clear();
+	}
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ ***********************************************************/
+bool FillCostProfiler::Initialize(const char* heatmapShaderPath)
+{
+	m_program = ShaderUniformManager::LoadComputeProgram(heatmapShaderPath);
+	if (m_program == 0)
+	{
+		return false;
+	}
+
+	m_screenSizeLocation = glGetUniformLocation(m_program, "screenSize");
+	return true;
+}
+
+/***********************************************************
+ *  CreateTargets()
+ ***********************************************************/
+void FillCostProfiler::CreateTargets(int width, int height)
+{
+	DestroyTargets();
+	m_width = width;
+	m_height = height;
+
+	glGenTextures(1, &m_countTexture);
+	glBindTexture(GL_TEXTURE_2D, m_countTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+	glGenTextures(1, &m_heatmapTexture);
+	glBindTexture(GL_TEXTURE_2D, m_heatmapTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_measureColorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_measureColorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &m_measureDepthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_measureDepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glGenFramebuffers(1, &m_heatmapFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_heatmapFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_heatmapTexture, 0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+	glGenFramebuffers(1, &m_measureFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_measureFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_measureColorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_measureDepthBuffer);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ ***********************************************************/
+void FillCostProfiler::DestroyTargets()
+{
+	if (m_countTexture != 0)
+	{
+		glDeleteFramebuffers(1, &m_heatmapFramebuffer);
+		glDeleteFramebuffers(1, &m_measureFramebuffer);
+		glDeleteRenderbuffers(1, &m_measureColorBuffer);
+		glDeleteRenderbuffers(1, &m_measureDepthBuffer);
+		glDeleteTextures(1, &m_countTexture);
+		glDeleteTextures(1, &m_heatmapTexture);
+	}
+	m_countTexture = 0;
+	m_heatmapTexture = 0;
+	m_heatmapFramebuffer = 0;
+	m_measureFramebuffer = 0;
+	m_measureColorBuffer = 0;
+	m_measureDepthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  BeginCounting()
+ ***********************************************************/
+void FillCostProfiler::BeginCounting(const SCENE_VIEW& view)
+{
+	if (m_program == 0)
+	{
+		return;
+	}
+
+	if (view.viewportWidth != m_width || view.viewportHeight != m_height)
+	{
+		CreateTargets(view.viewportWidth, view.viewportHeight);
+	}
+
+	const GLuint zero = 0;
+	glClearTexImage(m_countTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glBindImageTexture(SCENE_COUNT_IMAGE_UNIT, m_countTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+
+	glUseProgram(m_pShaderManager->GetProgramID());
+	m_pShaderManager->setBoolValue(m_countOverdrawHandle, true);
+}
+
+/***********************************************************
+ *  EndCounting()
+ ***********************************************************/
+void FillCostProfiler::EndCounting()
+{
+	if (m_program == 0)
+	{
+		return;
+	}
+
+	glUseProgram(m_pShaderManager->GetProgramID());
+	m_pShaderManager->setBoolValue(m_countOverdrawHandle, false);
+}
+
+/***********************************************************
+ *  DrawHeatmap()
+ ***********************************************************/
+void FillCostProfiler::DrawHeatmap()
+{
+	if (m_program == 0 || m_countTexture == 0)
+	{
+		return;
+	}
+
+	// the counts were written by image atomics
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	glProgramUniform2i(m_program, m_screenSizeLocation, m_width, m_height);
+	glBindImageTexture(HEATMAP_COUNT_IMAGE_UNIT, m_countTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+	glBindImageTexture(HEATMAP_IMAGE_UNIT, m_heatmapTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+	glUseProgram(m_program);
+	glDispatchCompute((m_width + TILE_SIZE - 1) / TILE_SIZE, (m_height + TILE_SIZE - 1) / TILE_SIZE, 1);
+	glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+
+	GLint targetFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &targetFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_heatmapFramebuffer);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(targetFramebuffer));
+
+	glUseProgram(m_pShaderManager->GetProgramID());
+}
+
+/***********************************************************
+ *  ReadSummary()
+ ***********************************************************/
+FillCostProfiler::OVERDRAW_SUMMARY FillCostProfiler::ReadSummary()
+{
+	OVERDRAW_SUMMARY summary = OVERDRAW_SUMMARY();
+	if (m_countTexture == 0)
+	{
+		return(summary);
+	}
+
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+	std::vector<uint32_t> counts(static_cast<size_t>(m_width) * m_height);
+	glBindTexture(GL_TEXTURE_2D, m_countTexture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, counts.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	summary.pixels = static_cast<uint32_t>(counts.size());
+	for (uint32_t count : counts)
+	{
+		if (count > 0)
+		{
+			summary.coveredPixels++;
+		}
+		summary.fragments += count;
+		summary.maxFragments = std::max(summary.maxFragments, count);
+		summary.levelPixels[std::min(count, static_cast<uint32_t>(HEATMAP_LEVELS - 1))]++;
+	}
+	return(summary);
+}
+
+/***********************************************************
+ *  BeginMeasurement()
+ *
+ *  The measurement counts per-pixel fragments as well, so
+ *  its summary matches the object counts.
+ ***********************************************************/
+void FillCostProfiler::BeginMeasurement(const SCENE_VIEW& view, uint32_t objectCount)
+{
+	if (m_program == 0)
+	{
+		return;
+	}
+
+	if (m_objectQueries.size() < objectCount)
+	{
+		size_t first = m_objectQueries.size();
+		m_objectQueries.resize(objectCount);
+		glGenQueries(static_cast<GLsizei>(objectCount - first), &m_objectQueries[first]);
+	}
+	m_measuredObjects = objectCount;
+
+	BeginCounting(view);
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_targetFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_targetViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_measureFramebuffer);
+	glViewport(0, 0, m_width, m_height);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/***********************************************************
+ *  BeginObject()
+ ***********************************************************/
+void FillCostProfiler::BeginObject(uint32_t objectIndex)
+{
+	if (objectIndex < m_measuredObjects)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, m_objectQueries[objectIndex]);
+	}
+}
+
+/***********************************************************
+ *  EndObject()
+ ***********************************************************/
+void FillCostProfiler::EndObject()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+}
+
+/***********************************************************
+ *  EndMeasurement()
+ ***********************************************************/
+void FillCostProfiler::EndMeasurement(std::vector<uint64_t>& objectFragments, OVERDRAW_SUMMARY& summary)
+{
+	objectFragments.assign(m_measuredObjects, 0);
+	summary = OVERDRAW_SUMMARY();
+	if (m_program == 0)
+	{
+		return;
+	}
+
+	EndCounting();
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_targetFramebuffer));
+	glViewport(m_targetViewport[0], m_targetViewport[1], m_targetViewport[2], m_targetViewport[3]);
+
+	for (uint32_t i = 0; i < m_measuredObjects; i++)
+	{
+		GLuint64 samples = 0;
+		glGetQueryObjectui64v(m_objectQueries[i], GL_QUERY_RESULT, &samples);
+		objectFragments[i] = samples;
+	}
+	summary = ReadSummary();
+}
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// fillcostprofiler.h
+// ==================
+// overdraw heatmap and per-object fill cost measurement
+//
+//  While counting, the scene fragment shader adds one to a per-pixel
+//  counter for every fragment it shades, with the depth test done before
+//  the shader so rejected fragments are not counted. The counts can be
+//  shown as a heatmap in place of the frame, and read back as a summary.
+//  A measurement draws into a framebuffer of its own so the frame is left
+//  alone, with an occlusion query around every object it draws, which
+//  gives the fragments each object shaded.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderUniformManager.h"
+#include "SceneView.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  FillCostProfiler
+ *
+ *  This class owns the per-pixel fragment counter, the
+ *  heatmap compute shader and the measurement framebuffer
+ *  and queries.
+ ***********************************************************/
+class FillCostProfiler
+{
+public:
+	// constructor
+	FillCostProfiler(ShaderUniformManager* pShaderManager);
+	// destructor
+	~FillCostProfiler();
+
+	FillCostProfiler(const FillCostProfiler&) = delete;
+	FillCostProfiler& operator=(const FillCostProfiler&) = delete;
+
+	// pixels across a heatmap work group, must match the local
+	// size of the compute shader
+	static const int TILE_SIZE = 16;
+	// fragment counts with a heatmap color of their own, higher
+	// counts share the last color
+	static const int HEATMAP_LEVELS = 6;
+
+	// fragments shaded per pixel over one counting pass
+	struct OVERDRAW_SUMMARY
+	{
+		uint32_t pixels;
+		// pixels shaded at least once
+		uint32_t coveredPixels;
+		uint64_t fragments;
+		uint32_t maxFragments;
+		// pixels by fragment count, the last level counting
+		// every pixel at or above it
+		uint32_t levelPixels[HEATMAP_LEVELS];
+	};
+
+	// compile the heatmap compute shader, false when it fails
+	bool Initialize(const char* heatmapShaderPath);
+	bool IsInitialized() const { return(m_program != 0); }
+
+	// clear the counts, resized to the view, and set the scene
+	// shader to count the fragments it shades
+	void BeginCounting(const SCENE_VIEW& view);
+	// set the scene shader back to shading only
+	void EndCounting();
+	// draw the counts as a heatmap over the bound framebuffer
+	void DrawHeatmap();
+	// read back the counts, waiting for the GPU
+	OVERDRAW_SUMMARY ReadSummary();
+
+	// bind and clear the measurement framebuffer, sized to the
+	// view, and count fragments for objectCount objects
+	void BeginMeasurement(const SCENE_VIEW& view, uint32_t objectCount);
+	// count the fragments of the draws that follow for one object
+	void BeginObject(uint32_t objectIndex);
+	void EndObject();
+	// restore the framebuffer and read back the fragments of
+	// each object and the overdraw of the whole measurement,
+	// waiting for the GPU
+	void EndMeasurement(std::vector<uint64_t>& objectFragments, OVERDRAW_SUMMARY& summary);
+
+private:
+	// create the counter, heatmap and measurement targets
+	void CreateTargets(int width, int height);
+	// delete the targets
+	void DestroyTargets();
+
+	// pointer to shader manager object
+	ShaderUniformManager* m_pShaderManager;
+	// scene shader switch to counting fragments
+	UniformHandle m_countOverdrawHandle;
+
+	GLuint m_program;
+	GLint m_screenSizeLocation;
+
+	// per pixel fragment counts and the heatmap drawn from them
+	GLuint m_countTexture;
+	GLuint m_heatmapTexture;
+	GLuint m_heatmapFramebuffer;
+	// color and depth of the measurement framebuffer
+	GLuint m_measureFramebuffer;
+	GLuint m_measureColorBuffer;
+	GLuint m_measureDepthBuffer;
+	int m_width;
+	int m_height;
+
+	// occlusion query of each measured object
+	std::vector<GLuint> m_objectQueries;
+	uint32_t m_measuredObjects;
+	// framebuffer and viewport of the frame, restored when a
+	// measurement ends
+	GLint m_targetFramebuffer;
+	GLint m_targetViewport[4];
+};
@@ -0,0 +1,315 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.cpp
+// =================
+// view frustum culling of world space bounding boxes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// boxes tested together, the streams are padded to this
+#if defined(__AVX__)
+	const uint32_t SIMD_WIDTH = 8;
+#else
+	const uint32_t SIMD_WIDTH = 4;
+#endif
+
+	// boxes tested by one job, a multiple of the SIMD width
+	const uint32_t CULL_GRAIN_SIZE = 1024;
+
+	// count of set bits in a lane mask
+	uint32_t CountLanes(uint32_t mask)
+	{
+		uint32_t count = 0;
+		while (mask != 0)
+		{
+			mask &= mask - 1;
+			count++;
+		}
+		return(count);
+	}
+}
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+	m_count = 0;
+	m_visibleCount = 0;
+	m_changed = false;
+}
+
+/***********************************************************
+ *  ExtractFrustum()
+ *
+ *  The planes are sums and differences of the rows of the
+ *  matrix. They are left unnormalized, since the box test
+ *  compares two distances scaled by the same length.
+ ***********************************************************/
+FrustumCuller::FRUSTUM FrustumCuller::ExtractFrustum(const glm::mat4& viewProjection)
+{
+	// glm is column major, so row i is element i of each column
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+			viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	FRUSTUM frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	return(frustum);
+}
+
+/***********************************************************
+ *  Resize()
+ ***********************************************************/
+void FrustumCuller::Resize(uint32_t count)
+{
+	uint32_t padded = (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	m_count = count;
+	m_centerX.resize(padded, 0.0f);
+	m_centerY.resize(padded, 0.0f);
+	m_centerZ.resize(padded, 0.0f);
+	m_extentX.resize(padded, 0.0f);
+	m_extentY.resize(padded, 0.0f);
+	m_extentZ.resize(padded, 0.0f);
+	m_visible.assign(count, 1);
+	m_visibleCount = count;
+	m_changed = true;
+}
+
+/***********************************************************
+ *  SetBounds()
+ ***********************************************************/
+void FrustumCuller::SetBounds(uint32_t index, const glm::vec3& center, const glm::vec3& extents)
+{
+	m_centerX[index] = center.x;
+	m_centerY[index] = center.y;
+	m_centerZ[index] = center.z;
+	m_extentX[index] = extents.x;
+	m_extentY[index] = extents.y;
+	m_extentZ[index] = extents.z;
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  Each job tests its own range of boxes and writes only
+ *  their visibility bytes, so the jobs share nothing but
+ *  the totals.
+ ***********************************************************/
+uint32_t FrustumCuller::Cull(const FRUSTUM& frustum, JobSystem* pJobSystem)
+{
+	uint32_t visibleCount = 0;
+	uint8_t changed = 0;
+	if (NULL == pJobSystem || m_count <= CULL_GRAIN_SIZE)
+	{
+		visibleCount = CullRange(frustum, 0, m_count, changed);
+	}
+	else
+	{
+		std::atomic<uint32_t> sharedCount(0);
+		std::atomic<uint32_t> sharedChanged(0);
+		pJobSystem->ParallelFor(m_count, CULL_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+			{
+				uint8_t rangeChanged = 0;
+				sharedCount += CullRange(frustum, begin, end, rangeChanged);
+				sharedChanged |= rangeChanged;
+			});
+		visibleCount = sharedCount.load();
+		changed = static_cast<uint8_t>(sharedChanged.load());
+	}
+
+	m_visibleCount = visibleCount;
+	m_changed = (changed != 0);
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  CullRange()
+ *
+ *  For each plane the box center distance is compared with
+ *  the box extents projected onto the plane normal. The
+ *  padding lanes of the last group are computed but never
+ *  written.
+ ***********************************************************/
+uint32_t FrustumCuller::CullRange(const FRUSTUM& frustum, uint32_t begin, uint32_t end, uint8_t& changed)
+{
+	uint32_t visibleCount = 0;
+
+#if defined(__AVX__)
+	__m256 normalX[6], normalY[6], normalZ[6], distance[6];
+	__m256 absoluteX[6], absoluteY[6], absoluteZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		normalX[p] = _mm256_set1_ps(plane.x);
+		normalY[p] = _mm256_set1_ps(plane.y);
+		normalZ[p] = _mm256_set1_ps(plane.z);
+		distance[p] = _mm256_set1_ps(plane.w);
+		absoluteX[p] = _mm256_set1_ps(std::fabs(plane.x));
+		absoluteY[p] = _mm256_set1_ps(std::fabs(plane.y));
+		absoluteZ[p] = _mm256_set1_ps(std::fabs(plane.z));
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (uint32_t i = begin; i < end; i += SIMD_WIDTH)
+	{
+		__m256 centerX = _mm256_loadu_ps(&m_centerX[i]);
+		__m256 centerY = _mm256_loadu_ps(&m_centerY[i]);
+		__m256 centerZ = _mm256_loadu_ps(&m_centerZ[i]);
+		__m256 extentX = _mm256_loadu_ps(&m_extentX[i]);
+		__m256 extentY = _mm256_loadu_ps(&m_extentY[i]);
+		__m256 extentZ = _mm256_loadu_ps(&m_extentZ[i]);
+
+		__m256 outside = zero;
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 centerDistance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(normalX[p], centerX), _mm256_mul_ps(normalY[p], centerY)),
+				_mm256_add_ps(_mm256_mul_ps(normalZ[p], centerZ), distance[p]));
+			__m256 radius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(absoluteX[p], extentX), _mm256_mul_ps(absoluteY[p], extentY)),
+				_mm256_mul_ps(absoluteZ[p], extentZ));
+			outside = _mm256_or_ps(outside,
+				_mm256_cmp_ps(_mm256_add_ps(centerDistance, radius), zero, _CMP_LT_OQ));
+		}
+
+		uint32_t visibleMask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFF;
+#else
+	__m128 normalX[6], normalY[6], normalZ[6], distance[6];
+	__m128 absoluteX[6], absoluteY[6], absoluteZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		normalX[p] = _mm_set1_ps(plane.x);
+		normalY[p] = _mm_set1_ps(plane.y);
+		normalZ[p] = _mm_set1_ps(plane.z);
+		distance[p] = _mm_set1_ps(plane.w);
+		absoluteX[p] = _mm_set1_ps(std::fabs(plane.x));
+		absoluteY[p] = _mm_set1_ps(std::fabs(plane.y));
+		absoluteZ[p] = _mm_set1_ps(std::fabs(plane.z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint32_t i = begin; i < end; i += SIMD_WIDTH)
+	{
+		__m128 centerX = _mm_loadu_ps(&m_centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&m_centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&m_centerZ[i]);
+		__m128 extentX = _mm_loadu_ps(&m_extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&m_extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&m_extentZ[i]);
+
+		__m128 outside = zero;
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 centerDistance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(normalX[p], centerX), _mm_mul_ps(normalY[p], centerY)),
+				_mm_add_ps(_mm_mul_ps(normalZ[p], centerZ), distance[p]));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(absoluteX[p], extentX), _mm_mul_ps(absoluteY[p], extentY)),
+				_mm_mul_ps(absoluteZ[p], extentZ));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(centerDistance, radius), zero));
+		}
+
+		uint32_t visibleMask = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xF;
+#endif
+
+		uint32_t lanes = (end - i < SIMD_WIDTH) ? end - i : SIMD_WIDTH;
+		visibleMask &= (1u << lanes) - 1;
+		for (uint32_t lane = 0; lane < lanes; lane++)
+		{
+			uint8_t visible = static_cast<uint8_t>((visibleMask >> lane) & 1);
+			changed |= m_visible[i + lane] ^ visible;
+			m_visible[i + lane] = visible;
+		}
+		visibleCount += CountLanes(visibleMask);
+	}
+
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  CullScalar()
+ ***********************************************************/
+uint32_t FrustumCuller::CullScalar(const FRUSTUM& frustum)
+{
+	uint32_t visibleCount = 0;
+	uint8_t changed = 0;
+	for (uint32_t i = 0; i < m_count; i++)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float centerDistance = plane.x * m_centerX[i] + plane.y * m_centerY[i] +
+				plane.z * m_centerZ[i] + plane.w;
+			float radius = std::fabs(plane.x) * m_extentX[i] + std::fabs(plane.y) * m_extentY[i] +
+				std::fabs(plane.z) * m_extentZ[i];
+			outside = (centerDistance + radius < 0.0f);
+		}
+		uint8_t visible = outside ? 0 : 1;
+		changed |= m_visible[i] ^ visible;
+		m_visible[i] = visible;
+		visibleCount += visible;
+	}
+
+	m_visibleCount = visibleCount;
+	m_changed = (changed != 0);
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  SetAllVisible()
+ ***********************************************************/
+void FrustumCuller::SetAllVisible()
+{
+	m_changed = (m_visibleCount != m_count);
+	m_visible.assign(m_count, 1);
+	m_visibleCount = m_count;
+}
+
+/***********************************************************
+ *  TransformBounds()
+ *
+ *  The world extents are the local extents taken through
+ *  the absolute values of the rotation and scale part of
+ *  the model matrix.
+ ***********************************************************/
+void FrustumCuller::TransformBounds(
+	const glm::mat4& model,
+	const glm::vec3& localCenter,
+	const glm::vec3& localExtents,
+	glm::vec3& worldCenter,
+	glm::vec3& worldExtents)
+{
+	worldCenter = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	for (int row = 0; row < 3; row++)
+	{
+		worldExtents[row] =
+			std::fabs(model[0][row]) * localExtents.x +
+			std::fabs(model[1][row]) * localExtents.y +
+			std::fabs(model[2][row]) * localExtents.z;
+	}
+}
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.h
+// ===============
+// view frustum culling of world space bounding boxes
+//
+//  Object bounds are kept as structure-of-arrays center and half-extent
+//  streams, padded to the SIMD width, so the test runs over 8 boxes at a
+//  time with AVX and 4 at a time with SSE. A box is culled when it lies
+//  entirely outside one of the six frustum planes, which can keep a few
+//  boxes near the frustum corners that are not visible, but never drops
+//  a visible one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class holds the bounds of the scene objects and
+ *  finds the ones inside a view frustum.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// constructor
+	FrustumCuller();
+
+	// planes of a view frustum as (normal, distance), with the
+	// normals pointing inwards, left, right, bottom, top, near, far
+	struct FRUSTUM
+	{
+		glm::vec4 planes[6];
+	};
+
+	// frustum of a combined projection * view matrix
+	static FRUSTUM ExtractFrustum(const glm::mat4& viewProjection);
+
+	// number of boxes held, new boxes are empty at the origin
+	void Resize(uint32_t count);
+	uint32_t GetCount() const { return(m_count); }
+	// set the world space box of an object
+	void SetBounds(uint32_t index, const glm::vec3& center, const glm::vec3& extents);
+	glm::vec3 GetCenter(uint32_t index) const { return(glm::vec3(m_centerX[index], m_centerY[index], m_centerZ[index])); }
+	glm::vec3 GetExtents(uint32_t index) const { return(glm::vec3(m_extentX[index], m_extentY[index], m_extentZ[index])); }
+
+	// test every box, returns the number inside the frustum;
+	// with a job system ranges of boxes are tested in parallel
+	uint32_t Cull(const FRUSTUM& frustum, JobSystem* pJobSystem = NULL);
+	// the same test one box at a time, for reference
+	uint32_t CullScalar(const FRUSTUM& frustum);
+	// treat every box as visible, as when culling is off
+	void SetAllVisible();
+
+	// result of the last cull for one object
+	bool IsVisible(uint32_t index) const { return(m_visible[index] != 0); }
+	// 1 for each object inside the frustum, 0 for culled
+	const std::vector<uint8_t>& GetVisibility() const { return(m_visible); }
+	uint32_t GetVisibleCount() const { return(m_visibleCount); }
+	uint32_t GetCulledCount() const { return(m_count - m_visibleCount); }
+	// true when the last cull changed the result of any box
+	bool VisibilityChanged() const { return(m_changed); }
+
+	// world space box of a combination of a model matrix and a
+	// local box, enclosing the transformed local box
+	static void TransformBounds(
+		const glm::mat4& model,
+		const glm::vec3& localCenter,
+		const glm::vec3& localExtents,
+		glm::vec3& worldCenter,
+		glm::vec3& worldExtents);
+
+private:
+	// test the boxes in [begin, end), begin a multiple of the
+	// SIMD width, and return the number inside the frustum
+	uint32_t CullRange(const FRUSTUM& frustum, uint32_t begin, uint32_t end, uint8_t& changed);
+
+	uint32_t m_count;
+	uint32_t m_visibleCount;
+	bool m_changed;
+	// box streams, padded to a multiple of the SIMD width
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+	std::vector<uint8_t> m_visible;
+};
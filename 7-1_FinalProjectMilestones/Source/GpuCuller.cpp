@@ -0,0 +1,332 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.cpp
+// =============
+// frustum culling and draw command generation in a compute shader
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuCuller.h"
+#include "FrustumCuller.h"
+#include "ShaderUniformManager.h"
+
+#include <algorithm>
+
+namespace
+{
+	// storage buffer bindings of the compute shader, after the
+	// ones the fragment shader uses
+	const GLuint OBJECT_BUFFER_BINDING = 3;
+	const GLuint COMMAND_BUFFER_BINDING = 4;
+	const GLuint INSTANCE_BUFFER_BINDING = 5;
+	const GLuint LOD_BUFFER_BINDING = 6;
+
+	// objects culled by one work group, must match local_size_x
+	const uint32_t WORK_GROUP_SIZE = 64;
+}
+
+/***********************************************************
+ *  GpuCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuCuller::GpuCuller()
+{
+	m_program = 0;
+	m_objectCountLocation = -1;
+	m_frustumPlanesLocation = -1;
+	m_cameraPositionLocation = -1;
+	m_pixelScaleLocation = -1;
+	m_lodSwitchPixelsLocation = -1;
+	m_lodHysteresisLocation = -1;
+	m_commandCount = 0;
+	m_dirtyBegin = 0;
+	m_dirtyEnd = 0;
+	m_objectBuffer = 0;
+	m_commandTemplateBuffer = 0;
+	m_commandBuffer = 0;
+	m_instanceBuffer = 0;
+	m_lodBuffer = 0;
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		m_readbacks[i].buffer = 0;
+		m_readbacks[i].fence = 0;
+	}
+	m_readbackFrame = 0;
+	m_drawnObjects = 0;
+	m_drawnTriangles = 0;
+}
+
+/***********************************************************
+ *  ~GpuCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuCuller::~GpuCuller()
+{
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+
+	DropReadbacks();
+	GLuint buffers[] = { m_objectBuffer, m_commandTemplateBuffer, m_commandBuffer,
+		m_instanceBuffer, m_lodBuffer };
+	for (GLuint buffer : buffers)
+	{
+		if (buffer != 0)
+		{
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		if (m_readbacks[i].buffer != 0)
+		{
+			glDeleteBuffers(1, &m_readbacks[i].buffer);
+		}
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ ***********************************************************/
+bool GpuCuller::Initialize(const char* computeShaderPath)
+{
+	m_program = ShaderUniformManager::LoadComputeProgram(computeShaderPath);
+	if (m_program == 0)
+	{
+		return false;
+	}
+
+	m_objectCountLocation = glGetUniformLocation(m_program, "objectCount");
+	m_frustumPlanesLocation = glGetUniformLocation(m_program, "frustumPlanes");
+	m_cameraPositionLocation = glGetUniformLocation(m_program, "cameraPosition");
+	m_pixelScaleLocation = glGetUniformLocation(m_program, "pixelScale");
+	m_lodSwitchPixelsLocation = glGetUniformLocation(m_program, "lodSwitchPixels");
+	m_lodHysteresisLocation = glGetUniformLocation(m_program, "lodHysteresis");
+
+	float switchPixels[PrimitiveMeshes::MAX_LOD_LEVELS - 1];
+	float hysteresis = 0.0f;
+	PrimitiveMeshes::GetLodThresholds(switchPixels, hysteresis);
+	glProgramUniform1fv(m_program, m_lodSwitchPixelsLocation, PrimitiveMeshes::MAX_LOD_LEVELS - 1, switchPixels);
+	glProgramUniform1f(m_program, m_lodHysteresisLocation, hysteresis);
+
+	glGenBuffers(1, &m_objectBuffer);
+	glGenBuffers(1, &m_commandTemplateBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_instanceBuffer);
+	glGenBuffers(1, &m_lodBuffer);
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		glGenBuffers(1, &m_readbacks[i].buffer);
+	}
+	return true;
+}
+
+/***********************************************************
+ *  SetScene()
+ *
+ *  Every object starts at its finest level. The command
+ *  buffer gets the same size as the template it is reset
+ *  from.
+ ***********************************************************/
+void GpuCuller::SetScene(
+	const std::vector<GPU_OBJECT>& objects,
+	const std::vector<PrimitiveMeshes::DRAW_COMMAND>& commands,
+	const std::vector<DRAW_GROUP>& groups,
+	uint32_t instanceCount)
+{
+	m_objects = objects;
+	m_groups = groups;
+	m_groupDrawn.assign(groups.size(), 1);
+	m_commandCount = static_cast<uint32_t>(commands.size());
+	m_dirtyBegin = 0;
+	m_dirtyEnd = 0;
+	DropReadbacks();
+	m_drawnObjects = 0;
+	m_drawnTriangles = 0;
+
+	std::vector<PrimitiveMeshes::DRAW_COMMAND> emptyCommands = commands;
+	for (PrimitiveMeshes::DRAW_COMMAND& command : emptyCommands)
+	{
+		command.instanceCount = 0;
+	}
+	std::vector<uint32_t> lods(objects.size(), 0);
+	const GLsizeiptr commandBytes = emptyCommands.size() * sizeof(PrimitiveMeshes::DRAW_COMMAND);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_objects.size() * sizeof(GPU_OBJECT), m_objects.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lodBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, lods.size() * sizeof(uint32_t), lods.data(), GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(PrimitiveMeshes::INSTANCE_DATA), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_commandTemplateBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, commandBytes, emptyCommands.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_commandBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, commandBytes, NULL, GL_DYNAMIC_COPY);
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_readbacks[i].buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, commandBytes, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  SetObject()
+ ***********************************************************/
+void GpuCuller::SetObject(uint32_t index, const GPU_OBJECT& object)
+{
+	m_objects[index] = object;
+	if (m_dirtyBegin == m_dirtyEnd)
+	{
+		m_dirtyBegin = index;
+		m_dirtyEnd = index + 1;
+	}
+	else
+	{
+		m_dirtyBegin = std::min(m_dirtyBegin, index);
+		m_dirtyEnd = std::max(m_dirtyEnd, index + 1);
+	}
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  The dispatch is ordered before the draws by a barrier on
+ *  the command and instance reads they do, and before the
+ *  copies of the commands by one on buffer updates. The
+ *  command buffer was last written by the previous frame's
+ *  dispatch, so the reset copy waits on that too.
+ ***********************************************************/
+void GpuCuller::Cull(const SCENE_VIEW& view, bool lodEnabled)
+{
+	if (m_program == 0 || m_objects.empty())
+	{
+		return;
+	}
+
+	COMMAND_READBACK& readback = m_readbacks[m_readbackFrame % FRAME_LATENCY];
+	m_readbackFrame++;
+	ReadBackCommands(readback);
+
+	if (m_dirtyBegin != m_dirtyEnd)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, m_dirtyBegin * sizeof(GPU_OBJECT),
+			(m_dirtyEnd - m_dirtyBegin) * sizeof(GPU_OBJECT), &m_objects[m_dirtyBegin]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_dirtyBegin = m_dirtyEnd = 0;
+	}
+
+	const GLsizeiptr commandBytes = m_commandCount * sizeof(PrimitiveMeshes::DRAW_COMMAND);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_commandTemplateBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_commandBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	FrustumCuller::FRUSTUM frustum = FrustumCuller::ExtractFrustum(view.projection * view.view);
+	const float pixelScale = lodEnabled ?
+		view.projection[1][1] * 0.5f * static_cast<float>(view.viewportHeight) : 0.0f;
+	const uint32_t objectCount = static_cast<uint32_t>(m_objects.size());
+	glProgramUniform1ui(m_program, m_objectCountLocation, objectCount);
+	glProgramUniform4fv(m_program, m_frustumPlanesLocation, 6, &frustum.planes[0].x);
+	glProgramUniform3f(m_program, m_cameraPositionLocation, view.position.x, view.position.y, view.position.z);
+	glProgramUniform1f(m_program, m_pixelScaleLocation, pixelScale);
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_program);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BUFFER_BINDING, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BUFFER_BINDING, m_instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOD_BUFFER_BINDING, m_lodBuffer);
+	glDispatchCompute((objectCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	glUseProgram(static_cast<GLuint>(previousProgram));
+
+	// kept for the statistics, read when this readback comes
+	// round again
+	glBindBuffer(GL_COPY_READ_BUFFER, m_commandBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/***********************************************************
+ *  DrawGroup()
+ ***********************************************************/
+void GpuCuller::DrawGroup(const PrimitiveMeshes* pMeshes, size_t groupIndex) const
+{
+	const DRAW_GROUP& group = m_groups[groupIndex];
+	pMeshes->DrawMeshesIndirect(m_commandBuffer, group.firstCommand, group.commandCount);
+}
+
+/***********************************************************
+ *  ReadBackCommands()
+ *
+ *  The fence is only polled. A copy that has not finished
+ *  by the time its readback is reused is dropped and the
+ *  counts of the frame before are kept.
+ ***********************************************************/
+void GpuCuller::ReadBackCommands(COMMAND_READBACK& readback)
+{
+	if (readback.fence == 0)
+	{
+		return;
+	}
+
+	GLenum result = glClientWaitSync(readback.fence, 0, 0);
+	glDeleteSync(readback.fence);
+	readback.fence = 0;
+	if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+	{
+		return;
+	}
+
+	m_readbackCommands.resize(m_commandCount);
+	glBindBuffer(GL_COPY_READ_BUFFER, readback.buffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+		m_commandCount * sizeof(PrimitiveMeshes::DRAW_COMMAND), m_readbackCommands.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	m_drawnObjects = 0;
+	m_drawnTriangles = 0;
+	for (const PrimitiveMeshes::DRAW_COMMAND& command : m_readbackCommands)
+	{
+		m_drawnObjects += command.instanceCount;
+		m_drawnTriangles += static_cast<uint64_t>(command.indexCount / 3) * command.instanceCount;
+	}
+
+	for (size_t g = 0; g < m_groups.size(); g++)
+	{
+		const DRAW_GROUP& group = m_groups[g];
+		uint8_t drawn = 0;
+		for (uint32_t c = group.firstCommand; c < group.firstCommand + group.commandCount; c++)
+		{
+			drawn |= (m_readbackCommands[c].instanceCount > 0) ? 1 : 0;
+		}
+		m_groupDrawn[g] = drawn;
+	}
+}
+
+/***********************************************************
+ *  DropReadbacks()
+ ***********************************************************/
+void GpuCuller::DropReadbacks()
+{
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		if (m_readbacks[i].fence != 0)
+		{
+			glDeleteSync(m_readbacks[i].fence);
+			m_readbacks[i].fence = 0;
+		}
+	}
+}
@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculler.h
+// ===========
+// frustum culling and draw command generation in a compute shader
+//
+//  Every scene object is kept in a storage buffer with its instance
+//  values, world bounds and the first of its draw commands, one command
+//  per level of detail of its batch. Each frame the commands are reset to
+//  zero instances and a compute shader tests every object against the
+//  view frustum, picks its level and appends its instance values to the
+//  instance range of the command, counting it in the command. The
+//  commands are then drawn with glMultiDrawElementsIndirect straight from
+//  the buffer, so the CPU does the same work however many objects there
+//  are. Commands are grouped by texture array, since the sampler can only
+//  change between draws; each group is one multi-draw.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "PrimitiveMeshes.h"
+#include "SceneView.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  GpuCuller
+ *
+ *  This class owns the object, command and instance
+ *  buffers of the GPU driven draws and runs the culling
+ *  compute shader.
+ ***********************************************************/
+class GpuCuller
+{
+public:
+	// constructor
+	GpuCuller();
+	// destructor
+	~GpuCuller();
+
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	// object as stored in the object buffer, laid out to match
+	// the std430 CullObject struct in the compute shader
+	struct GPU_OBJECT
+	{
+		PrimitiveMeshes::INSTANCE_DATA instance;
+		// world space box, w unused
+		glm::vec4 boundsCenter;
+		glm::vec4 boundsExtents;
+		// command of the finest level, the other levels follow
+		uint32_t firstCommand;
+		uint32_t lodCount;
+		uint32_t padding[2];
+	};
+
+	// commands drawn with one texture array bound
+	struct DRAW_GROUP
+	{
+		// texture array sampled by the group, -1 for none
+		int textureArray;
+		uint32_t firstCommand;
+		uint32_t commandCount;
+	};
+
+	// compile the culling compute shader, false when it fails
+	bool Initialize(const char* computeShaderPath);
+	bool IsInitialized() const { return(m_program != 0); }
+
+	// upload the objects and the draw commands, whose instance
+	// counts are ignored; instanceCount is the size of the
+	// instance buffer the command ranges lie in
+	void SetScene(
+		const std::vector<GPU_OBJECT>& objects,
+		const std::vector<PrimitiveMeshes::DRAW_COMMAND>& commands,
+		const std::vector<DRAW_GROUP>& groups,
+		uint32_t instanceCount);
+	const GPU_OBJECT& GetObject(uint32_t index) const { return(m_objects[index]); }
+	// replace one object, uploaded by the next Cull()
+	void SetObject(uint32_t index, const GPU_OBJECT& object);
+
+	// reset the commands and cull every object for the view;
+	// lodEnabled false draws every object at its finest level
+	void Cull(const SCENE_VIEW& view, bool lodEnabled);
+
+	// instance values written by the last Cull(), to be read
+	// by the mesh vertex array
+	GLuint GetInstanceBuffer() const { return(m_instanceBuffer); }
+	const std::vector<DRAW_GROUP>& GetGroups() const { return(m_groups); }
+	// draw one group of commands with a single call
+	void DrawGroup(const PrimitiveMeshes* pMeshes, size_t groupIndex) const;
+
+	// frames a command copy has to finish in before it is read
+	// back; a copy still running by then is dropped
+	static const int FRAME_LATENCY = 3;
+
+	// objects drawn and triangles submitted by the commands of
+	// a frame up to FRAME_LATENCY frames before the last Cull(),
+	// read back only once its fence has passed so the CPU never
+	// waits on the culling
+	uint32_t GetDrawnObjects() const { return(m_drawnObjects); }
+	uint64_t GetDrawnTriangles() const { return(m_drawnTriangles); }
+	// true when a group drew any object in the same frame the
+	// counts come from, and for every group until the first
+	// commands are read back
+	bool IsGroupDrawn(size_t groupIndex) const { return(m_groupDrawn[groupIndex] != 0); }
+
+private:
+	// copy of one frame's commands and the fence that passes
+	// when the copy is done
+	struct COMMAND_READBACK
+	{
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	// read back the commands copied into the readback about to
+	// be reused, when its fence has passed
+	void ReadBackCommands(COMMAND_READBACK& readback);
+	// delete the fences of the copies still pending
+	void DropReadbacks();
+
+	GLuint m_program;
+	// uniform locations of the compute shader
+	GLint m_objectCountLocation;
+	GLint m_frustumPlanesLocation;
+	GLint m_cameraPositionLocation;
+	GLint m_pixelScaleLocation;
+	GLint m_lodSwitchPixelsLocation;
+	GLint m_lodHysteresisLocation;
+
+	std::vector<GPU_OBJECT> m_objects;
+	std::vector<DRAW_GROUP> m_groups;
+	uint32_t m_commandCount;
+	// objects changed since the last upload, as an index range
+	uint32_t m_dirtyBegin;
+	uint32_t m_dirtyEnd;
+
+	GLuint m_objectBuffer;
+	// commands as uploaded, copied over the command buffer to
+	// reset it every frame
+	GLuint m_commandTemplateBuffer;
+	GLuint m_commandBuffer;
+	GLuint m_instanceBuffer;
+	GLuint m_lodBuffer;
+	// copies of the last frames' commands for the statistics,
+	// used in turn
+	COMMAND_READBACK m_readbacks[FRAME_LATENCY];
+	uint32_t m_readbackFrame;
+	std::vector<PrimitiveMeshes::DRAW_COMMAND> m_readbackCommands;
+	uint32_t m_drawnObjects;
+	uint64_t m_drawnTriangles;
+	// 1 for each group that drew an object
+	std::vector<uint8_t> m_groupDrawn;
+};
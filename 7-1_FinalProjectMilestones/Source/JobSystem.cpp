@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// =============
+// work-stealing scheduler for the per-frame jobs
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+namespace
+{
+	// system and queue index of the calling thread, set by the
+	// worker threads when they start
+	thread_local const JobSystem* t_pJobSystem = NULL;
+	thread_local unsigned int t_threadIndex = 0;
+}
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JobSystem::JobSystem(unsigned int threadCount)
+{
+	m_queuedJobs = 0;
+	m_stopping = false;
+
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	// every queue exists before any worker starts stealing
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_queues.push_back(new JOB_QUEUE());
+	}
+	for (unsigned int i = 1; i < threadCount; i++)
+	{
+		m_threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+	// queued jobs are run before the workers stop
+	QUEUED_JOB job;
+	while (TakeJob(0, job))
+	{
+		RunJob(job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_jobQueued.notify_all();
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+
+	for (JOB_QUEUE* pQueue : m_queues)
+	{
+		delete pQueue;
+	}
+	m_queues.clear();
+}
+
+/***********************************************************
+ *  GetCurrentThread()
+ ***********************************************************/
+unsigned int JobSystem::GetCurrentThread() const
+{
+	return((t_pJobSystem == this) ? t_threadIndex : 0);
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  The job count is raised before the sleep mutex is taken,
+ *  so a worker that has just found no work is either still
+ *  checking the count or already waiting for the signal.
+ ***********************************************************/
+void JobSystem::Submit(JOB_GROUP& group, JOB job)
+{
+	group.pending++;
+	m_queuedJobs++;
+
+	JOB_QUEUE* pQueue = m_queues[GetCurrentThread()];
+	{
+		std::lock_guard<std::mutex> lock(pQueue->mutex);
+		QUEUED_JOB queued;
+		queued.job = std::move(job);
+		queued.group = &group;
+		pQueue->jobs.push_back(std::move(queued));
+	}
+
+	if (!m_threads.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_jobQueued.notify_one();
+	}
+}
+
+/***********************************************************
+ *  Wait()
+ *
+ *  The waiting thread runs queued jobs, of any group, until
+ *  the group is done. When there is nothing left to take the
+ *  last jobs of the group are running on other threads, so
+ *  it only yields until they finish.
+ ***********************************************************/
+void JobSystem::Wait(JOB_GROUP& group)
+{
+	const unsigned int thread = GetCurrentThread();
+	while (group.pending.load() != 0)
+	{
+		QUEUED_JOB job;
+		if (TakeJob(thread, job))
+		{
+			RunJob(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  The first range runs on the calling thread while the
+ *  others wait to be stolen, so small loops finish without
+ *  waking a worker.
+ ***********************************************************/
+void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, const RANGE_JOB& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	if (grainSize == 0)
+	{
+		grainSize = 1;
+	}
+	if (m_threads.empty() || count <= grainSize)
+	{
+		job(0, count);
+		return;
+	}
+
+	JOB_GROUP group;
+	for (uint32_t begin = grainSize; begin < count; begin += grainSize)
+	{
+		uint32_t end = (count - begin > grainSize) ? begin + grainSize : count;
+		Submit(group, [&job, begin, end]() { job(begin, end); });
+	}
+	job(0, grainSize);
+	Wait(group);
+}
+
+/***********************************************************
+ *  TakeJob()
+ *
+ *  Victims are tried in order starting after the thread
+ *  itself, which spreads the thieves over the queues.
+ ***********************************************************/
+bool JobSystem::TakeJob(unsigned int thread, QUEUED_JOB& job)
+{
+	if (m_queuedJobs.load() == 0)
+	{
+		return(false);
+	}
+
+	{
+		JOB_QUEUE* pQueue = m_queues[thread];
+		std::lock_guard<std::mutex> lock(pQueue->mutex);
+		if (!pQueue->jobs.empty())
+		{
+			job = std::move(pQueue->jobs.back());
+			pQueue->jobs.pop_back();
+			m_queuedJobs--;
+			return(true);
+		}
+	}
+
+	const unsigned int queueCount = static_cast<unsigned int>(m_queues.size());
+	for (unsigned int i = 1; i < queueCount; i++)
+	{
+		JOB_QUEUE* pVictim = m_queues[(thread + i) % queueCount];
+		std::lock_guard<std::mutex> lock(pVictim->mutex);
+		if (!pVictim->jobs.empty())
+		{
+			job = std::move(pVictim->jobs.front());
+			pVictim->jobs.pop_front();
+			m_queuedJobs--;
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  RunJob()
+ ***********************************************************/
+void JobSystem::RunJob(QUEUED_JOB& job)
+{
+	job.job();
+	job.job = nullptr;
+	job.group->pending--;
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ ***********************************************************/
+void JobSystem::WorkerLoop(unsigned int thread)
+{
+	t_pJobSystem = this;
+	t_threadIndex = thread;
+
+	for (;;)
+	{
+		QUEUED_JOB job;
+		if (TakeJob(thread, job))
+		{
+			RunJob(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_jobQueued.wait(lock, [this]() { return m_stopping || m_queuedJobs.load() != 0; });
+		if (m_stopping && m_queuedJobs.load() == 0)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ===========
+// work-stealing scheduler for the per-frame jobs
+//
+//  Every thread of the system owns a queue of jobs. A thread pushes the
+//  jobs it submits to the back of its own queue and runs them from the
+//  back, newest first; a thread whose queue is empty steals the oldest
+//  job from the front of another thread's queue. The thread that created
+//  the system counts as thread 0 and runs jobs while it waits for them,
+//  so a system of one thread runs everything on the caller.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  JobSystem
+ *
+ *  This class runs jobs on a fixed set of worker threads
+ *  and the thread that waits for them.
+ ***********************************************************/
+class JobSystem
+{
+public:
+	typedef std::function<void()> JOB;
+	// body of a parallel loop, called with a range of indices
+	typedef std::function<void(uint32_t begin, uint32_t end)> RANGE_JOB;
+
+	// jobs waited for together, counts the unfinished ones
+	struct JOB_GROUP
+	{
+		std::atomic<uint32_t> pending;
+
+		JOB_GROUP() : pending(0) {}
+	};
+
+	// constructor, the count includes the calling thread;
+	// 0 uses one thread per hardware core
+	JobSystem(unsigned int threadCount);
+	// destructor, waits for the queued jobs to finish
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// queue a job of a group on the calling thread's queue
+	void Submit(JOB_GROUP& group, JOB job);
+	// run queued jobs until every job of the group has finished
+	void Wait(JOB_GROUP& group);
+	// split [0, count) into ranges of grainSize indices, run
+	// them in parallel and return when all have finished
+	void ParallelFor(uint32_t count, uint32_t grainSize, const RANGE_JOB& job);
+
+	// threads running jobs, the calling thread included
+	unsigned int GetThreadCount() const { return(static_cast<unsigned int>(m_queues.size())); }
+	// index of the calling thread in this system, 0 for the
+	// creating thread and any thread outside the system
+	unsigned int GetCurrentThread() const;
+
+private:
+	// queued job and the group it belongs to
+	struct QUEUED_JOB
+	{
+		JOB job;
+		JOB_GROUP* group;
+	};
+
+	// jobs of one thread, guarded by its own mutex so threads
+	// only contend when stealing
+	struct JOB_QUEUE
+	{
+		std::mutex mutex;
+		std::deque<QUEUED_JOB> jobs;
+	};
+
+	// take the newest job of a thread's own queue, or steal the
+	// oldest job of another queue; false when all are empty
+	bool TakeJob(unsigned int thread, QUEUED_JOB& job);
+	// run a job and count it finished in its group
+	void RunJob(QUEUED_JOB& job);
+	// run and steal jobs until the system is destroyed
+	void WorkerLoop(unsigned int thread);
+
+	// queue of each thread, index 0 belongs to the creating thread
+	std::vector<JOB_QUEUE*> m_queues;
+	std::vector<std::thread> m_threads;
+	// jobs in all queues, idle workers sleep while it is 0
+	std::atomic<uint32_t> m_queuedJobs;
+	std::mutex m_sleepMutex;
+	// signaled when a job is queued or the system stops
+	std::condition_variable m_jobQueued;
+	bool m_stopping;
+};
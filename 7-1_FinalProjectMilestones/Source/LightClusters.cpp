@@ -0,0 +1,301 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.cpp
+// =================
+// clustered forward lighting with the lights in shader storage buffers
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+// storage buffer bindings and uniform names used by the fragment shader
+namespace
+{
+	const GLuint LIGHT_BUFFER_BINDING = 0;
+	const GLuint CLUSTER_BUFFER_BINDING = 1;
+	const GLuint CLUSTER_INDEX_BUFFER_BINDING = 2;
+
+	const char* g_GlobalLightCountName = "globalLightCount";
+	const char* g_ClusterCountName = "clusterCount";
+	const char* g_ClusterTileSizeName = "clusterTileSize";
+	const char* g_ClusterDepthParamsName = "clusterDepthParams";
+	const char* g_ClusterPlanesName = "clusterPlanes";
+
+	const int TOTAL_CLUSTERS =
+		LightClusters::CLUSTER_COUNT_X * LightClusters::CLUSTER_COUNT_Y * LightClusters::CLUSTER_COUNT_Z;
+}
+
+static_assert(sizeof(LightClusters::LIGHT_SOURCE) == 64, "LIGHT_SOURCE must match the std430 layout");
+
+/***********************************************************
+ *  LightClusters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusters::LightClusters(ShaderUniformManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_globalLightCount = 0;
+	m_lightsChanged = true;
+	m_depthSliceScale = 0.0f;
+	m_depthSliceBias = 0.0f;
+	m_tileSize = glm::vec2(1.0f);
+	m_lightBuffer = 0;
+	m_clusterBuffer = 0;
+	m_clusterIndexBuffer = 0;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->RegisterUniform(&m_globalLightCountHandle, g_GlobalLightCountName);
+		m_pShaderManager->RegisterUniform(&m_clusterCountHandle, g_ClusterCountName);
+		m_pShaderManager->RegisterUniform(&m_clusterTileSizeHandle, g_ClusterTileSizeName);
+		m_pShaderManager->RegisterUniform(&m_clusterDepthParamsHandle, g_ClusterDepthParamsName);
+		m_pShaderManager->RegisterUniform(&m_clusterPlanesHandle, g_ClusterPlanesName);
+	}
+}
+
+/***********************************************************
+ *  ~LightClusters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusters::~LightClusters()
+{
+	m_pShaderManager = NULL;
+	if (m_lightBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_lightBuffer);
+		glDeleteBuffers(1, &m_clusterBuffer);
+		glDeleteBuffers(1, &m_clusterIndexBuffer);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method creates the storage buffers. The cluster
+ *  record buffer has a fixed size, the other two grow with
+ *  the light count.
+ ***********************************************************/
+void LightClusters::Initialize()
+{
+	glGenBuffers(1, &m_lightBuffer);
+	glGenBuffers(1, &m_clusterBuffer);
+	glGenBuffers(1, &m_clusterIndexBuffer);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, TOTAL_CLUSTERS * sizeof(CLUSTER_RECORD), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_clusterRecords.resize(TOTAL_CLUSTERS);
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method replaces the scene lights. Global lights are
+ *  moved to the front so the shader can loop over them
+ *  before walking the cluster list.
+ ***********************************************************/
+void LightClusters::SetLights(const std::vector<LIGHT_SOURCE>& lights)
+{
+	m_lights.clear();
+	m_lights.reserve(lights.size());
+	for (const LIGHT_SOURCE& light : lights)
+	{
+		if (light.range <= 0.0f)
+		{
+			m_lights.push_back(light);
+		}
+	}
+	m_globalLightCount = static_cast<uint32_t>(m_lights.size());
+	for (const LIGHT_SOURCE& light : lights)
+	{
+		if (light.range > 0.0f)
+		{
+			m_lights.push_back(light);
+		}
+	}
+	m_lightsChanged = true;
+}
+
+/***********************************************************
+ *  FindLightBounds()
+ *
+ *  This method finds the cluster ranges covered by the
+ *  view space bounding box of a point light. The box is
+ *  clipped to the near and far planes first, so all of its
+ *  corners project with a positive w.
+ ***********************************************************/
+bool LightClusters::FindLightBounds(const SCENE_VIEW& view, uint32_t lightIndex, LIGHT_BOUNDS& bounds) const
+{
+	const LIGHT_SOURCE& light = m_lights[lightIndex];
+	glm::vec3 center = glm::vec3(view.view * glm::vec4(light.position, 1.0f));
+	float radius = light.range;
+
+	// view space depth grows away from the camera along -Z
+	float nearDepth = -center.z - radius;
+	float farDepth = -center.z + radius;
+	if (farDepth < view.nearPlane || nearDepth > view.farPlane)
+	{
+		return false;
+	}
+	nearDepth = std::max(nearDepth, view.nearPlane);
+	farDepth = std::min(farDepth, view.farPlane);
+
+	float minX = 1.0e30f;
+	float minY = 1.0e30f;
+	float maxX = -1.0e30f;
+	float maxY = -1.0e30f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec4 point(
+			center.x + ((corner & 1) ? radius : -radius),
+			center.y + ((corner & 2) ? radius : -radius),
+			(corner & 4) ? -farDepth : -nearDepth,
+			1.0f);
+		glm::vec4 clip = view.projection * point;
+		float pixelX = (clip.x / clip.w * 0.5f + 0.5f) * view.viewportWidth;
+		float pixelY = (clip.y / clip.w * 0.5f + 0.5f) * view.viewportHeight;
+		minX = std::min(minX, pixelX);
+		maxX = std::max(maxX, pixelX);
+		minY = std::min(minY, pixelY);
+		maxY = std::max(maxY, pixelY);
+	}
+	if (maxX < 0.0f || maxY < 0.0f || minX >= view.viewportWidth || minY >= view.viewportHeight)
+	{
+		return false;
+	}
+
+	bounds.lightIndex = lightIndex;
+	bounds.minX = std::max(0, static_cast<int>(minX / m_tileSize.x));
+	bounds.maxX = std::min(CLUSTER_COUNT_X - 1, static_cast<int>(maxX / m_tileSize.x));
+	bounds.minY = std::max(0, static_cast<int>(minY / m_tileSize.y));
+	bounds.maxY = std::min(CLUSTER_COUNT_Y - 1, static_cast<int>(maxY / m_tileSize.y));
+	bounds.minZ = std::max(0, static_cast<int>(std::floor(std::log(nearDepth) * m_depthSliceScale - m_depthSliceBias)));
+	bounds.maxZ = std::min(CLUSTER_COUNT_Z - 1, static_cast<int>(std::floor(std::log(farDepth) * m_depthSliceScale - m_depthSliceBias)));
+
+	return true;
+}
+
+/***********************************************************
+ *  AssignClusters()
+ *
+ *  This method rebuilds the cluster light lists for the
+ *  view. Lights are counted per cluster first, the counts
+ *  become offsets, and a second pass writes the indices,
+ *  so each cluster's lights are contiguous in the list.
+ ***********************************************************/
+void LightClusters::AssignClusters(const SCENE_VIEW& view)
+{
+	// exponential slicing keeps the clusters roughly cubic
+	float depthRatio = std::log(view.farPlane / view.nearPlane);
+	m_depthSliceScale = CLUSTER_COUNT_Z / depthRatio;
+	m_depthSliceBias = CLUSTER_COUNT_Z * std::log(view.nearPlane) / depthRatio;
+	m_tileSize = glm::vec2(
+		static_cast<float>((view.viewportWidth + CLUSTER_COUNT_X - 1) / CLUSTER_COUNT_X),
+		static_cast<float>((view.viewportHeight + CLUSTER_COUNT_Y - 1) / CLUSTER_COUNT_Y));
+
+	// count the lights touching each cluster
+	for (CLUSTER_RECORD& record : m_clusterRecords)
+	{
+		record.offset = 0;
+		record.count = 0;
+	}
+	m_lightBounds.clear();
+	for (uint32_t i = m_globalLightCount; i < m_lights.size(); i++)
+	{
+		LIGHT_BOUNDS bounds;
+		if (!FindLightBounds(view, i, bounds))
+		{
+			continue;
+		}
+		m_lightBounds.push_back(bounds);
+		for (int z = bounds.minZ; z <= bounds.maxZ; z++)
+			for (int y = bounds.minY; y <= bounds.maxY; y++)
+				for (int x = bounds.minX; x <= bounds.maxX; x++)
+					m_clusterRecords[x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * z)].count++;
+	}
+
+	// turn the counts into offsets into the index list
+	uint32_t totalReferences = 0;
+	for (CLUSTER_RECORD& record : m_clusterRecords)
+	{
+		record.offset = totalReferences;
+		totalReferences += record.count;
+		record.count = 0;
+	}
+
+	// write the light indices of each cluster
+	m_clusterLightIndices.resize(totalReferences);
+	for (const LIGHT_BOUNDS& bounds : m_lightBounds)
+	{
+		for (int z = bounds.minZ; z <= bounds.maxZ; z++)
+			for (int y = bounds.minY; y <= bounds.maxY; y++)
+				for (int x = bounds.minX; x <= bounds.maxX; x++)
+				{
+					CLUSTER_RECORD& record = m_clusterRecords[x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * z)];
+					m_clusterLightIndices[record.offset + record.count] = bounds.lightIndex;
+					record.count++;
+				}
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+		m_clusterRecords.size() * sizeof(CLUSTER_RECORD), m_clusterRecords.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterIndexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER,
+		std::max<size_t>(m_clusterLightIndices.size(), 1) * sizeof(uint32_t),
+		m_clusterLightIndices.empty() ? NULL : m_clusterLightIndices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method uploads changed lights, rebuilds the
+ *  cluster light lists when asked and binds the light
+ *  buffers and settings for the scene shader.
+ ***********************************************************/
+void LightClusters::Update(const SCENE_VIEW& view, bool assignClusters)
+{
+	if (m_lightBuffer == 0)
+	{
+		return;
+	}
+
+	if (m_lightsChanged)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER,
+			std::max<size_t>(m_lights.size(), 1) * sizeof(LIGHT_SOURCE),
+			m_lights.empty() ? NULL : m_lights.data(), GL_STATIC_DRAW);
+		m_lightsChanged = false;
+	}
+
+	if (assignClusters)
+	{
+		AssignClusters(view);
+	}
+	else
+	{
+		m_clusterLightIndices.clear();
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BUFFER_BINDING, m_lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BUFFER_BINDING, m_clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BUFFER_BINDING, m_clusterIndexBuffer);
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setIntValue(m_globalLightCountHandle, static_cast<int>(m_globalLightCount));
+		m_pShaderManager->setIVec3Value(m_clusterCountHandle,
+			glm::ivec3(CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z));
+		m_pShaderManager->setVec2Value(m_clusterTileSizeHandle, m_tileSize);
+		m_pShaderManager->setVec2Value(m_clusterDepthParamsHandle,
+			glm::vec2(m_depthSliceScale, m_depthSliceBias));
+		m_pShaderManager->setVec2Value(m_clusterPlanesHandle,
+			glm::vec2(view.nearPlane, view.farPlane));
+	}
+}
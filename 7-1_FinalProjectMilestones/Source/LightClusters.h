@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.h
+// ===============
+// clustered forward lighting with the lights in shader storage buffers
+//
+//  The view frustum is split into a 3D grid of clusters, screen tiles in
+//  X and Y and exponential depth slices in Z. Each frame the point lights
+//  are assigned on the CPU to the clusters their range touches, and each
+//  fragment only evaluates the lights listed for its cluster. Lights
+//  without a range light the whole scene and are always evaluated.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderUniformManager.h"
+#include "SceneView.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  LightClusters
+ *
+ *  This class owns the light storage buffers and builds
+ *  the per-cluster light lists for the fragment shader.
+ ***********************************************************/
+class LightClusters
+{
+public:
+	// constructor
+	LightClusters(ShaderUniformManager* pShaderManager);
+	// destructor
+	~LightClusters();
+
+	// cluster grid dimensions
+	static const int CLUSTER_COUNT_X = 16;
+	static const int CLUSTER_COUNT_Y = 9;
+	static const int CLUSTER_COUNT_Z = 24;
+
+	// light source values, laid out to match the std430
+	// LightSource struct in the fragment shader
+	struct LIGHT_SOURCE
+	{
+		glm::vec3 position;
+		// 0 for a light that reaches the whole scene
+		float range;
+		glm::vec3 ambientColor;
+		float focalStrength;
+		glm::vec3 diffuseColor;
+		float specularIntensity;
+		glm::vec3 specularColor;
+		// layer of the light's cube shadow map, -1 for none
+		float shadowMap;
+	};
+
+	// create the storage buffers
+	void Initialize();
+	// replace the scene lights
+	void SetLights(const std::vector<LIGHT_SOURCE>& lights);
+	// assign the point lights to the clusters of the view
+	// and bind the light buffers for rendering; a renderer
+	// culling the lights itself can skip the assignment
+	void Update(const SCENE_VIEW& view, bool assignClusters = true);
+
+	// every light, with the global lights first
+	uint32_t GetLightCount() const { return(static_cast<uint32_t>(m_lights.size())); }
+	// lights evaluated by every fragment
+	uint32_t GetGlobalLightCount() const { return(m_globalLightCount); }
+	// lights assigned through the cluster grid
+	uint32_t GetPointLightCount() const { return(static_cast<uint32_t>(m_lights.size()) - m_globalLightCount); }
+	// cluster light list entries written by the last update
+	uint32_t GetClusterLightReferences() const { return(static_cast<uint32_t>(m_clusterLightIndices.size())); }
+
+private:
+	// light list of one cluster, matches uvec2 in the shader
+	struct CLUSTER_RECORD
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// cluster ranges touched by one point light
+	struct LIGHT_BOUNDS
+	{
+		uint32_t lightIndex;
+		int minX, maxX;
+		int minY, maxY;
+		int minZ, maxZ;
+	};
+
+	// fill the cluster records and light index list of the
+	// view and upload them
+	void AssignClusters(const SCENE_VIEW& view);
+	// find the clusters a point light touches, false when
+	// the light is outside the view
+	bool FindLightBounds(const SCENE_VIEW& view, uint32_t lightIndex, LIGHT_BOUNDS& bounds) const;
+
+	// pointer to shader manager object
+	ShaderUniformManager* m_pShaderManager;
+
+	// lights with the global lights first
+	std::vector<LIGHT_SOURCE> m_lights;
+	uint32_t m_globalLightCount;
+	bool m_lightsChanged;
+
+	// per-frame cluster data
+	std::vector<LIGHT_BOUNDS> m_lightBounds;
+	std::vector<CLUSTER_RECORD> m_clusterRecords;
+	std::vector<uint32_t> m_clusterLightIndices;
+
+	// exponential depth slice parameters of the last view
+	float m_depthSliceScale;
+	float m_depthSliceBias;
+	glm::vec2 m_tileSize;
+
+	// storage buffers: lights, cluster records, light indices
+	GLuint m_lightBuffer;
+	GLuint m_clusterBuffer;
+	GLuint m_clusterIndexBuffer;
+
+	// uniform handles for the cluster settings
+	UniformHandle m_globalLightCountHandle;
+	UniformHandle m_clusterCountHandle;
+	UniformHandle m_clusterTileSizeHandle;
+	UniformHandle m_clusterDepthParamsHandle;
+	UniformHandle m_clusterPlanesHandle;
+};
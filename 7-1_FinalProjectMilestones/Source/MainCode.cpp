@@ -1,5 +1,9 @@
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <climits>          // UINT_MAX
+#include <cstring>          // strcmp
+#include <chrono>           // startup timing
+#include <string>           // command line file names
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -14,7 +18,10 @@
 #include "SceneManager.h"
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
-#include "ShaderManager.h"
+#include "ShaderUniformManager.h"
+#include "Benchmarks.h"
+#include "OffscreenTarget.h"
+#include "Profiler.h"
 
 // Namespace for declaring global variables
 namespace
@@ -28,15 +35,45 @@ namespace
 	// scene manager object for managing the 3D scene prepare and render
 	SceneManager* g_SceneManager = nullptr;
 	// shader manager object for dynamic interaction with the shader code
-	ShaderManager* g_ShaderManager = nullptr;
+	ShaderUniformManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// framebuffer rendered into instead of the window in headless mode
+	OffscreenTarget* g_OffscreenTarget = nullptr;
+
+	// frames rendered by a headless run unless given on the command line
+	const int DEFAULT_HEADLESS_FRAMES = 600;
+	// camera path benchmark defaults
+	const char* const BENCHMARK_PATH_DIRECTORY = "benchmarks/paths";
+	const char* const BENCHMARK_BASELINE_DIRECTORY = "benchmarks/baselines";
+	const float BENCHMARK_TIME_STEP = 1.0f / 60.0f;
+	const float BENCHMARK_REGRESSION_PERCENT = 10.0f;
+
+	// name based uniform lookups of the last reported frame
+	unsigned int g_LastUniformLookups = UINT_MAX;
+	// draw state changes of the last reported frame
+	SceneManager::DRAW_STATE_CHANGES g_LastUnsortedChanges = { UINT_MAX, UINT_MAX, UINT_MAX };
+	SceneManager::DRAW_STATE_CHANGES g_LastSortedChanges = { UINT_MAX, UINT_MAX, UINT_MAX };
+	// fill cost measurement asked for from the keyboard, printed
+	// once the frame measuring it is rendered
+	bool g_FillCostReportPending = false;
+
+	// true when two sets of state change counts differ
+	bool StateChangesDiffer(
+		const SceneManager::DRAW_STATE_CHANGES& a,
+		const SceneManager::DRAW_STATE_CHANGES& b)
+	{
+		return(a.textures != b.textures || a.vertexArrays != b.vertexArrays || a.uniforms != b.uniforms);
+	}
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
-bool InitializeGLFW();
-bool InitializeGLEW();
+bool InitializeGLFW(bool headless, bool useOSMesa);
+bool InitializeGLEW(bool headless);
+void RenderFrame();
+void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
+void Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 
 /***********************************************************
@@ -47,26 +84,215 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// startup is timed up to the first finished frame
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	// optional benchmark mode instead of the interactive loop
+	bool benchLights = false;
+	bool benchPrepass = false;
+	bool benchFillCost = false;
+	bool benchPaths = false;
+	bool benchCulling = false;
+	bool benchSpatialIndex = false;
+	// false to draw every object whether it is in view or not
+	bool frustumCulling = true;
+	// false to draw the objects hidden behind the occluders
+	bool occlusionCulling = true;
+	// false to draw every round object at full tessellation
+	bool levelOfDetail = true;
+	// false to draw the static objects as instances like the rest
+	bool staticBatching = true;
+	// cull and pick levels in a compute shader and draw from
+	// the commands it writes
+	bool gpuDriven = false;
+	// false to redraw the static shadow casters every frame
+	bool shadowCaching = true;
+	// light the scene from a G-buffer instead of per fragment
+	bool deferredShading = false;
+	// draw the scene depth front to back before shading it
+	bool depthPrepass = false;
+	// show the fragments shaded per pixel instead of the scene
+	bool overdrawHeatmap = false;
+	PATH_BENCHMARK_OPTIONS pathOptions;
+	pathOptions.pathDirectory = BENCHMARK_PATH_DIRECTORY;
+	pathOptions.baselineDirectory = BENCHMARK_BASELINE_DIRECTORY;
+	pathOptions.timeStep = BENCHMARK_TIME_STEP;
+	pathOptions.regressionThreshold = BENCHMARK_REGRESSION_PERCENT / 100.0f;
+	pathOptions.updateBaselines = false;
+	// file the interactive camera movement is recorded to, empty when off
+	std::string recordPath;
+	// texture decode and frame job threads, 0 for one per hardware core
+	unsigned int workerThreads = 0;
+	// keep the cached textures BC1 compressed
+	bool compressTextures = false;
+	// resident texture memory limit in megabytes, 0 for none
+	unsigned int textureBudgetMB = 0;
+	// render a fixed number of frames offscreen, through EGL
+	// unless OSMesa is asked for
+	bool headless = false;
+	bool useOSMesa = false;
+	int headlessFrames = DEFAULT_HEADLESS_FRAMES;
+	// profile output path without extension, empty when off
+	std::string profilePath;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench-lights") == 0)
+		{
+			benchLights = true;
+		}
+		else if (strcmp(argv[i], "--bench-prepass") == 0)
+		{
+			benchPrepass = true;
+		}
+		else if (strcmp(argv[i], "--fill-cost") == 0)
+		{
+			benchFillCost = true;
+		}
+		else if (strcmp(argv[i], "--bench-paths") == 0)
+		{
+			benchPaths = true;
+		}
+		else if (strcmp(argv[i], "--bench-culling") == 0)
+		{
+			benchCulling = true;
+		}
+		else if (strcmp(argv[i], "--bench-bvh") == 0)
+		{
+			benchSpatialIndex = true;
+		}
+		else if (strcmp(argv[i], "--no-culling") == 0)
+		{
+			frustumCulling = false;
+		}
+		else if (strcmp(argv[i], "--no-occlusion") == 0)
+		{
+			occlusionCulling = false;
+		}
+		else if (strcmp(argv[i], "--no-lod") == 0)
+		{
+			levelOfDetail = false;
+		}
+		else if (strcmp(argv[i], "--no-static-batching") == 0)
+		{
+			staticBatching = false;
+		}
+		else if (strcmp(argv[i], "--gpu-driven") == 0)
+		{
+			gpuDriven = true;
+		}
+		else if (strcmp(argv[i], "--no-shadow-cache") == 0)
+		{
+			shadowCaching = false;
+		}
+		else if (strcmp(argv[i], "--deferred") == 0)
+		{
+			deferredShading = true;
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			depthPrepass = true;
+		}
+		else if (strcmp(argv[i], "--overdraw") == 0)
+		{
+			overdrawHeatmap = true;
+		}
+		else if (strcmp(argv[i], "--update-baselines") == 0)
+		{
+			pathOptions.updateBaselines = true;
+		}
+		else if (strcmp(argv[i], "--regression-threshold") == 0 && i + 1 < argc)
+		{
+			pathOptions.regressionThreshold = static_cast<float>(atof(argv[++i])) / 100.0f;
+		}
+		else if (strcmp(argv[i], "--record-path") == 0 && i + 1 < argc)
+		{
+			recordPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--compress-textures") == 0)
+		{
+			compressTextures = true;
+		}
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+		{
+			textureBudgetMB = static_cast<unsigned int>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			workerThreads = static_cast<unsigned int>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(argv[i], "--osmesa") == 0)
+		{
+			headless = true;
+			useOSMesa = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			headlessFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+		{
+			profilePath = argv[++i];
+		}
+	}
+
+	// recording starts before any loading thread is created
+	Profiler::SetEnabled(!profilePath.empty());
+
+	// culling and spatial queries are timed on the CPU alone,
+	// without a window
+	if (benchCulling)
+	{
+		return(RunCullingBenchmark());
+	}
+	if (benchSpatialIndex)
+	{
+		return(RunSpatialIndexBenchmark());
+	}
+
 	// if GLFW fails initialization, then terminate the application
-	if (InitializeGLFW() == false)
+	if (InitializeGLFW(headless, useOSMesa) == false)
 	{
 		return(EXIT_FAILURE);
 	}
 
 	// try to create a new shader manager object
-	g_ShaderManager = new ShaderManager();
+	g_ShaderManager = new ShaderUniformManager();
 	// try to create a new view manager object
 	g_ViewManager = new ViewManager(
 		g_ShaderManager);
 
-	// try to create the main display window
+	// try to create the main display window, which is never
+	// shown in headless mode
 	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	if (NULL == g_Window)
+	{
+		return(EXIT_FAILURE);
+	}
 
 	// if GLEW fails initialization, then terminate the application
-	if (InitializeGLEW() == false)
+	if (InitializeGLEW(headless) == false)
 	{
 		return(EXIT_FAILURE);
 	}
+	Profiler::InitializeGPU();
+
+	// headless frames go to a framebuffer object of the window size
+	if (headless)
+	{
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(g_Window, &width, &height);
+		g_OffscreenTarget = new OffscreenTarget();
+		if (!g_OffscreenTarget->Create(width, height))
+		{
+			return(EXIT_FAILURE);
+		}
+		g_OffscreenTarget->Bind();
+	}
 
 	// load the shader code from the external GLSL files
 	g_ShaderManager->LoadShaders(
@@ -76,34 +302,103 @@ int main(int argc, char* argv[])
 
 	// try to create a new scene manager object and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager->SetWorkerThreadCount(workerThreads);
+	g_SceneManager->SetTextureCompression(compressTextures);
+	g_SceneManager->SetTextureMemoryBudget(static_cast<size_t>(textureBudgetMB) * 1024 * 1024);
+	g_SceneManager->SetFrustumCulling(frustumCulling);
+	g_SceneManager->SetOcclusionCulling(occlusionCulling);
+	g_SceneManager->SetLevelOfDetail(levelOfDetail);
+	g_SceneManager->SetStaticBatching(staticBatching);
+	g_SceneManager->SetGpuDrivenRendering(gpuDriven);
+	g_SceneManager->SetShadowCaching(shadowCaching);
+	g_SceneManager->SetDeferredShading(deferredShading);
+	g_SceneManager->SetDepthPrepass(depthPrepass);
+	g_SceneManager->SetOverdrawHeatmap(overdrawHeatmap);
+	std::chrono::steady_clock::time_point sceneStartTime = std::chrono::steady_clock::now();
 	g_SceneManager->PrepareScene();
+	double sceneMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - sceneStartTime).count();
 
-	// loop will keep running until the application is closed 
-	// or until an error has occurred
-	while (!glfwWindowShouldClose(g_Window))
-	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+	// the camera collides with the scene objects, clicking
+	// picks the object under the view center, R switches
+	// between forward and deferred shading, P turns the depth
+	// pre-pass on and off, O the overdraw heatmap, and F
+	// prints the fill cost of each object in view
+	g_ViewManager->SetCollisionIndex(g_SceneManager->GetSpatialIndex());
+	glfwSetMouseButtonCallback(g_Window, Mouse_Button_Callback);
+	glfwSetKeyCallback(g_Window, Key_Callback);
 
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	g_ShaderManager->ResetNameLookupCount();
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+	// render the first frame and wait for it to complete, so that
+	// the startup time includes everything up to a visible image
+	RenderFrame();
+	glFinish();
+	double firstFrameMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - startTime).count();
+	std::cout << "INFO: Time to first frame: " << firstFrameMilliseconds << " ms (scene "
+		<< sceneMilliseconds << " ms, " << g_SceneManager->GetWorkerThreadCount()
+		<< " decode threads)" << std::endl;
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+	int exitCode = EXIT_SUCCESS;
+	if (benchLights)
+	{
+		exitCode = RunLightCountBenchmark(g_SceneManager, RenderFrame);
+	}
+	else if (benchPrepass)
+	{
+		exitCode = RunDepthPrepassBenchmark(g_SceneManager, RenderFrame);
+	}
+	else if (benchFillCost)
+	{
+		exitCode = RunFillCostReport(g_SceneManager, RenderFrame);
+	}
+	else if (benchPaths)
+	{
+		exitCode = RunCameraPathBenchmark(g_ViewManager, g_SceneManager, pathOptions, RenderFrame);
+	}
+	else if (headless)
+	{
+		exitCode = RunFixedFrames(headlessFrames, RenderFrame);
+		std::cout << "INFO: Final frame hash: " << std::hex << g_OffscreenTarget->HashColorBuffer()
+			<< std::dec << std::endl;
+	}
+	else
+	{
+		if (!recordPath.empty())
+		{
+			g_ViewManager->StartRecording();
+		}
 
+		// loop will keep running until the application is closed 
+		// or until an error has occurred
+		while (!glfwWindowShouldClose(g_Window))
+		{
+			RenderFrame();
+		}
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		if (!recordPath.empty() && g_ViewManager->GetRecordedPath().Save(recordPath.c_str()))
+		{
+			std::cout << "INFO: Recorded " << g_ViewManager->GetRecordedPath().GetKeyCount()
+				<< " camera keys to " << recordPath << std::endl;
+		}
+	}
 
-		// query the latest GLFW events
-		glfwPollEvents();
+	// write the profile while the context is still alive to
+	// read the last GPU results
+	if (Profiler::IsEnabled())
+	{
+		Profiler::ShutdownGPU();
+		Profiler::WriteChromeTrace((profilePath + ".json").c_str());
+		Profiler::WriteSummary((profilePath + ".csv").c_str());
 	}
 
 	// clear the allocated manager objects from memory
+	if (NULL != g_OffscreenTarget)
+	{
+		delete g_OffscreenTarget;
+		g_OffscreenTarget = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
@@ -120,20 +415,176 @@ int main(int argc, char* argv[])
 		g_ShaderManager = NULL;
 	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
+	// Terminates the program
+	exit(exitCode); 
+}
+
+/***********************************************************
+ *	RenderFrame()
+ *
+ *  This function renders and presents one frame of the
+ *  3D scene.
+ ***********************************************************/
+void RenderFrame()
+{
+	Profiler::BeginFrame();
+	PROFILE_GPU_SCOPE("Frame");
+
+	// Enable z-depth
+	glEnable(GL_DEPTH_TEST);
+
+	// Clear the frame and z buffers
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// convert from 3D object space to 2D view
+	g_ViewManager->PrepareSceneView();
+
+	// refresh the 3D scene
+	g_SceneManager->RenderScene(g_ViewManager->GetSceneView());
+	if (g_FillCostReportPending)
+	{
+		PrintFillCostReport(g_SceneManager);
+		g_FillCostReportPending = false;
+	}
+
+	// per frame count of name based uniform lookups, reported
+	// whenever it changes so that it can be kept at zero
+	if (g_ShaderManager->GetNameLookupCount() != g_LastUniformLookups)
+	{
+		g_LastUniformLookups = g_ShaderManager->GetNameLookupCount();
+		std::cout << "INFO: Uniform name lookups per frame: " << g_LastUniformLookups << std::endl;
+	}
+	g_ShaderManager->ResetNameLookupCount();
+
+	// state changes of the file order against the sorted
+	// submission, both counted by walking the draw queue from
+	// nothing bound, reported whenever they change
+	const SceneManager::DRAW_STATE_CHANGES& unsorted = g_SceneManager->GetUnsortedStateChanges();
+	const SceneManager::DRAW_STATE_CHANGES& sorted = g_SceneManager->GetSortedStateChanges();
+	if (StateChangesDiffer(unsorted, g_LastUnsortedChanges) || StateChangesDiffer(sorted, g_LastSortedChanges))
+	{
+		g_LastUnsortedChanges = unsorted;
+		g_LastSortedChanges = sorted;
+		std::cout << "INFO: Predicted state changes per frame (unsorted -> sorted): "
+			<< "textures " << unsorted.textures << " -> " << sorted.textures
+			<< ", VAOs " << unsorted.vertexArrays << " -> " << sorted.vertexArrays
+			<< ", uniforms " << unsorted.uniforms << " -> " << sorted.uniforms << std::endl;
+	}
+
+	// Flips the the back buffer with the front buffer every frame,
+	// headless frames stay in the offscreen target
+	if (NULL == g_OffscreenTarget)
+	{
+		glfwSwapBuffers(g_Window);
+	}
+
+	// query the latest GLFW events
+	glfwPollEvents();
+}
+
+/***********************************************************
+ *	Mouse_Button_Callback()
+ *
+ *  This function is called from GLFW whenever a mouse button
+ *  changes. The cursor is captured by the camera, so a left
+ *  click picks the object at the center of the view.
+ ***********************************************************/
+void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS || NULL == g_SceneManager)
+	{
+		return;
+	}
+
+	glm::vec3 origin;
+	glm::vec3 direction;
+	g_ViewManager->GetViewRay(0.0f, 0.0f, origin, direction);
+
+	SceneBVH::RAY_HIT hit;
+	if (g_SceneManager->PickObject(origin, direction, hit))
+	{
+		std::cout << "INFO: Picked " << g_SceneManager->GetObjectName(hit.object)
+			<< " at " << hit.distance << std::endl;
+	}
+	else
+	{
+		std::cout << "INFO: Picked nothing" << std::endl;
+	}
+}
+
+/***********************************************************
+ *	Key_Callback()
+ *
+ *  This function is called from GLFW whenever a key is
+ *  pressed or released. The camera polls its own keys, so
+ *  only the rendering switches are handled here.
+ ***********************************************************/
+void Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (action != GLFW_PRESS || NULL == g_SceneManager)
+	{
+		return;
+	}
+
+	if (key == GLFW_KEY_R)
+	{
+		g_SceneManager->SetDeferredShading(!g_SceneManager->IsDeferredShading());
+		std::cout << "INFO: " << (g_SceneManager->IsDeferredShading() ? "Deferred" : "Forward")
+			<< " shading" << std::endl;
+	}
+	else if (key == GLFW_KEY_P)
+	{
+		// the counts shown are of the frames before the switch
+		const SceneManager::FRAME_STATS& stats = g_SceneManager->GetFrameStats();
+		std::cout << "INFO: " << stats.shadedFragments << " fragments shaded, "
+			<< stats.prepassFragments << " in the depth pre-pass" << std::endl;
+		g_SceneManager->SetDepthPrepass(!g_SceneManager->IsDepthPrepass());
+		std::cout << "INFO: Depth pre-pass " << (g_SceneManager->IsDepthPrepass() ? "on" : "off") << std::endl;
+	}
+	else if (key == GLFW_KEY_O)
+	{
+		g_SceneManager->SetOverdrawHeatmap(!g_SceneManager->IsOverdrawHeatmap());
+		if (g_SceneManager->IsOverdrawHeatmap())
+		{
+			std::cout << "INFO: Overdraw heatmap on, fragments per pixel: black 0, blue 1, green 2, "
+				<< "yellow 3, red 4, white 5 or more" << std::endl;
+		}
+		else
+		{
+			std::cout << "INFO: Overdraw heatmap off" << std::endl;
+		}
+	}
+	else if (key == GLFW_KEY_F)
+	{
+		g_SceneManager->RequestFillCostMeasurement();
+		g_FillCostReportPending = true;
+	}
 }
 
 /***********************************************************
  *	InitializeGLFW()
  * 
  *  This function is used to initialize the GLFW library.   
+ *  Headless runs use the null platform, which needs no
+ *  display server, with a surfaceless EGL or an OSMesa
+ *  context such as Mesa's llvmpipe.
  ***********************************************************/
-bool InitializeGLFW()
+bool InitializeGLFW(bool headless, bool useOSMesa)
 {
 	// GLFW: initialize and configure library
 	// --------------------------------------
-	glfwInit();
+#ifdef GLFW_PLATFORM_NULL
+	if (headless)
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
+	if (!glfwInit())
+	{
+		std::cout << "ERROR: GLFW INITIALIZATION FAILED" << std::endl;
+		return(false);
+	}
 
 #ifdef __APPLE__
 	// set the version of OpenGL and profile to use
@@ -146,6 +597,18 @@ bool InitializeGLFW()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #endif
+
+	// software rasterizers top out at OpenGL 4.5, which covers
+	// everything the renderer uses
+	if (headless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API,
+			useOSMesa ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+	}
 	// GLFW: end -------------------------------
 
 	return(true);
@@ -155,15 +618,18 @@ bool InitializeGLFW()
  *	InitializeGLEW()
  *
  *  This function is used to initialize the GLEW library.
+ *  glewInit() also sets up the window system extensions,
+ *  which fails without a display, so headless runs only
+ *  load the OpenGL entry points.
  ***********************************************************/
-bool InitializeGLEW()
+bool InitializeGLEW(bool headless)
 {
 	// GLEW: initialize
 	// -----------------------------------------
 	GLenum GLEWInitResult = GLEW_OK;
 
 	// try to initialize the GLEW library
-	GLEWInitResult = glewInit();
+	GLEWInitResult = headless ? glewContextInit() : glewInit();
 	if (GLEW_OK != GLEWInitResult)
 	{
 		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// read-only memory mapping of binary asset files
+//
+//  Used for the compiled scene files so their tables can be read in
+//  place without copying them into separate allocations.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps an entire file into the address space
+ *  for reading, using mmap on POSIX systems and a file
+ *  mapping object on Windows.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// open and map the whole file for reading
+	bool Open(const char* filename);
+	// unmap and close the file
+	void Close();
+
+	// true when a file is currently mapped
+	bool IsOpen() const { return(m_pData != nullptr); }
+	// first byte of the mapped file
+	const unsigned char* GetData() const { return(m_pData); }
+	// size of the mapped file in bytes
+	size_t GetSize() const { return(m_size); }
+
+private:
+	// mapped files own OS handles, so they are not copied
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// start of the mapped view
+	const unsigned char* m_pData;
+	// size of the mapped view
+	size_t m_size;
+#ifdef _WIN32
+	// file and mapping object handles
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	// open file descriptor
+	int m_fileDescriptor;
+#endif
+};
@@ -0,0 +1,449 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.cpp
+// ===================
+// occlusion culling against a small software depth buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <emmintrin.h>
+
+namespace
+{
+	const int TILES_X = OcclusionCuller::BUFFER_WIDTH / OcclusionCuller::TILE_SIZE;
+	const int TILES_Y = OcclusionCuller::BUFFER_HEIGHT / OcclusionCuller::TILE_SIZE;
+
+	// corners of a box by index bits x, y and z, and its faces
+	// wound counter clockwise seen from outside
+	const float g_BoxCorners[8][3] =
+	{
+		{ -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 },
+		{ -1, -1,  1 }, { 1, -1,  1 }, { -1, 1,  1 }, { 1, 1,  1 }
+	};
+	const uint8_t g_BoxFaces[6][4] =
+	{
+		{ 4, 6, 2, 0 }, { 1, 3, 7, 5 }, { 1, 5, 4, 0 },
+		{ 2, 6, 7, 3 }, { 2, 3, 1, 0 }, { 4, 5, 7, 6 }
+	};
+
+	// signed distance of a clip space point inside the near plane
+	float NearDistance(const glm::vec4& point)
+	{
+		return(point.z + point.w);
+	}
+}
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller()
+{
+	m_tileBins.resize(TILES_X * TILES_Y);
+	m_depth.assign(BUFFER_WIDTH * BUFFER_HEIGHT, 1.0f);
+	m_viewProjection = glm::mat4(1.0f);
+	m_pJobSystem = NULL;
+}
+
+/***********************************************************
+ *  ~OcclusionCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+/***********************************************************
+ *  ClearOccluders()
+ ***********************************************************/
+void OcclusionCuller::ClearOccluders()
+{
+	m_occluders.clear();
+}
+
+/***********************************************************
+ *  AddOccluder()
+ ***********************************************************/
+void OcclusionCuller::AddOccluder(const glm::mat4& model, const glm::vec3& localCenter, const glm::vec3& localExtents)
+{
+	OCCLUDER occluder;
+	occluder.model = model;
+	occluder.center = localCenter;
+	occluder.extents = localExtents;
+	m_occluders.push_back(occluder);
+}
+
+/***********************************************************
+ *  RenderOccluders()
+ *
+ *  The faces are set up and binned on the calling thread,
+ *  then each tile is cleared and rasterized as a separate
+ *  job. Tiles never share pixels, so the jobs need no
+ *  locking.
+ ***********************************************************/
+void OcclusionCuller::RenderOccluders(const glm::mat4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	m_faces.clear();
+	for (std::vector<uint32_t>& bin : m_tileBins)
+	{
+		bin.clear();
+	}
+
+	for (const OCCLUDER& occluder : m_occluders)
+	{
+		glm::mat4 modelViewProjection = viewProjection * occluder.model;
+		glm::vec4 corners[8];
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 local = occluder.center + occluder.extents *
+				glm::vec3(g_BoxCorners[i][0], g_BoxCorners[i][1], g_BoxCorners[i][2]);
+			corners[i] = modelViewProjection * glm::vec4(local, 1.0f);
+		}
+
+		// a mirroring model matrix turns the faces inside out
+		bool mirrored = glm::determinant(glm::mat3(occluder.model)) < 0.0f;
+		for (int face = 0; face < 6; face++)
+		{
+			glm::vec4 quad[4];
+			for (int i = 0; i < 4; i++)
+			{
+				quad[i] = corners[g_BoxFaces[face][mirrored ? 3 - i : i]];
+			}
+			AddFace(quad);
+		}
+	}
+
+	const uint32_t tileCount = static_cast<uint32_t>(m_tileBins.size());
+	if (NULL != m_pJobSystem)
+	{
+		m_pJobSystem->ParallelFor(tileCount, 1, [this](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t tile = begin; tile < end; tile++)
+				{
+					RasterizeTile(tile);
+				}
+			});
+	}
+	else
+	{
+		for (uint32_t tile = 0; tile < tileCount; tile++)
+		{
+			RasterizeTile(tile);
+		}
+	}
+}
+
+/***********************************************************
+ *  AddFace()
+ *
+ *  Faces wholly outside one side of the frustum are
+ *  dropped. A face crossing the near plane is cut down to
+ *  the part in front of the camera; the other planes are
+ *  handled by clamping the pixel bounds.
+ ***********************************************************/
+void OcclusionCuller::AddFace(const glm::vec4 quad[4])
+{
+	bool outside[5] = { true, true, true, true, true };
+	for (int i = 0; i < 4; i++)
+	{
+		const glm::vec4& corner = quad[i];
+		outside[0] = outside[0] && corner.x > corner.w;
+		outside[1] = outside[1] && corner.x < -corner.w;
+		outside[2] = outside[2] && corner.y > corner.w;
+		outside[3] = outside[3] && corner.y < -corner.w;
+		outside[4] = outside[4] && corner.z > corner.w;
+	}
+	if (outside[0] || outside[1] || outside[2] || outside[3] || outside[4])
+	{
+		return;
+	}
+
+	float distances[4];
+	bool allInside = true;
+	for (int i = 0; i < 4; i++)
+	{
+		distances[i] = NearDistance(quad[i]);
+		allInside = allInside && distances[i] >= 0.0f;
+	}
+	if (allInside)
+	{
+		BinFace(quad, 4);
+		return;
+	}
+
+	// Sutherland-Hodgman against the near plane keeps the winding
+	glm::vec4 clipped[MAX_FACE_VERTICES];
+	int clippedCount = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		int next = (i + 1) % 4;
+		if (distances[i] >= 0.0f)
+		{
+			clipped[clippedCount++] = quad[i];
+		}
+		if ((distances[i] >= 0.0f) != (distances[next] >= 0.0f))
+		{
+			float t = distances[i] / (distances[i] - distances[next]);
+			clipped[clippedCount++] = quad[i] + (quad[next] - quad[i]) * t;
+		}
+	}
+	if (clippedCount >= 3)
+	{
+		BinFace(clipped, clippedCount);
+	}
+}
+
+/***********************************************************
+ *  BinFace()
+ *
+ *  The edge functions and depth plane of the face are set
+ *  up once here, and the face is added to the bin of each
+ *  tile its pixel bounds overlap.
+ ***********************************************************/
+void OcclusionCuller::BinFace(const glm::vec4* vertices, int vertexCount)
+{
+	float x[MAX_FACE_VERTICES];
+	float y[MAX_FACE_VERTICES];
+	float z[MAX_FACE_VERTICES];
+	for (int i = 0; i < vertexCount; i++)
+	{
+		// the near plane cut keeps w at the near distance or more
+		float inverseW = 1.0f / std::max(vertices[i].w, 1e-6f);
+		x[i] = (vertices[i].x * inverseW * 0.5f + 0.5f) * BUFFER_WIDTH;
+		y[i] = (vertices[i].y * inverseW * 0.5f + 0.5f) * BUFFER_HEIGHT;
+		z[i] = vertices[i].z * inverseW * 0.5f + 0.5f;
+	}
+
+	float minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+	for (int i = 1; i < vertexCount; i++)
+	{
+		minX = std::min(minX, x[i]);
+		maxX = std::max(maxX, x[i]);
+		minY = std::min(minY, y[i]);
+		maxY = std::max(maxY, y[i]);
+	}
+	if (maxX < 0.0f || maxY < 0.0f || minX >= BUFFER_WIDTH || minY >= BUFFER_HEIGHT)
+	{
+		return;
+	}
+
+	// edge i runs from vertex i to the next one, with
+	// E(x, y) = A * x + B * y + C positive inside
+	SCREEN_FACE face;
+	face.edgeCount = vertexCount;
+	float area = 0.0f;
+	for (int i = 0; i < vertexCount; i++)
+	{
+		int next = (i + 1) % vertexCount;
+		face.edgeA[i] = y[i] - y[next];
+		face.edgeB[i] = x[next] - x[i];
+		face.edgeC[i] = x[i] * y[next] - y[i] * x[next];
+		area += face.edgeC[i];
+	}
+	// back facing or edge on
+	if (area <= 0.0f)
+	{
+		return;
+	}
+
+	// the face is planar, so its depth plane is that of the
+	// largest triangle fanned from the first vertex
+	int apex = 1;
+	float apexArea = 0.0f;
+	for (int i = 1; i + 1 < vertexCount; i++)
+	{
+		float fanArea = (x[i] - x[0]) * (y[i + 1] - y[0]) - (x[i + 1] - x[0]) * (y[i] - y[0]);
+		if (fanArea > apexArea)
+		{
+			apex = i;
+			apexArea = fanArea;
+		}
+	}
+	float edgeX1 = x[apex] - x[0], edgeY1 = y[apex] - y[0], edgeZ1 = z[apex] - z[0];
+	float edgeX2 = x[apex + 1] - x[0], edgeY2 = y[apex + 1] - y[0], edgeZ2 = z[apex + 1] - z[0];
+	float inverseArea = 1.0f / std::max(apexArea, 1e-12f);
+	face.depthA = (edgeZ1 * edgeY2 - edgeZ2 * edgeY1) * inverseArea;
+	face.depthB = (edgeZ2 * edgeX1 - edgeZ1 * edgeX2) * inverseArea;
+	face.depthC = z[0] - face.depthA * x[0] - face.depthB * y[0];
+
+	// only pixels the face covers completely are written, with
+	// the farthest depth it has inside them, so a box is never
+	// hidden by a sliver of a pixel
+	for (int i = 0; i < vertexCount; i++)
+	{
+		face.edgeC[i] -= 0.5f * (std::fabs(face.edgeA[i]) + std::fabs(face.edgeB[i]));
+	}
+	face.depthC += 0.5f * (std::fabs(face.depthA) + std::fabs(face.depthB));
+
+	face.minX = std::max(static_cast<int>(minX), 0);
+	face.maxX = std::min(static_cast<int>(maxX), BUFFER_WIDTH - 1);
+	face.minY = std::max(static_cast<int>(minY), 0);
+	face.maxY = std::min(static_cast<int>(maxY), BUFFER_HEIGHT - 1);
+
+	uint32_t faceIndex = static_cast<uint32_t>(m_faces.size());
+	m_faces.push_back(face);
+	for (int tileY = face.minY / TILE_SIZE; tileY <= face.maxY / TILE_SIZE; tileY++)
+	{
+		for (int tileX = face.minX / TILE_SIZE; tileX <= face.maxX / TILE_SIZE; tileX++)
+		{
+			m_tileBins[tileY * TILES_X + tileX].push_back(faceIndex);
+		}
+	}
+}
+
+/***********************************************************
+ *  RasterizeTile()
+ *
+ *  The edge functions and the depth plane are linear in
+ *  the pixel position, so each is evaluated for four pixel
+ *  centers of a row at once and stepped along it. Pixels
+ *  inside every edge keep the nearer depth.
+ ***********************************************************/
+void OcclusionCuller::RasterizeTile(uint32_t tileIndex)
+{
+	const int tileX0 = static_cast<int>(tileIndex % TILES_X) * TILE_SIZE;
+	const int tileY0 = static_cast<int>(tileIndex / TILES_X) * TILE_SIZE;
+	const __m128 farDepth = _mm_set1_ps(1.0f);
+	for (int y = tileY0; y < tileY0 + TILE_SIZE; y++)
+	{
+		float* row = &m_depth[y * BUFFER_WIDTH + tileX0];
+		for (int x = 0; x < TILE_SIZE; x += 4)
+		{
+			_mm_storeu_ps(row + x, farDepth);
+		}
+	}
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for (uint32_t faceIndex : m_tileBins[tileIndex])
+	{
+		const SCREEN_FACE& face = m_faces[faceIndex];
+
+		// rows start on a multiple of 4 pixels, the tiles do too
+		int startX = std::max(face.minX, tileX0) & ~3;
+		int endX = std::min(face.maxX, tileX0 + TILE_SIZE - 1);
+		int startY = std::max(face.minY, tileY0);
+		int endY = std::min(face.maxY, tileY0 + TILE_SIZE - 1);
+
+		const __m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(startX)), laneOffsets);
+		__m128 edgeX[MAX_FACE_VERTICES];
+		__m128 edgeStep[MAX_FACE_VERTICES];
+		for (int i = 0; i < face.edgeCount; i++)
+		{
+			edgeX[i] = _mm_mul_ps(_mm_set1_ps(face.edgeA[i]), pixelX);
+			edgeStep[i] = _mm_set1_ps(face.edgeA[i] * 4.0f);
+		}
+		const __m128 depthX = _mm_mul_ps(_mm_set1_ps(face.depthA), pixelX);
+		const __m128 depthStep = _mm_set1_ps(face.depthA * 4.0f);
+
+		for (int y = startY; y <= endY; y++)
+		{
+			float pixelY = y + 0.5f;
+			__m128 edges[MAX_FACE_VERTICES];
+			for (int i = 0; i < face.edgeCount; i++)
+			{
+				edges[i] = _mm_add_ps(edgeX[i], _mm_set1_ps(face.edgeB[i] * pixelY + face.edgeC[i]));
+			}
+			__m128 depth = _mm_add_ps(depthX, _mm_set1_ps(face.depthB * pixelY + face.depthC));
+
+			float* row = &m_depth[y * BUFFER_WIDTH];
+			for (int x = startX; x <= endX; x += 4)
+			{
+				__m128 inside = _mm_cmpge_ps(edges[0], zero);
+				edges[0] = _mm_add_ps(edges[0], edgeStep[0]);
+				for (int i = 1; i < face.edgeCount; i++)
+				{
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(edges[i], zero));
+					edges[i] = _mm_add_ps(edges[i], edgeStep[i]);
+				}
+				if (_mm_movemask_ps(inside) != 0)
+				{
+					__m128 stored = _mm_loadu_ps(row + x);
+					__m128 nearer = _mm_min_ps(stored, depth);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+				}
+				depth = _mm_add_ps(depth, depthStep);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  IsOccluded()
+ *
+ *  The box is projected to a pixel rectangle and its
+ *  nearest depth. A box reaching in front of the near plane
+ *  or off the buffer is never hidden. Any pixel of the
+ *  rectangle whose stored depth is not nearer than the box
+ *  makes it visible, four pixels at a time.
+ ***********************************************************/
+bool OcclusionCuller::IsOccluded(const glm::vec3& center, const glm::vec3& extents) const
+{
+	glm::vec4 clipCenter = m_viewProjection * glm::vec4(center, 1.0f);
+	glm::vec4 clipX = m_viewProjection[0] * extents.x;
+	glm::vec4 clipY = m_viewProjection[1] * extents.y;
+	glm::vec4 clipZ = m_viewProjection[2] * extents.z;
+
+	float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f;
+	float minDepth = 1.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner = clipCenter +
+			clipX * g_BoxCorners[i][0] + clipY * g_BoxCorners[i][1] + clipZ * g_BoxCorners[i][2];
+		if (NearDistance(corner) <= 0.0f || corner.w <= 0.0f)
+		{
+			return false;
+		}
+		float inverseW = 1.0f / corner.w;
+		float x = corner.x * inverseW;
+		float y = corner.y * inverseW;
+		if (i == 0)
+		{
+			minX = maxX = x;
+			minY = maxY = y;
+		}
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, corner.z * inverseW * 0.5f + 0.5f);
+	}
+
+	// every pixel the rectangle touches is tested
+	int startX = static_cast<int>(std::floor((minX * 0.5f + 0.5f) * BUFFER_WIDTH));
+	int endX = static_cast<int>(std::floor((maxX * 0.5f + 0.5f) * BUFFER_WIDTH));
+	int startY = static_cast<int>(std::floor((minY * 0.5f + 0.5f) * BUFFER_HEIGHT));
+	int endY = static_cast<int>(std::floor((maxY * 0.5f + 0.5f) * BUFFER_HEIGHT));
+	if (startX < 0 || startY < 0 || endX >= BUFFER_WIDTH || endY >= BUFFER_HEIGHT)
+	{
+		return false;
+	}
+
+	const __m128 boxDepth = _mm_set1_ps(minDepth);
+	const __m128 laneX = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 firstX = _mm_set1_ps(static_cast<float>(startX));
+	const __m128 lastX = _mm_set1_ps(static_cast<float>(endX));
+	for (int y = startY; y <= endY; y++)
+	{
+		const float* row = &m_depth[y * BUFFER_WIDTH];
+		for (int x = startX & ~3; x <= endX; x += 4)
+		{
+			__m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneX);
+			__m128 inRect = _mm_and_ps(_mm_cmpge_ps(pixelX, firstX), _mm_cmple_ps(pixelX, lastX));
+			__m128 uncovered = _mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth);
+			if (_mm_movemask_ps(_mm_and_ps(inRect, uncovered)) != 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
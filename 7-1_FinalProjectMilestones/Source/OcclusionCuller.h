@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.h
+// =================
+// occlusion culling against a small software depth buffer
+//
+//  A few large occluders are drawn as boxes into a low resolution depth
+//  buffer on the CPU. The buffer is split into tiles that are rasterized
+//  in parallel, four pixels at a time with SSE. Only pixels a face covers
+//  completely are written, at the farthest depth the face has in them.
+//  The screen rectangle of an object box is then compared with the
+//  buffer, and the object is hidden when every pixel under it holds an
+//  occluder nearer than the nearest corner of the box. Occluder boxes
+//  must lie inside the objects they stand for, so nothing visible is
+//  ever hidden.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class draws the occluders of a view into a depth
+ *  buffer and tests object boxes against it.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// depth buffer size in pixels, multiples of the tile size
+	static const int BUFFER_WIDTH = 320;
+	static const int BUFFER_HEIGHT = 192;
+	static const int TILE_SIZE = 64;
+
+	// constructor
+	OcclusionCuller();
+	// destructor
+	~OcclusionCuller();
+
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	// jobs rasterizing the tiles, NULL rasterizes them all on
+	// the calling thread
+	void SetJobSystem(JobSystem* pJobSystem) { m_pJobSystem = pJobSystem; }
+
+	// remove every occluder
+	void ClearOccluders();
+	// add a local box, taken through a model matrix, that is
+	// drawn into the depth buffer
+	void AddOccluder(const glm::mat4& model, const glm::vec3& localCenter, const glm::vec3& localExtents);
+	uint32_t GetOccluderCount() const { return(static_cast<uint32_t>(m_occluders.size())); }
+
+	// clear the depth buffer and draw the occluders as seen
+	// through a combined projection * view matrix
+	void RenderOccluders(const glm::mat4& viewProjection);
+	// true when the world space box is hidden behind the
+	// occluders drawn by the last RenderOccluders()
+	bool IsOccluded(const glm::vec3& center, const glm::vec3& extents) const;
+
+	// box faces drawn by the last RenderOccluders(), after back
+	// faces and faces off the screen are dropped
+	uint32_t GetFaceCount() const { return(static_cast<uint32_t>(m_faces.size())); }
+	// depth of each pixel from 0 at the near plane to 1 at the
+	// far plane, bottom row first
+	const std::vector<float>& GetDepthBuffer() const { return(m_depth); }
+
+private:
+	// occluder box and its placement
+	struct OCCLUDER
+	{
+		glm::mat4 model;
+		glm::vec3 center;
+		glm::vec3 extents;
+	};
+
+	// a box face cut by the near plane has one corner more
+	static const int MAX_FACE_VERTICES = 5;
+
+	// convex face set up for rasterizing, as edge functions
+	// and a depth plane over pixel coordinates
+	struct SCREEN_FACE
+	{
+		float edgeA[MAX_FACE_VERTICES];
+		float edgeB[MAX_FACE_VERTICES];
+		float edgeC[MAX_FACE_VERTICES];
+		int edgeCount;
+		float depthA;
+		float depthB;
+		float depthC;
+		// pixel bounds clamped to the buffer
+		int minX;
+		int maxX;
+		int minY;
+		int maxY;
+	};
+
+	// clip a clip space box face against the near plane and
+	// add what is left to the tile bins
+	void AddFace(const glm::vec4 quad[4]);
+	// set up a clip space face in front of the near plane and
+	// add it to the bins of the tiles it overlaps
+	void BinFace(const glm::vec4* vertices, int vertexCount);
+	// clear one tile and draw the faces binned to it
+	void RasterizeTile(uint32_t tileIndex);
+
+	std::vector<OCCLUDER> m_occluders;
+	std::vector<SCREEN_FACE> m_faces;
+	// faces overlapping each tile, rows of tiles bottom first
+	std::vector<std::vector<uint32_t>> m_tileBins;
+	std::vector<float> m_depth;
+	glm::mat4 m_viewProjection;
+	// not owned, NULL when the tiles are rasterized on the
+	// calling thread
+	JobSystem* m_pJobSystem;
+};
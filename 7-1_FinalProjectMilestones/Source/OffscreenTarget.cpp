@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// offscreentarget.cpp
+// ===================
+// framebuffer object the scene is rendered into in headless mode
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OffscreenTarget.h"
+
+#include <iostream>
+#include <vector>
+
+/***********************************************************
+ *  OffscreenTarget()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OffscreenTarget::OffscreenTarget()
+{
+	m_framebuffer = 0;
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~OffscreenTarget()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OffscreenTarget::~OffscreenTarget()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ ***********************************************************/
+bool OffscreenTarget::Create(int width, int height)
+{
+	Destroy();
+
+	m_width = width;
+	m_height = height;
+
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR: OFFSCREEN FRAMEBUFFER INCOMPLETE: 0x" << std::hex << status
+			<< std::dec << std::endl;
+		Destroy();
+		return false;
+	}
+
+	std::cout << "INFO: Rendering offscreen at " << width << "x" << height << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  Bind()
+ ***********************************************************/
+void OffscreenTarget::Bind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+}
+
+/***********************************************************
+ *  Destroy()
+ ***********************************************************/
+void OffscreenTarget::Destroy()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (m_colorBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		m_colorBuffer = 0;
+	}
+	if (m_depthBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_depthBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  HashColorBuffer()
+ ***********************************************************/
+uint64_t OffscreenTarget::HashColorBuffer() const
+{
+	std::vector<unsigned char> pixels(static_cast<size_t>(m_width) * m_height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char value : pixels)
+	{
+		hash ^= value;
+		hash *= 1099511628211ULL;
+	}
+	return(hash);
+}
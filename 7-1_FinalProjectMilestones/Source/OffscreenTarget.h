@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+// offscreentarget.h
+// =================
+// framebuffer object the scene is rendered into in headless mode
+//
+//  A headless context has no default framebuffer worth drawing to, so
+//  the frames go to a color and depth renderbuffer pair of the window
+//  size instead. The target stays bound for the whole run.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+/***********************************************************
+ *  OffscreenTarget
+ *
+ *  This class owns the framebuffer object used instead of
+ *  a visible window.
+ ***********************************************************/
+class OffscreenTarget
+{
+public:
+	// constructor
+	OffscreenTarget();
+	// destructor
+	~OffscreenTarget();
+
+	// create the framebuffer and its attachments, false when
+	// the framebuffer is incomplete
+	bool Create(int width, int height);
+	// bind the framebuffer for drawing and set the viewport
+	void Bind() const;
+	// release the framebuffer and its attachments
+	void Destroy();
+
+	// 64-bit FNV-1a hash of the color attachment, so runs can
+	// be checked for identical output
+	uint64_t HashColorBuffer() const;
+
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+
+private:
+	GLuint m_framebuffer;
+	GLuint m_colorBuffer;
+	GLuint m_depthBuffer;
+	int m_width;
+	int m_height;
+};
@@ -0,0 +1,717 @@
+///////////////////////////////////////////////////////////////////////////////
+// primitivemeshes.cpp
+// ===================
+// primitive meshes drawn with per-instance transforms and colors
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PrimitiveMeshes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace
+{
+	// tessellation of the round primitives at each level
+	const int ROUND_SEGMENTS[PrimitiveMeshes::MAX_LOD_LEVELS] = { 36, 16, 8, 5 };
+	const int SPHERE_STACKS[PrimitiveMeshes::MAX_LOD_LEVELS] = { 18, 8, 4, 3 };
+
+	// screen diameter in pixels below which the next coarser
+	// level is drawn
+	const float LOD_SWITCH_PIXELS[PrimitiveMeshes::MAX_LOD_LEVELS - 1] = { 160.0f, 48.0f, 12.0f };
+	// a level is kept until the size moves this fraction past
+	// its switch point, so objects near one do not flicker
+	const float LOD_HYSTERESIS = 0.2f;
+
+	const float PI = 3.14159265358979f;
+
+	// first vertex attribute location of the instance data
+	const GLuint INSTANCE_MODEL_LOCATION = 3;
+	const GLuint INSTANCE_COLOR_LOCATION = 7;
+	const GLuint INSTANCE_MATERIAL_LOCATION = 8;
+}
+
+/***********************************************************
+ *  PrimitiveMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PrimitiveMeshes::PrimitiveMeshes()
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		m_meshes[i].vao = 0;
+		m_meshes[i].vbo = 0;
+		m_meshes[i].ibo = 0;
+		m_meshes[i].baseVertex = 0;
+		m_meshes[i].lodCount = 0;
+		m_meshes[i].boundsCenter = glm::vec3(0.0f);
+		m_meshes[i].boundsExtents = glm::vec3(0.0f);
+	}
+	m_identityBuffer = 0;
+	m_meshVertexArray = 0;
+	m_meshVertexBuffer = 0;
+	m_meshIndexBuffer = 0;
+	m_boundVertexArray = 0;
+}
+
+/***********************************************************
+ *  ~PrimitiveMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PrimitiveMeshes::~PrimitiveMeshes()
+{
+	if (m_meshVertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_meshVertexArray);
+		glDeleteBuffers(1, &m_meshVertexBuffer);
+		glDeleteBuffers(1, &m_meshIndexBuffer);
+		m_meshVertexArray = 0;
+	}
+	for (GL_MESH& batch : m_staticBatches)
+	{
+		glDeleteVertexArrays(1, &batch.vao);
+		glDeleteBuffers(1, &batch.vbo);
+		glDeleteBuffers(1, &batch.ibo);
+	}
+	m_staticBatches.clear();
+	if (m_identityBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_identityBuffer);
+		m_identityBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method builds the geometry of every primitive and
+ *  uploads it all into one vertex and index buffer, each
+ *  mesh at its own base vertex and every tessellation level
+ *  of a round shape at its own index range. Any mix of
+ *  meshes can then be drawn from the one vertex array,
+ *  which is what the indirect draws rely on.
+ ***********************************************************/
+void PrimitiveMeshes::LoadMeshes()
+{
+	std::vector<VERTEX> allVertices;
+	std::vector<uint32_t> allIndices;
+	std::vector<VERTEX> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<GLsizei> lodFirstIndices;
+
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		vertices.clear();
+		indices.clear();
+		lodFirstIndices.clear();
+
+		if (meshID == MESH_PLANE || meshID == MESH_BOX)
+		{
+			lodFirstIndices.push_back(0);
+			if (meshID == MESH_PLANE)
+				BuildPlane(vertices, indices);
+			else
+				BuildBox(vertices, indices);
+		}
+		else
+		{
+			for (int lod = 0; lod < MAX_LOD_LEVELS; lod++)
+			{
+				lodFirstIndices.push_back(static_cast<GLsizei>(indices.size()));
+				if (meshID == MESH_CYLINDER)
+					BuildCylinder(ROUND_SEGMENTS[lod], vertices, indices);
+				else if (meshID == MESH_CONE)
+					BuildCone(ROUND_SEGMENTS[lod], vertices, indices);
+				else
+					BuildSphere(ROUND_SEGMENTS[lod], SPHERE_STACKS[lod], vertices, indices);
+			}
+		}
+
+		AddMesh(static_cast<SCENE_MESH_ID>(meshID), vertices, indices, lodFirstIndices, allVertices, allIndices);
+	}
+
+	glGenVertexArrays(1, &m_meshVertexArray);
+	glGenBuffers(1, &m_meshVertexBuffer);
+	glGenBuffers(1, &m_meshIndexBuffer);
+
+	glBindVertexArray(m_meshVertexArray);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_meshVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, allVertices.size() * sizeof(VERTEX), allVertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_meshIndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, allIndices.size() * sizeof(uint32_t), allIndices.data(), GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)offsetof(VERTEX, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)offsetof(VERTEX, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)offsetof(VERTEX, textureCoordinate));
+
+	UnbindVertexArray();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		m_meshes[meshID].vao = m_meshVertexArray;
+	}
+}
+
+/***********************************************************
+ *  AddMesh()
+ ***********************************************************/
+void PrimitiveMeshes::AddMesh(
+	SCENE_MESH_ID meshID,
+	const std::vector<VERTEX>& vertices,
+	const std::vector<uint32_t>& indices,
+	const std::vector<GLsizei>& lodFirstIndices,
+	std::vector<VERTEX>& allVertices,
+	std::vector<uint32_t>& allIndices)
+{
+	GL_MESH& mesh = m_meshes[meshID];
+	const GLsizei firstIndex = static_cast<GLsizei>(allIndices.size());
+	mesh.baseVertex = static_cast<GLint>(allVertices.size());
+	allVertices.insert(allVertices.end(), vertices.begin(), vertices.end());
+	allIndices.insert(allIndices.end(), indices.begin(), indices.end());
+
+	mesh.lodCount = std::min(static_cast<int>(lodFirstIndices.size()), MAX_LOD_LEVELS);
+	for (int lod = 0; lod < mesh.lodCount; lod++)
+	{
+		GLsizei lodEnd = (lod + 1 < mesh.lodCount) ?
+			lodFirstIndices[lod + 1] : static_cast<GLsizei>(indices.size());
+		mesh.lodFirstIndex[lod] = firstIndex + lodFirstIndices[lod];
+		mesh.lodIndexCount[lod] = lodEnd - lodFirstIndices[lod];
+	}
+
+	glm::vec3 boundsMin(0.0f);
+	glm::vec3 boundsMax(0.0f);
+	if (!vertices.empty())
+	{
+		boundsMin = boundsMax = vertices[0].position;
+	}
+	for (const VERTEX& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	mesh.boundsCenter = (boundsMin + boundsMax) * 0.5f;
+	mesh.boundsExtents = (boundsMax - boundsMin) * 0.5f;
+}
+
+/***********************************************************
+ *  SetInstanceBuffer()
+ *
+ *  This method points the instance attributes of the mesh
+ *  vertex array at the given buffer, advancing once per
+ *  instance.
+ ***********************************************************/
+void PrimitiveMeshes::SetInstanceBuffer(GLuint instanceBuffer)
+{
+	if (m_meshVertexArray != 0)
+	{
+		glBindVertexArray(m_meshVertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+		// a mat4 attribute takes one location per column
+		for (GLuint column = 0; column < 4; column++)
+		{
+			GLuint location = INSTANCE_MODEL_LOCATION + column;
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+				(void*)(offsetof(INSTANCE_DATA, model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(location, 1);
+		}
+		glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+		glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA),
+			(void*)offsetof(INSTANCE_DATA, color));
+		glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+		glEnableVertexAttribArray(INSTANCE_MATERIAL_LOCATION);
+		glVertexAttribIPointer(INSTANCE_MATERIAL_LOCATION, 2, GL_INT, sizeof(INSTANCE_DATA),
+			(void*)offsetof(INSTANCE_DATA, materialIndex));
+		glVertexAttribDivisor(INSTANCE_MATERIAL_LOCATION, 1);
+	}
+
+	UnbindVertexArray();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DrawMeshInstanced()
+ ***********************************************************/
+void PrimitiveMeshes::DrawMeshInstanced(
+	SCENE_MESH_ID meshID,
+	int lod,
+	uint32_t instanceCount,
+	uint32_t firstInstance) const
+{
+	const GL_MESH& mesh = m_meshes[meshID];
+	if (mesh.vao == 0 || instanceCount == 0 || lod < 0 || lod >= mesh.lodCount)
+	{
+		return;
+	}
+
+	BindVertexArray(mesh.vao);
+	glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, mesh.lodIndexCount[lod], GL_UNSIGNED_INT,
+		(void*)(mesh.lodFirstIndex[lod] * sizeof(uint32_t)), instanceCount, mesh.baseVertex, firstInstance);
+}
+
+/***********************************************************
+ *  GetLodRange()
+ ***********************************************************/
+void PrimitiveMeshes::GetLodRange(
+	SCENE_MESH_ID meshID,
+	int lod,
+	GLuint& indexCount,
+	GLuint& firstIndex,
+	GLint& baseVertex) const
+{
+	const GL_MESH& mesh = m_meshes[meshID];
+	lod = std::min(std::max(lod, 0), std::max(mesh.lodCount - 1, 0));
+	indexCount = static_cast<GLuint>(mesh.lodIndexCount[lod]);
+	firstIndex = static_cast<GLuint>(mesh.lodFirstIndex[lod]);
+	baseVertex = mesh.baseVertex;
+}
+
+/***********************************************************
+ *  DrawMeshesIndirect()
+ ***********************************************************/
+void PrimitiveMeshes::DrawMeshesIndirect(GLuint commandBuffer, uint32_t firstCommand, uint32_t commandCount) const
+{
+	if (m_meshVertexArray == 0 || commandCount == 0)
+	{
+		return;
+	}
+
+	BindVertexArray(m_meshVertexArray);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		(void*)(firstCommand * sizeof(DRAW_COMMAND)), static_cast<GLsizei>(commandCount), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetLodThresholds()
+ ***********************************************************/
+void PrimitiveMeshes::GetLodThresholds(float switchPixels[MAX_LOD_LEVELS - 1], float& hysteresis)
+{
+	for (int lod = 0; lod < MAX_LOD_LEVELS - 1; lod++)
+	{
+		switchPixels[lod] = LOD_SWITCH_PIXELS[lod];
+	}
+	hysteresis = LOD_HYSTERESIS;
+}
+
+/***********************************************************
+ *  SelectLod()
+ *
+ *  A level switches to a finer one only once the object is
+ *  the hysteresis fraction larger than the switch point,
+ *  and to a coarser one once it is that much smaller.
+ ***********************************************************/
+int PrimitiveMeshes::SelectLod(SCENE_MESH_ID meshID, float screenDiameter, int currentLod) const
+{
+	int lastLod = m_meshes[meshID].lodCount - 1;
+	int lod = std::min(std::max(currentLod, 0), std::max(lastLod, 0));
+	while (lod > 0 && screenDiameter > LOD_SWITCH_PIXELS[lod - 1] * (1.0f + LOD_HYSTERESIS))
+	{
+		lod--;
+	}
+	while (lod < lastLod && screenDiameter < LOD_SWITCH_PIXELS[lod] * (1.0f - LOD_HYSTERESIS))
+	{
+		lod++;
+	}
+	return(lod);
+}
+
+/***********************************************************
+ *  GetTriangleCount()
+ ***********************************************************/
+uint32_t PrimitiveMeshes::GetTriangleCount(SCENE_MESH_ID meshID, int lod) const
+{
+	if (lod < 0 || lod >= m_meshes[meshID].lodCount)
+	{
+		return(0);
+	}
+	return(static_cast<uint32_t>(m_meshes[meshID].lodIndexCount[lod] / 3));
+}
+
+/***********************************************************
+ *  CreateStaticBatch()
+ *
+ *  This method copies the finest level of each object's
+ *  mesh into one vertex and index buffer, with positions
+ *  taken through the object's model matrix and its color,
+ *  material and texture layer stored in every vertex. The
+ *  model matrix attribute reads a single identity matrix.
+ ***********************************************************/
+int PrimitiveMeshes::CreateStaticBatch(const std::vector<STATIC_OBJECT>& objects)
+{
+	std::vector<VERTEX> meshVertices[MESH_COUNT];
+	std::vector<uint32_t> meshIndices[MESH_COUNT];
+	std::vector<STATIC_VERTEX> vertices;
+	std::vector<uint32_t> indices;
+	for (const STATIC_OBJECT& object : objects)
+	{
+		if (meshVertices[object.meshID].empty())
+		{
+			BuildMesh(object.meshID, meshVertices[object.meshID], meshIndices[object.meshID]);
+		}
+
+		uint32_t first = static_cast<uint32_t>(vertices.size());
+		for (const VERTEX& vertex : meshVertices[object.meshID])
+		{
+			STATIC_VERTEX merged;
+			merged.position = glm::vec3(object.model * glm::vec4(vertex.position, 1.0f));
+			// the shader lights with the mesh normals as they are,
+			// so they are not transformed
+			merged.normal = vertex.normal;
+			merged.textureCoordinate = vertex.textureCoordinate;
+			merged.color = object.color;
+			merged.materialIndex = object.materialIndex;
+			merged.textureLayer = object.textureLayer;
+			vertices.push_back(merged);
+		}
+		for (uint32_t index : meshIndices[object.meshID])
+		{
+			indices.push_back(first + index);
+		}
+	}
+
+	if (m_identityBuffer == 0)
+	{
+		const glm::mat4 identity(1.0f);
+		glGenBuffers(1, &m_identityBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, m_identityBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(identity), &identity, GL_STATIC_DRAW);
+	}
+
+	GL_MESH batch;
+	batch.baseVertex = 0;
+	glGenVertexArrays(1, &batch.vao);
+	glGenBuffers(1, &batch.vbo);
+	glGenBuffers(1, &batch.ibo);
+
+	glBindVertexArray(batch.vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(STATIC_VERTEX), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(STATIC_VERTEX), (void*)offsetof(STATIC_VERTEX, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(STATIC_VERTEX), (void*)offsetof(STATIC_VERTEX, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(STATIC_VERTEX), (void*)offsetof(STATIC_VERTEX, textureCoordinate));
+	glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+	glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(STATIC_VERTEX),
+		(void*)offsetof(STATIC_VERTEX, color));
+	glEnableVertexAttribArray(INSTANCE_MATERIAL_LOCATION);
+	glVertexAttribIPointer(INSTANCE_MATERIAL_LOCATION, 2, GL_INT, sizeof(STATIC_VERTEX),
+		(void*)offsetof(STATIC_VERTEX, materialIndex));
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_identityBuffer);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		GLuint location = INSTANCE_MODEL_LOCATION + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+			(void*)(column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(location, 1);
+	}
+
+	UnbindVertexArray();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	batch.lodCount = 1;
+	batch.lodFirstIndex[0] = 0;
+	batch.lodIndexCount[0] = static_cast<GLsizei>(indices.size());
+
+	glm::vec3 boundsMin(0.0f);
+	glm::vec3 boundsMax(0.0f);
+	if (!vertices.empty())
+	{
+		boundsMin = boundsMax = vertices[0].position;
+	}
+	for (const STATIC_VERTEX& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	batch.boundsCenter = (boundsMin + boundsMax) * 0.5f;
+	batch.boundsExtents = (boundsMax - boundsMin) * 0.5f;
+
+	m_staticBatches.push_back(batch);
+	return(static_cast<int>(m_staticBatches.size()) - 1);
+}
+
+/***********************************************************
+ *  DrawStaticBatch()
+ ***********************************************************/
+void PrimitiveMeshes::DrawStaticBatch(int batchIndex) const
+{
+	if (batchIndex < 0 || batchIndex >= static_cast<int>(m_staticBatches.size()))
+	{
+		return;
+	}
+
+	const GL_MESH& batch = m_staticBatches[batchIndex];
+	BindVertexArray(batch.vao);
+	glDrawElements(GL_TRIANGLES, batch.lodIndexCount[0], GL_UNSIGNED_INT, NULL);
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ ***********************************************************/
+void PrimitiveMeshes::BindVertexArray(GLuint vertexArray) const
+{
+	if (vertexArray == m_boundVertexArray)
+	{
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	m_boundVertexArray = vertexArray;
+}
+
+/***********************************************************
+ *  UnbindVertexArray()
+ ***********************************************************/
+void PrimitiveMeshes::UnbindVertexArray()
+{
+	glBindVertexArray(0);
+	m_boundVertexArray = 0;
+}
+
+/***********************************************************
+ *  GetStaticTriangleCount()
+ ***********************************************************/
+uint32_t PrimitiveMeshes::GetStaticTriangleCount(int batchIndex) const
+{
+	if (batchIndex < 0 || batchIndex >= static_cast<int>(m_staticBatches.size()))
+	{
+		return(0);
+	}
+	return(static_cast<uint32_t>(m_staticBatches[batchIndex].lodIndexCount[0] / 3));
+}
+
+/***********************************************************
+ *  BuildMesh()
+ ***********************************************************/
+void PrimitiveMeshes::BuildMesh(SCENE_MESH_ID meshID, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices)
+{
+	vertices.clear();
+	indices.clear();
+	switch (meshID)
+	{
+	case MESH_PLANE:
+		BuildPlane(vertices, indices);
+		break;
+	case MESH_BOX:
+		BuildBox(vertices, indices);
+		break;
+	case MESH_CYLINDER:
+		BuildCylinder(ROUND_SEGMENTS[0], vertices, indices);
+		break;
+	case MESH_CONE:
+		BuildCone(ROUND_SEGMENTS[0], vertices, indices);
+		break;
+	default:
+		BuildSphere(ROUND_SEGMENTS[0], SPHERE_STACKS[0], vertices, indices);
+		break;
+	}
+}
+
+/***********************************************************
+ *  GetLocalBounds()
+ ***********************************************************/
+void PrimitiveMeshes::GetLocalBounds(SCENE_MESH_ID meshID, glm::vec3& center, glm::vec3& extents) const
+{
+	center = m_meshes[meshID].boundsCenter;
+	extents = m_meshes[meshID].boundsExtents;
+}
+
+/***********************************************************
+ *  BuildPlane()
+ *
+ *  A square of size 2 on the XZ plane facing up.
+ ***********************************************************/
+void PrimitiveMeshes::BuildPlane(std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices)
+{
+	const glm::vec3 up(0.0f, 1.0f, 0.0f);
+	vertices = {
+		{ glm::vec3(-1.0f, 0.0f,  1.0f), up, glm::vec2(0.0f, 0.0f) },
+		{ glm::vec3( 1.0f, 0.0f,  1.0f), up, glm::vec2(1.0f, 0.0f) },
+		{ glm::vec3( 1.0f, 0.0f, -1.0f), up, glm::vec2(1.0f, 1.0f) },
+		{ glm::vec3(-1.0f, 0.0f, -1.0f), up, glm::vec2(0.0f, 1.0f) } };
+	indices = { 0, 1, 2, 0, 2, 3 };
+}
+
+/***********************************************************
+ *  BuildBox()
+ *
+ *  A unit cube centered on the origin, with its own
+ *  normals and texture coordinates on each face.
+ ***********************************************************/
+void PrimitiveMeshes::BuildBox(std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices)
+{
+	// face normal and the two face axes, ordered so that
+	// right x up points along the normal
+	const glm::vec3 faces[6][3] = {
+		{ glm::vec3( 1, 0, 0), glm::vec3( 0, 0, -1), glm::vec3(0, 1,  0) },
+		{ glm::vec3(-1, 0, 0), glm::vec3( 0, 0,  1), glm::vec3(0, 1,  0) },
+		{ glm::vec3( 0, 1, 0), glm::vec3( 1, 0,  0), glm::vec3(0, 0, -1) },
+		{ glm::vec3( 0,-1, 0), glm::vec3( 1, 0,  0), glm::vec3(0, 0,  1) },
+		{ glm::vec3( 0, 0, 1), glm::vec3( 1, 0,  0), glm::vec3(0, 1,  0) },
+		{ glm::vec3( 0, 0,-1), glm::vec3(-1, 0,  0), glm::vec3(0, 1,  0) } };
+
+	vertices.clear();
+	indices.clear();
+	for (int face = 0; face < 6; face++)
+	{
+		const glm::vec3& normal = faces[face][0];
+		const glm::vec3& right = faces[face][1];
+		const glm::vec3& up = faces[face][2];
+		uint32_t first = static_cast<uint32_t>(vertices.size());
+
+		vertices.push_back({ (normal - right - up) * 0.5f, normal, glm::vec2(0.0f, 0.0f) });
+		vertices.push_back({ (normal + right - up) * 0.5f, normal, glm::vec2(1.0f, 0.0f) });
+		vertices.push_back({ (normal + right + up) * 0.5f, normal, glm::vec2(1.0f, 1.0f) });
+		vertices.push_back({ (normal - right + up) * 0.5f, normal, glm::vec2(0.0f, 1.0f) });
+
+		indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+	}
+}
+
+/***********************************************************
+ *  BuildCylinder()
+ *
+ *  A cylinder of radius 1 standing on the origin, 1 unit
+ *  tall, with both ends capped.
+ ***********************************************************/
+void PrimitiveMeshes::BuildCylinder(int segments, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices)
+{
+	// side wall, the seam column is duplicated for the UVs
+	const uint32_t first = static_cast<uint32_t>(vertices.size());
+	for (int i = 0; i <= segments; i++)
+	{
+		float u = static_cast<float>(i) / segments;
+		float angle = u * 2.0f * PI;
+		glm::vec3 normal(std::sin(angle), 0.0f, std::cos(angle));
+		vertices.push_back({ normal, normal, glm::vec2(u, 0.0f) });
+		vertices.push_back({ normal + glm::vec3(0.0f, 1.0f, 0.0f), normal, glm::vec2(u, 1.0f) });
+	}
+	for (uint32_t i = 0; i < static_cast<uint32_t>(segments); i++)
+	{
+		uint32_t bottom = first + i * 2;
+		indices.insert(indices.end(), { bottom, bottom + 2, bottom + 3, bottom, bottom + 3, bottom + 1 });
+	}
+
+	// top and bottom caps
+	for (int cap = 0; cap < 2; cap++)
+	{
+		float height = (cap == 0) ? 1.0f : 0.0f;
+		glm::vec3 normal(0.0f, (cap == 0) ? 1.0f : -1.0f, 0.0f);
+		uint32_t center = static_cast<uint32_t>(vertices.size());
+		vertices.push_back({ glm::vec3(0.0f, height, 0.0f), normal, glm::vec2(0.5f, 0.5f) });
+		for (int i = 0; i <= segments; i++)
+		{
+			float angle = static_cast<float>(i) / segments * 2.0f * PI;
+			float x = std::sin(angle);
+			float z = std::cos(angle);
+			vertices.push_back({ glm::vec3(x, height, z), normal, glm::vec2(0.5f + 0.5f * x, 0.5f - 0.5f * z) });
+		}
+		for (uint32_t i = 0; i < static_cast<uint32_t>(segments); i++)
+		{
+			if (cap == 0)
+				indices.insert(indices.end(), { center, center + 1 + i, center + 2 + i });
+			else
+				indices.insert(indices.end(), { center, center + 2 + i, center + 1 + i });
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildCone()
+ *
+ *  A cone of radius 1 standing on the origin with its tip
+ *  1 unit up, with the base capped.
+ ***********************************************************/
+void PrimitiveMeshes::BuildCone(int segments, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices)
+{
+	// side, one tip vertex per segment so each gets a normal
+	const float slope = 1.0f / std::sqrt(2.0f);
+	for (uint32_t i = 0; i < static_cast<uint32_t>(segments); i++)
+	{
+		float u0 = static_cast<float>(i) / segments;
+		float u1 = static_cast<float>(i + 1) / segments;
+		float a0 = u0 * 2.0f * PI;
+		float a1 = u1 * 2.0f * PI;
+		float aMid = (a0 + a1) * 0.5f;
+		uint32_t first = static_cast<uint32_t>(vertices.size());
+
+		vertices.push_back({ glm::vec3(std::sin(a0), 0.0f, std::cos(a0)),
+			glm::vec3(std::sin(a0), 1.0f, std::cos(a0)) * slope, glm::vec2(u0, 0.0f) });
+		vertices.push_back({ glm::vec3(std::sin(a1), 0.0f, std::cos(a1)),
+			glm::vec3(std::sin(a1), 1.0f, std::cos(a1)) * slope, glm::vec2(u1, 0.0f) });
+		vertices.push_back({ glm::vec3(0.0f, 1.0f, 0.0f),
+			glm::vec3(std::sin(aMid), 1.0f, std::cos(aMid)) * slope, glm::vec2((u0 + u1) * 0.5f, 1.0f) });
+
+		indices.insert(indices.end(), { first, first + 1, first + 2 });
+	}
+
+	// base cap
+	const glm::vec3 down(0.0f, -1.0f, 0.0f);
+	uint32_t center = static_cast<uint32_t>(vertices.size());
+	vertices.push_back({ glm::vec3(0.0f), down, glm::vec2(0.5f, 0.5f) });
+	for (int i = 0; i <= segments; i++)
+	{
+		float angle = static_cast<float>(i) / segments * 2.0f * PI;
+		float x = std::sin(angle);
+		float z = std::cos(angle);
+		vertices.push_back({ glm::vec3(x, 0.0f, z), down, glm::vec2(0.5f + 0.5f * x, 0.5f + 0.5f * z) });
+	}
+	for (uint32_t i = 0; i < static_cast<uint32_t>(segments); i++)
+	{
+		indices.insert(indices.end(), { center, center + 2 + i, center + 1 + i });
+	}
+}
+
+/***********************************************************
+ *  BuildSphere()
+ *
+ *  A sphere of radius 1 centered on the origin.
+ ***********************************************************/
+void PrimitiveMeshes::BuildSphere(int segments, int stacks, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices)
+{
+	const uint32_t first = static_cast<uint32_t>(vertices.size());
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		float v = static_cast<float>(stack) / stacks;
+		float polar = v * PI;
+		for (int i = 0; i <= segments; i++)
+		{
+			float u = static_cast<float>(i) / segments;
+			float angle = u * 2.0f * PI;
+			glm::vec3 normal(
+				std::sin(polar) * std::sin(angle),
+				std::cos(polar),
+				std::sin(polar) * std::cos(angle));
+			vertices.push_back({ normal, normal, glm::vec2(u, 1.0f - v) });
+		}
+	}
+
+	const uint32_t rowLength = segments + 1;
+	for (uint32_t stack = 0; stack < static_cast<uint32_t>(stacks); stack++)
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(segments); i++)
+		{
+			uint32_t top = first + stack * rowLength + i;
+			uint32_t bottom = top + rowLength;
+			indices.insert(indices.end(), { bottom, bottom + 1, top + 1, bottom, top + 1, top });
+		}
+	}
+}
@@ -0,0 +1,216 @@
+///////////////////////////////////////////////////////////////////////////////
+// primitivemeshes.h
+// =================
+// primitive meshes drawn with per-instance transforms and colors
+//
+//  Builds the same plane, box, cylinder, cone and sphere shapes as
+//  ShapeMeshes, but the vertex array also reads a per-instance model
+//  matrix, color and material from a shared instance buffer, so every
+//  copy of a mesh can be drawn with one call.
+//
+//  Every mesh lives in one vertex and index buffer at its own base vertex,
+//  and the round shapes are built at several tessellation levels stored
+//  one after another, so a mesh or a level of detail is only a different
+//  index range of the same vertex array.
+//
+//  Objects that never move can instead be merged into static batches,
+//  whose vertices are transformed into world space once and carry the
+//  per-instance values themselves, so a whole batch is one draw.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneFile.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  PrimitiveMeshes
+ *
+ *  This class owns the vertex arrays of the primitive
+ *  meshes and issues instanced draws for them.
+ ***********************************************************/
+class PrimitiveMeshes
+{
+public:
+	// constructor
+	PrimitiveMeshes();
+	// destructor
+	~PrimitiveMeshes();
+
+	// most tessellation levels of a mesh, level 0 is the finest
+	static const int MAX_LOD_LEVELS = 4;
+
+	// per-instance values read by the vertex shader, attribute
+	// locations 3-6 (model), 7 (color) and 8 (material and
+	// texture layer)
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		int32_t materialIndex;
+		// layer in the batch's texture array, -1 for color only
+		int32_t textureLayer;
+		int32_t padding[2];
+	};
+
+	// DrawElementsIndirectCommand as read by
+	// glMultiDrawElementsIndirect
+	struct DRAW_COMMAND
+	{
+		GLuint indexCount;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// object merged into a static batch
+	struct STATIC_OBJECT
+	{
+		SCENE_MESH_ID meshID;
+		glm::mat4 model;
+		glm::vec4 color;
+		int32_t materialIndex;
+		// layer in the batch's texture array, -1 for color only
+		int32_t textureLayer;
+	};
+
+	// build the vertex data of every primitive mesh
+	void LoadMeshes();
+	// read the per-instance attributes from this buffer
+	void SetInstanceBuffer(GLuint instanceBuffer);
+
+	// draw instanceCount copies of a mesh level, taking the
+	// instance data from firstInstance onwards in the instance
+	// buffer
+	void DrawMeshInstanced(
+		SCENE_MESH_ID meshID,
+		int lod,
+		uint32_t instanceCount,
+		uint32_t firstInstance) const;
+
+	// index range of a mesh level in the shared index buffer,
+	// as the fields of a draw command
+	void GetLodRange(
+		SCENE_MESH_ID meshID,
+		int lod,
+		GLuint& indexCount,
+		GLuint& firstIndex,
+		GLint& baseVertex) const;
+	// draw the commands of a command buffer with one call, any
+	// mix of meshes and levels
+	void DrawMeshesIndirect(GLuint commandBuffer, uint32_t firstCommand, uint32_t commandCount) const;
+
+	// tessellation levels built for a mesh, 1 for flat shapes
+	int GetLodCount(SCENE_MESH_ID meshID) const { return(m_meshes[meshID].lodCount); }
+	// level to draw a mesh at when its bounding sphere is
+	// screenDiameter pixels across, given the level it was
+	// drawn at before
+	int SelectLod(SCENE_MESH_ID meshID, float screenDiameter, int currentLod) const;
+	// triangles in one copy of a mesh level
+	uint32_t GetTriangleCount(SCENE_MESH_ID meshID, int lod) const;
+	// screen diameters SelectLod() switches levels at, and the
+	// fraction a size must move past one to switch
+	static void GetLodThresholds(float switchPixels[MAX_LOD_LEVELS - 1], float& hysteresis);
+
+	// vertex arrays the draws of a mesh or a static batch bind
+	GLuint GetMeshVertexArray(SCENE_MESH_ID meshID) const { return(m_meshes[meshID].vao); }
+	GLuint GetStaticBatchVertexArray(int batchIndex) const { return(m_staticBatches[batchIndex].vao); }
+	// the draws only bind a vertex array that is not bound
+	// already, so anything else binding one has to go through
+	// this to keep track
+	void UnbindVertexArray();
+
+	// merge objects at their finest level into one vertex array
+	// in world space, returns the index of the static batch
+	int CreateStaticBatch(const std::vector<STATIC_OBJECT>& objects);
+	// draw every object of a static batch with one call
+	void DrawStaticBatch(int batchIndex) const;
+	uint32_t GetStaticBatchCount() const { return(static_cast<uint32_t>(m_staticBatches.size())); }
+	uint32_t GetStaticTriangleCount(int batchIndex) const;
+	// box around the vertices of a mesh in model space
+	void GetLocalBounds(SCENE_MESH_ID meshID, glm::vec3& center, glm::vec3& extents) const;
+
+private:
+	// interleaved vertex as stored in the vertex buffers
+	struct VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+	};
+
+	// GPU objects of one mesh; the primitive meshes share the
+	// mesh vertex array and own no buffers
+	struct GL_MESH
+	{
+		GLuint vao;
+		GLuint vbo;
+		GLuint ibo;
+		// added to every index of the mesh
+		GLint baseVertex;
+		// index range of each tessellation level
+		int lodCount;
+		GLsizei lodFirstIndex[MAX_LOD_LEVELS];
+		GLsizei lodIndexCount[MAX_LOD_LEVELS];
+		// model space box around the vertices
+		glm::vec3 boundsCenter;
+		glm::vec3 boundsExtents;
+	};
+
+	// CPU geometry of the primitives; the round shapes append
+	// one tessellation level with the given segments around
+	static void BuildPlane(std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices);
+	static void BuildBox(std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices);
+	static void BuildCylinder(int segments, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices);
+	static void BuildCone(int segments, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices);
+	static void BuildSphere(int segments, int stacks, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices);
+
+	// vertex of a static batch, with the per-instance values of
+	// its object read from attribute locations 7 and 8
+	struct STATIC_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+		glm::vec4 color;
+		int32_t materialIndex;
+		int32_t textureLayer;
+	};
+
+	// bind a vertex array for drawing unless it is bound already
+	void BindVertexArray(GLuint vertexArray) const;
+
+	// build the finest level of a mesh on the CPU
+	static void BuildMesh(SCENE_MESH_ID meshID, std::vector<VERTEX>& vertices, std::vector<uint32_t>& indices);
+
+	// append the geometry of one mesh to the shared vertex and
+	// index data, with each level starting at an entry of
+	// lodFirstIndices
+	void AddMesh(
+		SCENE_MESH_ID meshID,
+		const std::vector<VERTEX>& vertices,
+		const std::vector<uint32_t>& indices,
+		const std::vector<GLsizei>& lodFirstIndices,
+		std::vector<VERTEX>& allVertices,
+		std::vector<uint32_t>& allIndices);
+
+	// mesh ranges indexed by mesh ID
+	GL_MESH m_meshes[MESH_COUNT];
+	// vertex array and buffers holding every primitive mesh
+	GLuint m_meshVertexArray;
+	GLuint m_meshVertexBuffer;
+	GLuint m_meshIndexBuffer;
+	// merged vertex arrays of the static batches
+	std::vector<GL_MESH> m_staticBatches;
+	// one identity model matrix, the instance value of every
+	// static batch
+	GLuint m_identityBuffer;
+	// vertex array bound by the last bind
+	mutable GLuint m_boundVertexArray;
+};
@@ -0,0 +1,424 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.cpp
+// ============
+// scoped CPU and GPU section timing with trace and summary export
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace
+{
+	// events kept in the ring, a power of two
+	const uint64_t RING_CAPACITY = 1 << 16;
+	// frames a GPU result may take before it is read
+	const int FRAME_LATENCY = 4;
+	// GPU sections recorded per frame
+	const int MAX_GPU_SECTIONS = 64;
+
+	// ring slot, the sequence is the event index plus one once
+	// the event is complete and zero while it is written
+	struct RING_SLOT
+	{
+		std::atomic<uint64_t> sequence;
+		Profiler::PROFILE_EVENT event;
+	};
+
+	// timestamp queries of the GPU sections of one frame
+	struct GPU_FRAME
+	{
+		GLuint queries[MAX_GPU_SECTIONS * 2];
+		const char* names[MAX_GPU_SECTIONS];
+		uint32_t frame;
+		int sectionCount;
+	};
+
+	std::unique_ptr<RING_SLOT[]> g_pRing;
+	std::atomic<uint64_t> g_writeIndex(0);
+	std::atomic<uint32_t> g_frame(0);
+	std::atomic<uint32_t> g_nextThreadID(1);
+	thread_local uint32_t t_threadID = 0;
+
+	// GPU state, only touched by the thread owning the context
+	GPU_FRAME g_gpuFrames[FRAME_LATENCY];
+	bool g_gpuInitialized = false;
+	// added to GPU timestamps to put them on the CPU clock
+	int64_t g_gpuClockOffset = 0;
+	// GPU sections whose results were not ready in time
+	uint64_t g_droppedGPUSections = 0;
+
+	// read the finished sections of a frame, waiting for the
+	// results only when asked to
+	void ResolveGPUFrame(GPU_FRAME& gpuFrame, bool wait, std::vector<Profiler::PROFILE_EVENT>* pEvents)
+	{
+		for (int i = 0; i < gpuFrame.sectionCount; i++)
+		{
+			GLuint available = GL_TRUE;
+			if (!wait)
+			{
+				glGetQueryObjectuiv(gpuFrame.queries[i * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			}
+			if (available != GL_TRUE)
+			{
+				g_droppedGPUSections++;
+				continue;
+			}
+
+			GLuint64 begin = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(gpuFrame.queries[i * 2], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(gpuFrame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+			Profiler::PROFILE_EVENT event;
+			event.name = gpuFrame.names[i];
+			event.startNanoseconds = static_cast<int64_t>(begin) + g_gpuClockOffset;
+			event.durationNanoseconds = static_cast<int64_t>(end - begin);
+			event.threadID = 0;
+			event.frame = gpuFrame.frame;
+			event.gpu = true;
+			pEvents->push_back(event);
+		}
+		gpuFrame.sectionCount = 0;
+	}
+
+	// quote a section name, escaping quotes with the given
+	// character: '\\' for JSON and '"' for CSV
+	std::string QuoteName(const char* name, char escape)
+	{
+		std::string quoted = "\"";
+		for (const char* pChar = name; *pChar != '\0'; pChar++)
+		{
+			if (*pChar == '"' || (*pChar == '\\' && escape == '\\'))
+			{
+				quoted.push_back(escape);
+			}
+			quoted.push_back(*pChar);
+		}
+		quoted.push_back('"');
+		return(quoted);
+	}
+}
+
+std::atomic<bool> Profiler::s_enabled(false);
+
+/***********************************************************
+ *  SetEnabled()
+ ***********************************************************/
+void Profiler::SetEnabled(bool enabled)
+{
+	if (enabled && !g_pRing)
+	{
+		g_pRing.reset(new RING_SLOT[RING_CAPACITY]);
+		for (uint64_t i = 0; i < RING_CAPACITY; i++)
+		{
+			g_pRing[i].sequence.store(0, std::memory_order_relaxed);
+		}
+	}
+	s_enabled.store(enabled, std::memory_order_release);
+}
+
+/***********************************************************
+ *  InitializeGPU()
+ *
+ *  The GPU and CPU clocks are paired once here, which is
+ *  close enough to line the sections up in a trace.
+ ***********************************************************/
+void Profiler::InitializeGPU()
+{
+	if (!IsEnabled() || g_gpuInitialized)
+	{
+		return;
+	}
+
+	for (GPU_FRAME& gpuFrame : g_gpuFrames)
+	{
+		glGenQueries(MAX_GPU_SECTIONS * 2, gpuFrame.queries);
+		gpuFrame.sectionCount = 0;
+		gpuFrame.frame = 0;
+	}
+
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	g_gpuClockOffset = Now() - gpuTime;
+	g_gpuInitialized = true;
+}
+
+/***********************************************************
+ *  ShutdownGPU()
+ ***********************************************************/
+void Profiler::ShutdownGPU()
+{
+	if (!g_gpuInitialized)
+	{
+		return;
+	}
+
+	std::vector<PROFILE_EVENT> events;
+	uint32_t frame = g_frame.load(std::memory_order_relaxed);
+	for (int i = 1; i <= FRAME_LATENCY; i++)
+	{
+		ResolveGPUFrame(g_gpuFrames[(frame + i) % FRAME_LATENCY], true, &events);
+	}
+	for (const PROFILE_EVENT& event : events)
+	{
+		PushEvent(event);
+	}
+
+	for (GPU_FRAME& gpuFrame : g_gpuFrames)
+	{
+		glDeleteQueries(MAX_GPU_SECTIONS * 2, gpuFrame.queries);
+	}
+	g_gpuInitialized = false;
+
+	if (g_droppedGPUSections > 0)
+	{
+		std::cout << "INFO: " << g_droppedGPUSections << " GPU sections were not ready in "
+			<< FRAME_LATENCY << " frames and were dropped" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  The query slot of the new frame was last used
+ *  FRAME_LATENCY frames ago, so its results are read just
+ *  before it is reused.
+ ***********************************************************/
+void Profiler::BeginFrame()
+{
+	uint32_t frame = g_frame.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (!IsEnabled() || !g_gpuInitialized)
+	{
+		return;
+	}
+
+	GPU_FRAME& gpuFrame = g_gpuFrames[frame % FRAME_LATENCY];
+	std::vector<PROFILE_EVENT> events;
+	ResolveGPUFrame(gpuFrame, false, &events);
+	for (const PROFILE_EVENT& event : events)
+	{
+		PushEvent(event);
+	}
+	gpuFrame.frame = frame;
+}
+
+/***********************************************************
+ *  Now()
+ ***********************************************************/
+int64_t Profiler::Now()
+{
+	return(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/***********************************************************
+ *  RecordCPU()
+ ***********************************************************/
+void Profiler::RecordCPU(const char* name, int64_t startNanoseconds, int64_t endNanoseconds)
+{
+	if (t_threadID == 0)
+	{
+		t_threadID = g_nextThreadID.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	PROFILE_EVENT event;
+	event.name = name;
+	event.startNanoseconds = startNanoseconds;
+	event.durationNanoseconds = endNanoseconds - startNanoseconds;
+	event.threadID = t_threadID;
+	event.frame = g_frame.load(std::memory_order_relaxed);
+	event.gpu = false;
+	PushEvent(event);
+}
+
+/***********************************************************
+ *  BeginGPU()
+ ***********************************************************/
+int Profiler::BeginGPU(const char* name)
+{
+	if (!g_gpuInitialized)
+	{
+		return -1;
+	}
+
+	GPU_FRAME& gpuFrame = g_gpuFrames[g_frame.load(std::memory_order_relaxed) % FRAME_LATENCY];
+	if (gpuFrame.sectionCount >= MAX_GPU_SECTIONS)
+	{
+		return -1;
+	}
+
+	int section = gpuFrame.sectionCount++;
+	gpuFrame.names[section] = name;
+	glQueryCounter(gpuFrame.queries[section * 2], GL_TIMESTAMP);
+	return(section);
+}
+
+/***********************************************************
+ *  EndGPU()
+ ***********************************************************/
+void Profiler::EndGPU(int section)
+{
+	GPU_FRAME& gpuFrame = g_gpuFrames[g_frame.load(std::memory_order_relaxed) % FRAME_LATENCY];
+	glQueryCounter(gpuFrame.queries[section * 2 + 1], GL_TIMESTAMP);
+}
+
+/***********************************************************
+ *  PushEvent()
+ *
+ *  Writers claim a slot with one atomic increment and
+ *  never wait. The slot sequence is cleared while the event
+ *  is copied in, so a reader can tell a half written slot.
+ ***********************************************************/
+void Profiler::PushEvent(const PROFILE_EVENT& event)
+{
+	if (!g_pRing)
+	{
+		return;
+	}
+
+	uint64_t index = g_writeIndex.fetch_add(1, std::memory_order_relaxed);
+	RING_SLOT& slot = g_pRing[index & (RING_CAPACITY - 1)];
+	slot.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.event = event;
+	slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+/***********************************************************
+ *  CollectEvents()
+ ***********************************************************/
+std::vector<Profiler::PROFILE_EVENT> Profiler::CollectEvents()
+{
+	std::vector<PROFILE_EVENT> events;
+	if (!g_pRing)
+	{
+		return(events);
+	}
+
+	uint64_t end = g_writeIndex.load(std::memory_order_acquire);
+	uint64_t begin = (end > RING_CAPACITY) ? end - RING_CAPACITY : 0;
+	events.reserve(static_cast<size_t>(end - begin));
+	for (uint64_t index = begin; index < end; index++)
+	{
+		const RING_SLOT& slot = g_pRing[index & (RING_CAPACITY - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+		{
+			continue;
+		}
+		PROFILE_EVENT event = slot.event;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == index + 1)
+		{
+			events.push_back(event);
+		}
+	}
+	return(events);
+}
+
+/***********************************************************
+ *  WriteChromeTrace()
+ *
+ *  CPU sections appear on one track per thread and GPU
+ *  sections on their own track, with times relative to the
+ *  first recorded section.
+ ***********************************************************/
+bool Profiler::WriteChromeTrace(const char* path)
+{
+	std::vector<PROFILE_EVENT> events = CollectEvents();
+	int64_t origin = 0;
+	if (!events.empty())
+	{
+		origin = events[0].startNanoseconds;
+		for (const PROFILE_EVENT& event : events)
+		{
+			origin = std::min(origin, event.startNanoseconds);
+		}
+	}
+
+	std::ofstream output(path, std::ios::trunc);
+	output << "{\"traceEvents\":[\n";
+	output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	output << std::fixed << std::setprecision(3);
+	for (const PROFILE_EVENT& event : events)
+	{
+		output << ",\n{\"name\":" << QuoteName(event.name, '\\')
+			<< ",\"cat\":\"" << (event.gpu ? "gpu" : "cpu") << "\""
+			<< ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadID
+			<< ",\"ts\":" << (event.startNanoseconds - origin) / 1000.0
+			<< ",\"dur\":" << event.durationNanoseconds / 1000.0
+			<< ",\"args\":{\"frame\":" << event.frame << "}}";
+	}
+	output << "\n]}\n";
+
+	if (!output)
+	{
+		std::cout << "ERROR: COULD NOT WRITE PROFILE TRACE: " << path << std::endl;
+		return false;
+	}
+	std::cout << "INFO: Wrote " << events.size() << " profile events to " << path << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  WriteSummary()
+ *
+ *  Percentiles use the nearest rank of the section times
+ *  still held in the ring.
+ ***********************************************************/
+bool Profiler::WriteSummary(const char* path)
+{
+	std::map<std::pair<std::string, bool>, std::vector<int64_t>> sections;
+	for (const PROFILE_EVENT& event : CollectEvents())
+	{
+		sections[std::make_pair(std::string(event.name), event.gpu)].push_back(event.durationNanoseconds);
+	}
+
+	std::ofstream output(path, std::ios::trunc);
+	output << "section,timeline,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	output << std::fixed << std::setprecision(4);
+	for (std::pair<const std::pair<std::string, bool>, std::vector<int64_t>>& section : sections)
+	{
+		std::vector<int64_t>& durations = section.second;
+		std::sort(durations.begin(), durations.end());
+
+		double total = 0.0;
+		for (int64_t duration : durations)
+		{
+			total += static_cast<double>(duration);
+		}
+		auto percentile = [&durations](double fraction)
+			{
+				size_t rank = static_cast<size_t>(fraction * durations.size() + 0.999999);
+				rank = std::min(std::max(rank, static_cast<size_t>(1)), durations.size());
+				return(durations[rank - 1] / 1.0e6);
+			};
+
+		output << QuoteName(section.first.first.c_str(), '"') << ","
+			<< (section.first.second ? "gpu" : "cpu") << ","
+			<< durations.size() << ","
+			<< total / durations.size() / 1.0e6 << ","
+			<< percentile(0.50) << ","
+			<< percentile(0.95) << ","
+			<< percentile(0.99) << ","
+			<< durations.back() / 1.0e6 << "\n";
+	}
+
+	if (!output)
+	{
+		std::cout << "ERROR: COULD NOT WRITE PROFILE SUMMARY: " << path << std::endl;
+		return false;
+	}
+	std::cout << "INFO: Wrote profile summary of " << sections.size() << " sections to " << path << std::endl;
+	return true;
+}
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.h
+// ==========
+// scoped CPU and GPU section timing with trace and summary export
+//
+//  PROFILE_SCOPE(name) times the rest of the enclosing block on the CPU
+//  and may be used from any thread. PROFILE_GPU_SCOPE(name) also brackets
+//  the block with GL timestamp queries and must run on the thread that
+//  owns the main context. Section names must be string literals.
+//
+//  Finished sections go into a fixed size lock-free ring buffer, so the
+//  newest events are kept when a run outlives it. GPU results are read
+//  a few frames late so the queries never stall the pipeline.
+//
+//  While the profiler is disabled a scope costs one relaxed load and a
+//  branch. Defining DISABLE_PROFILER compiles the scopes out entirely.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  Profiler
+ *
+ *  This class holds the process wide profiling state.
+ ***********************************************************/
+class Profiler
+{
+public:
+	// one finished section
+	struct PROFILE_EVENT
+	{
+		const char* name;
+		// on the CPU clock, GPU times are shifted onto it
+		int64_t startNanoseconds;
+		int64_t durationNanoseconds;
+		uint32_t threadID;
+		uint32_t frame;
+		bool gpu;
+	};
+
+	// turn recording on or off, enable before starting threads
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled() { return(s_enabled.load(std::memory_order_relaxed)); }
+
+	// create the GPU timer queries, with the main context current
+	static void InitializeGPU();
+	// read the outstanding GPU results and release the queries
+	static void ShutdownGPU();
+	// collect the GPU results of older frames and start a new one
+	static void BeginFrame();
+
+	// nanoseconds on the profiler clock
+	static int64_t Now();
+	// store a finished CPU section
+	static void RecordCPU(const char* name, int64_t startNanoseconds, int64_t endNanoseconds);
+	// issue the opening timestamp of a GPU section, -1 when
+	// the frame has no queries left
+	static int BeginGPU(const char* name);
+	// issue the closing timestamp of a GPU section
+	static void EndGPU(int section);
+
+	// copy the events still in the ring, oldest first
+	static std::vector<PROFILE_EVENT> CollectEvents();
+	// write the events as Chrome trace JSON (chrome://tracing)
+	static bool WriteChromeTrace(const char* path);
+	// write per-section percentiles as CSV
+	static bool WriteSummary(const char* path);
+
+private:
+	// add an event to the ring
+	static void PushEvent(const PROFILE_EVENT& event);
+
+	static std::atomic<bool> s_enabled;
+};
+
+/***********************************************************
+ *  ProfileScope
+ *
+ *  This class times its own lifetime as a named section.
+ ***********************************************************/
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name, bool gpu)
+	{
+		m_name = NULL;
+		if (Profiler::IsEnabled())
+		{
+			m_name = name;
+			m_gpuSection = gpu ? Profiler::BeginGPU(name) : -1;
+			m_startNanoseconds = Profiler::Now();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (NULL != m_name)
+		{
+			Profiler::RecordCPU(m_name, m_startNanoseconds, Profiler::Now());
+			if (m_gpuSection != -1)
+			{
+				Profiler::EndGPU(m_gpuSection);
+			}
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* m_name;
+	int m_gpuSection;
+	int64_t m_startNanoseconds;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef DISABLE_PROFILER
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, false)
+#define PROFILE_GPU_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, true)
+#endif
@@ -0,0 +1,571 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.cpp
+// ============
+// bounding volume hierarchy over the world space boxes of scene objects
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+namespace
+{
+	// candidate split positions tried per axis
+	const int SAH_BINS = 16;
+	// leaves are only forced to split above this many objects
+	const uint32_t MAX_LEAF_OBJECTS = 4;
+	// cost of visiting a node against testing one object box
+	const float TRAVERSAL_COST = 1.0f;
+	// refitted trees are rebuilt past this cost against a fresh build
+	const float REBUILD_COST_RATIO = 1.5f;
+	// nodes a traversal stack holds; a tree of depth d never
+	// needs more than d + 1, so the build stops splitting at
+	// MAX_TREE_DEPTH and no traversal can run out of room
+	const int MAX_STACK_DEPTH = 64;
+	const int MAX_TREE_DEPTH = MAX_STACK_DEPTH - 1;
+
+	// half the surface area of a box, enough for comparing costs
+	float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return(size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// true when two boxes overlap
+	bool BoxesOverlap(
+		const glm::vec3& minA, const glm::vec3& maxA,
+		const glm::vec3& minB, const glm::vec3& maxB)
+	{
+		return(minA.x <= maxB.x && maxA.x >= minB.x &&
+			minA.y <= maxB.y && maxA.y >= minB.y &&
+			minA.z <= maxB.z && maxA.z >= minB.z);
+	}
+
+	// squared distance from a point to a box, 0 inside it
+	float DistanceSquared(const glm::vec3& point, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 closest = glm::clamp(point, boundsMin, boundsMax);
+		glm::vec3 offset = point - closest;
+		return(glm::dot(offset, offset));
+	}
+
+	// entry distance of a ray into a box, FLT_MAX when missed
+	float RayBoxDistance(
+		const glm::vec3& origin,
+		const glm::vec3& inverseDirection,
+		const glm::vec3& boundsMin,
+		const glm::vec3& boundsMax,
+		float maxDistance)
+	{
+		glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return((enter <= exit) ? enter : FLT_MAX);
+	}
+}
+
+/***********************************************************
+ *  SceneBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBVH::SceneBVH()
+{
+	m_builtCost = 0.0f;
+	m_boundsChanged = false;
+	m_countChanged = false;
+}
+
+/***********************************************************
+ *  Resize()
+ ***********************************************************/
+void SceneBVH::Resize(uint32_t count)
+{
+	m_objectMin.resize(count, glm::vec3(0.0f));
+	m_objectMax.resize(count, glm::vec3(0.0f));
+	m_countChanged = true;
+}
+
+/***********************************************************
+ *  SetBounds()
+ ***********************************************************/
+void SceneBVH::SetBounds(uint32_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	m_objectMin[index] = boundsMin;
+	m_objectMax[index] = boundsMax;
+	m_boundsChanged = true;
+	if (!m_countChanged && index < m_slotOfObject.size())
+	{
+		m_slotMin[m_slotOfObject[index]] = boundsMin;
+		m_slotMax[m_slotOfObject[index]] = boundsMax;
+	}
+}
+
+/***********************************************************
+ *  Build()
+ ***********************************************************/
+void SceneBVH::Build()
+{
+	uint32_t count = GetCount();
+	m_nodes.clear();
+	m_slotOfObject.resize(count);
+	m_slotMin.resize(count);
+	m_slotMax.resize(count);
+	m_objectSlots.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		m_objectSlots[i] = i;
+	}
+
+	m_boundsChanged = false;
+	m_countChanged = false;
+	m_builtCost = 0.0f;
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> centroids(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		centroids[i] = (m_objectMin[i] + m_objectMax[i]) * 0.5f;
+	}
+
+	// a binary tree over n leaves of at least one object has
+	// fewer than 2n nodes
+	m_nodes.reserve(2 * count);
+	BVH_NODE root;
+	root.leftFirst = 0;
+	root.count = count;
+	FitNode(root);
+	m_nodes.push_back(root);
+	Subdivide(0, 0, centroids);
+
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		uint32_t object = m_objectSlots[slot];
+		m_slotOfObject[object] = slot;
+		m_slotMin[slot] = m_objectMin[object];
+		m_slotMax[slot] = m_objectMax[object];
+	}
+
+	m_nodes.shrink_to_fit();
+	m_builtCost = ComputeCost();
+}
+
+/***********************************************************
+ *  Update()
+ ***********************************************************/
+void SceneBVH::Update()
+{
+	if (m_countChanged || m_nodes.empty())
+	{
+		Build();
+	}
+	else if (m_boundsChanged && Refit() > REBUILD_COST_RATIO)
+	{
+		Build();
+	}
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  Children always follow their parent in the node array,
+ *  so walking it backwards visits both children before
+ *  their parent.
+ ***********************************************************/
+float SceneBVH::Refit()
+{
+	m_boundsChanged = false;
+	if (m_nodes.empty())
+	{
+		return(1.0f);
+	}
+
+	for (size_t i = m_nodes.size(); i-- > 0;)
+	{
+		BVH_NODE& node = m_nodes[i];
+		if (node.count > 0)
+		{
+			node.boundsMin = m_slotMin[node.leftFirst];
+			node.boundsMax = m_slotMax[node.leftFirst];
+			for (uint32_t slot = node.leftFirst + 1; slot < node.leftFirst + node.count; slot++)
+			{
+				node.boundsMin = glm::min(node.boundsMin, m_slotMin[slot]);
+				node.boundsMax = glm::max(node.boundsMax, m_slotMax[slot]);
+			}
+		}
+		else
+		{
+			const BVH_NODE& left = m_nodes[node.leftFirst];
+			const BVH_NODE& right = m_nodes[node.leftFirst + 1];
+			node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+			node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+		}
+	}
+
+	return((m_builtCost > 0.0f) ? ComputeCost() / m_builtCost : 1.0f);
+}
+
+/***********************************************************
+ *  Subdivide()
+ *
+ *  The object centroids are sorted into bins along each
+ *  axis and the split between bins with the lowest area
+ *  weighted object count is taken, unless keeping the
+ *  node whole is cheaper. Nodes whose centroids all
+ *  coincide are split in half by object order. Skewed
+ *  inputs can peel off a few objects per level, so nodes
+ *  at MAX_TREE_DEPTH stay leaves however many objects they
+ *  hold, which keeps every traversal within its stack.
+ ***********************************************************/
+void SceneBVH::Subdivide(uint32_t nodeIndex, int depth, const std::vector<glm::vec3>& centroids)
+{
+	uint32_t first = m_nodes[nodeIndex].leftFirst;
+	uint32_t count = m_nodes[nodeIndex].count;
+	if (count <= 1 || depth >= MAX_TREE_DEPTH)
+	{
+		return;
+	}
+
+	glm::vec3 centroidMin(FLT_MAX);
+	glm::vec3 centroidMax(-FLT_MAX);
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		centroidMin = glm::min(centroidMin, centroids[m_objectSlots[i]]);
+		centroidMax = glm::max(centroidMax, centroids[m_objectSlots[i]]);
+	}
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+		float binScale = SAH_BINS / extent;
+
+		uint32_t binCounts[SAH_BINS] = {};
+		glm::vec3 binMin[SAH_BINS];
+		glm::vec3 binMax[SAH_BINS];
+		for (int b = 0; b < SAH_BINS; b++)
+		{
+			binMin[b] = glm::vec3(FLT_MAX);
+			binMax[b] = glm::vec3(-FLT_MAX);
+		}
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			uint32_t object = m_objectSlots[i];
+			int bin = std::min(SAH_BINS - 1,
+				static_cast<int>((centroids[object][axis] - centroidMin[axis]) * binScale));
+			binCounts[bin]++;
+			binMin[bin] = glm::min(binMin[bin], m_objectMin[object]);
+			binMax[bin] = glm::max(binMax[bin], m_objectMax[object]);
+		}
+
+		// sweep from both ends to get the cost of each split
+		float leftArea[SAH_BINS - 1];
+		uint32_t leftCount[SAH_BINS - 1];
+		glm::vec3 sweepMin(FLT_MAX);
+		glm::vec3 sweepMax(-FLT_MAX);
+		uint32_t sweepCount = 0;
+		for (int b = 0; b < SAH_BINS - 1; b++)
+		{
+			sweepCount += binCounts[b];
+			sweepMin = glm::min(sweepMin, binMin[b]);
+			sweepMax = glm::max(sweepMax, binMax[b]);
+			leftCount[b] = sweepCount;
+			leftArea[b] = HalfArea(sweepMin, sweepMax);
+		}
+		sweepMin = glm::vec3(FLT_MAX);
+		sweepMax = glm::vec3(-FLT_MAX);
+		sweepCount = 0;
+		for (int b = SAH_BINS - 1; b > 0; b--)
+		{
+			sweepCount += binCounts[b];
+			sweepMin = glm::min(sweepMin, binMin[b]);
+			sweepMax = glm::max(sweepMax, binMax[b]);
+			if (leftCount[b - 1] == 0 || sweepCount == 0)
+			{
+				continue;
+			}
+			float cost = leftCount[b - 1] * leftArea[b - 1] + sweepCount * HalfArea(sweepMin, sweepMax);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	BVH_NODE& node = m_nodes[nodeIndex];
+	float nodeArea = HalfArea(node.boundsMin, node.boundsMax);
+	if (bestAxis != -1 && bestCost + TRAVERSAL_COST * nodeArea >= count * nodeArea &&
+		count <= MAX_LEAF_OBJECTS)
+	{
+		return;
+	}
+
+	uint32_t split = first + count / 2;
+	if (bestAxis != -1)
+	{
+		float binScale = SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		uint32_t* middle = std::partition(&m_objectSlots[first], &m_objectSlots[first] + count,
+			[&](uint32_t object)
+			{
+				int bin = std::min(SAH_BINS - 1,
+					static_cast<int>((centroids[object][bestAxis] - centroidMin[bestAxis]) * binScale));
+				return(bin < bestSplit);
+			});
+		split = static_cast<uint32_t>(middle - m_objectSlots.data());
+	}
+	else if (count <= MAX_LEAF_OBJECTS)
+	{
+		return;
+	}
+
+	uint32_t leftIndex = static_cast<uint32_t>(m_nodes.size());
+	BVH_NODE left;
+	left.leftFirst = first;
+	left.count = split - first;
+	FitNode(left);
+	BVH_NODE right;
+	right.leftFirst = split;
+	right.count = first + count - split;
+	FitNode(right);
+	m_nodes.push_back(left);
+	m_nodes.push_back(right);
+
+	m_nodes[nodeIndex].leftFirst = leftIndex;
+	m_nodes[nodeIndex].count = 0;
+
+	Subdivide(leftIndex, depth + 1, centroids);
+	Subdivide(leftIndex + 1, depth + 1, centroids);
+}
+
+/***********************************************************
+ *  FitNode()
+ ***********************************************************/
+void SceneBVH::FitNode(BVH_NODE& node) const
+{
+	node.boundsMin = glm::vec3(FLT_MAX);
+	node.boundsMax = glm::vec3(-FLT_MAX);
+	for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+	{
+		node.boundsMin = glm::min(node.boundsMin, m_objectMin[m_objectSlots[i]]);
+		node.boundsMax = glm::max(node.boundsMax, m_objectMax[m_objectSlots[i]]);
+	}
+}
+
+/***********************************************************
+ *  ComputeCost()
+ *
+ *  Each node costs its area for the box test, and each
+ *  leaf its area again for every object in it.
+ ***********************************************************/
+float SceneBVH::ComputeCost() const
+{
+	float cost = 0.0f;
+	for (const BVH_NODE& node : m_nodes)
+	{
+		cost += HalfArea(node.boundsMin, node.boundsMax) * (1.0f + node.count);
+	}
+	float rootArea = HalfArea(m_nodes[0].boundsMin, m_nodes[0].boundsMax);
+	return((rootArea > 0.0f) ? cost / rootArea : cost);
+}
+
+/***********************************************************
+ *  RayCast()
+ *
+ *  The nearer child is visited first, and subtrees that
+ *  start beyond the closest hit so far are skipped.
+ ***********************************************************/
+bool SceneBVH::RayCast(
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float maxDistance,
+	RAY_HIT& hit) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	// division by a zero component gives an infinity, which
+	// the slab test handles
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float closest = maxDistance;
+	bool found = false;
+
+	// nodes waiting to be visited with their entry distances,
+	// which are checked again against hits found meanwhile
+	uint32_t stack[MAX_STACK_DEPTH];
+	float stackDistances[MAX_STACK_DEPTH];
+	int stackSize = 0;
+	float rootDistance = RayBoxDistance(origin, inverseDirection,
+		m_nodes[0].boundsMin, m_nodes[0].boundsMax, closest);
+	if (rootDistance == FLT_MAX)
+	{
+		return false;
+	}
+	stack[stackSize] = 0;
+	stackDistances[stackSize++] = rootDistance;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (found && stackDistances[stackSize] >= closest)
+		{
+			continue;
+		}
+		const BVH_NODE& node = m_nodes[stack[stackSize]];
+		if (node.count > 0)
+		{
+			for (uint32_t slot = node.leftFirst; slot < node.leftFirst + node.count; slot++)
+			{
+				float distance = RayBoxDistance(origin, inverseDirection,
+					m_slotMin[slot], m_slotMax[slot], closest);
+				// distances are capped at the closest hit so far
+				if (distance != FLT_MAX && (!found || distance < closest))
+				{
+					closest = distance;
+					hit.object = m_objectSlots[slot];
+					hit.distance = distance;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		uint32_t near = node.leftFirst;
+		uint32_t far = node.leftFirst + 1;
+		float nearDistance = RayBoxDistance(origin, inverseDirection,
+			m_nodes[near].boundsMin, m_nodes[near].boundsMax, closest);
+		float farDistance = RayBoxDistance(origin, inverseDirection,
+			m_nodes[far].boundsMin, m_nodes[far].boundsMax, closest);
+		if (farDistance < nearDistance)
+		{
+			std::swap(near, far);
+			std::swap(nearDistance, farDistance);
+		}
+		// pushed far first so the near child is popped first;
+		// the build depth limit keeps both within the stack
+		assert(stackSize + 2 <= MAX_STACK_DEPTH);
+		if (farDistance != FLT_MAX)
+		{
+			stack[stackSize] = far;
+			stackDistances[stackSize++] = farDistance;
+		}
+		if (nearDistance != FLT_MAX)
+		{
+			stack[stackSize] = near;
+			stackDistances[stackSize++] = nearDistance;
+		}
+	}
+
+	return(found);
+}
+
+/***********************************************************
+ *  VisitBox()
+ ***********************************************************/
+template<typename VISITOR>
+bool SceneBVH::VisitBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, VISITOR visitor) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	uint32_t stack[MAX_STACK_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BVH_NODE& node = m_nodes[stack[--stackSize]];
+		if (!BoxesOverlap(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+		{
+			continue;
+		}
+		if (node.count > 0)
+		{
+			for (uint32_t slot = node.leftFirst; slot < node.leftFirst + node.count; slot++)
+			{
+				if (visitor(slot))
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			// the build depth limit keeps both within the stack
+			assert(stackSize + 2 <= MAX_STACK_DEPTH);
+			stack[stackSize++] = node.leftFirst + 1;
+			stack[stackSize++] = node.leftFirst;
+		}
+	}
+	return false;
+}
+
+/***********************************************************
+ *  OverlapSphere()
+ ***********************************************************/
+void SceneBVH::OverlapSphere(
+	const glm::vec3& center,
+	float radius,
+	std::vector<uint32_t>& objects) const
+{
+	float radiusSquared = radius * radius;
+	VisitBox(center - glm::vec3(radius), center + glm::vec3(radius),
+		[&](uint32_t slot)
+		{
+			if (DistanceSquared(center, m_slotMin[slot], m_slotMax[slot]) <= radiusSquared)
+			{
+				objects.push_back(m_objectSlots[slot]);
+			}
+			return false;
+		});
+}
+
+/***********************************************************
+ *  AnyOverlapSphere()
+ ***********************************************************/
+bool SceneBVH::AnyOverlapSphere(const glm::vec3& center, float radius) const
+{
+	float radiusSquared = radius * radius;
+	return(VisitBox(center - glm::vec3(radius), center + glm::vec3(radius),
+		[&](uint32_t slot)
+		{
+			return(DistanceSquared(center, m_slotMin[slot], m_slotMax[slot]) <= radiusSquared);
+		}));
+}
+
+/***********************************************************
+ *  OverlapBox()
+ ***********************************************************/
+void SceneBVH::OverlapBox(
+	const glm::vec3& boundsMin,
+	const glm::vec3& boundsMax,
+	std::vector<uint32_t>& objects) const
+{
+	VisitBox(boundsMin, boundsMax,
+		[&](uint32_t slot)
+		{
+			if (BoxesOverlap(m_slotMin[slot], m_slotMax[slot], boundsMin, boundsMax))
+			{
+				objects.push_back(m_objectSlots[slot]);
+			}
+			return false;
+		});
+}
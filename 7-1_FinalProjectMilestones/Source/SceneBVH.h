@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.h
+// ==========
+// bounding volume hierarchy over the world space boxes of scene objects
+//
+//  The tree is built top down with a binned surface area heuristic and
+//  stored depth first in one array, children after their parent, so a
+//  refit is a single backwards pass. Moving objects only refits the
+//  boxes; when refitting has made the tree much worse than a fresh build
+//  it is rebuilt on the next Update().
+//
+//  Queries work on the object boxes, so a ray hits the box of an object
+//  rather than its triangles.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SceneBVH
+ *
+ *  This class holds the hierarchy and answers ray, sphere
+ *  and box queries against it.
+ ***********************************************************/
+class SceneBVH
+{
+public:
+	// constructor
+	SceneBVH();
+
+	// closest object hit by a ray
+	struct RAY_HIT
+	{
+		uint32_t object;
+		float distance;
+	};
+
+	// number of objects held, new objects are empty at the origin
+	void Resize(uint32_t count);
+	uint32_t GetCount() const { return(static_cast<uint32_t>(m_objectMin.size())); }
+	// set the world space box of an object, the tree follows
+	// on the next Update()
+	void SetBounds(uint32_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	const glm::vec3& GetBoundsMin(uint32_t index) const { return(m_objectMin[index]); }
+	const glm::vec3& GetBoundsMax(uint32_t index) const { return(m_objectMax[index]); }
+
+	// build the tree over every object from scratch
+	void Build();
+	// refit or rebuild the tree after objects have moved
+	void Update();
+	// refit the node boxes to the objects without changing the
+	// tree, returns the cost of the refitted tree relative to
+	// the one it was built as
+	float Refit();
+
+	// closest object box hit by the ray within maxDistance,
+	// false when none is hit
+	bool RayCast(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		RAY_HIT& hit) const;
+	// append the objects whose boxes overlap a sphere
+	void OverlapSphere(
+		const glm::vec3& center,
+		float radius,
+		std::vector<uint32_t>& objects) const;
+	// true when any object box overlaps the sphere
+	bool AnyOverlapSphere(const glm::vec3& center, float radius) const;
+	// append the objects whose boxes overlap a box
+	void OverlapBox(
+		const glm::vec3& boundsMin,
+		const glm::vec3& boundsMax,
+		std::vector<uint32_t>& objects) const;
+
+	uint32_t GetNodeCount() const { return(static_cast<uint32_t>(m_nodes.size())); }
+
+private:
+	// tree node, a leaf when count is not 0
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		// first child for inner nodes, first object slot for leaves
+		uint32_t leftFirst;
+		glm::vec3 boundsMax;
+		uint32_t count;
+	};
+
+	// split a node at a depth below the root, recursing into
+	// its children
+	void Subdivide(uint32_t nodeIndex, int depth, const std::vector<glm::vec3>& centroids);
+	// grow a node box around its objects while building
+	void FitNode(BVH_NODE& node) const;
+	// surface area heuristic cost of the whole tree
+	float ComputeCost() const;
+	// visit the leaf slots whose leaves overlap a box, stopping
+	// when the visitor returns true
+	template<typename VISITOR>
+	bool VisitBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, VISITOR visitor) const;
+
+	std::vector<glm::vec3> m_objectMin;
+	std::vector<glm::vec3> m_objectMax;
+	std::vector<BVH_NODE> m_nodes;
+	// objects in leaf order
+	std::vector<uint32_t> m_objectSlots;
+	// leaf slot of each object
+	std::vector<uint32_t> m_slotOfObject;
+	// object boxes copied in leaf order, so leaves read them
+	// without following the slot table
+	std::vector<glm::vec3> m_slotMin;
+	std::vector<glm::vec3> m_slotMax;
+	// cost right after the last build
+	float m_builtCost;
+	// objects moved or added since the last Update()
+	bool m_boundsChanged;
+	bool m_countChanged;
+};
@@ -0,0 +1,720 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// =============
+// compile scene text files and map the compiled binary object table
+//
+//  Text format, one record per line, '#' starts a comment:
+//
+//    material <tag> [ambientColor r g b] [ambientStrength s]
+//                   [diffuseColor r g b] [specularColor r g b] [shininess s]
+//    object <name> <plane|box|cylinder|cone|sphere> [scale x y z]
+//                   [rotate x y z] [position x y z] [texture tag]
+//                   [material tag] [color r g b a]
+//    light <name> [position x y z] [ambientColor r g b] [diffuseColor r g b]
+//                   [specularColor r g b] [focalStrength s]
+//                   [specularIntensity s] [range r] [shadows]
+//
+//  Objects without a texture are drawn with their color. Objects without
+//  a material use the first material in the file. Lights without a range
+//  reach the whole scene; lights with a range are clustered point lights.
+//  The bare shadows keyword gives a light without a range a shadow map.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// binary layout definitions
+namespace
+{
+	const char g_SceneMagic[4] = { 'S', 'C', 'N', 'B' };
+	const uint32_t g_SceneVersion = 4;
+	const size_t g_SectionAlignment = 16;
+
+	const char* const g_MeshNames[MESH_COUNT] =
+	{
+		"plane", "box", "cylinder", "cone", "sphere"
+	};
+
+	// sections of the binary file, each aligned to 16 bytes
+	enum SCENE_SECTION
+	{
+		SECTION_MESH = 0,
+		SECTION_SCALE,
+		SECTION_ROTATION,
+		SECTION_POSITION,
+		SECTION_TEXTURE,
+		SECTION_MATERIAL,
+		SECTION_COLOR,
+		SECTION_NAME,
+		SECTION_FLAGS,
+		SECTION_TEXTURE_TAGS,
+		SECTION_MATERIAL_RECORDS,
+		SECTION_LIGHT_RECORDS,
+		SECTION_STRINGS,
+		SECTION_COUNT
+	};
+
+	struct SCENE_FILE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t objectCount;
+		uint32_t textureCount;
+		uint32_t materialCount;
+		uint32_t lightCount;
+		uint32_t stringBytes;
+		uint32_t sectionOffsets[SECTION_COUNT];
+		uint32_t sectionSizes[SECTION_COUNT];
+	};
+
+	size_t AlignSection(size_t offset)
+	{
+		return((offset + g_SectionAlignment - 1) & ~(g_SectionAlignment - 1));
+	}
+
+	// read a fixed number of floats following a keyword
+	bool ReadFloats(std::istringstream& tokens, float* values, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (!(tokens >> values[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// append a zero terminated string to the string block
+	uint32_t AddString(std::string& strings, const std::string& value)
+	{
+		uint32_t offset = static_cast<uint32_t>(strings.size());
+		strings.append(value);
+		strings.push_back('\0');
+		return(offset);
+	}
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	memset(&m_objects, 0, sizeof(m_objects));
+	m_textureTagOffsets = nullptr;
+	m_textureCount = 0;
+	m_materials = nullptr;
+	m_materialCount = 0;
+	m_lights = nullptr;
+	m_lightCount = 0;
+	m_strings = nullptr;
+	m_stringBytes = 0;
+}
+
+/***********************************************************
+ *  ~SceneFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method releases the mapped scene binary.
+ ***********************************************************/
+void SceneFile::Close()
+{
+	m_file.Close();
+	memset(&m_objects, 0, sizeof(m_objects));
+	m_textureTagOffsets = nullptr;
+	m_textureCount = 0;
+	m_materials = nullptr;
+	m_materialCount = 0;
+	m_lights = nullptr;
+	m_lightCount = 0;
+	m_strings = nullptr;
+	m_stringBytes = 0;
+}
+
+/***********************************************************
+ *  FindMeshID()
+ *
+ *  This method is used for converting a mesh name from a
+ *  scene text file into its mesh ID, or -1 if unknown.
+ ***********************************************************/
+int SceneFile::FindMeshID(const char* meshName)
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		if (strcmp(g_MeshNames[i], meshName) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for loading a scene. The compiled
+ *  binary sits next to the text file with a 'b' appended to
+ *  the extension and is rebuilt whenever the text is newer.
+ ***********************************************************/
+bool SceneFile::Load(const char* scenePath)
+{
+	namespace fs = std::filesystem;
+
+	auto startTime = std::chrono::steady_clock::now();
+	std::string binaryPath = std::string(scenePath) + "b";
+	std::error_code error;
+
+	Close();
+
+	bool textExists = fs::exists(scenePath, error);
+	bool binaryExists = fs::exists(binaryPath, error);
+	if (textExists)
+	{
+		bool compile = !binaryExists;
+		if (binaryExists)
+		{
+			compile = fs::last_write_time(binaryPath, error) <
+				fs::last_write_time(scenePath, error);
+		}
+		if (compile && !Compile(scenePath, binaryPath.c_str()))
+		{
+			return false;
+		}
+	}
+	else if (!binaryExists)
+	{
+		std::cout << "ERROR: SCENE FILE NOT FOUND: " << scenePath << std::endl;
+		return false;
+	}
+
+	// a binary from an older format version is rebuilt from the text
+	bool mapped = MapBinary(binaryPath.c_str());
+	if (!mapped && textExists)
+	{
+		Close();
+		mapped = Compile(scenePath, binaryPath.c_str()) && MapBinary(binaryPath.c_str());
+	}
+	if (!mapped)
+	{
+		std::cout << "ERROR: INVALID SCENE BINARY: " << binaryPath << std::endl;
+		Close();
+		return false;
+	}
+
+	std::chrono::duration<double, std::milli> elapsed =
+		std::chrono::steady_clock::now() - startTime;
+	std::cout << "LOADED SCENE: " << binaryPath << " (" << m_objects.count
+		<< " objects, " << elapsed.count() << " ms)" << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  Compile()
+ *
+ *  This method is used for parsing a scene text file and
+ *  writing out the binary object table.
+ ***********************************************************/
+bool SceneFile::Compile(const char* textPath, const char* binaryPath)
+{
+	std::ifstream input(textPath);
+	if (!input)
+	{
+		std::cout << "ERROR: COULD NOT OPEN SCENE FILE: " << textPath << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> meshIDs;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::vec3> rotations;
+	std::vector<glm::vec3> positions;
+	std::vector<int32_t> textureIndices;
+	std::vector<int32_t> materialIndices;
+	std::vector<glm::vec4> colors;
+	std::vector<uint32_t> nameOffsets;
+	std::vector<uint32_t> flags;
+	std::vector<uint32_t> textureTagOffsets;
+	std::vector<MATERIAL_RECORD> materials;
+	std::vector<LIGHT_RECORD> lights;
+	std::unordered_map<std::string, int32_t> textureLookup;
+	std::unordered_map<std::string, int32_t> materialLookup;
+	std::string strings;
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(input, line))
+	{
+		lineNumber++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream tokens(line);
+		std::string keyword;
+		if (!(tokens >> keyword))
+		{
+			continue;
+		}
+
+		std::string error;
+		if (keyword == "material")
+		{
+			std::string tag;
+			MATERIAL_RECORD material = {
+				{ 1.0f, 1.0f, 1.0f }, 0.0f,
+				{ 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f, 0 };
+
+			if (!(tokens >> tag))
+			{
+				error = "material needs a tag";
+			}
+			else if (materialLookup.count(tag) != 0)
+			{
+				error = "material '" + tag + "' is already defined";
+			}
+
+			std::string key;
+			while (error.empty() && (tokens >> key))
+			{
+				bool valid = false;
+				if (key == "ambientColor")
+					valid = ReadFloats(tokens, material.ambientColor, 3);
+				else if (key == "ambientStrength")
+					valid = ReadFloats(tokens, &material.ambientStrength, 1);
+				else if (key == "diffuseColor")
+					valid = ReadFloats(tokens, material.diffuseColor, 3);
+				else if (key == "specularColor")
+					valid = ReadFloats(tokens, material.specularColor, 3);
+				else if (key == "shininess")
+					valid = ReadFloats(tokens, &material.shininess, 1);
+
+				if (!valid)
+				{
+					error = "bad material value '" + key + "'";
+				}
+			}
+
+			if (error.empty())
+			{
+				material.tagOffset = AddString(strings, tag);
+				materialLookup[tag] = static_cast<int32_t>(materials.size());
+				materials.push_back(material);
+			}
+		}
+		else if (keyword == "object")
+		{
+			std::string name;
+			std::string meshName;
+			int meshID = -1;
+			glm::vec3 scale(1.0f);
+			glm::vec3 rotation(0.0f);
+			glm::vec3 position(0.0f);
+			int32_t textureIndex = -1;
+			int32_t materialIndex = 0;
+			glm::vec4 color(1.0f);
+			uint32_t objectFlags = 0;
+
+			if (!(tokens >> name >> meshName))
+			{
+				error = "object needs a name and a mesh";
+			}
+			else if ((meshID = FindMeshID(meshName.c_str())) < 0)
+			{
+				error = "unknown mesh '" + meshName + "'";
+			}
+			else if (materials.empty())
+			{
+				error = "objects need a material defined before them";
+			}
+
+			std::string key;
+			while (error.empty() && (tokens >> key))
+			{
+				bool valid = false;
+				std::string tag;
+				if (key == "scale")
+					valid = ReadFloats(tokens, &scale.x, 3);
+				else if (key == "rotate")
+					valid = ReadFloats(tokens, &rotation.x, 3);
+				else if (key == "position")
+					valid = ReadFloats(tokens, &position.x, 3);
+				else if (key == "color")
+					valid = ReadFloats(tokens, &color.x, 4);
+				else if (key == "occluder")
+				{
+					objectFlags |= OBJECT_FLAG_OCCLUDER;
+					valid = true;
+				}
+				else if (key == "static")
+				{
+					objectFlags |= OBJECT_FLAG_STATIC;
+					valid = true;
+				}
+				else if (key == "texture" && (tokens >> tag))
+				{
+					auto found = textureLookup.find(tag);
+					if (found == textureLookup.end())
+					{
+						textureIndex = static_cast<int32_t>(textureTagOffsets.size());
+						textureLookup[tag] = textureIndex;
+						textureTagOffsets.push_back(AddString(strings, tag));
+					}
+					else
+					{
+						textureIndex = found->second;
+					}
+					valid = true;
+				}
+				else if (key == "material" && (tokens >> tag))
+				{
+					auto found = materialLookup.find(tag);
+					if (found != materialLookup.end())
+					{
+						materialIndex = found->second;
+						valid = true;
+					}
+				}
+
+				if (!valid)
+				{
+					error = "bad object value '" + key + "'";
+				}
+			}
+
+			if (error.empty())
+			{
+				meshIDs.push_back(static_cast<uint8_t>(meshID));
+				scales.push_back(scale);
+				rotations.push_back(rotation);
+				positions.push_back(position);
+				textureIndices.push_back(textureIndex);
+				materialIndices.push_back(materialIndex);
+				colors.push_back(color);
+				nameOffsets.push_back(AddString(strings, name));
+				flags.push_back(objectFlags);
+			}
+		}
+		else if (keyword == "light")
+		{
+			std::string name;
+			LIGHT_RECORD light = {
+				{ 0.0f, 0.0f, 0.0f }, 0.0f, { 0.0f, 0.0f, 0.0f }, 1.0f,
+				{ 0.0f, 0.0f, 0.0f }, 0.0f, { 0.0f, 0.0f, 0.0f }, 0, 0 };
+
+			if (!(tokens >> name))
+			{
+				error = "light needs a name";
+			}
+
+			std::string key;
+			while (error.empty() && (tokens >> key))
+			{
+				bool valid = false;
+				if (key == "position")
+					valid = ReadFloats(tokens, light.position, 3);
+				else if (key == "ambientColor")
+					valid = ReadFloats(tokens, light.ambientColor, 3);
+				else if (key == "diffuseColor")
+					valid = ReadFloats(tokens, light.diffuseColor, 3);
+				else if (key == "specularColor")
+					valid = ReadFloats(tokens, light.specularColor, 3);
+				else if (key == "focalStrength")
+					valid = ReadFloats(tokens, &light.focalStrength, 1);
+				else if (key == "specularIntensity")
+					valid = ReadFloats(tokens, &light.specularIntensity, 1);
+				else if (key == "range")
+					valid = ReadFloats(tokens, &light.range, 1) && light.range >= 0.0f;
+				else if (key == "shadows")
+				{
+					light.flags |= LIGHT_FLAG_SHADOWS;
+					valid = true;
+				}
+
+				if (!valid)
+				{
+					error = "bad light value '" + key + "'";
+				}
+			}
+
+			if (error.empty() && (light.flags & LIGHT_FLAG_SHADOWS) != 0 && light.range > 0.0f)
+			{
+				error = "shadows need a light without a range";
+			}
+			if (error.empty())
+			{
+				light.nameOffset = AddString(strings, name);
+				lights.push_back(light);
+			}
+		}
+		else
+		{
+			error = "unknown record '" + keyword + "'";
+		}
+
+		if (!error.empty())
+		{
+			std::cout << "ERROR: " << textPath << "(" << lineNumber << "): "
+				<< error << std::endl;
+			return false;
+		}
+	}
+
+	// lay out the sections of the binary image
+	SCENE_FILE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_SceneMagic, sizeof(header.magic));
+	header.version = g_SceneVersion;
+	header.objectCount = static_cast<uint32_t>(meshIDs.size());
+	header.textureCount = static_cast<uint32_t>(textureTagOffsets.size());
+	header.materialCount = static_cast<uint32_t>(materials.size());
+	header.lightCount = static_cast<uint32_t>(lights.size());
+	header.stringBytes = static_cast<uint32_t>(strings.size());
+
+	const void* sectionData[SECTION_COUNT] =
+	{
+		meshIDs.data(), scales.data(), rotations.data(), positions.data(),
+		textureIndices.data(), materialIndices.data(), colors.data(),
+		nameOffsets.data(), flags.data(), textureTagOffsets.data(), materials.data(),
+		lights.data(), strings.data()
+	};
+	const size_t sectionSizes[SECTION_COUNT] =
+	{
+		meshIDs.size() * sizeof(uint8_t),
+		scales.size() * sizeof(glm::vec3),
+		rotations.size() * sizeof(glm::vec3),
+		positions.size() * sizeof(glm::vec3),
+		textureIndices.size() * sizeof(int32_t),
+		materialIndices.size() * sizeof(int32_t),
+		colors.size() * sizeof(glm::vec4),
+		nameOffsets.size() * sizeof(uint32_t),
+		flags.size() * sizeof(uint32_t),
+		textureTagOffsets.size() * sizeof(uint32_t),
+		materials.size() * sizeof(MATERIAL_RECORD),
+		lights.size() * sizeof(LIGHT_RECORD),
+		strings.size()
+	};
+
+	size_t offset = AlignSection(sizeof(header));
+	for (int i = 0; i < SECTION_COUNT; i++)
+	{
+		header.sectionOffsets[i] = static_cast<uint32_t>(offset);
+		header.sectionSizes[i] = static_cast<uint32_t>(sectionSizes[i]);
+		offset = AlignSection(offset + sectionSizes[i]);
+	}
+
+	std::vector<char> image(offset, 0);
+	memcpy(image.data(), &header, sizeof(header));
+	for (int i = 0; i < SECTION_COUNT; i++)
+	{
+		if (sectionSizes[i] > 0)
+		{
+			memcpy(image.data() + header.sectionOffsets[i], sectionData[i], sectionSizes[i]);
+		}
+	}
+
+	std::ofstream output(binaryPath, std::ios::binary | std::ios::trunc);
+	output.write(image.data(), static_cast<std::streamsize>(image.size()));
+	if (!output)
+	{
+		std::cout << "ERROR: COULD NOT WRITE SCENE BINARY: " << binaryPath << std::endl;
+		return false;
+	}
+
+	std::cout << "COMPILED SCENE: " << textPath << " -> " << binaryPath
+		<< " (" << header.objectCount << " objects)" << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  MapBinary()
+ *
+ *  This method maps a compiled scene and checks that every
+ *  section and index fits inside the file before any of it
+ *  is handed to the renderer.
+ ***********************************************************/
+bool SceneFile::MapBinary(const char* binaryPath)
+{
+	if (!m_file.Open(binaryPath) || m_file.GetSize() < sizeof(SCENE_FILE_HEADER))
+	{
+		return false;
+	}
+
+	const unsigned char* pData = m_file.GetData();
+	SCENE_FILE_HEADER header;
+	memcpy(&header, pData, sizeof(header));
+
+	if (memcmp(header.magic, g_SceneMagic, sizeof(header.magic)) != 0 ||
+		header.version != g_SceneVersion)
+	{
+		return false;
+	}
+
+	const size_t objectCount = header.objectCount;
+	const size_t expectedSizes[SECTION_COUNT] =
+	{
+		objectCount * sizeof(uint8_t),
+		objectCount * sizeof(glm::vec3),
+		objectCount * sizeof(glm::vec3),
+		objectCount * sizeof(glm::vec3),
+		objectCount * sizeof(int32_t),
+		objectCount * sizeof(int32_t),
+		objectCount * sizeof(glm::vec4),
+		objectCount * sizeof(uint32_t),
+		objectCount * sizeof(uint32_t),
+		header.textureCount * sizeof(uint32_t),
+		header.materialCount * sizeof(MATERIAL_RECORD),
+		header.lightCount * sizeof(LIGHT_RECORD),
+		header.stringBytes
+	};
+	for (int i = 0; i < SECTION_COUNT; i++)
+	{
+		size_t sectionEnd = static_cast<size_t>(header.sectionOffsets[i]) + header.sectionSizes[i];
+		if (header.sectionSizes[i] != expectedSizes[i] ||
+			header.sectionOffsets[i] % g_SectionAlignment != 0 ||
+			sectionEnd > m_file.GetSize())
+		{
+			return false;
+		}
+	}
+	if (header.stringBytes > 0 &&
+		pData[header.sectionOffsets[SECTION_STRINGS] + header.stringBytes - 1] != '\0')
+	{
+		return false;
+	}
+
+	m_objects.count = header.objectCount;
+	m_objects.meshIDs = pData + header.sectionOffsets[SECTION_MESH];
+	m_objects.scales = reinterpret_cast<const glm::vec3*>(pData + header.sectionOffsets[SECTION_SCALE]);
+	m_objects.rotations = reinterpret_cast<const glm::vec3*>(pData + header.sectionOffsets[SECTION_ROTATION]);
+	m_objects.positions = reinterpret_cast<const glm::vec3*>(pData + header.sectionOffsets[SECTION_POSITION]);
+	m_objects.textureIndices = reinterpret_cast<const int32_t*>(pData + header.sectionOffsets[SECTION_TEXTURE]);
+	m_objects.materialIndices = reinterpret_cast<const int32_t*>(pData + header.sectionOffsets[SECTION_MATERIAL]);
+	m_objects.colors = reinterpret_cast<const glm::vec4*>(pData + header.sectionOffsets[SECTION_COLOR]);
+	m_objects.nameOffsets = reinterpret_cast<const uint32_t*>(pData + header.sectionOffsets[SECTION_NAME]);
+	m_objects.flags = reinterpret_cast<const uint32_t*>(pData + header.sectionOffsets[SECTION_FLAGS]);
+	m_textureTagOffsets = reinterpret_cast<const uint32_t*>(pData + header.sectionOffsets[SECTION_TEXTURE_TAGS]);
+	m_textureCount = header.textureCount;
+	m_materials = reinterpret_cast<const MATERIAL_RECORD*>(pData + header.sectionOffsets[SECTION_MATERIAL_RECORDS]);
+	m_materialCount = header.materialCount;
+	m_lights = reinterpret_cast<const LIGHT_RECORD*>(pData + header.sectionOffsets[SECTION_LIGHT_RECORDS]);
+	m_lightCount = header.lightCount;
+	m_strings = reinterpret_cast<const char*>(pData + header.sectionOffsets[SECTION_STRINGS]);
+	m_stringBytes = header.stringBytes;
+
+	// every index must resolve so the render loop needs no checks
+	for (uint32_t i = 0; i < m_objects.count; i++)
+	{
+		if (m_objects.meshIDs[i] >= MESH_COUNT ||
+			m_objects.textureIndices[i] < -1 ||
+			m_objects.textureIndices[i] >= static_cast<int32_t>(m_textureCount) ||
+			m_objects.materialIndices[i] < 0 ||
+			m_objects.materialIndices[i] >= static_cast<int32_t>(m_materialCount) ||
+			m_objects.nameOffsets[i] >= m_stringBytes)
+		{
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m_textureCount; i++)
+	{
+		if (m_textureTagOffsets[i] >= m_stringBytes)
+		{
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m_materialCount; i++)
+	{
+		if (m_materials[i].tagOffset >= m_stringBytes)
+		{
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < m_lightCount; i++)
+	{
+		if (m_lights[i].nameOffset >= m_stringBytes)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  GetString()
+ ***********************************************************/
+const char* SceneFile::GetString(uint32_t offset) const
+{
+	return(m_strings + offset);
+}
+
+/***********************************************************
+ *  GetObjectName()
+ ***********************************************************/
+const char* SceneFile::GetObjectName(uint32_t index) const
+{
+	return(GetString(m_objects.nameOffsets[index]));
+}
+
+/***********************************************************
+ *  GetTextureTag()
+ ***********************************************************/
+const char* SceneFile::GetTextureTag(uint32_t index) const
+{
+	return(GetString(m_textureTagOffsets[index]));
+}
+
+/***********************************************************
+ *  GetMaterial()
+ ***********************************************************/
+const SceneFile::MATERIAL_RECORD& SceneFile::GetMaterial(uint32_t index) const
+{
+	return(m_materials[index]);
+}
+
+/***********************************************************
+ *  GetMaterialTag()
+ ***********************************************************/
+const char* SceneFile::GetMaterialTag(uint32_t index) const
+{
+	return(GetString(m_materials[index].tagOffset));
+}
+
+/***********************************************************
+ *  GetLight()
+ ***********************************************************/
+const SceneFile::LIGHT_RECORD& SceneFile::GetLight(uint32_t index) const
+{
+	return(m_lights[index]);
+}
+
+/***********************************************************
+ *  GetLightName()
+ ***********************************************************/
+const char* SceneFile::GetLightName(uint32_t index) const
+{
+	return(GetString(m_lights[index].nameOffset));
+}
@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ===========
+// load the scene object table from a compiled scene file
+//
+//  Scenes are authored as text (.scene) and compiled on first use into a
+//  binary (.sceneb) that is memory mapped. The binary stores the objects
+//  as a structure of arrays, so each table below points straight into the
+//  mapped file.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// primitive meshes that scene objects can be drawn with
+enum SCENE_MESH_ID
+{
+	MESH_PLANE = 0,
+	MESH_BOX,
+	MESH_CYLINDER,
+	MESH_CONE,
+	MESH_SPHERE,
+	MESH_COUNT
+};
+
+// per-object flags set by bare keywords in scene text files
+enum SCENE_OBJECT_FLAGS
+{
+	// large solid object drawn into the occlusion depth buffer
+	OBJECT_FLAG_OCCLUDER = 1 << 0,
+	// object that never moves, merged into a static batch
+	OBJECT_FLAG_STATIC = 1 << 1
+};
+
+// per-light flags set by bare keywords in scene text files
+enum SCENE_LIGHT_FLAGS
+{
+	// light with a cube shadow map, global lights only
+	LIGHT_FLAG_SHADOWS = 1 << 0
+};
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class compiles scene text files into the binary
+ *  format and exposes the mapped object table.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// constructor
+	SceneFile();
+	// destructor
+	~SceneFile();
+
+	// material definition as stored in the binary file
+	struct MATERIAL_RECORD
+	{
+		float ambientColor[3];
+		float ambientStrength;
+		float diffuseColor[3];
+		float specularColor[3];
+		float shininess;
+		uint32_t tagOffset;
+	};
+
+	// light source as stored in the binary file, a range of
+	// zero marks a light that reaches the whole scene
+	struct LIGHT_RECORD
+	{
+		float position[3];
+		float range;
+		float ambientColor[3];
+		float focalStrength;
+		float diffuseColor[3];
+		float specularIntensity;
+		float specularColor[3];
+		uint32_t nameOffset;
+		// SCENE_LIGHT_FLAGS bits
+		uint32_t flags;
+	};
+
+	// structure-of-arrays view of the scene objects
+	struct OBJECT_TABLE
+	{
+		uint32_t count;
+		const uint8_t* meshIDs;
+		const glm::vec3* scales;
+		// rotation in degrees around X, Y and Z
+		const glm::vec3* rotations;
+		const glm::vec3* positions;
+		// index into the texture tags, -1 for color only
+		const int32_t* textureIndices;
+		const int32_t* materialIndices;
+		const glm::vec4* colors;
+		const uint32_t* nameOffsets;
+		// SCENE_OBJECT_FLAGS bits
+		const uint32_t* flags;
+	};
+
+	// load a scene, compiling the text file when the
+	// binary is missing or older than the text
+	bool Load(const char* scenePath);
+	// release the mapped scene
+	void Close();
+
+	// compile a scene text file into the binary format
+	static bool Compile(const char* textPath, const char* binaryPath);
+	// parse a mesh name used in scene text files
+	static int FindMeshID(const char* meshName);
+
+	// mapped object table
+	const OBJECT_TABLE& GetObjects() const { return(m_objects); }
+	// display name of an object
+	const char* GetObjectName(uint32_t index) const;
+
+	// texture tags referenced by the objects
+	uint32_t GetTextureCount() const { return(m_textureCount); }
+	const char* GetTextureTag(uint32_t index) const;
+
+	// materials referenced by the objects
+	uint32_t GetMaterialCount() const { return(m_materialCount); }
+	const MATERIAL_RECORD& GetMaterial(uint32_t index) const;
+	const char* GetMaterialTag(uint32_t index) const;
+
+	// light sources of the scene
+	uint32_t GetLightCount() const { return(m_lightCount); }
+	const LIGHT_RECORD& GetLight(uint32_t index) const;
+	const char* GetLightName(uint32_t index) const;
+
+private:
+	// map a compiled binary and validate its layout
+	bool MapBinary(const char* binaryPath);
+	// look up a string in the mapped string block
+	const char* GetString(uint32_t offset) const;
+
+	// mapped binary file
+	MappedFile m_file;
+	// object table pointing into the mapped file
+	OBJECT_TABLE m_objects;
+	// texture tag string offsets
+	const uint32_t* m_textureTagOffsets;
+	uint32_t m_textureCount;
+	// material records
+	const MATERIAL_RECORD* m_materials;
+	uint32_t m_materialCount;
+	// light records
+	const LIGHT_RECORD* m_lights;
+	uint32_t m_lightCount;
+	// packed zero terminated strings
+	const char* m_strings;
+	uint32_t m_stringBytes;
+};
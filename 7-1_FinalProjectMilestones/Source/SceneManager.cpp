@@ -10,41 +10,102 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
-
-#ifndef STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-#endif
+#include "JobSystem.h"
+#include "Profiler.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <tuple>
+#include <utility>
 
 
 // shader uniform references
 namespace
 {
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
-	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_TextureName = "objectTexture";
+	const char* g_ViewName = "view";
+	const char* g_ProjectionName = "projection";
+
+	const char* g_DepthVertexShaderPath = "shaders/depthVertexShader.glsl";
+	const char* g_DepthFragmentShaderPath = "shaders/depthFragmentShader.glsl";
+
+	// fragment count queries of the scene pass and the pre-pass
+	const int SCENE_FRAGMENT_QUERY = 0;
+	const int PREPASS_FRAGMENT_QUERY = 1;
+
+	// uniform buffer binding of the material table
+	const GLuint MATERIAL_BUFFER_BINDING = 0;
+
+	// occluder box of a round mesh relative to its bounds, a
+	// little inside the box inscribed in the true shape so it
+	// stays inside the tessellated one
+	const float CYLINDER_OCCLUDER_SCALE = 0.7f;
+	const float SPHERE_OCCLUDER_SCALE = 0.55f;
+
+	// scene objects and draw batches handled by one frame job
+	const uint32_t OBJECT_GRAIN_SIZE = 256;
+	const uint32_t BATCH_GRAIN_SIZE = 32;
+
+	// width of the grid cells the static objects are merged by,
+	// so each large surface of the room is ordered on its own
+	const float STATIC_CHUNK_SIZE = 10.0f;
+
+	// distance from a point to the nearest point of a box, 0
+	// from inside it
+	float DistanceToBox(const glm::vec3& point, const glm::vec3& center, const glm::vec3& extents)
+	{
+		return(glm::length(glm::max(glm::abs(point - center) - extents, glm::vec3(0.0f))));
+	}
 }
 
 /***********************************************************
  *  SceneManager()
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager* pShaderManager)
+SceneManager::SceneManager(ShaderUniformManager* pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
-
-	for (int i = 0; i < 16; i++)
-	{
-		m_textureIDs[i].tag = "/0";
-		m_textureIDs[i].ID = 0;
-	}
-	m_loadedTextures = 0;
+	RegisterUniforms();
+	m_basicMeshes = new PrimitiveMeshes();
+	m_pLightClusters = new LightClusters(pShaderManager);
+	m_pShadowMaps = new ShadowMaps(pShaderManager);
+	m_pDeferredShading = new DeferredShading(pShaderManager);
+	m_deferredShading = false;
+	m_pFillCostProfiler = new FillCostProfiler(pShaderManager);
+	m_overdrawHeatmap = false;
+	m_fillCostRequested = false;
+	m_fillCostInstanceBuffer = 0;
+	m_overdrawSummary = FillCostProfiler::OVERDRAW_SUMMARY();
+	m_depthProgram = 0;
+	m_depthPrepass = false;
+	m_fragmentQueries[0] = m_fragmentQueries[1] = 0;
+	m_fragmentQueryTarget = GL_SAMPLES_PASSED;
+	m_fragmentQueriesPending = false;
+	m_prepassQueryPending = false;
+
+	m_transforms.anyDirty = false;
+	m_materialBuffer = 0;
+	m_instanceBuffer = 0;
+	m_instancesDirty = false;
+	m_cullingEnabled = true;
+	m_occlusionEnabled = true;
+	m_lodEnabled = true;
+	m_staticBatching = true;
+	m_gpuDriven = false;
+	m_workerThreadCount = 0;
+	m_pJobSystem = NULL;
+	m_compressTextures = false;
+	m_unsortedStateChanges = DRAW_STATE_CHANGES();
+	m_sortedStateChanges = DRAW_STATE_CHANGES();
+	m_frameStats = FRAME_STATS();
 }
 
 /***********************************************************
@@ -55,139 +116,57 @@ SceneManager::~SceneManager()
 	m_pShaderManager = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
-
-	if (m_loadedTextures > 0)
-	{
-		DestroyGLTextures();
-	}
-}
-
-
-/***********************************************************
- *  CreateGLTexture()
- ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
-{
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// prevent overflow beyond 16 texture slots
-	if (m_loadedTextures >= 16)
+	delete m_pLightClusters;
+	m_pLightClusters = NULL;
+	delete m_pShadowMaps;
+	m_pShadowMaps = NULL;
+	delete m_pDeferredShading;
+	m_pDeferredShading = NULL;
+	delete m_pFillCostProfiler;
+	m_pFillCostProfiler = NULL;
+	if (m_fragmentQueries[0] != 0)
 	{
-		std::cout << "ERROR: TEXTURE LIMIT REACHED. " << filename << std::endl;
-		return false;
-	}
-
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* image = stbi_load(filename, &width, &height, &colorChannels, 0);
-
-	if (!image)
-	{
-		std::cout << "FAILED TO LOAD IMAGE: " << filename << std::endl;
-		return false;
+		glDeleteQueries(2, m_fragmentQueries);
+		m_fragmentQueries[0] = m_fragmentQueries[1] = 0;
 	}
-
-	std::cout << "LOADED IMAAGE: " << filename << " (" << width << "x" << height << ", channels: " << colorChannels << ")" << std::endl;
-
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	if (colorChannels == 3)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	else if (colorChannels == 4)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-	else
+	m_occlusionCuller.SetJobSystem(NULL);
+	if (NULL != m_pJobSystem)
 	{
-		std::cout << "UNSUPPORTED: " << colorChannels  << std::endl;
-		stbi_image_free(image);
-		return false;
+		delete m_pJobSystem;
+		m_pJobSystem = NULL;
 	}
 
-	glGenerateMipmap(GL_TEXTURE_2D);
-	stbi_image_free(image);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	m_textureIDs[m_loadedTextures].ID = textureID;
-	m_textureIDs[m_loadedTextures].tag = tag;
-	m_loadedTextures++;
-
-	return true;
-}
-
-
-/***********************************************************
- *  BindGLTextures()
- ***********************************************************/
-void SceneManager::BindGLTextures()
-{
-	for (int i = 0; i < m_loadedTextures; i++)
+	m_textures.Destroy();
+	if (m_materialBuffer != 0)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		glDeleteBuffers(1, &m_materialBuffer);
+		m_materialBuffer = 0;
 	}
-}
-
-/***********************************************************
- *  DestroyGLTextures()
- ***********************************************************/
-void SceneManager::DestroyGLTextures()
-{
-	if (m_loadedTextures <= 0)
+	if (m_instanceBuffer != 0)
 	{
-		std::cout << "NO TEXTURES TO DESTROY." << std::endl;
-		return;
+		glDeleteBuffers(1, &m_instanceBuffer);
+		m_instanceBuffer = 0;
 	}
-
-	for (int i = 0; i < m_loadedTextures; i++)
+	if (m_fillCostInstanceBuffer != 0)
 	{
-		if (m_textureIDs[i].ID != 0)
-		{
-			glDeleteTextures(1, &m_textureIDs[i].ID);
-			m_textureIDs[i].ID = 0;
-		}
+		glDeleteBuffers(1, &m_fillCostInstanceBuffer);
+		m_fillCostInstanceBuffer = 0;
 	}
-	m_loadedTextures = 0;
-
-	std::cout << "TEXTURES DESTROYED SUCCESSFULLY." << std::endl;
 }
 
 
 /***********************************************************
- *  FindTextureSlot()
- ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
-{
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		if (m_textureIDs[i].tag == tag)
-			return i;
-	}
-	return -1;
-}
-
-/***********************************************************
- *  SetShaderTexture()
+ *  CreateGLTexture()
+ *
+ *  This method registers a texture image to be decoded and
+ *  packed into the texture array for its size and format
+ *  when all the scene textures are loaded.
  ***********************************************************/
-void SceneManager::SetShaderTexture(std::string tag)
+bool SceneManager::CreateGLTexture(const char* filename, const std::string& tag)
 {
-	if (m_pShaderManager == NULL)
-		return;
+	m_textures.Register(filename, tag);
 
-	int slot = FindTextureSlot(tag);
-	if (slot != -1)
-	{
-		m_pShaderManager->setIntValue("bUseTexture", true);
-		m_pShaderManager->setSampler2DValue("objectTexture", slot);
-	}
+	return true;
 }
 
 /***********************************************************
@@ -195,6 +174,8 @@ void SceneManager::SetShaderTexture(std::string tag)
  ***********************************************************/
 void SceneManager::LoadSceneTextures()
 {
+	PROFILE_SCOPE("Load textures");
+
 	std::cout << "LOADING TEXTURES..." << std::endl;
 
 	CreateGLTexture("textures/cake.jpg", "cake");
@@ -210,32 +191,148 @@ void SceneManager::LoadSceneTextures()
 	CreateGLTexture("textures/paper2.jpg", "paper2");
 	CreateGLTexture("textures/frosting.jpg", "frosting");
 
-
-	BindGLTextures();
+	// decode in parallel and pack the textures into arrays,
+	// bound once for all frames; files with the same contents
+	// (the two ceiling tags) share one texture
+	m_textures.LoadAll(m_workerThreadCount, m_compressTextures);
+	m_workerThreadCount = m_textures.GetLoadThreadCount();
 
 	std::cout << "ALL TEXTURES LOADED." << std::endl;
 }
 
 
+/***********************************************************
+ *  LoadSceneFile()
+ *
+ *  This method loads the scene object table, copies its
+ *  materials into the material list and resolves the
+ *  texture tags to loaded textures.
+ ***********************************************************/
+bool SceneManager::LoadSceneFile(const char* scenePath)
+{
+	PROFILE_SCOPE("Load scene");
+
+	if (!m_sceneFile.Load(scenePath))
+	{
+		return false;
+	}
+	if (m_sceneFile.GetMaterialCount() > MAX_SCENE_MATERIALS)
+	{
+		std::cout << "ERROR: TOO MANY SCENE MATERIALS: " << m_sceneFile.GetMaterialCount()
+			<< " (MAX " << MAX_SCENE_MATERIALS << ")" << std::endl;
+		m_sceneFile.Close();
+		return false;
+	}
+
+	m_objectMaterials.clear();
+	for (uint32_t i = 0; i < m_sceneFile.GetMaterialCount(); i++)
+	{
+		const SceneFile::MATERIAL_RECORD& record = m_sceneFile.GetMaterial(i);
+		OBJECT_MATERIAL material;
+		material.ambientColor = glm::vec3(record.ambientColor[0], record.ambientColor[1], record.ambientColor[2]);
+		material.ambientStrength = record.ambientStrength;
+		material.diffuseColor = glm::vec3(record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2]);
+		material.specularColor = glm::vec3(record.specularColor[0], record.specularColor[1], record.specularColor[2]);
+		material.shininess = record.shininess;
+		material.tag = m_sceneFile.GetMaterialTag(i);
+		m_objectMaterials.push_back(material);
+	}
+
+	for (int texture : m_sceneTextures)
+	{
+		m_textures.Release(texture);
+	}
+	m_sceneTextures.clear();
+	for (uint32_t i = 0; i < m_sceneFile.GetTextureCount(); i++)
+	{
+		int texture = m_textures.Acquire(m_sceneFile.GetTextureTag(i));
+		if (texture == -1)
+		{
+			std::cout << "MISSING SCENE TEXTURE: " << m_sceneFile.GetTextureTag(i) << std::endl;
+		}
+		m_sceneTextures.push_back(texture);
+	}
+
+	std::vector<LightClusters::LIGHT_SOURCE> lights;
+	for (uint32_t i = 0; i < m_sceneFile.GetLightCount(); i++)
+	{
+		const SceneFile::LIGHT_RECORD& record = m_sceneFile.GetLight(i);
+		LightClusters::LIGHT_SOURCE light;
+		light.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+		light.range = record.range;
+		light.ambientColor = glm::vec3(record.ambientColor[0], record.ambientColor[1], record.ambientColor[2]);
+		light.focalStrength = record.focalStrength;
+		light.diffuseColor = glm::vec3(record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2]);
+		light.specularIntensity = record.specularIntensity;
+		light.specularColor = glm::vec3(record.specularColor[0], record.specularColor[1], record.specularColor[2]);
+		// any layer marks a shadowed light, the shadow maps
+		// assign the real one
+		light.shadowMap = ((record.flags & LIGHT_FLAG_SHADOWS) != 0) ? 0.0f : -1.0f;
+		lights.push_back(light);
+	}
+	SetSceneLights(lights);
+
+	return true;
+}
+
+
 /***********************************************************
  *  PrepareScene()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadConeMesh();
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadSphereMesh();
+	m_basicMeshes->LoadMeshes();
 
 	LoadSceneTextures();
+
+	// the frame jobs get as many threads as the decodes had,
+	// one per core unless a count was given
+	if (NULL == m_pJobSystem)
+	{
+		m_pJobSystem = new JobSystem(m_workerThreadCount);
+		m_occlusionCuller.SetJobSystem(m_pJobSystem);
+	}
+
+	m_pLightClusters->Initialize();
+	m_pShadowMaps->Initialize();
+	if (!m_pDeferredShading->Initialize("shaders/deferredLightingComputeShader.glsl"))
+	{
+		std::cout << "ERROR: DEFERRED SHADING UNAVAILABLE, DRAWING FORWARD" << std::endl;
+	}
+	if (!m_pFillCostProfiler->Initialize("shaders/overdrawHeatmapComputeShader.glsl"))
+	{
+		std::cout << "ERROR: OVERDRAW HEATMAP UNAVAILABLE" << std::endl;
+	}
+	InitializeDepthPrepass();
+
+	if (LoadSceneFile("scenes/kitchen.scene"))
+	{
+		CreateMaterialBuffer();
+		InitializeTransformCache();
+		// the compute shader culls instances only, so nothing
+		// is merged into static batches
+		if (m_gpuDriven)
+		{
+			m_staticBatching = false;
+		}
+		BuildDrawBatches();
+		if (m_gpuDriven && !BuildGpuScene())
+		{
+			std::cout << "ERROR: GPU DRIVEN RENDERING UNAVAILABLE, DRAWING FROM THE CPU" << std::endl;
+			m_gpuDriven = false;
+			m_basicMeshes->SetInstanceBuffer(m_instanceBuffer);
+		}
+		BuildShadowCasters();
+	}
+
+	m_textures.ReportResidency();
 }
 
 
 /***********************************************************
- *  SetTransformations()
+ *  BuildModelMatrix()
  ***********************************************************/
-void SceneManager::SetTransformations(glm::vec3 scaleXYZ,
+glm::mat4 SceneManager::BuildModelMatrix(glm::vec3 scaleXYZ,
 	float XrotationDegrees,
 	float YrotationDegrees,
 	float ZrotationDegrees,
@@ -247,646 +344,1406 @@ void SceneManager::SetTransformations(glm::vec3 scaleXYZ,
 	glm::mat4 rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0, 0, 1));
 	glm::mat4 translation = glm::translate(positionXYZ);
 
-	glm::mat4 modelView = translation * rotationZ * rotationY * rotationX * scale;
-
-	if (m_pShaderManager)
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+	return(translation * rotationZ * rotationY * rotationX * scale);
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  InitializeTransformCache()
+ *
+ *  This method copies the object transforms out of the
+ *  mapped scene table so they can be changed at runtime,
+ *  and builds every model matrix once.
  ***********************************************************/
-void SceneManager::SetShaderColor(float r, float g, float b, float a)
+void SceneManager::InitializeTransformCache()
 {
-	glm::vec4 color(r, g, b, a);
-	if (m_pShaderManager)
+	const SceneFile::OBJECT_TABLE& objects = m_sceneFile.GetObjects();
+
+	m_transforms.scales.assign(objects.scales, objects.scales + objects.count);
+	m_transforms.rotations.assign(objects.rotations, objects.rotations + objects.count);
+	m_transforms.positions.assign(objects.positions, objects.positions + objects.count);
+	m_transforms.modelMatrices.resize(objects.count);
+	m_transforms.dirty.assign(objects.count, 1);
+	m_transforms.anyDirty = true;
+	m_culler.Resize(objects.count);
+	m_spatialIndex.Resize(objects.count);
+	m_occluded.assign(objects.count, 0);
+	m_objectLods.assign(objects.count, 0);
+
+	// occluders are drawn as a box that fits inside the mesh,
+	// cones have no useful one
+	m_occluders.clear();
+	for (uint32_t i = 0; i < objects.count; i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, color);
+		SCENE_MESH_ID meshID = static_cast<SCENE_MESH_ID>(objects.meshIDs[i]);
+		if ((objects.flags[i] & OBJECT_FLAG_OCCLUDER) == 0 || meshID == MESH_CONE)
+		{
+			continue;
+		}
+
+		SCENE_OCCLUDER occluder;
+		occluder.object = i;
+		m_basicMeshes->GetLocalBounds(meshID, occluder.localCenter, occluder.localExtents);
+		if (meshID == MESH_CYLINDER)
+		{
+			occluder.localExtents.x *= CYLINDER_OCCLUDER_SCALE;
+			occluder.localExtents.z *= CYLINDER_OCCLUDER_SCALE;
+		}
+		else if (meshID == MESH_SPHERE)
+		{
+			occluder.localExtents *= SPHERE_OCCLUDER_SCALE;
+		}
+		m_occluders.push_back(occluder);
 	}
+
+	UpdateTransformCache();
+	m_spatialIndex.Build();
 }
 
 /***********************************************************
- *  RenderScene()
+ *  UpdateTransformCache()
  *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes
+ *  This method rebuilds only the model matrices and world
+ *  bounds of objects that were moved since the last update.
+ *  The matrices, culling bounds and instance transforms are
+ *  rebuilt by jobs over ranges of objects. The hierarchy
+ *  marks itself changed on every new box, so it is given
+ *  the boxes afterwards on the calling thread.
  ***********************************************************/
-void SceneManager::RenderScene()
+void SceneManager::UpdateTransformCache()
 {
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
-
-	BindGLTextures();
-
-	m_pShaderManager->setIntValue("bUseLighting", true);
+	if (!m_transforms.anyDirty)
+	{
+		return;
+	}
 
+	const SceneFile::OBJECT_TABLE& objects = m_sceneFile.GetObjects();
+	const uint32_t objectCount = static_cast<uint32_t>(m_transforms.modelMatrices.size());
+	std::atomic<uint32_t> instancesChanged(0);
+	m_pJobSystem->ParallelFor(objectCount, OBJECT_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t rangeChanged = 0;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				if (!m_transforms.dirty[i])
+				{
+					continue;
+				}
+
+				m_transforms.modelMatrices[i] = BuildModelMatrix(
+					m_transforms.scales[i],
+					m_transforms.rotations[i].x,
+					m_transforms.rotations[i].y,
+					m_transforms.rotations[i].z,
+					m_transforms.positions[i]);
+
+				glm::vec3 localCenter;
+				glm::vec3 localExtents;
+				glm::vec3 worldCenter;
+				glm::vec3 worldExtents;
+				m_basicMeshes->GetLocalBounds(static_cast<SCENE_MESH_ID>(objects.meshIDs[i]),
+					localCenter, localExtents);
+				FrustumCuller::TransformBounds(m_transforms.modelMatrices[i],
+					localCenter, localExtents, worldCenter, worldExtents);
+				m_culler.SetBounds(i, worldCenter, worldExtents);
+
+				if (i < m_objectInstances.size() && m_objectInstances[i] != UINT32_MAX)
+				{
+					m_instances[m_objectInstances[i]].model = m_transforms.modelMatrices[i];
+					rangeChanged = 1;
+				}
+			}
+			instancesChanged |= rangeChanged;
+		});
+
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		if (m_transforms.dirty[i])
+		{
+			glm::vec3 worldCenter = m_culler.GetCenter(i);
+			glm::vec3 worldExtents = m_culler.GetExtents(i);
+			m_spatialIndex.SetBounds(i, worldCenter - worldExtents, worldCenter + worldExtents);
+			if (i < m_pShadowMaps->GetCasterCount())
+			{
+				m_pShadowMaps->SetCasterTransform(i, m_transforms.modelMatrices[i], worldCenter, worldExtents);
+			}
+			if (m_gpuDriven && m_gpuCuller.IsInitialized())
+			{
+				GpuCuller::GPU_OBJECT gpuObject = m_gpuCuller.GetObject(i);
+				gpuObject.instance = m_instances[m_objectInstances[i]];
+				gpuObject.boundsCenter = glm::vec4(worldCenter, 0.0f);
+				gpuObject.boundsExtents = glm::vec4(worldExtents, 0.0f);
+				m_gpuCuller.SetObject(i, gpuObject);
+			}
+			m_transforms.dirty[i] = 0;
+		}
+	}
 
-	//LIGHT 0 
+	if (instancesChanged.load() != 0)
+	{
+		m_instancesDirty = true;
+	}
+	m_transforms.anyDirty = false;
+}
 
-	m_pShaderManager->setVec3Value("lightSources[0].position", glm::vec3(0.0f));
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", glm::vec3(0.0f));
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", glm::vec3(0.0f));
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", glm::vec3(0.0f));
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 1.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.0f);
+/***********************************************************
+ *  BuildDrawBatches()
+ *
+ *  This method groups the scene objects by mesh and
+ *  texture array. Each group is one instanced draw, with
+ *  the object transforms, colors, materials and texture
+ *  layers laid out contiguously in the instance buffer. Batches are kept
+ *  in the order their first object appears in the file;
+ *  the draw order is decided each frame by sort key.
+ *  Objects flagged static are instead merged, per texture
+ *  array and grid cell of their positions, into meshes
+ *  already in world space, which are drawn whole every
+ *  frame without culling. The cells keep the walls, floor
+ *  and ceiling apart, so they can be ordered by distance
+ *  like the other batches.
+ ***********************************************************/
+void SceneManager::BuildDrawBatches()
+{
+	const SceneFile::OBJECT_TABLE& objects = m_sceneFile.GetObjects();
+
+	std::map<std::pair<int, int>, size_t> batchLookup;
+	std::vector<std::vector<uint32_t>> batchObjects;
+	// static objects by texture array and grid cell, the
+	// material is per vertex
+	std::map<std::tuple<int, int, int, int>, std::vector<uint32_t>> staticObjects;
+	uint32_t instanceCount = 0;
+	m_objectTextureArrays.assign(objects.count, -1);
+	m_objectTextureLayers.assign(objects.count, -1);
+	m_drawBatches.clear();
+	for (uint32_t i = 0; i < objects.count; i++)
+	{
+		int textureArray = -1;
+		int texture = -1;
+		if (objects.textureIndices[i] >= 0)
+		{
+			texture = m_sceneTextures[objects.textureIndices[i]];
+		}
+		if (texture != -1 && m_textures.GetLayer(texture).arrayIndex != -1)
+		{
+			textureArray = m_textures.GetLayer(texture).arrayIndex;
+			m_objectTextureArrays[i] = textureArray;
+			m_objectTextureLayers[i] = m_textures.GetLayer(texture).layer;
+		}
 
+		if (m_staticBatching && (objects.flags[i] & OBJECT_FLAG_STATIC) != 0)
+		{
+			glm::ivec3 cell = glm::ivec3(glm::floor(m_transforms.positions[i] / STATIC_CHUNK_SIZE));
+			staticObjects[std::make_tuple(textureArray, cell.x, cell.y, cell.z)].push_back(i);
+			continue;
+		}
 
-	//LIGHT 1 (SUNLIGHT)
+		std::pair<int, int> batchKey(objects.meshIDs[i], textureArray);
+		std::map<std::pair<int, int>, size_t>::iterator found = batchLookup.find(batchKey);
+		if (found == batchLookup.end())
+		{
+			DRAW_BATCH batch;
+			batch.meshID = static_cast<SCENE_MESH_ID>(objects.meshIDs[i]);
+			batch.textureArray = textureArray;
+			batch.materialIndex = objects.materialIndices[i];
+			batch.firstObject = i;
+			batch.firstInstance = 0;
+			batch.instanceCount = 0;
+			batch.staticBatch = -1;
+			batch.firstStaticObject = 0;
+			found = batchLookup.insert(std::make_pair(batchKey, m_drawBatches.size())).first;
+			m_drawBatches.push_back(batch);
+			batchObjects.push_back(std::vector<uint32_t>());
+		}
+		batchObjects[found->second].push_back(i);
+		instanceCount++;
+	}
 
-	m_pShaderManager->setVec3Value("lightSources[1].position", glm::vec3(0.0f, 6.5f, -14.0f));
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", glm::vec3(0.08f, 0.06f, 0.03f));
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", glm::vec3(0.6f, 0.45f, 0.25f));
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", glm::vec3(0.7f, 0.55f, 0.35f));
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 20.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.7f);
+	m_instances.resize(instanceCount);
+	m_objectInstances.assign(objects.count, UINT32_MAX);
+	m_instanceObjects.resize(instanceCount);
+	uint32_t slot = 0;
+	for (size_t b = 0; b < m_drawBatches.size(); b++)
+	{
+		m_drawBatches[b].firstInstance = slot;
+		m_drawBatches[b].instanceCount = static_cast<uint32_t>(batchObjects[b].size());
+		m_drawBatches[b].visibleInstanceCount = m_drawBatches[b].instanceCount;
+		for (int lod = 0; lod < PrimitiveMeshes::MAX_LOD_LEVELS; lod++)
+		{
+			m_drawBatches[b].lodInstanceCounts[lod] = 0;
+		}
+		m_drawBatches[b].lodInstanceCounts[0] = m_drawBatches[b].instanceCount;
 
+		for (uint32_t object : batchObjects[b])
+		{
+			PrimitiveMeshes::INSTANCE_DATA& instance = m_instances[slot];
+			instance.model = m_transforms.modelMatrices[object];
+			instance.color = objects.colors[object];
+			instance.materialIndex = objects.materialIndices[object];
+			instance.textureLayer = m_objectTextureLayers[object];
+			instance.padding[0] = instance.padding[1] = 0;
+			m_objectInstances[object] = slot;
+			m_instanceObjects[slot] = object;
+			slot++;
+		}
+	}
 
-	//LIGHT 2 (ROOM LIGHT)
+	if (m_instanceBuffer == 0)
+	{
+		glGenBuffers(1, &m_instanceBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_instances.size() * sizeof(PrimitiveMeshes::INSTANCE_DATA),
+		m_instances.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_basicMeshes->SetInstanceBuffer(m_instanceBuffer);
+	m_visibleInstances = m_instances;
+	m_instancesDirty = false;
+
+	const size_t instancedBatchCount = m_drawBatches.size();
+	m_staticBatchObjects.clear();
+	for (const std::pair<const std::tuple<int, int, int, int>, std::vector<uint32_t>>& group : staticObjects)
+	{
+		std::vector<PrimitiveMeshes::STATIC_OBJECT> merged;
+		merged.reserve(group.second.size());
+		for (uint32_t object : group.second)
+		{
+			PrimitiveMeshes::STATIC_OBJECT staticObject;
+			staticObject.meshID = static_cast<SCENE_MESH_ID>(objects.meshIDs[object]);
+			staticObject.model = m_transforms.modelMatrices[object];
+			staticObject.color = objects.colors[object];
+			staticObject.materialIndex = objects.materialIndices[object];
+			staticObject.textureLayer = m_objectTextureLayers[object];
+			merged.push_back(staticObject);
+		}
 
-	m_pShaderManager->setVec3Value("lightSources[2].position", glm::vec3(0.0f, 20.0f, 0.0f));
-	m_pShaderManager->setVec3Value("lightSources[2].ambientColor", glm::vec3(0.025f, 0.025f, 0.025f));
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", glm::vec3(0.06f, 0.06f, 0.06f));
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", glm::vec3(0.08f, 0.08f, 0.08f));
-	m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 2.0f);
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.05f);
+		DRAW_BATCH batch;
+		batch.meshID = static_cast<SCENE_MESH_ID>(objects.meshIDs[group.second[0]]);
+		batch.textureArray = std::get<0>(group.first);
+		batch.materialIndex = objects.materialIndices[group.second[0]];
+		batch.firstObject = group.second[0];
+		batch.firstInstance = 0;
+		batch.instanceCount = static_cast<uint32_t>(group.second.size());
+		batch.visibleInstanceCount = batch.instanceCount;
+		for (int lod = 0; lod < PrimitiveMeshes::MAX_LOD_LEVELS; lod++)
+		{
+			batch.lodInstanceCounts[lod] = 0;
+		}
+		batch.staticBatch = m_basicMeshes->CreateStaticBatch(merged);
+		batch.firstStaticObject = static_cast<uint32_t>(m_staticBatchObjects.size());
+		m_staticBatchObjects.insert(m_staticBatchObjects.end(), group.second.begin(), group.second.end());
+		m_drawBatches.push_back(batch);
+	}
 
+	std::cout << "INFO: " << objects.count << " scene objects in "
+		<< instancedBatchCount << " instanced draws and "
+		<< (m_drawBatches.size() - instancedBatchCount) << " static batches of "
+		<< (objects.count - instanceCount) << " objects" << std::endl;
+}
 
+/***********************************************************
+ *  BuildGpuScene()
+ *
+ *  This method turns every level of every batch into an
+ *  indirect draw command with its own range of instance
+ *  slots, as large as the batch, so the compute shader can
+ *  append to any level without counting first. Batches are
+ *  ordered by texture array so each array's commands are
+ *  contiguous and drawn by one multi-draw.
+ ***********************************************************/
+bool SceneManager::BuildGpuScene()
+{
+	if (!m_gpuCuller.Initialize("shaders/cullComputeShader.glsl"))
+	{
+		return(false);
+	}
 
-	//LIGHT 3
+	std::vector<size_t> batchOrder;
+	batchOrder.reserve(m_drawBatches.size());
+	for (size_t b = 0; b < m_drawBatches.size(); b++)
+	{
+		batchOrder.push_back(b);
+	}
+	std::stable_sort(batchOrder.begin(), batchOrder.end(), [this](size_t a, size_t b)
+		{
+			return(m_drawBatches[a].textureArray < m_drawBatches[b].textureArray);
+		});
+
+	std::vector<PrimitiveMeshes::DRAW_COMMAND> commands;
+	std::vector<GpuCuller::DRAW_GROUP> groups;
+	std::vector<uint32_t> batchCommands(m_drawBatches.size(), 0);
+	uint32_t instanceSlots = 0;
+	for (size_t b : batchOrder)
+	{
+		const DRAW_BATCH& batch = m_drawBatches[b];
+		if (groups.empty() || groups.back().textureArray != batch.textureArray)
+		{
+			GpuCuller::DRAW_GROUP group;
+			group.textureArray = batch.textureArray;
+			group.firstCommand = static_cast<uint32_t>(commands.size());
+			group.commandCount = 0;
+			groups.push_back(group);
+		}
 
-	m_pShaderManager->setVec3Value("lightSources[3].position", glm::vec3(0.0f));
-	m_pShaderManager->setVec3Value("lightSources[3].ambientColor", glm::vec3(0.0f));
-	m_pShaderManager->setVec3Value("lightSources[3].diffuseColor", glm::vec3(0.0f));
-	m_pShaderManager->setVec3Value("lightSources[3].specularColor", glm::vec3(0.0f));
-	m_pShaderManager->setFloatValue("lightSources[3].focalStrength", 1.0f);
-	m_pShaderManager->setFloatValue("lightSources[3].specularIntensity", 0.0f);
+		batchCommands[b] = static_cast<uint32_t>(commands.size());
+		const int lodCount = m_basicMeshes->GetLodCount(batch.meshID);
+		for (int lod = 0; lod < lodCount; lod++)
+		{
+			PrimitiveMeshes::DRAW_COMMAND command;
+			m_basicMeshes->GetLodRange(batch.meshID, lod,
+				command.indexCount, command.firstIndex, command.baseVertex);
+			command.instanceCount = 0;
+			command.baseInstance = instanceSlots;
+			commands.push_back(command);
+			instanceSlots += batch.instanceCount;
+		}
+		groups.back().commandCount += static_cast<uint32_t>(lodCount);
+	}
 
+	const SceneFile::OBJECT_TABLE& objects = m_sceneFile.GetObjects();
+	std::vector<GpuCuller::GPU_OBJECT> gpuObjects(objects.count);
+	for (size_t b = 0; b < m_drawBatches.size(); b++)
+	{
+		const DRAW_BATCH& batch = m_drawBatches[b];
+		for (uint32_t slot = batch.firstInstance; slot < batch.firstInstance + batch.instanceCount; slot++)
+		{
+			uint32_t object = m_instanceObjects[slot];
+			GpuCuller::GPU_OBJECT& gpuObject = gpuObjects[object];
+			gpuObject.instance = m_instances[slot];
+			gpuObject.boundsCenter = glm::vec4(m_culler.GetCenter(object), 0.0f);
+			gpuObject.boundsExtents = glm::vec4(m_culler.GetExtents(object), 0.0f);
+			gpuObject.firstCommand = batchCommands[b];
+			gpuObject.lodCount = static_cast<uint32_t>(m_basicMeshes->GetLodCount(batch.meshID));
+			gpuObject.padding[0] = gpuObject.padding[1] = 0;
+		}
+	}
 
-	//MATERIALS
+	m_gpuCuller.SetScene(gpuObjects, commands, groups, instanceSlots);
+	m_basicMeshes->SetInstanceBuffer(m_gpuCuller.GetInstanceBuffer());
 
-	m_pShaderManager->setVec3Value("material.ambientColor", glm::vec3(1.0f, 1.0f, 1.0f));
-	m_pShaderManager->setFloatValue("material.ambientStrength", 0.025f);
-	m_pShaderManager->setVec3Value("material.diffuseColor", glm::vec3(0.75f, 0.75f, 0.75f));
-	m_pShaderManager->setVec3Value("material.specularColor", glm::vec3(0.3f, 0.3f, 0.3f));
-	m_pShaderManager->setFloatValue("material.shininess", 20.0f);
+	std::cout << "INFO: " << commands.size() << " indirect draw commands in "
+		<< groups.size() << " multi-draws, culled on the GPU" << std::endl;
+	return(true);
+}
 
+/***********************************************************
+ *  BuildShadowCasters()
+ *
+ *  Every scene object casts shadows. The objects flagged
+ *  static are drawn into the cached shadow maps, the rest
+ *  over them whenever they move.
+ ***********************************************************/
+void SceneManager::BuildShadowCasters()
+{
+	const SceneFile::OBJECT_TABLE& objects = m_sceneFile.GetObjects();
 
+	std::vector<ShadowMaps::SHADOW_CASTER> casters(objects.count);
+	for (uint32_t i = 0; i < objects.count; i++)
+	{
+		ShadowMaps::SHADOW_CASTER& caster = casters[i];
+		caster.meshID = static_cast<SCENE_MESH_ID>(objects.meshIDs[i]);
+		caster.model = m_transforms.modelMatrices[i];
+		caster.boundsCenter = m_culler.GetCenter(i);
+		caster.boundsExtents = m_culler.GetExtents(i);
+		caster.isStatic = (objects.flags[i] & OBJECT_FLAG_STATIC) != 0;
+	}
+	m_pShadowMaps->SetCasters(casters);
+}
 
+/***********************************************************
+ *  CullObjects()
+ *
+ *  This method tests the object bounds against the view
+ *  frustum. The instances are only repacked when the set
+ *  of visible objects differs from the last frame. Static
+ *  batches are drawn whole, so their objects are left out
+ *  of the visible and culled counts.
+ ***********************************************************/
+void SceneManager::CullObjects(const SCENE_VIEW& view)
+{
+	if (m_cullingEnabled)
+	{
+		m_culler.Cull(FrustumCuller::ExtractFrustum(view.projection * view.view), m_pJobSystem);
+	}
+	else
+	{
+		m_culler.SetAllVisible();
+	}
 
-//FLOOR//
+	if (m_culler.VisibilityChanged())
+	{
+		m_instancesDirty = true;
+	}
 
-	scaleXYZ = glm::vec3(25.0f, 1.0f, 25.0f);
-	positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("floor");
-	m_basicMeshes->DrawPlaneMesh();
+	uint32_t staticVisible = 0;
+	for (uint32_t object : m_staticBatchObjects)
+	{
+		staticVisible += m_culler.IsVisible(object) ? 1 : 0;
+	}
+	const uint32_t staticCount = static_cast<uint32_t>(m_staticBatchObjects.size());
+	m_frameStats.visibleObjects = m_culler.GetVisibleCount() - staticVisible;
+	m_frameStats.culledObjects = m_culler.GetCulledCount() - (staticCount - staticVisible);
+	m_frameStats.untestedObjects = staticCount;
+}
 
-	m_pShaderManager->setIntValue("bUseTexture", false);
+/***********************************************************
+ *  OccludeObjects()
+ *
+ *  This method draws the occluders into the software depth
+ *  buffer and tests the bounds of each object left by the
+ *  frustum cull against it, in jobs over ranges of objects.
+ *  Occluders are tested too; their bounds enclose their own
+ *  occluder box, so they are only hidden by other occluders.
+ *  Objects in static batches are drawn anyway and are not
+ *  tested.
+ ***********************************************************/
+void SceneManager::OccludeObjects(const SCENE_VIEW& view)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
+	uint8_t changed = 0;
+	uint32_t occludedCount = 0;
+	if (m_occlusionEnabled && !m_occluders.empty())
+	{
+		m_occlusionCuller.ClearOccluders();
+		for (const SCENE_OCCLUDER& occluder : m_occluders)
+		{
+			m_occlusionCuller.AddOccluder(m_transforms.modelMatrices[occluder.object],
+				occluder.localCenter, occluder.localExtents);
+		}
+		m_occlusionCuller.RenderOccluders(view.projection * view.view);
+
+		std::atomic<uint32_t> sharedChanged(0);
+		std::atomic<uint32_t> sharedCount(0);
+		m_pJobSystem->ParallelFor(static_cast<uint32_t>(m_occluded.size()), OBJECT_GRAIN_SIZE,
+			[&](uint32_t begin, uint32_t end)
+			{
+				uint8_t rangeChanged = 0;
+				uint32_t rangeCount = 0;
+				for (uint32_t i = begin; i < end; i++)
+				{
+					uint8_t occluded = 0;
+					if (m_culler.IsVisible(i) && m_objectInstances[i] != UINT32_MAX)
+					{
+						const glm::vec3& boundsMin = m_spatialIndex.GetBoundsMin(i);
+						const glm::vec3& boundsMax = m_spatialIndex.GetBoundsMax(i);
+						occluded = m_occlusionCuller.IsOccluded(
+							(boundsMin + boundsMax) * 0.5f, (boundsMax - boundsMin) * 0.5f) ? 1 : 0;
+					}
+					rangeChanged |= m_occluded[i] ^ occluded;
+					m_occluded[i] = occluded;
+					rangeCount += occluded;
+				}
+				sharedChanged |= rangeChanged;
+				sharedCount += rangeCount;
+			});
+		changed = static_cast<uint8_t>(sharedChanged.load());
+		occludedCount = sharedCount.load();
+	}
+	else
+	{
+		for (uint8_t& occluded : m_occluded)
+		{
+			changed |= occluded;
+			occluded = 0;
+		}
+	}
 
+	if (changed != 0)
+	{
+		m_instancesDirty = true;
+	}
 
+	m_frameStats.occludedObjects = occludedCount;
+	m_frameStats.visibleObjects -= occludedCount;
+	m_frameStats.occlusionMilliseconds = std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+}
 
-//CEILING//
+/***********************************************************
+ *  SelectLevelsOfDetail()
+ *
+ *  The screen size of an object is the diameter of the
+ *  sphere around its bounds, projected at its distance.
+ *  Objects out of view keep their level until they are
+ *  seen again. Ranges of objects are handled by jobs.
+ ***********************************************************/
+void SceneManager::SelectLevelsOfDetail(const SCENE_VIEW& view)
+{
+	const SceneFile::OBJECT_TABLE& objects = m_sceneFile.GetObjects();
+	// pixels across per unit of size at unit distance
+	const float pixelScale = view.projection[1][1] * 0.5f * static_cast<float>(view.viewportHeight);
 
-	float savedAmbientStrength = 0.03f;
-	glm::vec3 savedSpecularColor = glm::vec3(0.4f, 0.4f, 0.4f);
-	float savedShininess = 24.0f;
+	std::atomic<uint32_t> changed(0);
+	m_pJobSystem->ParallelFor(static_cast<uint32_t>(m_objectLods.size()), OBJECT_GRAIN_SIZE,
+		[&](uint32_t begin, uint32_t end)
+		{
+			uint32_t rangeChanged = 0;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				SCENE_MESH_ID meshID = static_cast<SCENE_MESH_ID>(objects.meshIDs[i]);
+				if (m_basicMeshes->GetLodCount(meshID) < 2 || !m_culler.IsVisible(i) || m_occluded[i] != 0)
+				{
+					continue;
+				}
+
+				int lod = 0;
+				if (m_lodEnabled)
+				{
+					const glm::vec3& boundsMin = m_spatialIndex.GetBoundsMin(i);
+					const glm::vec3& boundsMax = m_spatialIndex.GetBoundsMax(i);
+					float diameter = glm::length(boundsMax - boundsMin);
+					float distance = glm::length((boundsMin + boundsMax) * 0.5f - view.position);
+					// the camera inside the sphere sees the object up close
+					float screenDiameter = (distance > diameter * 0.5f) ?
+						diameter * pixelScale / distance : FLT_MAX;
+					lod = m_basicMeshes->SelectLod(meshID, screenDiameter, m_objectLods[i]);
+				}
+
+				if (lod != m_objectLods[i])
+				{
+					m_objectLods[i] = static_cast<uint8_t>(lod);
+					rangeChanged = 1;
+				}
+			}
+			changed |= rangeChanged;
+		});
+
+	if (changed.load() != 0)
+	{
+		m_instancesDirty = true;
+	}
+}
 
-	m_pShaderManager->setFloatValue("material.ambientStrength", 0.02f);
-	m_pShaderManager->setVec3Value("material.specularColor", glm::vec3(0.08f, 0.08f, 0.08f));
-	m_pShaderManager->setFloatValue("material.shininess", 4.0f);
+/***********************************************************
+ *  BuildDrawLists()
+ *
+ *  Each job handles a range of batches, repacking their
+ *  instances when anything changed and recording a sort key
+ *  for every batch with visible instances into a draw list
+ *  of its own. Batches own disjoint instance slots, so the
+ *  jobs write nothing in common, and merging the lists in
+ *  job order gives the same queue as recording serially.
+ ***********************************************************/
+void SceneManager::BuildDrawLists(const SCENE_VIEW& view)
+{
+	const bool packInstances = m_instancesDirty && m_instanceBuffer != 0;
+	const uint32_t batchCount = static_cast<uint32_t>(m_drawBatches.size());
+	m_drawLists.resize((batchCount + BATCH_GRAIN_SIZE - 1) / BATCH_GRAIN_SIZE);
 
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("ceiling");
-	scaleXYZ = glm::vec3(25.0f, 1.0f, 25.0f);
-	positionXYZ = glm::vec3(0.0f, 12.0f, 0.0f);
-	SetTransformations(scaleXYZ, 180.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawPlaneMesh();
+	m_pJobSystem->ParallelFor(batchCount, BATCH_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+		{
+			DrawQueue& drawList = m_drawLists[begin / BATCH_GRAIN_SIZE];
+			drawList.Clear();
+			for (uint32_t i = begin; i < end; i++)
+			{
+				DRAW_BATCH& batch = m_drawBatches[i];
+				if (packInstances && batch.staticBatch < 0)
+				{
+					PackBatchInstances(batch);
+				}
+				if (batch.visibleInstanceCount == 0)
+				{
+					continue;
+				}
+
+				// each static batch has a vertex array of its own
+				uint32_t mesh = (batch.staticBatch >= 0) ?
+					static_cast<uint32_t>(MESH_COUNT + batch.staticBatch) : static_cast<uint32_t>(batch.meshID);
+				drawList.Add(DrawQueue::MakeKey(
+					static_cast<uint32_t>(batch.textureArray + 1),
+					static_cast<uint32_t>(batch.materialIndex),
+					mesh,
+					GetBatchDistance(batch, view.position),
+					view.farPlane), i);
+			}
+		});
+}
 
-	m_pShaderManager->setFloatValue("material.ambientStrength", savedAmbientStrength);
-	m_pShaderManager->setVec3Value("material.specularColor", savedSpecularColor);
-	m_pShaderManager->setFloatValue("material.shininess", savedShininess);
+/***********************************************************
+ *  GetBatchDistance()
+ *
+ *  The distance is to the nearest box of the objects the
+ *  batch draws: the visible ones of an instanced batch and
+ *  every object of a static one. Within an instanced draw
+ *  the instances still go in slot order, not by distance,
+ *  so the front to back order is by batch, not by object.
+ ***********************************************************/
+float SceneManager::GetBatchDistance(const DRAW_BATCH& batch, const glm::vec3& viewPosition) const
+{
+	float nearest = FLT_MAX;
+	if (batch.staticBatch >= 0)
+	{
+		for (uint32_t k = 0; k < batch.instanceCount; k++)
+		{
+			uint32_t object = m_staticBatchObjects[batch.firstStaticObject + k];
+			nearest = std::min(nearest, DistanceToBox(viewPosition, m_culler.GetCenter(object), m_culler.GetExtents(object)));
+		}
+		return(nearest);
+	}
 
+	const uint32_t lastSlot = batch.firstInstance + batch.instanceCount;
+	for (uint32_t slot = batch.firstInstance; slot < lastSlot; slot++)
+	{
+		uint32_t object = m_instanceObjects[slot];
+		if (m_culler.IsVisible(object) && m_occluded[object] == 0)
+		{
+			nearest = std::min(nearest, DistanceToBox(viewPosition, m_culler.GetCenter(object), m_culler.GetExtents(object)));
+		}
+	}
+	return(nearest);
+}
 
+/***********************************************************
+ *  PackBatchInstances()
+ *
+ *  The visible instances of the batch are packed at the
+ *  front of its slots, grouped by level of detail, so a
+ *  batch is one draw call per level it uses.
+ ***********************************************************/
+void SceneManager::PackBatchInstances(DRAW_BATCH& batch)
+{
+	const uint32_t lastSlot = batch.firstInstance + batch.instanceCount;
+	for (int lod = 0; lod < PrimitiveMeshes::MAX_LOD_LEVELS; lod++)
+	{
+		batch.lodInstanceCounts[lod] = 0;
+	}
+	for (uint32_t slot = batch.firstInstance; slot < lastSlot; slot++)
+	{
+		uint32_t object = m_instanceObjects[slot];
+		if (m_culler.IsVisible(object) && m_occluded[object] == 0)
+		{
+			batch.lodInstanceCounts[m_objectLods[object]]++;
+		}
+	}
 
+	uint32_t lodStarts[PrimitiveMeshes::MAX_LOD_LEVELS];
+	uint32_t packed = batch.firstInstance;
+	for (int lod = 0; lod < PrimitiveMeshes::MAX_LOD_LEVELS; lod++)
+	{
+		lodStarts[lod] = packed;
+		packed += batch.lodInstanceCounts[lod];
+	}
+	for (uint32_t slot = batch.firstInstance; slot < lastSlot; slot++)
+	{
+		uint32_t object = m_instanceObjects[slot];
+		if (m_culler.IsVisible(object) && m_occluded[object] == 0)
+		{
+			m_visibleInstances[lodStarts[m_objectLods[object]]++] = m_instances[slot];
+		}
+	}
+	batch.visibleInstanceCount = packed - batch.firstInstance;
+}
 
-//TRIM AROUND ROOM// 
-
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("trim");
-
-	float trimHeight = 0.25f;
-	float trimDepth = 0.1f;
-
-	//BACK WALL
-
-	scaleXYZ = glm::vec3(25.0f, trimHeight, trimDepth);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 0.125f, -12.45f));
-	m_basicMeshes->DrawBoxMesh();
-
-	// LEFT WALL
-
-	scaleXYZ = glm::vec3(25.0f, trimHeight, trimDepth);
-	SetTransformations(scaleXYZ, 0.0f, 90.0f, 0.0f, glm::vec3(-12.45f, 0.125f, 0.0f));
-	m_basicMeshes->DrawBoxMesh();
-
-	//RIGHT WALL
-
-	scaleXYZ = glm::vec3(25.0f, trimHeight, trimDepth);
-	SetTransformations(scaleXYZ, 0.0f, -90.0f, 0.0f, glm::vec3(12.45f, 0.125f, 0.0f));
-	m_basicMeshes->DrawBoxMesh();
-
-	//FRONT WALL
-
-	scaleXYZ = glm::vec3(25.0f, trimHeight, trimDepth);
-	SetTransformations(scaleXYZ, 0.0f, 180.0f, 0.0f, glm::vec3(0.0f, 0.125f, 12.45f));
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-//BACK WALL//
-
-
-	//BACK WALL LEFT
-
-	scaleXYZ = glm::vec3(6.0f, 1.0f, 12.0f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-9.5f, 6.0f, -12.51f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("wall");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-	//BACK WALL RIGHT
-
-	scaleXYZ = glm::vec3(6.0f, 1.0f, 12.0f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(9.5f, 6.0f, -12.51f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("wall");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-	//BACK WALL LEFT
-
-	scaleXYZ = glm::vec3(6.0f, 1.0f, 4.0f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 10.5f, -12.51f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("wall");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-	// LEFT WALL
-	scaleXYZ = glm::vec3(12.0f, 1.0f, 25.0f);
-	positionXYZ = glm::vec3(-12.51f, 6.0f, 0.0f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 90.0f, positionXYZ);
-	SetShaderTexture("wall");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-	//RIGHT WALL
-
-	scaleXYZ = glm::vec3(12.0f, 1.0f, 25.0f);
-	positionXYZ = glm::vec3(12.51f, 6.0f, 0.0f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, -90.0f, positionXYZ);
-	SetShaderTexture("wall");
-	m_basicMeshes->DrawPlaneMesh();
-
-	//FRONT WALL
-
-	scaleXYZ = glm::vec3(25.0f, 1.0f, 12.0f);
-	positionXYZ = glm::vec3(0.0f, 6.0f, 12.51f);     
-	SetTransformations(scaleXYZ, -90.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("wall");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-
-//FRIDGE//
-
-	scaleXYZ = glm::vec3(3.5f, 6.5f, 3.0f);
-	positionXYZ = glm::vec3(-10.5f, 3.25f, -9.5f);
-	SetTransformations(scaleXYZ, 0.0f, 10.0f, 0.0f, positionXYZ);
-	SetShaderTexture("fridge");
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//FRIDGE HANDLES
-
-	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f);
-
-
-	//TOP HANDLE
-
-	scaleXYZ = glm::vec3(0.15f, 1.1f, 0.15f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 10.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-8.9f, 5.05f, -8.25f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
-
-
-	//BOTTOM HANDLE
-
-	scaleXYZ = glm::vec3(0.15f, 2.2f, 0.15f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 10.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-8.9f, 2.45f, -8.25f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
-
-
-	//A+ PAPER
-
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("paper");
-
-	scaleXYZ = glm::vec3(0.7f, 0.9f, 0.01f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 2.0f;
-
-	glm::vec3 paperPos(-10.5f, 4.5f, -7.95f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, paperPos);
-	m_basicMeshes->DrawBoxMesh();
-	;
-
-
-	//STICK FIGURE PAPER
-
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("paper2");
-
-	scaleXYZ = glm::vec3(0.7f, 0.9f, 0.01f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = -1.5f;
-
-	glm::vec3 paper2Pos(-10.5f, 3.25f, -7.95f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, paper2Pos);
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-//TABLETOP//
-
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("wood");
-
-
-	scaleXYZ = glm::vec3(5.0f, 0.15f, 5.0f);
-	positionXYZ = glm::vec3(0.0f, 2.7f, -3.0f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
-
-
-
-//PLATE//
-
-	m_pShaderManager->setIntValue("bUseTexture", false);
-	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f);
-
-	scaleXYZ = glm::vec3(2.3f, 0.1f, 2.3f);
-	positionXYZ = glm::vec3(0.0f, 2.95f, -3.0f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
-
-
-
-//WINDOW AND OUTDOORS//
-
-
-	//BACK WALL
-
-	scaleXYZ = glm::vec3(25.0f, 1.0f, 12.0f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 6.0f, -12.5f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("wall");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-	//SKY TEXTURE
-
-	scaleXYZ = glm::vec3(2.95f, 1.0f, 1.65f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 7.0f, -12.35f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("sky");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-	//GRASS TEXTURE
-
-	scaleXYZ = glm::vec3(2.95f, 1.0f, 0.65f);
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 5.15f, -12.36f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("grass");
-	m_basicMeshes->DrawPlaneMesh();
-
-
-	//WINDOW FRAME
-
-	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f);
-
-
-	//TOP FRAME
-
-	scaleXYZ = glm::vec3(6.4f, 0.3f, 0.3f);
-	positionXYZ = glm::vec3(0.0f, 8.5f, -12.3f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//BOTTOM FRAME
-
-	scaleXYZ = glm::vec3(6.4f, 0.3f, 0.3f);
-	positionXYZ = glm::vec3(0.0f, 4.5f, -12.3f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//LEFT FRAME
-
-	scaleXYZ = glm::vec3(0.3f, 4.0f, 0.3f);
-	positionXYZ = glm::vec3(-3.1f, 6.5f, -12.3f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//RIGHT FRAME
-
-	scaleXYZ = glm::vec3(0.3f, 4.0f, 0.3f);
-	positionXYZ = glm::vec3(3.1f, 6.5f, -12.3f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
-
-	//WINDOW SILL
-
-	scaleXYZ = glm::vec3(6.0f, 0.3f, 0.6f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 4.2f, -12.2f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-//WINDOW PANES//
-
-
-	m_pShaderManager->setIntValue("bUseTexture", false);
-	m_pShaderManager->setVec3Value("objectColor", glm::vec3(1.0f));
-
-	float windowCenterX = 0.0f;
-	float windowCenterY = 6.1f;
-	float windowCenterZ = -12.33f;
-
-	float windowWidth = 5.9f;
-	float windowHeight = 4.4f;
-	float paneThickness = 0.08f;
-
-
-	//VERTICAL PANE
-
-	scaleXYZ = glm::vec3(paneThickness, windowHeight, 0.05f);
-	positionXYZ = glm::vec3(windowCenterX, windowCenterY + 0.4f, windowCenterZ + 0.02f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
-
-
-	//HORIZONTAL PANE
-
-	scaleXYZ = glm::vec3(windowWidth, paneThickness, 0.05f);
-	positionXYZ = glm::vec3(windowCenterX, windowCenterY, windowCenterZ + 0.02f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawBoxMesh();
-
-
-
-	
-//TABLETOP LEGS//
-
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("wood");
-
-	scaleXYZ = glm::vec3(0.3f, 2.7f, 0.3f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  UpdateInstanceBuffer()
+ ***********************************************************/
+void SceneManager::UpdateInstanceBuffer()
+{
+	if (!m_instancesDirty || m_instanceBuffer == 0)
+	{
+		return;
+	}
 
-	float legRadius = 4.3f;
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0,
+		m_visibleInstances.size() * sizeof(PrimitiveMeshes::INSTANCE_DATA), m_visibleInstances.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_instancesDirty = false;
+}
 
-	//FRONT LEG
+/***********************************************************
+ *  SetObjectTransform()
+ ***********************************************************/
+void SceneManager::SetObjectTransform(
+	uint32_t objectIndex,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	if (objectIndex >= m_transforms.modelMatrices.size())
+	{
+		return;
+	}
 
-	positionXYZ = glm::vec3(0.0f, 0.0f, -3.0f + legRadius);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	m_transforms.scales[objectIndex] = scaleXYZ;
+	m_transforms.rotations[objectIndex] = rotationDegreesXYZ;
+	m_transforms.positions[objectIndex] = positionXYZ;
+	m_transforms.dirty[objectIndex] = 1;
+	m_transforms.anyDirty = true;
+}
 
-	//BACK LEG
+/***********************************************************
+ *  PickObject()
+ ***********************************************************/
+bool SceneManager::PickObject(const glm::vec3& origin, const glm::vec3& direction, SceneBVH::RAY_HIT& hit) const
+{
+	const float maxDistance = 1000.0f;
+	return(m_spatialIndex.RayCast(origin, glm::normalize(direction), maxDistance, hit));
+}
 
-	positionXYZ = glm::vec3(0.0f, 0.0f, -3.0f - legRadius);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+/***********************************************************
+ *  FindMaterial()
+ ***********************************************************/
+int SceneManager::FindMaterial(const std::string& tag)
+{
+	for (size_t i = 0; i < m_objectMaterials.size(); i++)
+	{
+		if (m_objectMaterials[i].tag == tag)
+		{
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
 
-	//LEFT LEG
+/***********************************************************
+ *  CreateMaterialBuffer()
+ *
+ *  This method packs every defined material into a std140
+ *  uniform buffer once, so drawing an object only selects
+ *  its material by index.
+ ***********************************************************/
+void SceneManager::CreateMaterialBuffer()
+{
+	std::vector<MATERIAL_BLOCK> blocks(MAX_SCENE_MATERIALS);
+	for (size_t i = 0; i < m_objectMaterials.size() && i < blocks.size(); i++)
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[i];
+		blocks[i].ambientColor = glm::vec4(material.ambientColor, material.ambientStrength);
+		blocks[i].diffuseColor = glm::vec4(material.diffuseColor, 0.0f);
+		blocks[i].specularColor = glm::vec4(material.specularColor, material.shininess);
+	}
 
-	positionXYZ = glm::vec3(-legRadius, 0.0f, -3.0f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	if (m_materialBuffer == 0)
+	{
+		glGenBuffers(1, &m_materialBuffer);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, blocks.size() * sizeof(MATERIAL_BLOCK), blocks.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BUFFER_BINDING, m_materialBuffer);
+}
 
-	//RIGHT LEG
+/***********************************************************
+ *  RegisterUniforms()
+ *
+ *  This method registers every uniform the render loop
+ *  sets, so they are resolved once when the shaders link.
+ ***********************************************************/
+void SceneManager::RegisterUniforms()
+{
+	if (m_pShaderManager == NULL)
+		return;
 
-	positionXYZ = glm::vec3(legRadius, 0.0f, -3.0f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	m_pShaderManager->RegisterUniform(&m_uniforms.useLighting, g_UseLightingName);
+	m_pShaderManager->RegisterUniform(&m_uniforms.objectTexture, g_TextureName);
 
+	m_depthShader.RegisterUniform(&m_uniforms.prepassView, g_ViewName);
+	m_depthShader.RegisterUniform(&m_uniforms.prepassProjection, g_ProjectionName);
+}
 
+/***********************************************************
+ *  SetSceneLights()
+ *
+ *  This method replaces the scene lights. Lights with a
+ *  range are assigned to clusters each frame, the others
+ *  are evaluated for every fragment. Lights marked for
+ *  shadows are given their shadow map layer first.
+ ***********************************************************/
+void SceneManager::SetSceneLights(const std::vector<LightClusters::LIGHT_SOURCE>& lights)
+{
+	m_sceneLights = lights;
+	m_pShadowMaps->SetLights(m_sceneLights);
+	m_pLightClusters->SetLights(m_sceneLights);
+}
 
-	//CAKE//
+/***********************************************************
+ *  SubmitDrawQueue()
+ *
+ *  This method sets only the state that differs from the
+ *  previous batch in the queue. Without issuing draws it
+ *  just counts the changes the order would need. Both ways
+ *  the counts come from the same model of the queue, not
+ *  from the calls made, so the unsorted and sorted walks
+ *  compare like with like: each walk starts with nothing
+ *  bound and counts a vertex array bind wherever a batch
+ *  uses another array than the batch before, which is when
+ *  the meshes bind one.
+ ***********************************************************/
+SceneManager::DRAW_STATE_CHANGES SceneManager::SubmitDrawQueue(bool issueDraws)
+{
+	DRAW_STATE_CHANGES changes = DRAW_STATE_CHANGES();
+	uint32_t currentTexture = UINT32_MAX;
+	GLuint currentVertexArray = 0;
 
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("cake");
-	m_pShaderManager->setVec3Value("material.ambientColor", glm::vec3(0.9f, 0.8f, 0.6f));
-	m_pShaderManager->setFloatValue("material.ambientStrength", 0.3f);
-	m_pShaderManager->setVec3Value("material.diffuseColor", glm::vec3(0.9f, 0.8f, 0.6f));
-	m_pShaderManager->setVec3Value("material.specularColor", glm::vec3(0.05f, 0.05f, 0.05f));
-	m_pShaderManager->setFloatValue("material.shininess", 4.0f);
+	// every batch is drawn with the scene program
+	if (issueDraws)
+	{
+		glUseProgram(m_pShaderManager->GetProgramID());
+	}
 
+	for (size_t i = 0; i < m_drawQueue.GetCount(); i++)
+	{
+		uint64_t key = m_drawQueue.GetKey(i);
+		const DRAW_BATCH& batch = m_drawBatches[m_drawQueue.GetDrawIndex(i)];
+
+		// the texture arrays stay bound to their units and the
+		// layer comes with each instance, so switching texture
+		// means pointing the sampler at another array's unit;
+		// untextured batches keep whatever array is selected
+		uint32_t texture = DrawQueue::GetTexture(key);
+		if (texture != 0 && texture != currentTexture)
+		{
+			changes.textures++;
+			changes.uniforms++;
+			if (issueDraws)
+			{
+				m_pShaderManager->setSampler2DValue(m_uniforms.objectTexture,
+					m_textures.GetArrayUnit(batch.textureArray));
+				m_textures.MarkArrayUsed(batch.textureArray);
+			}
+			currentTexture = texture;
+		}
 
-	scaleXYZ = glm::vec3(2.0f, 1.0f, 2.0f);
-	positionXYZ = glm::vec3(0.0f, 3.0f, -3.0f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+		// the primitive meshes share one vertex array, each
+		// static batch has its own
+		GLuint vertexArray = (batch.staticBatch >= 0) ?
+			m_basicMeshes->GetStaticBatchVertexArray(batch.staticBatch) : m_basicMeshes->GetMeshVertexArray(batch.meshID);
+		if (vertexArray != currentVertexArray)
+		{
+			currentVertexArray = vertexArray;
+			changes.vertexArrays++;
+		}
 
+		if (issueDraws)
+		{
+			DrawBatch(batch);
+		}
+	}
 
+	return(changes);
+}
 
-	// BLUE CANDLE
+/***********************************************************
+ *  DrawBatch()
+ ***********************************************************/
+void SceneManager::DrawBatch(const DRAW_BATCH& batch)
+{
+	if (batch.staticBatch >= 0)
+	{
+		m_basicMeshes->DrawStaticBatch(batch.staticBatch);
+		m_frameStats.drawCalls++;
+		m_frameStats.triangles += m_basicMeshes->GetStaticTriangleCount(batch.staticBatch);
+		return;
+	}
 
+	// one draw per level, the levels share the vertex array
+	uint32_t firstInstance = batch.firstInstance;
+	for (int lod = 0; lod < PrimitiveMeshes::MAX_LOD_LEVELS; lod++)
+	{
+		uint32_t instanceCount = batch.lodInstanceCounts[lod];
+		if (instanceCount == 0)
+		{
+			continue;
+		}
+		m_basicMeshes->DrawMeshInstanced(batch.meshID, lod, instanceCount, firstInstance);
+		m_frameStats.drawCalls++;
+		m_frameStats.triangles += static_cast<uint64_t>(
+			m_basicMeshes->GetTriangleCount(batch.meshID, lod)) * instanceCount;
+		firstInstance += instanceCount;
+	}
+}
 
-	// CANDLE BODY
+/***********************************************************
+ *  InitializeDepthPrepass()
+ *
+ *  Fragments are counted as fragment shader invocations
+ *  where the driver has pipeline statistics queries, and
+ *  otherwise as the samples passing the depth test, which
+ *  early depth testing makes about the same.
+ ***********************************************************/
+void SceneManager::InitializeDepthPrepass()
+{
+	// linking makes the depth program current
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLuint program = m_depthShader.LoadShaders(g_DepthVertexShaderPath, g_DepthFragmentShaderPath);
+	GLint linked = GL_FALSE;
+	if (program != 0)
+	{
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	}
+	glUseProgram(static_cast<GLuint>(previousProgram));
+	if (linked == GL_TRUE)
+	{
+		m_depthProgram = program;
+	}
+	else
+	{
+		std::cout << "ERROR: DEPTH PRE-PASS SHADERS FAILED TO LINK, DRAWING WITHOUT IT" << std::endl;
+	}
 
-	m_pShaderManager->setIntValue("bUseTexture", false);
-	SetShaderColor(0.15f, 0.35f, 0.85f, 1.0f);
+	if (GLEW_ARB_pipeline_statistics_query)
+	{
+		m_fragmentQueryTarget = GL_FRAGMENT_SHADER_INVOCATIONS_ARB;
+	}
+	glGenQueries(2, m_fragmentQueries);
+}
 
-	float cakeTopY = 3.0f + 1.0f;
-	float candleBaseY = cakeTopY;
-	float candleX = 0.0f;
-	float candleZ = -3.0f;
-	scaleXYZ = glm::vec3(0.12f, 1.0f, 0.12f);
-	positionXYZ = glm::vec3(candleX, candleBaseY, candleZ);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+/***********************************************************
+ *  DrawDepthPrepass()
+ *
+ *  The batches are drawn in the order of the depth field
+ *  of their sort keys alone, the distance from the camera
+ *  to the nearest object of each batch that the scene pass
+ *  orders each state group by. The order is by batch: the
+ *  instances of a batch are drawn in slot order, and a
+ *  static batch is as coarse as its grid cell. No state
+ *  but the vertex arrays changes between these draws.
+ ***********************************************************/
+void SceneManager::DrawDepthPrepass(const SCENE_VIEW& view)
+{
+	m_prepassQueue.Clear();
+	for (size_t i = 0; i < m_drawQueue.GetCount(); i++)
+	{
+		m_prepassQueue.Add(DrawQueue::GetDepth(m_drawQueue.GetKey(i)), m_drawQueue.GetDrawIndex(i));
+	}
+	m_prepassQueue.Sort();
 
+	glUseProgram(m_depthProgram);
+	m_depthShader.setMat4Value(m_uniforms.prepassView, view.view);
+	m_depthShader.setMat4Value(m_uniforms.prepassProjection, view.projection);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	for (size_t i = 0; i < m_prepassQueue.GetCount(); i++)
+	{
+		DrawBatch(m_drawBatches[m_prepassQueue.GetDrawIndex(i)]);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-	//WICK
+	// the scene pass only shades the fragments that made it
+	// into the depth buffer, and leaves the buffer as it is
+	glUseProgram(m_pShaderManager->GetProgramID());
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+}
 
-	SetShaderColor(0.05f, 0.05f, 0.05f, 1.0f);
-	scaleXYZ = glm::vec3(0.02f, 0.10f, 0.02f);
-	positionXYZ = glm::vec3(candleX, candleBaseY + 1.0f, candleZ);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+/***********************************************************
+ *  ReadFragmentCounts()
+ *
+ *  The queries are only restarted once their results have
+ *  been read, so the counts never make the CPU wait.
+ ***********************************************************/
+bool SceneManager::ReadFragmentCounts()
+{
+	if (m_fragmentQueries[0] == 0)
+	{
+		return(false);
+	}
+	if (!m_fragmentQueriesPending)
+	{
+		return(true);
+	}
 
+	// the scene pass query ended last
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(m_fragmentQueries[SCENE_FRAGMENT_QUERY], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available != GL_TRUE)
+	{
+		return(false);
+	}
 
-	//FLAME
+	GLuint64 fragments = 0;
+	glGetQueryObjectui64v(m_fragmentQueries[SCENE_FRAGMENT_QUERY], GL_QUERY_RESULT, &fragments);
+	m_frameStats.shadedFragments = fragments;
+	fragments = 0;
+	if (m_prepassQueryPending)
+	{
+		glGetQueryObjectui64v(m_fragmentQueries[PREPASS_FRAGMENT_QUERY], GL_QUERY_RESULT, &fragments);
+	}
+	m_frameStats.prepassFragments = fragments;
+	m_fragmentQueriesPending = false;
+	m_prepassQueryPending = false;
+	return(true);
+}
 
-	SetShaderColor(1.0f, 0.8f, 0.3f, 1.0f);
-	scaleXYZ = glm::vec3(0.10f, 0.18f, 0.10f);
-	positionXYZ = glm::vec3(candleX, candleBaseY + 1.18f, candleZ);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+/***********************************************************
+ *  MeasureFillCost()
+ *
+ *  Every object the last frame drew is drawn again with an
+ *  occlusion query of its own, in the order the scene pass
+ *  drew it and at the same level of detail, so each object
+ *  counts the pixels where it was nearer than everything
+ *  drawn before it: its share of the overdraw included.
+ *  Objects of static batches are drawn from their own
+ *  meshes one at a time. With the depth pre-pass on, the
+ *  depth is laid down first and only the visible surface
+ *  of each object is counted. The GPU driven path keeps
+ *  its visible set on the GPU, so there every instanced
+ *  object is drawn at full detail and the ones outside the
+ *  view count nothing.
+ ***********************************************************/
+void SceneManager::MeasureFillCost(const SCENE_VIEW& view)
+{
+	const SceneFile::OBJECT_TABLE& objects = m_sceneFile.GetObjects();
 
+	std::vector<uint32_t> measured;
+	std::vector<int> levels;
+	const size_t drawCount = m_gpuDriven ? m_drawBatches.size() : m_drawQueue.GetCount();
+	for (size_t i = 0; i < drawCount; i++)
+	{
+		const DRAW_BATCH& batch = m_gpuDriven ? m_drawBatches[i] : m_drawBatches[m_drawQueue.GetDrawIndex(i)];
+		if (batch.staticBatch >= 0)
+		{
+			for (uint32_t k = 0; k < batch.instanceCount; k++)
+			{
+				measured.push_back(m_staticBatchObjects[batch.firstStaticObject + k]);
+				levels.push_back(0);
+			}
+			continue;
+		}
 
-	//FLAME LIGHT
-	m_pShaderManager->setVec3Value("lightSources[4].position", glm::vec3(0.15f, 5.45f, -2.85f));
-	m_pShaderManager->setVec3Value("lightSources[4].ambientColor", glm::vec3(0.4f, 0.25f, 0.1f)); 
-	m_pShaderManager->setVec3Value("lightSources[4].diffuseColor", glm::vec3(1.0f, 0.85f, 0.55f));  
-	m_pShaderManager->setVec3Value("lightSources[4].specularColor", glm::vec3(1.0f, 0.95f, 0.7f)); 
-	m_pShaderManager->setFloatValue("lightSources[4].focalStrength", 30.0f);
-	m_pShaderManager->setFloatValue("lightSources[4].specularIntensity", 2.5f);
+		const uint32_t lastSlot = batch.firstInstance + batch.instanceCount;
+		if (m_gpuDriven)
+		{
+			for (uint32_t slot = batch.firstInstance; slot < lastSlot; slot++)
+			{
+				measured.push_back(m_instanceObjects[slot]);
+				levels.push_back(0);
+			}
+			continue;
+		}
 
+		// the order PackBatchInstances() packed them in
+		for (int lod = 0; lod < PrimitiveMeshes::MAX_LOD_LEVELS; lod++)
+		{
+			for (uint32_t slot = batch.firstInstance; slot < lastSlot; slot++)
+			{
+				uint32_t object = m_instanceObjects[slot];
+				if (m_culler.IsVisible(object) && m_occluded[object] == 0 && m_objectLods[object] == lod)
+				{
+					measured.push_back(object);
+					levels.push_back(lod);
+				}
+			}
+		}
+	}
 
-	// FROSTING
+	m_fillCosts.clear();
+	m_overdrawSummary = FillCostProfiler::OVERDRAW_SUMMARY();
+	if (measured.empty() || !m_pFillCostProfiler->IsInitialized())
+	{
+		return;
+	}
 
-	m_pShaderManager->setIntValue("bUseTexture", true);
-	SetShaderTexture("frosting");
+	// one instance per object, drawn by its index
+	const uint32_t count = static_cast<uint32_t>(measured.size());
+	std::vector<PrimitiveMeshes::INSTANCE_DATA> instances(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t object = measured[i];
+		instances[i].model = m_transforms.modelMatrices[object];
+		instances[i].color = objects.colors[object];
+		instances[i].materialIndex = objects.materialIndices[object];
+		instances[i].textureLayer = m_objectTextureLayers[object];
+		instances[i].padding[0] = instances[i].padding[1] = 0;
+	}
+	if (m_fillCostInstanceBuffer == 0)
+	{
+		glGenBuffers(1, &m_fillCostInstanceBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, m_fillCostInstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(PrimitiveMeshes::INSTANCE_DATA),
+		instances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_basicMeshes->SetInstanceBuffer(m_fillCostInstanceBuffer);
 
-	scaleXYZ = glm::vec3(1.95f, 0.05f, 1.95f);
+	m_pFillCostProfiler->BeginMeasurement(view, count);
 
-	positionXYZ = glm::vec3(0.0f, 4.02f, -3.0f);
+	const bool prepass = !m_gpuDriven && IsDepthPrepass();
+	if (prepass)
+	{
+		glUseProgram(m_depthProgram);
+		m_depthShader.setMat4Value(m_uniforms.prepassView, view.view);
+		m_depthShader.setMat4Value(m_uniforms.prepassProjection, view.projection);
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			m_basicMeshes->DrawMeshInstanced(static_cast<SCENE_MESH_ID>(objects.meshIDs[measured[i]]), levels[i], 1, i);
+		}
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glUseProgram(m_pShaderManager->GetProgramID());
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
 
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t object = measured[i];
+		int textureArray = m_objectTextureArrays[object];
+		if (textureArray != -1)
+		{
+			m_pShaderManager->setSampler2DValue(m_uniforms.objectTexture, m_textures.GetArrayUnit(textureArray));
+			m_textures.MarkArrayUsed(textureArray);
+		}
+		m_pFillCostProfiler->BeginObject(i);
+		m_basicMeshes->DrawMeshInstanced(static_cast<SCENE_MESH_ID>(objects.meshIDs[object]), levels[i], 1, i);
+		m_pFillCostProfiler->EndObject();
+	}
 
+	if (prepass)
+	{
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
+	m_basicMeshes->UnbindVertexArray();
 
+	std::vector<uint64_t> fragments;
+	m_pFillCostProfiler->EndMeasurement(fragments, m_overdrawSummary);
+	m_basicMeshes->SetInstanceBuffer(m_gpuDriven ? m_gpuCuller.GetInstanceBuffer() : m_instanceBuffer);
 
+	m_fillCosts.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		m_fillCosts[i].object = measured[i];
+		m_fillCosts[i].fragments = fragments[i];
+	}
+	std::stable_sort(m_fillCosts.begin(), m_fillCosts.end(),
+		[](const OBJECT_FILL_COST& a, const OBJECT_FILL_COST& b)
+		{
+			return(a.fragments > b.fragments);
+		});
+}
 
-//ANT//
+/***********************************************************
+ *  FinishFillCost()
+ ***********************************************************/
+void SceneManager::FinishFillCost(const SCENE_VIEW& view, bool heatmap)
+{
+	if (heatmap)
+	{
+		PROFILE_GPU_SCOPE("Overdraw heatmap");
+		m_pFillCostProfiler->EndCounting();
+		m_pFillCostProfiler->DrawHeatmap();
+	}
 
-	m_pShaderManager->setIntValue("bUseTexture", false);
-	m_pShaderManager->setVec3Value("material.ambientColor", glm::vec3(0.01f, 0.01f, 0.01f));
-	m_pShaderManager->setFloatValue("material.ambientStrength", 0.15f);
-	m_pShaderManager->setVec3Value("material.diffuseColor", glm::vec3(0.03f, 0.03f, 0.03f));
-	m_pShaderManager->setVec3Value("material.specularColor", glm::vec3(0.0f, 0.0f, 0.0f));
-	m_pShaderManager->setFloatValue("material.shininess", 4.0f);
-	m_pShaderManager->setVec3Value("objectColor", glm::vec3(0.0f, 0.0f, 0.0f));
+	if (m_fillCostRequested)
+	{
+		PROFILE_GPU_SCOPE("Fill cost");
+		MeasureFillCost(view);
+		m_fillCostRequested = false;
+	}
+}
 
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by
+ *  recording each batch of scene objects that share a
+ *  mesh and texture with its state sort key, and drawing
+ *  the batches in key order with one instanced call for
+ *  each level of detail they use. The per-object work and
+ *  the recording run as jobs; only GL calls stay on this
+ *  thread
+ ***********************************************************/
+void SceneManager::RenderScene(const SCENE_VIEW& view)
+{
+	PROFILE_GPU_SCOPE("Render scene");
 
-	//ANT POSITION
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BUFFER_BINDING, m_materialBuffer);
 
-	float tableTopY = 2.7f + 0.15f;
-	float antBodyY = tableTopY + 0.09f;
-	float legBaseY = tableTopY + 0.02f;
+	m_pShaderManager->setIntValue(m_uniforms.useLighting, true);
 
+	const bool deferred = IsDeferredShading();
+	const bool heatmap = IsOverdrawHeatmap();
+	{
+		PROFILE_GPU_SCOPE("Light clusters");
+		// the deferred lighting culls the point lights per tile
+		m_pLightClusters->Update(view, !deferred);
+	}
 
+	{
+		PROFILE_SCOPE("Transforms");
+		UpdateTransformCache();
+		m_spatialIndex.Update();
+	}
 
-	//BODY
+	{
+		PROFILE_GPU_SCOPE("Shadows");
+		// the casters are drawn from the shadow maps' own instances
+		if (m_pShadowMaps->Update(m_basicMeshes))
+		{
+			m_basicMeshes->SetInstanceBuffer(m_gpuDriven ? m_gpuCuller.GetInstanceBuffer() : m_instanceBuffer);
+		}
+		m_frameStats.shadowFaces = m_pShadowMaps->GetStaticFacesDrawn() + m_pShadowMaps->GetDynamicFacesDrawn();
+	}
 
-	scaleXYZ = glm::vec3(0.15f, 0.09f, 0.10f);
-	positionXYZ = glm::vec3(-3.0f, antBodyY, -0.8f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	// the compute shader does the culling, level selection and
+	// instance packing, the CPU only binds each texture array
+	if (m_gpuDriven)
+	{
+		{
+			PROFILE_GPU_SCOPE("GPU cull");
+			m_gpuCuller.Cull(view, m_lodEnabled);
+		}
 
-	scaleXYZ = glm::vec3(0.12f, 0.08f, 0.09f);
-	positionXYZ = glm::vec3(-2.85f, antBodyY, -0.8f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+		if (deferred)
+		{
+			m_pDeferredShading->BeginGeometry(view);
+		}
 
-	scaleXYZ = glm::vec3(0.09f, 0.07f, 0.07f);
-	positionXYZ = glm::vec3(-2.70f, antBodyY, -0.8f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+		if (heatmap)
+		{
+			m_pFillCostProfiler->BeginCounting(view);
+		}
 
+		const bool countFragments = ReadFragmentCounts();
+		{
+			PROFILE_GPU_SCOPE("Draw submit");
+			if (countFragments)
+			{
+				glBeginQuery(m_fragmentQueryTarget, m_fragmentQueries[SCENE_FRAGMENT_QUERY]);
+			}
+			glUseProgram(m_pShaderManager->GetProgramID());
+			const std::vector<GpuCuller::DRAW_GROUP>& groups = m_gpuCuller.GetGroups();
+			for (size_t g = 0; g < groups.size(); g++)
+			{
+				if (groups[g].textureArray != -1)
+				{
+					m_pShaderManager->setSampler2DValue(m_uniforms.objectTexture,
+						m_textures.GetArrayUnit(groups[g].textureArray));
+					// every group is drawn, only the ones with
+					// objects in view count as using their array
+					if (m_gpuCuller.IsGroupDrawn(g))
+					{
+						m_textures.MarkArrayUsed(groups[g].textureArray);
+					}
+				}
+				m_gpuCuller.DrawGroup(m_basicMeshes, g);
+			}
+			if (countFragments)
+			{
+				glEndQuery(m_fragmentQueryTarget);
+				m_fragmentQueriesPending = true;
+			}
+
+			// counts come from the commands of a few frames before
+			m_frameStats.drawCalls = static_cast<uint32_t>(groups.size());
+			m_frameStats.triangles = m_gpuCuller.GetDrawnTriangles();
+			m_frameStats.visibleObjects = m_gpuCuller.GetDrawnObjects();
+			m_frameStats.culledObjects = static_cast<uint32_t>(m_instances.size()) - m_frameStats.visibleObjects;
+			m_frameStats.untestedObjects = static_cast<uint32_t>(m_staticBatchObjects.size());
+			m_frameStats.occludedObjects = 0;
+			m_frameStats.occlusionMilliseconds = 0.0f;
+		}
 
-	//LEGS
+		if (deferred)
+		{
+			PROFILE_GPU_SCOPE("Deferred lighting");
+			m_pDeferredShading->Resolve(view, m_pLightClusters, m_pShadowMaps);
+		}
 
-	scaleXYZ = glm::vec3(0.015f, 0.08f, 0.015f);
-	float legZLeft = -0.87f;
-	float legZRight = -0.73f;
+		m_basicMeshes->UnbindVertexArray();
+		FinishFillCost(view, heatmap);
 
+		m_textures.EndFrame();
+		return;
+	}
 
-	//LEFT
+	{
+		PROFILE_SCOPE("Frustum cull");
+		CullObjects(view);
+	}
 
-	for (int i = 0; i < 2; i++) {
-		float offsetX = -3.05f + (i * 0.22f);
-		float rotZ = 25.0f;
-		positionXYZ = glm::vec3(offsetX, legBaseY, legZLeft);
-		SetTransformations(scaleXYZ, 0.0f, 0.0f, rotZ, positionXYZ);
-		m_basicMeshes->DrawCylinderMesh();
+	{
+		PROFILE_SCOPE("Occlusion cull");
+		OccludeObjects(view);
 	}
 
-	//RIGHT
+	{
+		PROFILE_SCOPE("Level of detail");
+		SelectLevelsOfDetail(view);
+	}
 
-	for (int i = 0; i < 2; i++) {
-		float offsetX = -3.05f + (i * 0.22f);
-		float rotZ = -25.0f;
-		positionXYZ = glm::vec3(offsetX, legBaseY, legZRight);
-		SetTransformations(scaleXYZ, 0.0f, 0.0f, rotZ, positionXYZ);
-		m_basicMeshes->DrawCylinderMesh();
+	{
+		PROFILE_SCOPE("Draw lists");
+		BuildDrawLists(view);
 	}
 
+	{
+		PROFILE_GPU_SCOPE("Instance upload");
+		UpdateInstanceBuffer();
+	}
 
-	//ANTENNA//
+	{
+		PROFILE_SCOPE("Draw queue");
+		m_drawQueue.Clear();
+		for (const DrawQueue& drawList : m_drawLists)
+		{
+			m_drawQueue.Append(drawList);
+		}
 
-	scaleXYZ = glm::vec3(0.02f, 0.07f, 0.02f);
+		m_unsortedStateChanges = SubmitDrawQueue(false);
+		m_drawQueue.Sort();
+	}
 
+	if (deferred)
+	{
+		m_pDeferredShading->BeginGeometry(view);
+	}
 
-	//LEFT
+	m_frameStats.drawCalls = 0;
+	m_frameStats.triangles = 0;
+	const bool countFragments = ReadFragmentCounts();
+	const bool prepass = IsDepthPrepass();
+	if (prepass)
+	{
+		PROFILE_GPU_SCOPE("Depth pre-pass");
+		if (countFragments)
+		{
+			glBeginQuery(m_fragmentQueryTarget, m_fragmentQueries[PREPASS_FRAGMENT_QUERY]);
+		}
+		DrawDepthPrepass(view);
+		if (countFragments)
+		{
+			glEndQuery(m_fragmentQueryTarget);
+			m_prepassQueryPending = true;
+		}
+	}
 
-	XrotationDegrees = -35.0f;
-	positionXYZ = glm::vec3(-2.68f, antBodyY + 0.065f, -0.81f);
-	SetTransformations(scaleXYZ, XrotationDegrees, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	// only the scene pass counts, the pre-pass shades nothing
+	if (heatmap)
+	{
+		m_pFillCostProfiler->BeginCounting(view);
+	}
 
+	{
+		PROFILE_GPU_SCOPE("Draw submit");
+		if (countFragments)
+		{
+			glBeginQuery(m_fragmentQueryTarget, m_fragmentQueries[SCENE_FRAGMENT_QUERY]);
+		}
+		m_sortedStateChanges = SubmitDrawQueue(true);
+		if (countFragments)
+		{
+			glEndQuery(m_fragmentQueryTarget);
+			m_fragmentQueriesPending = true;
+		}
+	}
 
-	//RIGHT
+	if (prepass)
+	{
+		// back to the depth test everything else is drawn with
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
 
-	XrotationDegrees = 35.0f;
-	positionXYZ = glm::vec3(-2.73f, antBodyY + 0.065f, -0.81f);
-	SetTransformations(scaleXYZ, XrotationDegrees, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawCylinderMesh();
+	if (deferred)
+	{
+		PROFILE_GPU_SCOPE("Deferred lighting");
+		m_pDeferredShading->Resolve(view, m_pLightClusters, m_pShadowMaps);
+	}
 
+	m_basicMeshes->UnbindVertexArray();
+	FinishFillCost(view, heatmap);
 
+	m_textures.EndFrame();
 }
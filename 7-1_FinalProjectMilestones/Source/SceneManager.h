@@ -9,12 +9,26 @@
 
 #pragma once
 
-#include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "ShaderUniformManager.h"
+#include "PrimitiveMeshes.h"
+#include "SceneFile.h"
+#include "SceneView.h"
+#include "LightClusters.h"
+#include "ShadowMaps.h"
+#include "DeferredShading.h"
+#include "FillCostProfiler.h"
+#include "DrawQueue.h"
+#include "TextureRegistry.h"
+#include "FrustumCuller.h"
+#include "GpuCuller.h"
+#include "OcclusionCuller.h"
+#include "SceneBVH.h"
 
 #include <string>
 #include <vector>
 
+class JobSystem;
+
 /***********************************************************
  *  SceneManager
  *
@@ -25,16 +39,10 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager* pShaderManager);
+	SceneManager(ShaderUniformManager* pShaderManager);
 	// destructor
 	~SceneManager();
 
-	struct TEXTURE_INFO
-	{
-		std::string tag;
-		GLuint ID;
-	};
-
 	struct OBJECT_MATERIAL
 	{
 		float ambientStrength;
@@ -45,66 +53,386 @@ public:
 		std::string tag;
 	};
 
+	// most materials the material uniform buffer can hold,
+	// must match MAX_MATERIALS in the fragment shader
+	static const int MAX_SCENE_MATERIALS = 64;
+
+	// material values laid out to match the std140
+	// MaterialRecord struct in the fragment shader
+	struct MATERIAL_BLOCK
+	{
+		// ambient color, ambient strength in w
+		glm::vec4 ambientColor;
+		glm::vec4 diffuseColor;
+		// specular color, shininess in w
+		glm::vec4 specularColor;
+	};
+
+	// per-object transform values and their cached model matrices
+	struct TRANSFORM_CACHE
+	{
+		std::vector<glm::vec3> scales;
+		std::vector<glm::vec3> rotations;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::mat4> modelMatrices;
+		std::vector<uint8_t> dirty;
+		bool anyDirty;
+	};
+
+	// objects sharing a mesh and texture, drawn with one
+	// instanced call
+	struct DRAW_BATCH
+	{
+		SCENE_MESH_ID meshID;
+		// texture array sampled by the batch, -1 for none
+		int textureArray;
+		// material of the first instance, used for ordering
+		int materialIndex;
+		// object the batch was started from
+		uint32_t firstObject;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		// instances left after culling, packed at the front of
+		// the batch's slots in the instance buffer
+		uint32_t visibleInstanceCount;
+		// visible instances drawn at each level of detail, packed
+		// in level order, finest first
+		uint32_t lodInstanceCounts[PrimitiveMeshes::MAX_LOD_LEVELS];
+		// merged static batch drawn instead of instances, -1 for none
+		int staticBatch;
+		// first of the static batch's objects in the static
+		// object list, instanceCount of them
+		uint32_t firstStaticObject;
+	};
+
+	// GL state changes made while submitting one frame
+	struct DRAW_STATE_CHANGES
+	{
+		uint32_t textures;
+		uint32_t vertexArrays;
+		uint32_t uniforms;
+	};
+
+	// work submitted to the GPU for one frame
+	struct FRAME_STATS
+	{
+		uint32_t drawCalls;
+		uint64_t triangles;
+		// instanced objects drawn and outside the view frustum
+		uint32_t visibleObjects;
+		uint32_t culledObjects;
+		// objects merged into static batches, drawn whole
+		// whatever the frustum test says
+		uint32_t untestedObjects;
+		// objects in the frustum hidden behind the occluders,
+		// and the CPU time spent finding them
+		uint32_t occludedObjects;
+		float occlusionMilliseconds;
+		// shadow cube faces redrawn, zero while nothing moves
+		uint32_t shadowFaces;
+		// fragments shaded by the scene pass and by the depth
+		// pre-pass, from queries read back a frame or more late
+		uint64_t shadedFragments;
+		uint64_t prepassFragments;
+	};
+
+	// scene object drawn into the occlusion depth buffer, as a
+	// box inside its mesh
+	struct SCENE_OCCLUDER
+	{
+		uint32_t object;
+		glm::vec3 localCenter;
+		glm::vec3 localExtents;
+	};
+
+	// fragments one scene object shaded in a fill cost
+	// measurement
+	struct OBJECT_FILL_COST
+	{
+		uint32_t object;
+		uint64_t fragments;
+	};
+
+	// uniform handles resolved when the shaders are linked
+	struct SCENE_UNIFORMS
+	{
+		UniformHandle useLighting;
+		UniformHandle objectTexture;
+		// matrices of the depth pre-pass program
+		UniformHandle prepassView;
+		UniformHandle prepassProjection;
+	};
+
 private:
 	// pointer to shader manager object
-	ShaderManager* m_pShaderManager;
+	ShaderUniformManager* m_pShaderManager;
+	// uniform handles used while rendering
+	SCENE_UNIFORMS m_uniforms;
 	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	PrimitiveMeshes* m_basicMeshes;
+	// loaded textures packed into texture arrays
+	TextureRegistry m_textures;
+	// texture decode and frame job threads, 0 for one per
+	// hardware core
+	unsigned int m_workerThreadCount;
+	// runs the per-frame transform, culling and draw list jobs
+	JobSystem* m_pJobSystem;
+	// true to keep the cached textures BC1 compressed
+	bool m_compressTextures;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// uniform buffer holding every defined material
+	GLuint m_materialBuffer;
+	// loaded scene object table
+	SceneFile m_sceneFile;
+	// acquired texture asset for each texture tag in the scene file
+	std::vector<int> m_sceneTextures;
+	// cached object model matrices
+	TRANSFORM_CACHE m_transforms;
+	// instanced draws of the scene objects
+	std::vector<DRAW_BATCH> m_drawBatches;
+	// per-instance values, grouped by draw batch
+	std::vector<PrimitiveMeshes::INSTANCE_DATA> m_instances;
+	// instance slot of each scene object
+	std::vector<uint32_t> m_objectInstances;
+	// scene object of each instance slot
+	std::vector<uint32_t> m_instanceObjects;
+	// objects merged into the static batches, by batch
+	std::vector<uint32_t> m_staticBatchObjects;
+	// texture array and layer of each scene object, -1 for none
+	std::vector<int> m_objectTextureArrays;
+	std::vector<int> m_objectTextureLayers;
+	// instance values of the visible objects, as uploaded
+	std::vector<PrimitiveMeshes::INSTANCE_DATA> m_visibleInstances;
+	// GPU copy of the visible instance values
+	GLuint m_instanceBuffer;
+	bool m_instancesDirty;
+	// world space bounds of the scene objects
+	FrustumCuller m_culler;
+	bool m_cullingEnabled;
+	// objects flagged as occluders and the depth buffer they
+	// are drawn into
+	std::vector<SCENE_OCCLUDER> m_occluders;
+	OcclusionCuller m_occlusionCuller;
+	// 1 for each object hidden behind the occluders
+	std::vector<uint8_t> m_occluded;
+	bool m_occlusionEnabled;
+	// tessellation level each object was last drawn at
+	std::vector<uint8_t> m_objectLods;
+	bool m_lodEnabled;
+	// merge the objects flagged static into pre-transformed batches
+	bool m_staticBatching;
+	// cull and draw the instanced batches from GPU written commands
+	GpuCuller m_gpuCuller;
+	bool m_gpuDriven;
+	// hierarchy over the same bounds for spatial queries
+	SceneBVH m_spatialIndex;
+	// draw commands recorded by each draw list job, merged in
+	// job order into the draw queue
+	std::vector<DrawQueue> m_drawLists;
+	// draw batches ordered by state sort key
+	DrawQueue m_drawQueue;
+	// depth only program drawing the visible batches nearest
+	// first, for the scene pass to test against with GL_EQUAL
+	ShaderUniformManager m_depthShader;
+	GLuint m_depthProgram;
+	DrawQueue m_prepassQueue;
+	bool m_depthPrepass;
+	// fragment counts of the scene pass and the pre-pass, not
+	// restarted until the last ones have been read back
+	GLuint m_fragmentQueries[2];
+	GLenum m_fragmentQueryTarget;
+	bool m_fragmentQueriesPending;
+	bool m_prepassQueryPending;
+	// state changes of the last frame in recorded and sorted order
+	DRAW_STATE_CHANGES m_unsortedStateChanges;
+	DRAW_STATE_CHANGES m_sortedStateChanges;
+	// draws and triangles submitted by the last frame
+	FRAME_STATS m_frameStats;
+	// scene lights and their cluster assignment
+	LightClusters* m_pLightClusters;
+	std::vector<LightClusters::LIGHT_SOURCE> m_sceneLights;
+	// shadow maps of the lights marked for shadows
+	ShadowMaps* m_pShadowMaps;
+	// G-buffer and tiled lighting of the deferred path
+	DeferredShading* m_pDeferredShading;
+	bool m_deferredShading;
+	// fragments shaded per pixel and by each object
+	FillCostProfiler* m_pFillCostProfiler;
+	bool m_overdrawHeatmap;
+	bool m_fillCostRequested;
+	// instances of the objects drawn one at a time by the last
+	// measurement, and what it found
+	GLuint m_fillCostInstanceBuffer;
+	std::vector<OBJECT_FILL_COST> m_fillCosts;
+	FillCostProfiler::OVERDRAW_SUMMARY m_overdrawSummary;
 
-	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
-	void BindGLTextures();
-	// free the loaded OpenGL textures
-	void DestroyGLTextures();
-	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
+	// queue a texture image to be packed into a texture array
+	bool CreateGLTexture(const char* filename, const std::string& tag);
 	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	int FindMaterial(const std::string& tag);
 
-	// set the transformation values 
-	// into the transform buffer
-	void SetTransformations(
+	// build a model matrix from scale, rotation and position
+	static glm::mat4 BuildModelMatrix(
 		glm::vec3 scaleXYZ,
 		float XrotationDegrees,
 		float YrotationDegrees,
 		float ZrotationDegrees,
 		glm::vec3 positionXYZ);
-
-	// set the color values into the shader
-	void SetShaderColor(
-		float redColorValue,
-		float greenColorValue,
-		float blueColorValue,
-		float alphaValue);
-
-	// set the texture data into the shader
-	void SetShaderTexture(
-		std::string textureTag);
+	// fill the transform cache from the scene object table
+	void InitializeTransformCache();
+	// rebuild the model matrices of objects marked dirty
+	void UpdateTransformCache();
+	// group the scene objects into instanced draw batches
+	void BuildDrawBatches();
+	// upload the batches as indirect draw commands for the
+	// culling compute shader, false when it cannot be used
+	bool BuildGpuScene();
+	// hand every scene object to the shadow maps as a caster
+	void BuildShadowCasters();
+	// find the objects inside the view frustum
+	void CullObjects(const SCENE_VIEW& view);
+	// find the objects in the frustum hidden behind occluders
+	void OccludeObjects(const SCENE_VIEW& view);
+	// pick the tessellation level of each visible round object
+	// from its size on screen
+	void SelectLevelsOfDetail(const SCENE_VIEW& view);
+	// pack the visible instances of the batches and record a
+	// draw command for each batch that has any, in parallel
+	void BuildDrawLists(const SCENE_VIEW& view);
+	// distance from the view to the nearest object the batch
+	// draws, which orders it by depth
+	float GetBatchDistance(const DRAW_BATCH& batch, const glm::vec3& viewPosition) const;
+	// pack the visible instances of one batch by level of detail
+	void PackBatchInstances(DRAW_BATCH& batch);
+	// upload the packed instance values when objects have moved
+	// or the visible set or their levels have changed
+	void UpdateInstanceBuffer();
+	// walk the draw queue in its current order, setting the
+	// state each batch needs and drawing it when issueDraws
+	// is true, and count the state changes
+	DRAW_STATE_CHANGES SubmitDrawQueue(bool issueDraws);
+	// draw the visible instances of one batch, one instanced
+	// call per level of detail
+	void DrawBatch(const DRAW_BATCH& batch);
+	// load the depth only program and create the fragment
+	// count queries
+	void InitializeDepthPrepass();
+	// draw the depth of the queued batches front to back and
+	// set the depth test of the scene pass to GL_EQUAL
+	void DrawDepthPrepass(const SCENE_VIEW& view);
+	// read the fragment counts once the GPU has them, returns
+	// true when new counts can be started this frame
+	bool ReadFragmentCounts();
+	// draw the objects of the last frame one at a time into the
+	// profiler's framebuffer, counting what each one shaded
+	void MeasureFillCost(const SCENE_VIEW& view);
+	// show the heatmap of the frame when counting and run a
+	// requested measurement
+	void FinishFillCost(const SCENE_VIEW& view, bool heatmap);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
 		float u, float v);
 
-	// set the object material into the shader
-	void SetShaderMaterial(
-		std::string materialTag);
+	// pack the defined materials into the uniform buffer
+	void CreateMaterialBuffer();
 
 	// load all scene textures
 	void LoadSceneTextures();
+	// load the scene object table and its materials
+	bool LoadSceneFile(const char* scenePath);
+	// register the uniform handles used while rendering
+	void RegisterUniforms();
 
 public:
 
 	// The following methods are for the students to 
 	// customize for their own 3D scene
 	void PrepareScene();
-	void RenderScene();
+	void RenderScene(const SCENE_VIEW& view);
+
+	// threads used to decode the textures and run the frame jobs,
+	// set before PrepareScene; 0 uses one per hardware core
+	void SetWorkerThreadCount(unsigned int threadCount) { m_workerThreadCount = threadCount; }
+	unsigned int GetWorkerThreadCount() const { return(m_workerThreadCount); }
+	// load the textures BC1 compressed, set before PrepareScene
+	void SetTextureCompression(bool compress) { m_compressTextures = compress; }
+	// resident texture memory limit in bytes, 0 for no limit,
+	// applied at the end of every frame
+	void SetTextureMemoryBudget(size_t bytes) { m_textures.SetMemoryBudget(bytes); }
+	// skip the objects outside the view frustum, on by default
+	void SetFrustumCulling(bool enabled) { m_cullingEnabled = enabled; }
+	// skip the objects hidden behind occluders, on by default
+	void SetOcclusionCulling(bool enabled) { m_occlusionEnabled = enabled; }
+	// draw small round objects with fewer triangles, on by default
+	void SetLevelOfDetail(bool enabled) { m_lodEnabled = enabled; }
+	// merge the objects flagged static into one mesh per texture
+	// array and region of the scene, set before PrepareScene, on
+	// by default
+	void SetStaticBatching(bool enabled) { m_staticBatching = enabled; }
+	// cull and pick levels of detail in a compute shader and draw
+	// with one multi-draw per texture array, set before
+	// PrepareScene, off by default
+	void SetGpuDrivenRendering(bool enabled) { m_gpuDriven = enabled; }
+	// keep the static casters' shadows between frames, on by
+	// default; off redraws every shadow map every frame
+	void SetShadowCaching(bool enabled) { m_pShadowMaps->SetCaching(enabled); }
+	// draw the scene into a G-buffer and light each pixel once
+	// instead of lighting every fragment drawn, off by default;
+	// can be switched between frames
+	void SetDeferredShading(bool enabled) { m_deferredShading = enabled; }
+	// true when the frames are lit deferred, which needs the
+	// lighting compute shader to have compiled
+	bool IsDeferredShading() const { return(m_deferredShading && m_pDeferredShading->IsInitialized()); }
+	// lay down the depth of the visible batches front to back
+	// before the scene pass, so it shades each visible pixel
+	// once; off by default, applies to the draws submitted
+	// from the CPU and can be switched between frames
+	void SetDepthPrepass(bool enabled) { m_depthPrepass = enabled; }
+	bool IsDepthPrepass() const { return(m_depthPrepass && m_depthProgram != 0); }
+	// show the fragments shaded per pixel as a heatmap in place
+	// of the frame, off by default; can be switched between
+	// frames
+	void SetOverdrawHeatmap(bool enabled) { m_overdrawHeatmap = enabled; }
+	bool IsOverdrawHeatmap() const { return(m_overdrawHeatmap && m_pFillCostProfiler->IsInitialized()); }
+	// measure the fragments each object shades at the end of
+	// the next frame, waiting for the GPU
+	void RequestFillCostMeasurement() { m_fillCostRequested = true; }
+	// objects of the last measurement, most fragments first,
+	// and the overdraw of all of them together
+	const std::vector<OBJECT_FILL_COST>& GetFillCosts() const { return(m_fillCosts); }
+	const FillCostProfiler::OVERDRAW_SUMMARY& GetOverdrawSummary() const { return(m_overdrawSummary); }
+
+	// instanced draw calls issued by the last frame
+	uint32_t GetDrawCallCount() const { return(m_frameStats.drawCalls); }
+	// draws and triangles submitted by the last frame
+	const FRAME_STATS& GetFrameStats() const { return(m_frameStats); }
+	// state changes of the last frame before and after sorting
+	const DRAW_STATE_CHANGES& GetUnsortedStateChanges() const { return(m_unsortedStateChanges); }
+	const DRAW_STATE_CHANGES& GetSortedStateChanges() const { return(m_sortedStateChanges); }
+
+	// replace the scene light sources
+	void SetSceneLights(const std::vector<LightClusters::LIGHT_SOURCE>& lights);
+	const std::vector<LightClusters::LIGHT_SOURCE>& GetSceneLights() const { return(m_sceneLights); }
+	// point lights and cluster references of the last frame
+	const LightClusters* GetLightClusters() const { return(m_pLightClusters); }
+
+	// spatial queries over the scene object bounds, as of the
+	// last rendered frame
+	const SceneBVH* GetSpatialIndex() const { return(&m_spatialIndex); }
+	// closest object whose bounds the ray hits, false for none
+	bool PickObject(const glm::vec3& origin, const glm::vec3& direction, SceneBVH::RAY_HIT& hit) const;
+	// name of a scene object as given in the scene file
+	const char* GetObjectName(uint32_t objectIndex) const { return(m_sceneFile.GetObjectName(objectIndex)); }
+
+	// move a scene object, its model matrix is rebuilt
+	// before the next frame is rendered; objects merged into
+	// a static batch keep drawing where they were merged
+	void SetObjectTransform(
+		uint32_t objectIndex,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
 
 };
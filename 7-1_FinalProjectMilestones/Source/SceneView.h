@@ -0,0 +1,27 @@
+///////////////////////////////////////////////////////////////////////////////
+// sceneview.h
+// ===========
+// camera and projection state shared between the view and scene managers
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  SCENE_VIEW
+ *
+ *  The view settings of the current frame, filled in by
+ *  the view manager and used by the scene manager for the
+ *  view dependent work done while rendering.
+ ***********************************************************/
+struct SCENE_VIEW
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 position;
+	float nearPlane;
+	float farPlane;
+	int viewportWidth;
+	int viewportHeight;
+};
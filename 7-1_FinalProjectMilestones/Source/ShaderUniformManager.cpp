@@ -0,0 +1,243 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderuniformmanager.cpp
+// ========================
+// pre-resolved uniform handles on top of the shader manager
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderUniformManager.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/***********************************************************
+ *  ShaderUniformManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderUniformManager::ShaderUniformManager()
+{
+	m_linkedProgramID = 0;
+	m_nameLookupCount = 0;
+}
+
+/***********************************************************
+ *  ~ShaderUniformManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderUniformManager::~ShaderUniformManager()
+{
+	m_registeredUniforms.clear();
+}
+
+/***********************************************************
+ *  LoadShaders()
+ *
+ *  This method links the shader program and resolves every
+ *  registered handle, so no uniform names are looked up
+ *  while rendering.
+ ***********************************************************/
+GLuint ShaderUniformManager::LoadShaders(
+	const char* vertexShaderPath,
+	const char* fragmentShaderPath)
+{
+	GLint programID = 0;
+
+	ShaderManager::LoadShaders(vertexShaderPath, fragmentShaderPath);
+	use();
+	glGetIntegerv(GL_CURRENT_PROGRAM, &programID);
+	m_linkedProgramID = static_cast<GLuint>(programID);
+
+	for (REGISTERED_UNIFORM& uniform : m_registeredUniforms)
+	{
+		ResolveUniform(uniform);
+	}
+
+	return(m_linkedProgramID);
+}
+
+/***********************************************************
+ *  RegisterUniform()
+ *
+ *  This method registers a handle for resolution. Handles
+ *  registered after linking are resolved immediately.
+ ***********************************************************/
+void ShaderUniformManager::RegisterUniform(UniformHandle* pHandle, const char* name)
+{
+	REGISTERED_UNIFORM uniform;
+	uniform.pHandle = pHandle;
+	uniform.name = name;
+	m_registeredUniforms.push_back(uniform);
+
+	if (m_linkedProgramID != 0)
+	{
+		ResolveUniform(m_registeredUniforms.back());
+	}
+}
+
+/***********************************************************
+ *  ResolveUniform()
+ ***********************************************************/
+void ShaderUniformManager::ResolveUniform(REGISTERED_UNIFORM& uniform)
+{
+	uniform.pHandle->location =
+		glGetUniformLocation(m_linkedProgramID, uniform.name.c_str());
+}
+
+/***********************************************************
+ *  Handle based setters
+ *
+ *  These write straight to the resolved location. A handle
+ *  for a uniform the shader does not use has location -1,
+ *  which OpenGL ignores.
+ ***********************************************************/
+void ShaderUniformManager::setBoolValue(UniformHandle handle, bool value) const
+{
+	glProgramUniform1i(m_linkedProgramID, handle.location, static_cast<int>(value));
+}
+
+void ShaderUniformManager::setIntValue(UniformHandle handle, int value) const
+{
+	glProgramUniform1i(m_linkedProgramID, handle.location, value);
+}
+
+void ShaderUniformManager::setFloatValue(UniformHandle handle, float value) const
+{
+	glProgramUniform1f(m_linkedProgramID, handle.location, value);
+}
+
+void ShaderUniformManager::setVec2Value(UniformHandle handle, const glm::vec2& value) const
+{
+	glProgramUniform2f(m_linkedProgramID, handle.location, value.x, value.y);
+}
+
+void ShaderUniformManager::setVec3Value(UniformHandle handle, const glm::vec3& value) const
+{
+	glProgramUniform3f(m_linkedProgramID, handle.location, value.x, value.y, value.z);
+}
+
+void ShaderUniformManager::setVec4Value(UniformHandle handle, const glm::vec4& value) const
+{
+	glProgramUniform4f(m_linkedProgramID, handle.location, value.x, value.y, value.z, value.w);
+}
+
+void ShaderUniformManager::setIVec3Value(UniformHandle handle, const glm::ivec3& value) const
+{
+	glProgramUniform3i(m_linkedProgramID, handle.location, value.x, value.y, value.z);
+}
+
+void ShaderUniformManager::setMat4Value(UniformHandle handle, const glm::mat4& value) const
+{
+	glProgramUniformMatrix4fv(m_linkedProgramID, handle.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderUniformManager::setSampler2DValue(UniformHandle handle, int value) const
+{
+	glProgramUniform1i(m_linkedProgramID, handle.location, value);
+}
+
+/***********************************************************
+ *  Name based setters
+ *
+ *  These forward to the shader manager, which looks the
+ *  name up on every call, and count the lookup.
+ ***********************************************************/
+void ShaderUniformManager::setBoolValue(const std::string& name, bool value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setBoolValue(name, value);
+}
+
+void ShaderUniformManager::setIntValue(const std::string& name, int value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setIntValue(name, value);
+}
+
+void ShaderUniformManager::setFloatValue(const std::string& name, float value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setFloatValue(name, value);
+}
+
+void ShaderUniformManager::setVec2Value(const std::string& name, const glm::vec2& value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setVec2Value(name, value);
+}
+
+void ShaderUniformManager::setVec3Value(const std::string& name, const glm::vec3& value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setVec3Value(name, value);
+}
+
+void ShaderUniformManager::setVec4Value(const std::string& name, const glm::vec4& value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setVec4Value(name, value);
+}
+
+void ShaderUniformManager::setMat4Value(const std::string& name, const glm::mat4& value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setMat4Value(name, value);
+}
+
+void ShaderUniformManager::setSampler2DValue(const std::string& name, int value)
+{
+	m_nameLookupCount++;
+	ShaderManager::setSampler2DValue(name, value);
+}
+
+/***********************************************************
+ *  LoadComputeProgram()
+ *
+ *  This method is used to compile and link a compute
+ *  shader file into a program of its own.
+ ***********************************************************/
+GLuint ShaderUniformManager::LoadComputeProgram(const char* computeShaderPath)
+{
+	std::ifstream file(computeShaderPath);
+	if (!file)
+	{
+		std::cout << "ERROR: CANNOT OPEN COMPUTE SHADER " << computeShaderPath << std::endl;
+		return(0);
+	}
+	std::stringstream source;
+	source << file.rdbuf();
+	std::string text = source.str();
+	const char* pText = text.c_str();
+
+	GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader, 1, &pText, NULL);
+	glCompileShader(shader);
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		std::cout << "ERROR: COMPUTE SHADER " << computeShaderPath << " FAILED TO COMPILE\n" << log << std::endl;
+		glDeleteShader(shader);
+		return(0);
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cout << "ERROR: COMPUTE SHADER " << computeShaderPath << " FAILED TO LINK\n" << log << std::endl;
+		glDeleteProgram(program);
+		return(0);
+	}
+	return(program);
+}
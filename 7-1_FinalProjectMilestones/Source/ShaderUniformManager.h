@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderuniformmanager.h
+// ======================
+// pre-resolved uniform handles on top of the shader manager
+//
+//  Uniform names are resolved to locations once, when the shaders are
+//  linked, and the per-frame code sets values through the handles. The
+//  name based setters of ShaderManager still work but every call is
+//  counted, so the render loop can be checked for string lookups.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// location of a uniform in the linked shader program
+struct UniformHandle
+{
+	GLint location = -1;
+};
+
+/***********************************************************
+ *  ShaderUniformManager
+ *
+ *  This class extends the shader manager with uniform
+ *  handles that are resolved at link time.
+ ***********************************************************/
+class ShaderUniformManager : public ShaderManager
+{
+public:
+	// constructor
+	ShaderUniformManager();
+	// destructor
+	~ShaderUniformManager();
+
+	// load and link the shaders, then resolve every
+	// registered uniform handle
+	GLuint LoadShaders(const char* vertexShaderPath, const char* fragmentShaderPath);
+
+	// compile and link a compute shader file into a program
+	// of its own, 0 when it fails
+	static GLuint LoadComputeProgram(const char* computeShaderPath);
+
+	// register a handle to be resolved whenever the program
+	// is linked; the handle must outlive this object
+	void RegisterUniform(UniformHandle* pHandle, const char* name);
+
+	// linked shader program
+	GLuint GetProgramID() const { return(m_linkedProgramID); }
+
+	// set uniform values through pre-resolved handles
+	void setBoolValue(UniformHandle handle, bool value) const;
+	void setIntValue(UniformHandle handle, int value) const;
+	void setFloatValue(UniformHandle handle, float value) const;
+	void setVec2Value(UniformHandle handle, const glm::vec2& value) const;
+	void setVec3Value(UniformHandle handle, const glm::vec3& value) const;
+	void setVec4Value(UniformHandle handle, const glm::vec4& value) const;
+	void setIVec3Value(UniformHandle handle, const glm::ivec3& value) const;
+	void setMat4Value(UniformHandle handle, const glm::mat4& value) const;
+	void setSampler2DValue(UniformHandle handle, int value) const;
+
+	// name based setters, each call is a counted uniform lookup
+	void setBoolValue(const std::string& name, bool value);
+	void setIntValue(const std::string& name, int value);
+	void setFloatValue(const std::string& name, float value);
+	void setVec2Value(const std::string& name, const glm::vec2& value);
+	void setVec3Value(const std::string& name, const glm::vec3& value);
+	void setVec4Value(const std::string& name, const glm::vec4& value);
+	void setMat4Value(const std::string& name, const glm::mat4& value);
+	void setSampler2DValue(const std::string& name, int value);
+
+	// number of name based uniform lookups since the last reset
+	unsigned int GetNameLookupCount() const { return(m_nameLookupCount); }
+	void ResetNameLookupCount() { m_nameLookupCount = 0; }
+
+private:
+	// handle and uniform name registered for resolution
+	struct REGISTERED_UNIFORM
+	{
+		UniformHandle* pHandle;
+		std::string name;
+	};
+
+	// resolve one registered handle against the linked program
+	void ResolveUniform(REGISTERED_UNIFORM& uniform);
+
+	// program the handles were resolved against
+	GLuint m_linkedProgramID;
+	// handles to resolve after linking
+	std::vector<REGISTERED_UNIFORM> m_registeredUniforms;
+	// name based lookups since the last reset
+	unsigned int m_nameLookupCount;
+};
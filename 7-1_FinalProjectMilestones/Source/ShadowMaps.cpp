@@ -0,0 +1,497 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.cpp
+// ==============
+// cube shadow maps of the global lights, with the static casters cached
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowMaps.h"
+#include "FrustumCuller.h"
+#include "Profiler.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+// caster shaders and the uniform names of both programs
+namespace
+{
+	const char* g_ShadowVertexShaderPath = "shaders/shadowVertexShader.glsl";
+	const char* g_ShadowFragmentShaderPath = "shaders/shadowFragmentShader.glsl";
+
+	const char* g_FaceViewProjectionName = "faceViewProjection";
+	const char* g_LightPositionName = "lightPosition";
+	const char* g_ShadowMapsName = "shadowMaps";
+	const char* g_ShadowFarPlaneName = "shadowFarPlane";
+	const char* g_ShadowBiasName = "shadowBias";
+
+	// distances stored in the maps, the far plane has to reach
+	// the far corner of the room from every shadowed light
+	const float SHADOW_NEAR_PLANE = 0.05f;
+	const float SHADOW_FAR_PLANE = 50.0f;
+	// depth bias per unit of distance to the light, grown on
+	// surfaces seen at a grazing angle
+	const float SHADOW_BIAS = 0.004f;
+
+	// view direction and up vector of each cube face, in the
+	// GL face order +X, -X, +Y, -Y, +Z, -Z
+	const glm::vec3 CUBE_FACE_DIRECTIONS[6] =
+	{
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const glm::vec3 CUBE_FACE_UPS[6] =
+	{
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+
+	// true unless the box is entirely outside one plane
+	bool BoxInFrustum(const FrustumCuller::FRUSTUM& frustum, const glm::vec3& center, const glm::vec3& extents)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			glm::vec3 normal(frustum.planes[i]);
+			if (glm::dot(normal, center) + frustum.planes[i].w + glm::dot(glm::abs(normal), extents) < 0.0f)
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  ShadowMaps()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowMaps::ShadowMaps(ShaderUniformManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_shadowProgram = 0;
+	m_caching = true;
+	m_instanceBuffer = 0;
+	m_cacheTexture = 0;
+	m_shadowTexture = 0;
+	m_textureMapCount = 0;
+	m_framebuffer = 0;
+	m_textureUnit = 0;
+	m_staticFacesDrawn = 0;
+	m_dynamicFacesDrawn = 0;
+
+	m_shadowShader.RegisterUniform(&m_faceViewProjectionHandle, g_FaceViewProjectionName);
+	m_shadowShader.RegisterUniform(&m_lightPositionHandle, g_LightPositionName);
+	m_shadowShader.RegisterUniform(&m_casterFarPlaneHandle, g_ShadowFarPlaneName);
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->RegisterUniform(&m_shadowMapsHandle, g_ShadowMapsName);
+		m_pShaderManager->RegisterUniform(&m_shadowFarPlaneHandle, g_ShadowFarPlaneName);
+		m_pShaderManager->RegisterUniform(&m_shadowBiasHandle, g_ShadowBiasName);
+	}
+}
+
+/***********************************************************
+ *  ~ShadowMaps()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowMaps::~ShadowMaps()
+{
+	m_pShaderManager = NULL;
+	if (m_instanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_instanceBuffer);
+		m_instanceBuffer = 0;
+	}
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (m_cacheTexture != 0)
+	{
+		glDeleteTextures(1, &m_cacheTexture);
+		glDeleteTextures(1, &m_shadowTexture);
+		m_cacheTexture = 0;
+		m_shadowTexture = 0;
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  The maps are sampled from the last texture unit, which
+ *  the texture arrays leave free. The scene shader's cube
+ *  sampler is pointed at it even when the casters cannot
+ *  be drawn, so it never shares a unit with the arrays.
+ ***********************************************************/
+bool ShadowMaps::Initialize()
+{
+	GLint maxUnits = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxUnits);
+	m_textureUnit = maxUnits - 1;
+
+	// linking makes the caster program current
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLuint program = m_shadowShader.LoadShaders(g_ShadowVertexShaderPath, g_ShadowFragmentShaderPath);
+	GLint linked = GL_FALSE;
+	if (program != 0)
+	{
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	}
+	glUseProgram(static_cast<GLuint>(previousProgram));
+	if (linked != GL_TRUE)
+	{
+		std::cout << "ERROR: SHADOW MAP SHADERS FAILED TO LINK, DRAWING WITHOUT SHADOWS" << std::endl;
+		return false;
+	}
+	m_shadowProgram = program;
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+
+	glGenBuffers(1, &m_instanceBuffer);
+	return true;
+}
+
+/***********************************************************
+ *  SetLights()
+ ***********************************************************/
+void ShadowMaps::SetLights(std::vector<LightClusters::LIGHT_SOURCE>& lights)
+{
+	std::vector<SHADOW_MAP> maps;
+	for (LightClusters::LIGHT_SOURCE& light : lights)
+	{
+		if (light.shadowMap < 0.0f || light.range > 0.0f)
+		{
+			light.shadowMap = -1.0f;
+			continue;
+		}
+		if (maps.size() == MAX_SHADOW_MAPS)
+		{
+			std::cout << "ERROR: ONLY " << MAX_SHADOW_MAPS
+				<< " LIGHTS CAN HAVE SHADOWS, THE OTHERS ARE DRAWN WITHOUT" << std::endl;
+			light.shadowMap = -1.0f;
+			continue;
+		}
+
+		const size_t layer = maps.size();
+		SHADOW_MAP map;
+		map.lightPosition = light.position;
+		if (layer < m_maps.size() && m_maps[layer].lightPosition == light.position)
+		{
+			map.cacheDirty = m_maps[layer].cacheDirty;
+			map.dynamicDirty = m_maps[layer].dynamicDirty;
+		}
+		else
+		{
+			map.cacheDirty = true;
+			map.dynamicDirty = true;
+		}
+		light.shadowMap = static_cast<float>(layer);
+		maps.push_back(map);
+	}
+	m_maps = maps;
+}
+
+/***********************************************************
+ *  SetCasters()
+ *
+ *  Casters are kept in mesh order within the static and
+ *  the other list, so the casters of a face that share a
+ *  mesh are drawn with one instanced call.
+ ***********************************************************/
+void ShadowMaps::SetCasters(const std::vector<SHADOW_CASTER>& casters)
+{
+	m_casters = casters;
+	m_staticCasters.clear();
+	m_dynamicCasters.clear();
+	for (uint32_t i = 0; i < m_casters.size(); i++)
+	{
+		if (m_casters[i].isStatic)
+		{
+			m_staticCasters.push_back(i);
+		}
+		else
+		{
+			m_dynamicCasters.push_back(i);
+		}
+	}
+
+	auto byMesh = [this](uint32_t a, uint32_t b)
+		{
+			return(m_casters[a].meshID < m_casters[b].meshID);
+		};
+	std::stable_sort(m_staticCasters.begin(), m_staticCasters.end(), byMesh);
+	std::stable_sort(m_dynamicCasters.begin(), m_dynamicCasters.end(), byMesh);
+
+	for (SHADOW_MAP& map : m_maps)
+	{
+		map.cacheDirty = true;
+		map.dynamicDirty = true;
+	}
+}
+
+/***********************************************************
+ *  SetCasterTransform()
+ ***********************************************************/
+void ShadowMaps::SetCasterTransform(uint32_t index, const glm::mat4& model,
+	const glm::vec3& boundsCenter, const glm::vec3& boundsExtents)
+{
+	SHADOW_CASTER& caster = m_casters[index];
+	caster.model = model;
+	caster.boundsCenter = boundsCenter;
+	caster.boundsExtents = boundsExtents;
+	for (SHADOW_MAP& map : m_maps)
+	{
+		if (caster.isStatic)
+		{
+			map.cacheDirty = true;
+		}
+		map.dynamicDirty = true;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  A cube whose cache is redrawn also has its copy redone.
+ *  The copy overwrites all six faces, so the faces a caster
+ *  has moved out of lose its old shadow without having to
+ *  be drawn again.
+ ***********************************************************/
+bool ShadowMaps::Update(PrimitiveMeshes* pMeshes)
+{
+	m_staticFacesDrawn = 0;
+	m_dynamicFacesDrawn = 0;
+
+	bool anyDirty = false;
+	if (m_shadowProgram != 0)
+	{
+		if (m_textureMapCount < m_maps.size())
+		{
+			CreateTextures(static_cast<uint32_t>(m_maps.size()));
+		}
+		for (SHADOW_MAP& map : m_maps)
+		{
+			if (!m_caching)
+			{
+				map.cacheDirty = true;
+			}
+			map.dynamicDirty = map.dynamicDirty || map.cacheDirty;
+			anyDirty = anyDirty || map.dynamicDirty;
+		}
+	}
+
+	if (anyDirty)
+	{
+		PROFILE_GPU_SCOPE("Shadow maps");
+
+		GLint previousFramebuffer = 0;
+		GLint previousViewport[4];
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+		glUseProgram(m_shadowProgram);
+		m_shadowShader.setFloatValue(m_casterFarPlaneHandle, SHADOW_FAR_PLANE);
+		pMeshes->SetInstanceBuffer(m_instanceBuffer);
+
+		for (int i = 0; i < static_cast<int>(m_maps.size()); i++)
+		{
+			SHADOW_MAP& map = m_maps[i];
+			if (!map.dynamicDirty)
+			{
+				continue;
+			}
+
+			m_shadowShader.setVec3Value(m_lightPositionHandle, map.lightPosition);
+			if (map.cacheDirty)
+			{
+				m_staticFacesDrawn += DrawCasters(pMeshes, i, m_cacheTexture, true, true);
+				map.cacheDirty = false;
+			}
+			glCopyImageSubData(
+				m_cacheTexture, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, i * 6,
+				m_shadowTexture, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, i * 6,
+				SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 6);
+			m_dynamicFacesDrawn += DrawCasters(pMeshes, i, m_shadowTexture, false, false);
+			map.dynamicDirty = false;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	}
+
+	glUseProgram(m_pShaderManager->GetProgramID());
+	glActiveTexture(GL_TEXTURE0 + m_textureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_shadowTexture);
+	glActiveTexture(GL_TEXTURE0);
+	m_pShaderManager->setSampler2DValue(m_shadowMapsHandle, m_textureUnit);
+	m_pShaderManager->setFloatValue(m_shadowFarPlaneHandle, SHADOW_FAR_PLANE);
+	m_pShaderManager->setFloatValue(m_shadowBiasHandle, SHADOW_BIAS);
+
+	return(anyDirty);
+}
+
+/***********************************************************
+ *  CreateTextures()
+ *
+ *  Distances are stored in 16 bits, which over the far
+ *  plane is still finer than a millimeter. Only the sampled
+ *  cube compares against the stored distance.
+ ***********************************************************/
+void ShadowMaps::CreateTextures(uint32_t mapCount)
+{
+	if (m_cacheTexture != 0)
+	{
+		glDeleteTextures(1, &m_cacheTexture);
+		glDeleteTextures(1, &m_shadowTexture);
+	}
+
+	GLuint* textures[2] = { &m_cacheTexture, &m_shadowTexture };
+	for (int i = 0; i < 2; i++)
+	{
+		glGenTextures(1, textures[i]);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, *textures[i]);
+		glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT16,
+			SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, static_cast<GLsizei>(mapCount * 6));
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+	m_textureMapCount = mapCount;
+	for (SHADOW_MAP& map : m_maps)
+	{
+		map.cacheDirty = true;
+		map.dynamicDirty = true;
+	}
+}
+
+/***********************************************************
+ *  DrawCasters()
+ *
+ *  The casters of all six faces are packed and uploaded
+ *  together before any face is drawn. Faces without a
+ *  caster are skipped unless they need clearing.
+ ***********************************************************/
+uint32_t ShadowMaps::DrawCasters(PrimitiveMeshes* pMeshes, int map, GLuint texture, bool staticCasters, bool clear)
+{
+	const std::vector<uint32_t>& casters = staticCasters ? m_staticCasters : m_dynamicCasters;
+	const glm::vec3 lightPosition = m_maps[map].lightPosition;
+	const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f,
+		SHADOW_NEAR_PLANE, SHADOW_FAR_PLANE);
+
+	glm::mat4 faceViewProjections[6];
+	size_t faceDrawEnds[6];
+	m_faceInstances.clear();
+	m_faceDraws.clear();
+	for (int face = 0; face < 6; face++)
+	{
+		faceViewProjections[face] = projection * glm::lookAt(lightPosition,
+			lightPosition + CUBE_FACE_DIRECTIONS[face], CUBE_FACE_UPS[face]);
+		FrustumCuller::FRUSTUM frustum = FrustumCuller::ExtractFrustum(faceViewProjections[face]);
+
+		const size_t faceDrawBegin = m_faceDraws.size();
+		for (uint32_t index : casters)
+		{
+			const SHADOW_CASTER& caster = m_casters[index];
+			if (!BoxInFrustum(frustum, caster.boundsCenter, caster.boundsExtents))
+			{
+				continue;
+			}
+
+			if (m_faceDraws.size() == faceDrawBegin || m_faceDraws.back().meshID != caster.meshID)
+			{
+				DRAW_RANGE draw;
+				draw.meshID = caster.meshID;
+				draw.firstInstance = static_cast<uint32_t>(m_faceInstances.size());
+				draw.instanceCount = 0;
+				m_faceDraws.push_back(draw);
+			}
+
+			PrimitiveMeshes::INSTANCE_DATA instance;
+			instance.model = caster.model;
+			instance.color = glm::vec4(1.0f);
+			instance.materialIndex = 0;
+			instance.textureLayer = -1;
+			instance.padding[0] = instance.padding[1] = 0;
+			m_faceInstances.push_back(instance);
+			m_faceDraws.back().instanceCount++;
+		}
+		faceDrawEnds[face] = m_faceDraws.size();
+	}
+
+	if (!m_faceInstances.empty())
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, m_faceInstances.size() * sizeof(PrimitiveMeshes::INSTANCE_DATA),
+			m_faceInstances.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	uint32_t facesDrawn = 0;
+	size_t faceDrawBegin = 0;
+	for (int face = 0; face < 6; face++)
+	{
+		if (faceDrawBegin == faceDrawEnds[face] && !clear)
+		{
+			continue;
+		}
+
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, map * 6 + face);
+		if (clear)
+		{
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		m_shadowShader.setMat4Value(m_faceViewProjectionHandle, faceViewProjections[face]);
+		for (size_t d = faceDrawBegin; d < faceDrawEnds[face]; d++)
+		{
+			pMeshes->DrawMeshInstanced(m_faceDraws[d].meshID, 0,
+				m_faceDraws[d].instanceCount, m_faceDraws[d].firstInstance);
+		}
+		faceDrawBegin = faceDrawEnds[face];
+		facesDrawn++;
+	}
+
+	return(facesDrawn);
+}
+
+/***********************************************************
+ *  GetFarPlane()
+ *
+ *  This method returns the distance the stored depths
+ *  are scaled by.
+ ***********************************************************/
+float ShadowMaps::GetFarPlane() const
+{
+	return(SHADOW_FAR_PLANE);
+}
+
+/***********************************************************
+ *  GetBias()
+ *
+ *  This method returns the depth bias per unit of
+ *  distance to the light.
+ ***********************************************************/
+float ShadowMaps::GetBias() const
+{
+	return(SHADOW_BIAS);
+}
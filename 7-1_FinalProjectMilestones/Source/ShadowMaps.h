@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.h
+// ============
+// cube shadow maps of the global lights, with the static casters cached
+//
+//  Each shadowed light gets one cube of a cube map array, storing the
+//  distance from the light to the nearest caster in every direction. The
+//  casters flagged static are drawn into a separate cache cube, which is
+//  only redrawn when the light moves or a static caster changes. The cube
+//  the fragment shader samples is a copy of the cache with the other
+//  casters drawn over it, redone only when one of them moves, and then
+//  only on the faces they are in. A scene that does not change draws no
+//  shadow passes at all.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderUniformManager.h"
+#include "PrimitiveMeshes.h"
+#include "LightClusters.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  ShadowMaps
+ *
+ *  This class owns the shadow cube maps and the program
+ *  that draws the casters into them.
+ ***********************************************************/
+class ShadowMaps
+{
+public:
+	// constructor
+	ShadowMaps(ShaderUniformManager* pShaderManager);
+	// destructor
+	~ShadowMaps();
+
+	ShadowMaps(const ShadowMaps&) = delete;
+	ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+	// size in texels of each cube face
+	static const int SHADOW_MAP_SIZE = 1024;
+	// most lights with a shadow map
+	static const int MAX_SHADOW_MAPS = 2;
+
+	// scene object drawn into the shadow maps
+	struct SHADOW_CASTER
+	{
+		SCENE_MESH_ID meshID;
+		glm::mat4 model;
+		// world space box
+		glm::vec3 boundsCenter;
+		glm::vec3 boundsExtents;
+		// drawn into the cached cube
+		bool isStatic;
+	};
+
+	// load the caster shaders and create the framebuffer, false
+	// when the shaders fail to link
+	bool Initialize();
+	bool IsInitialized() const { return(m_shadowProgram != 0); }
+
+	// give each light marked with a shadow map layer of 0 or
+	// more its own layer, in order, and -1 to the rest; lights
+	// that moved or changed layer get their cache redrawn
+	void SetLights(std::vector<LightClusters::LIGHT_SOURCE>& lights);
+	// replace every caster, redrawing all the cubes
+	void SetCasters(const std::vector<SHADOW_CASTER>& casters);
+	uint32_t GetCasterCount() const { return(static_cast<uint32_t>(m_casters.size())); }
+	// move one caster; a static caster invalidates the cache
+	void SetCasterTransform(uint32_t index, const glm::mat4& model,
+		const glm::vec3& boundsCenter, const glm::vec3& boundsExtents);
+	// redraw the static cache every update, for comparison
+	void SetCaching(bool enabled) { m_caching = enabled; }
+
+	// redraw whatever changed and bind the maps and their
+	// settings for the scene shader; returns true when any
+	// caster was drawn, which changes the mesh instance buffer
+	bool Update(PrimitiveMeshes* pMeshes);
+
+	// texture unit the maps stay bound to, and the settings
+	// set on the scene shader, for other programs lighting
+	// the scene
+	int GetTextureUnit() const { return(m_textureUnit); }
+	float GetFarPlane() const;
+	float GetBias() const;
+
+	// cube faces drawn by the last update, into the cache and
+	// over the copies of it
+	uint32_t GetStaticFacesDrawn() const { return(m_staticFacesDrawn); }
+	uint32_t GetDynamicFacesDrawn() const { return(m_dynamicFacesDrawn); }
+
+private:
+	// instances of one mesh drawn into one face
+	struct DRAW_RANGE
+	{
+		SCENE_MESH_ID meshID;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	// light and redraw state of one cube
+	struct SHADOW_MAP
+	{
+		glm::vec3 lightPosition;
+		bool cacheDirty;
+		bool dynamicDirty;
+	};
+
+	// create the two cube map arrays with room for mapCount
+	// cubes, marking every cube for redrawing
+	void CreateTextures(uint32_t mapCount);
+	// draw the static or the other casters into the faces of a
+	// cube they are in, clearing the faces first when asked;
+	// returns the number of faces drawn
+	uint32_t DrawCasters(PrimitiveMeshes* pMeshes, int map, GLuint texture, bool staticCasters, bool clear);
+
+	// pointer to shader manager object
+	ShaderUniformManager* m_pShaderManager;
+
+	// program drawing the distances to the light
+	ShaderUniformManager m_shadowShader;
+	GLuint m_shadowProgram;
+	UniformHandle m_faceViewProjectionHandle;
+	UniformHandle m_lightPositionHandle;
+	UniformHandle m_casterFarPlaneHandle;
+
+	// scene shader uniforms
+	UniformHandle m_shadowMapsHandle;
+	UniformHandle m_shadowFarPlaneHandle;
+	UniformHandle m_shadowBiasHandle;
+
+	std::vector<SHADOW_CASTER> m_casters;
+	// indices of the static and the other casters, by mesh
+	std::vector<uint32_t> m_staticCasters;
+	std::vector<uint32_t> m_dynamicCasters;
+	std::vector<SHADOW_MAP> m_maps;
+	bool m_caching;
+
+	// instances and draws of the faces being drawn
+	std::vector<PrimitiveMeshes::INSTANCE_DATA> m_faceInstances;
+	std::vector<DRAW_RANGE> m_faceDraws;
+	GLuint m_instanceBuffer;
+
+	// cube map arrays of the cached casters and of all casters
+	GLuint m_cacheTexture;
+	GLuint m_shadowTexture;
+	uint32_t m_textureMapCount;
+	GLuint m_framebuffer;
+	int m_textureUnit;
+
+	uint32_t m_staticFacesDrawn;
+	uint32_t m_dynamicFacesDrawn;
+};
@@ -0,0 +1,513 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearrays.cpp
+// =================
+// scene textures packed into 2D texture arrays
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureArrays.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+namespace
+{
+	// bytes of one image of a texture format
+	size_t GetImageBytes(GLenum internalFormat, int width, int height)
+	{
+		size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+		switch (internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			return(blocks * 8);
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			return(blocks * 16);
+		case GL_RGB8:
+			return(static_cast<size_t>(width) * height * 3);
+		default:
+			return(static_cast<size_t>(width) * height * 4);
+		}
+	}
+
+	// true for the block compressed formats
+	bool IsCompressedFormat(GLenum internalFormat)
+	{
+		return(internalFormat != GL_RGBA8 && internalFormat != GL_RGB8);
+	}
+
+	// sampling state shared by every array, for the bound array
+	void SetArrayParameters(int levelCount)
+	{
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	}
+}
+
+/***********************************************************
+ *  TextureArrays()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureArrays::TextureArrays()
+{
+}
+
+/***********************************************************
+ *  ~TextureArrays()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureArrays::~TextureArrays()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  AddTexture()
+ ***********************************************************/
+bool TextureArrays::AddTexture(
+	const std::string& tag,
+	int width,
+	int height,
+	int colorChannels,
+	const unsigned char* pixels)
+{
+	if (colorChannels != 3 && colorChannels != 4)
+	{
+		std::cout << "UNSUPPORTED: " << colorChannels << std::endl;
+		return false;
+	}
+
+	PENDING_IMAGE* pImage = QueueImage(tag, width, height, (colorChannels == 4) ? GL_RGBA8 : GL_RGB8);
+	pImage->pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * colorChannels);
+	return true;
+}
+
+bool TextureArrays::AddTexture(
+	const std::string& tag,
+	GLenum internalFormat,
+	const std::vector<MIP_LEVEL>& levels,
+	GLuint pixelBuffer,
+	MappedFile* pSourceFile,
+	const unsigned char* pSourceData)
+{
+	if (levels.empty())
+	{
+		delete pSourceFile;
+		return false;
+	}
+
+	PENDING_IMAGE* pImage = QueueImage(tag, levels[0].width, levels[0].height, internalFormat);
+	pImage->pixelBuffer = pixelBuffer;
+	pImage->levels = levels;
+
+	if (NULL != pSourceFile)
+	{
+		TEXTURE_SOURCE& source = m_sources.back();
+		source.pFile = pSourceFile;
+		source.pData = pSourceData;
+		source.levels = levels;
+	}
+	return true;
+}
+
+/***********************************************************
+ *  QueueImage()
+ ***********************************************************/
+TextureArrays::PENDING_IMAGE* TextureArrays::QueueImage(
+	const std::string& tag,
+	int width,
+	int height,
+	GLenum internalFormat)
+{
+	TEXTURE_LAYER texture;
+	texture.tag = tag;
+	texture.arrayIndex = -1;
+	texture.layer = -1;
+	m_textures.push_back(texture);
+
+	TEXTURE_SOURCE source;
+	source.pFile = NULL;
+	source.pData = NULL;
+	m_sources.push_back(source);
+
+	PENDING_IMAGE image;
+	image.textureIndex = static_cast<int>(m_textures.size()) - 1;
+	image.width = width;
+	image.height = height;
+	image.internalFormat = internalFormat;
+	image.pixelBuffer = 0;
+	m_pendingImages.push_back(image);
+
+	return &m_pendingImages.back();
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method groups the queued images by size, format and
+ *  mip chain and uploads each group into a texture array,
+ *  splitting groups larger than the layer limit. Images
+ *  without a prebuilt chain get theirs from the driver.
+ ***********************************************************/
+void TextureArrays::Build()
+{
+	GLint maxLayers = 0;
+	GLint maxUnits = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxUnits);
+	// the last unit is kept for the shadow maps
+	maxUnits--;
+
+	// images of each size, format and prebuilt level count, in load order
+	std::map<std::tuple<int, int, GLenum, size_t>, std::vector<PENDING_IMAGE*>> groups;
+	for (PENDING_IMAGE& image : m_pendingImages)
+	{
+		groups[std::make_tuple(image.width, image.height, image.internalFormat,
+			image.levels.size())].push_back(&image);
+	}
+
+	for (const auto& group : groups)
+	{
+		const std::vector<PENDING_IMAGE*>& images = group.second;
+		for (size_t first = 0; first < images.size(); first += maxLayers)
+		{
+			if (static_cast<GLint>(m_arrays.size()) >= maxUnits)
+			{
+				std::cout << "ERROR: TEXTURE ARRAY LIMIT REACHED. " << images[first]->width << "x"
+					<< images[first]->height << " textures will not be drawn" << std::endl;
+				break;
+			}
+
+			size_t layerCount = std::min(images.size() - first, static_cast<size_t>(maxLayers));
+			const PENDING_IMAGE& sample = *images[first];
+			bool prebuilt = !sample.levels.empty();
+			bool compressed = IsCompressedFormat(sample.internalFormat);
+
+			TEXTURE_ARRAY textureArray;
+			textureArray.width = sample.width;
+			textureArray.height = sample.height;
+			textureArray.internalFormat = sample.internalFormat;
+			textureArray.layerCount = static_cast<int>(layerCount);
+			textureArray.droppedLevels = 0;
+			GLenum format = (sample.internalFormat == GL_RGBA8) ? GL_RGBA : GL_RGB;
+			textureArray.levelCount = static_cast<int>(sample.levels.size());
+			if (!prebuilt)
+			{
+				textureArray.levelCount = 1;
+				while ((std::max(sample.width, sample.height) >> textureArray.levelCount) > 0)
+				{
+					textureArray.levelCount++;
+				}
+			}
+
+			glGenTextures(1, &textureArray.ID);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, textureArray.levelCount, textureArray.internalFormat,
+				sample.width, sample.height, textureArray.layerCount);
+
+			SetArrayParameters(textureArray.levelCount);
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+			int arrayIndex = static_cast<int>(m_arrays.size());
+			for (size_t layer = 0; layer < layerCount; layer++)
+			{
+				const PENDING_IMAGE& image = *images[first + layer];
+				if (prebuilt)
+				{
+					// the data arguments are offsets into the bound buffer
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, image.pixelBuffer);
+					for (size_t level = 0; level < image.levels.size(); level++)
+					{
+						const MIP_LEVEL& mip = image.levels[level];
+						const void* offset = reinterpret_cast<const void*>(mip.offset);
+						if (compressed)
+						{
+							glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0,
+								static_cast<GLint>(layer), mip.width, mip.height, 1, image.internalFormat,
+								static_cast<GLsizei>(mip.size), offset);
+						}
+						else
+						{
+							glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), 0, 0,
+								static_cast<GLint>(layer), mip.width, mip.height, 1, format,
+								GL_UNSIGNED_BYTE, offset);
+						}
+					}
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				}
+				else
+				{
+					glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+						image.width, image.height, 1, format, GL_UNSIGNED_BYTE, image.pixels.data());
+				}
+				m_textures[image.textureIndex].arrayIndex = arrayIndex;
+				m_textures[image.textureIndex].layer = static_cast<int>(layer);
+				textureArray.layerTextures.push_back(image.textureIndex);
+			}
+			if (!prebuilt)
+			{
+				glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			}
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+			m_arrays.push_back(textureArray);
+
+			std::cout << "TEXTURE ARRAY " << arrayIndex << ": " << sample.width << "x" << sample.height
+				<< ", format: 0x" << std::hex << sample.internalFormat << std::dec
+				<< ", levels: " << textureArray.levelCount << ", layers: " << layerCount << std::endl;
+		}
+	}
+	m_pendingImages.clear();
+}
+
+/***********************************************************
+ *  BindArrays()
+ *
+ *  The arrays stay bound to their units from here on.
+ ***********************************************************/
+void TextureArrays::BindArrays() const
+{
+	for (size_t i = 0; i < m_arrays.size(); i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + GetArrayUnit(static_cast<int>(i)));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[i].ID);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  CanDropTopLevel()
+ *
+ *  Compressed arrays keep whole blocks at their top level.
+ ***********************************************************/
+bool TextureArrays::CanDropTopLevel(int arrayIndex) const
+{
+	const TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	if (textureArray.levelCount < 2)
+	{
+		return false;
+	}
+
+	bool compressed = IsCompressedFormat(textureArray.internalFormat);
+	int width = std::max(textureArray.width / 2, 1);
+	int height = std::max(textureArray.height / 2, 1);
+	return(!compressed || (width % 4 == 0 && height % 4 == 0));
+}
+
+/***********************************************************
+ *  DropTopLevel()
+ *
+ *  Texture storage is immutable, so the smaller array is a
+ *  new texture that the remaining levels are copied into on
+ *  the GPU. The layers keep their indices, which leaves the
+ *  instance data untouched.
+ ***********************************************************/
+bool TextureArrays::DropTopLevel(int arrayIndex)
+{
+	if (!CanDropTopLevel(arrayIndex))
+	{
+		return false;
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	int width = std::max(textureArray.width / 2, 1);
+	int height = std::max(textureArray.height / 2, 1);
+	int levelCount = textureArray.levelCount - 1;
+
+	// work on the array's own unit so no other binding changes
+	glActiveTexture(GL_TEXTURE0 + GetArrayUnit(arrayIndex));
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCount, textureArray.internalFormat,
+		width, height, textureArray.layerCount);
+	SetArrayParameters(levelCount);
+
+	for (int level = 0; level < levelCount; level++)
+	{
+		glCopyImageSubData(
+			textureArray.ID, GL_TEXTURE_2D_ARRAY, level + 1, 0, 0, 0,
+			textureID, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+			std::max(width >> level, 1), std::max(height >> level, 1), textureArray.layerCount);
+	}
+
+	glDeleteTextures(1, &textureArray.ID);
+	glActiveTexture(GL_TEXTURE0);
+
+	textureArray.ID = textureID;
+	textureArray.width = width;
+	textureArray.height = height;
+	textureArray.levelCount = levelCount;
+	textureArray.droppedLevels++;
+
+	return true;
+}
+
+/***********************************************************
+ *  CanRestoreTopLevel()
+ ***********************************************************/
+bool TextureArrays::CanRestoreTopLevel(int arrayIndex) const
+{
+	const TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	if (textureArray.droppedLevels == 0)
+	{
+		return false;
+	}
+
+	for (int texture : textureArray.layerTextures)
+	{
+		const TEXTURE_SOURCE& source = m_sources[texture];
+		if (NULL == source.pFile || static_cast<int>(source.levels.size()) < textureArray.droppedLevels)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/***********************************************************
+ *  GetRestoreBytes()
+ ***********************************************************/
+size_t TextureArrays::GetRestoreBytes(int arrayIndex) const
+{
+	const TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	if (!CanRestoreTopLevel(arrayIndex))
+	{
+		return(0);
+	}
+
+	const MIP_LEVEL& top = m_sources[textureArray.layerTextures[0]].levels[textureArray.droppedLevels - 1];
+	return(GetImageBytes(textureArray.internalFormat, top.width, top.height) * textureArray.layerCount);
+}
+
+/***********************************************************
+ *  RestoreTopLevel()
+ *
+ *  The reverse of DropTopLevel(): the resident levels are
+ *  copied one level down into a larger array on the GPU,
+ *  and the new top level of each layer is uploaded straight
+ *  from its mapped container, so nothing is decoded.
+ ***********************************************************/
+bool TextureArrays::RestoreTopLevel(int arrayIndex)
+{
+	if (!CanRestoreTopLevel(arrayIndex))
+	{
+		return false;
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	const int topLevel = textureArray.droppedLevels - 1;
+	const MIP_LEVEL& top = m_sources[textureArray.layerTextures[0]].levels[topLevel];
+	int levelCount = textureArray.levelCount + 1;
+	bool compressed = IsCompressedFormat(textureArray.internalFormat);
+	GLenum format = (textureArray.internalFormat == GL_RGBA8) ? GL_RGBA : GL_RGB;
+
+	// work on the array's own unit so no other binding changes
+	glActiveTexture(GL_TEXTURE0 + GetArrayUnit(arrayIndex));
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCount, textureArray.internalFormat,
+		top.width, top.height, textureArray.layerCount);
+	SetArrayParameters(levelCount);
+
+	for (int level = 0; level < textureArray.levelCount; level++)
+	{
+		glCopyImageSubData(
+			textureArray.ID, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+			textureID, GL_TEXTURE_2D_ARRAY, level + 1, 0, 0, 0,
+			std::max(textureArray.width >> level, 1), std::max(textureArray.height >> level, 1),
+			textureArray.layerCount);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t layer = 0; layer < textureArray.layerTextures.size(); layer++)
+	{
+		const TEXTURE_SOURCE& source = m_sources[textureArray.layerTextures[layer]];
+		const MIP_LEVEL& mip = source.levels[topLevel];
+		if (compressed)
+		{
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+				mip.width, mip.height, 1, textureArray.internalFormat,
+				static_cast<GLsizei>(mip.size), source.pData + mip.offset);
+		}
+		else
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+				mip.width, mip.height, 1, format, GL_UNSIGNED_BYTE, source.pData + mip.offset);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glDeleteTextures(1, &textureArray.ID);
+	glActiveTexture(GL_TEXTURE0);
+
+	textureArray.ID = textureID;
+	textureArray.width = top.width;
+	textureArray.height = top.height;
+	textureArray.levelCount = levelCount;
+	textureArray.droppedLevels--;
+
+	return true;
+}
+
+/***********************************************************
+ *  GetArrayBytes()
+ ***********************************************************/
+size_t TextureArrays::GetArrayBytes(int arrayIndex) const
+{
+	const TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	size_t bytes = 0;
+	for (int level = 0; level < textureArray.levelCount; level++)
+	{
+		bytes += GetImageBytes(textureArray.internalFormat,
+			std::max(textureArray.width >> level, 1), std::max(textureArray.height >> level, 1));
+	}
+	return(bytes * textureArray.layerCount);
+}
+
+/***********************************************************
+ *  Destroy()
+ ***********************************************************/
+void TextureArrays::Destroy()
+{
+	for (TEXTURE_ARRAY& textureArray : m_arrays)
+	{
+		if (textureArray.ID != 0)
+		{
+			glDeleteTextures(1, &textureArray.ID);
+			textureArray.ID = 0;
+		}
+	}
+	m_arrays.clear();
+	m_textures.clear();
+	m_pendingImages.clear();
+
+	for (TEXTURE_SOURCE& source : m_sources)
+	{
+		delete source.pFile;
+	}
+	m_sources.clear();
+}
+
+/***********************************************************
+ *  FindTexture()
+ ***********************************************************/
+int TextureArrays::FindTexture(const std::string& tag) const
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if (m_textures[i].tag == tag)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
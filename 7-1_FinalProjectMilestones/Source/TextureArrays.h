@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturearrays.h
+// ===============
+// scene textures packed into 2D texture arrays
+//
+//  Textures are grouped by size and format, and each group becomes one
+//  GL_TEXTURE_2D_ARRAY bound to its own texture unit once at startup.
+//  The images can come from client memory, with the mip chain generated
+//  by the driver, or from pixel buffer objects holding a prebuilt chain
+//  in any format the cache produces, compressed ones included. The arrays
+//  can be built on a context sharing objects with the one that draws them.
+//  A texture is then addressed by its array and layer, so draws only
+//  pick the array and every instance carries its own layer. An array can
+//  later give up its top mip level to free memory; its layers keep their
+//  indices. When every layer came from a cache container, which stays
+//  mapped, a dropped level can be uploaded again from it.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureArrays
+ *
+ *  This class collects decoded texture images and builds
+ *  the texture arrays holding them.
+ ***********************************************************/
+class TextureArrays
+{
+public:
+	// constructor
+	TextureArrays();
+	// destructor
+	~TextureArrays();
+
+	// where a loaded texture lives
+	struct TEXTURE_LAYER
+	{
+		std::string tag;
+		// index of the texture array, -1 when it did not fit
+		int arrayIndex;
+		int layer;
+	};
+
+	// one texture array and the size and format of its layers
+	struct TEXTURE_ARRAY
+	{
+		GLuint ID;
+		int width;
+		int height;
+		GLenum internalFormat;
+		int levelCount;
+		int layerCount;
+		// top levels released to save memory
+		int droppedLevels;
+		// texture held by each layer
+		std::vector<int> layerTextures;
+	};
+
+	// one mip level of an image in a pixel buffer, in bytes
+	// from the start of the buffer
+	struct MIP_LEVEL
+	{
+		int width;
+		int height;
+		size_t offset;
+		size_t size;
+	};
+
+	// queue a decoded image for packing, the pixels are copied
+	bool AddTexture(
+		const std::string& tag,
+		int width,
+		int height,
+		int colorChannels,
+		const unsigned char* pixels);
+	// queue an image and its mip chain held in a pixel buffer
+	// object, which must stay alive until Build() returns; the
+	// mapped container with the same levels at pSourceData, when
+	// given, is owned by the arrays from here on
+	bool AddTexture(
+		const std::string& tag,
+		GLenum internalFormat,
+		const std::vector<MIP_LEVEL>& levels,
+		GLuint pixelBuffer,
+		MappedFile* pSourceFile = NULL,
+		const unsigned char* pSourceData = NULL);
+	// create the texture arrays from the queued images
+	void Build();
+	// bind each array to its texture unit in the current context
+	void BindArrays() const;
+	// true when an array has a level below its top one that
+	// can become the new top level
+	bool CanDropTopLevel(int arrayIndex) const;
+	// reallocate an array without its top level, copying the
+	// remaining levels and rebinding it to its unit
+	bool DropTopLevel(int arrayIndex);
+	// true when an array has dropped a level and every layer
+	// has a mapped container to upload it from
+	bool CanRestoreTopLevel(int arrayIndex) const;
+	// GPU memory an array grows by when its last dropped level
+	// is restored
+	size_t GetRestoreBytes(int arrayIndex) const;
+	// reallocate an array with its last dropped level back on
+	// top, uploading it from the containers
+	bool RestoreTopLevel(int arrayIndex);
+	// release the texture arrays
+	void Destroy();
+
+	// find a loaded texture by tag, -1 when not found
+	int FindTexture(const std::string& tag) const;
+	uint32_t GetTextureCount() const { return(static_cast<uint32_t>(m_textures.size())); }
+	const TEXTURE_LAYER& GetTexture(int index) const { return(m_textures[index]); }
+
+	// texture arrays and the units they are bound to
+	uint32_t GetArrayCount() const { return(static_cast<uint32_t>(m_arrays.size())); }
+	const TEXTURE_ARRAY& GetArray(int arrayIndex) const { return(m_arrays[arrayIndex]); }
+	int GetArrayUnit(int arrayIndex) const { return(arrayIndex); }
+	// GPU memory held by an array's resident levels
+	size_t GetArrayBytes(int arrayIndex) const;
+
+private:
+	// decoded image waiting to be packed
+	struct PENDING_IMAGE
+	{
+		int textureIndex;
+		int width;
+		int height;
+		GLenum internalFormat;
+		// pixels in client memory, or the buffer holding them
+		// along with the levels stored in it
+		std::vector<unsigned char> pixels;
+		GLuint pixelBuffer;
+		std::vector<MIP_LEVEL> levels;
+	};
+
+	// mip chain of a texture in its mapped cache container
+	struct TEXTURE_SOURCE
+	{
+		MappedFile* pFile;
+		const unsigned char* pData;
+		std::vector<MIP_LEVEL> levels;
+	};
+
+	// register a texture and queue its image
+	PENDING_IMAGE* QueueImage(
+		const std::string& tag,
+		int width,
+		int height,
+		GLenum internalFormat);
+
+	// loaded textures in load order
+	std::vector<TEXTURE_LAYER> m_textures;
+	// container of each loaded texture, no file when it has none
+	std::vector<TEXTURE_SOURCE> m_sources;
+	// images queued since the last build
+	std::vector<PENDING_IMAGE> m_pendingImages;
+	// created texture arrays, array i is bound to unit i
+	std::vector<TEXTURE_ARRAY> m_arrays;
+};
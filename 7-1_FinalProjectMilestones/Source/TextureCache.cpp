@@ -0,0 +1,476 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ================
+// precompiled texture containers with prebuilt mip chains
+//
+//  Container layout, all values little endian:
+//
+//    TEXTURE_FILE_HEADER
+//    TEXTURE_FILE_LEVEL[levelCount]
+//    level data, starting at dataOffset (16 byte aligned), level 0 first
+//
+//  Level offsets are relative to dataOffset, so the data block can be
+//  copied into a pixel buffer as it is.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#ifndef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#endif
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+// container layout definitions
+namespace
+{
+	const char g_TextureMagic[4] = { 'T', 'E', 'X', 'B' };
+	const uint32_t g_TextureVersion = 1;
+	const size_t g_DataAlignment = 16;
+	const uint32_t g_MaxLevels = 32;
+
+	struct TEXTURE_FILE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t internalFormat;
+		uint32_t levelCount;
+		uint32_t dataOffset;
+		uint32_t dataSize;
+	};
+
+	struct TEXTURE_FILE_LEVEL
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	// halve an image with a 2x2 box filter, edge texels are
+	// repeated for odd sizes
+	std::vector<unsigned char> ReduceImage(
+		const std::vector<unsigned char>& pixels,
+		int width,
+		int height,
+		int colorChannels)
+	{
+		int reducedWidth = std::max(width / 2, 1);
+		int reducedHeight = std::max(height / 2, 1);
+		std::vector<unsigned char> reduced(static_cast<size_t>(reducedWidth) * reducedHeight * colorChannels);
+
+		for (int y = 0; y < reducedHeight; y++)
+		{
+			int y0 = std::min(y * 2, height - 1);
+			int y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < reducedWidth; x++)
+			{
+				int x0 = std::min(x * 2, width - 1);
+				int x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < colorChannels; c++)
+				{
+					int sum =
+						pixels[(static_cast<size_t>(y0) * width + x0) * colorChannels + c] +
+						pixels[(static_cast<size_t>(y0) * width + x1) * colorChannels + c] +
+						pixels[(static_cast<size_t>(y1) * width + x0) * colorChannels + c] +
+						pixels[(static_cast<size_t>(y1) * width + x1) * colorChannels + c];
+					reduced[(static_cast<size_t>(y) * reducedWidth + x) * colorChannels + c] =
+						static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+		return(reduced);
+	}
+
+	uint16_t PackRGB565(const int color[3])
+	{
+		return(static_cast<uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3)));
+	}
+
+	void UnpackRGB565(uint16_t packed, int color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// compress one 4x4 block to BC1, using the bounding box of
+	// the block colors as the endpoints
+	void EncodeBC1Block(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int colorChannels,
+		int blockX,
+		int blockY,
+		unsigned char* pBlock)
+	{
+		int texels[16][3];
+		int low[3] = { 255, 255, 255 };
+		int high[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			int x = std::min(blockX * 4 + (i % 4), width - 1);
+			int y = std::min(blockY * 4 + (i / 4), height - 1);
+			const unsigned char* pTexel = pixels + (static_cast<size_t>(y) * width + x) * colorChannels;
+			for (int c = 0; c < 3; c++)
+			{
+				texels[i][c] = pTexel[c];
+				low[c] = std::min(low[c], texels[i][c]);
+				high[c] = std::max(high[c], texels[i][c]);
+			}
+		}
+
+		// pull the endpoints in slightly, which lowers the
+		// error of the interpolated colors
+		for (int c = 0; c < 3; c++)
+		{
+			int inset = (high[c] - low[c]) / 16;
+			low[c] += inset;
+			high[c] -= inset;
+		}
+
+		uint16_t color0 = PackRGB565(high);
+		uint16_t color1 = PackRGB565(low);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		// four color mode needs color0 > color1, equal endpoints
+		// leave every index at 0
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			UnpackRGB565(color0, palette[0]);
+			UnpackRGB565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestDistance = INT32_MAX;
+				for (int p = 0; p < 4; p++)
+				{
+					int distance = 0;
+					for (int c = 0; c < 3; c++)
+					{
+						int delta = texels[i][c] - palette[p][c];
+						distance += delta * delta;
+					}
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = p;
+					}
+				}
+				indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+			}
+		}
+
+		pBlock[0] = static_cast<unsigned char>(color0 & 0xFF);
+		pBlock[1] = static_cast<unsigned char>(color0 >> 8);
+		pBlock[2] = static_cast<unsigned char>(color1 & 0xFF);
+		pBlock[3] = static_cast<unsigned char>(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			pBlock[4 + i] = static_cast<unsigned char>((indices >> (i * 8)) & 0xFF);
+		}
+	}
+
+	// compress a whole image to BC1 blocks in row order
+	std::vector<unsigned char> CompressBC1(
+		const std::vector<unsigned char>& pixels,
+		int width,
+		int height,
+		int colorChannels)
+	{
+		int blocksWide = (width + 3) / 4;
+		int blocksHigh = (height + 3) / 4;
+		std::vector<unsigned char> blocks(static_cast<size_t>(blocksWide) * blocksHigh * 8);
+		for (int blockY = 0; blockY < blocksHigh; blockY++)
+		{
+			for (int blockX = 0; blockX < blocksWide; blockX++)
+			{
+				EncodeBC1Block(pixels.data(), width, height, colorChannels, blockX, blockY,
+					blocks.data() + (static_cast<size_t>(blockY) * blocksWide + blockX) * 8);
+			}
+		}
+		return(blocks);
+	}
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache(const std::string& cacheDirectory, bool compressTextures)
+{
+	m_cacheDirectory = cacheDirectory;
+	m_compressTextures = compressTextures;
+}
+
+/***********************************************************
+ *  ~TextureCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureCache::~TextureCache()
+{
+}
+
+/***********************************************************
+ *  HashBytes()
+ ***********************************************************/
+uint64_t TextureCache::HashBytes(const unsigned char* pData, size_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= pData[i];
+		hash *= 1099511628211ULL;
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method hashes the source file to find its container.
+ *  Compressed and uncompressed containers of the same source
+ *  are kept side by side.
+ ***********************************************************/
+bool TextureCache::Load(const char* sourcePath, CACHED_IMAGE& image) const
+{
+	image.pFile = NULL;
+	image.pData = NULL;
+	image.dataSize = 0;
+	image.sourceHash = 0;
+	image.fromCache = false;
+
+	uint64_t sourceHash = 0;
+	{
+		MappedFile source;
+		if (!source.Open(sourcePath))
+		{
+			std::cout << "FAILED TO LOAD IMAGE: " << sourcePath << std::endl;
+			return false;
+		}
+		sourceHash = HashBytes(source.GetData(), source.GetSize());
+	}
+
+	char containerName[32];
+	snprintf(containerName, sizeof(containerName), "%016llx%s.texb",
+		static_cast<unsigned long long>(sourceHash), m_compressTextures ? "_bc1" : "");
+	std::string containerPath = m_cacheDirectory + "/" + containerName;
+
+	if (MapContainer(containerPath, sourceHash, image))
+	{
+		image.fromCache = true;
+		return true;
+	}
+
+	return(BuildContainer(sourcePath, sourceHash, containerPath) &&
+		MapContainer(containerPath, sourceHash, image));
+}
+
+/***********************************************************
+ *  BuildContainer()
+ *
+ *  This method decodes the source, builds its mip chain and
+ *  writes the container. The file is written under a
+ *  temporary name and renamed into place, so a load running
+ *  on another thread never maps a partial container.
+ ***********************************************************/
+bool TextureCache::BuildContainer(
+	const char* sourcePath,
+	uint64_t sourceHash,
+	const std::string& containerPath) const
+{
+	namespace fs = std::filesystem;
+
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+	unsigned char* pPixels = stbi_load(sourcePath, &width, &height, &colorChannels, 0);
+	if (NULL == pPixels)
+	{
+		std::cout << "FAILED TO LOAD IMAGE: " << sourcePath << std::endl;
+		return false;
+	}
+	if (colorChannels != 3 && colorChannels != 4)
+	{
+		std::cout << "UNSUPPORTED: " << colorChannels << std::endl;
+		stbi_image_free(pPixels);
+		return false;
+	}
+
+	std::cout << "LOADED IMAAGE: " << sourcePath << " (" << width << "x" << height
+		<< ", channels: " << colorChannels << ")" << std::endl;
+
+	std::vector<unsigned char> level(pPixels, pPixels + static_cast<size_t>(width) * height * colorChannels);
+	stbi_image_free(pPixels);
+
+	// BC1 has no useful alpha and needs whole blocks at the top level
+	bool compress = m_compressTextures && colorChannels == 3 && width % 4 == 0 && height % 4 == 0;
+	GLenum internalFormat = compress ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT :
+		(colorChannels == 4 ? GL_RGBA8 : GL_RGB8);
+
+	std::vector<TEXTURE_FILE_LEVEL> levelTable;
+	std::vector<unsigned char> data;
+	int levelWidth = width;
+	int levelHeight = height;
+	for (;;)
+	{
+		TEXTURE_FILE_LEVEL entry;
+		entry.width = static_cast<uint32_t>(levelWidth);
+		entry.height = static_cast<uint32_t>(levelHeight);
+		entry.offset = static_cast<uint32_t>(data.size());
+		if (compress)
+		{
+			std::vector<unsigned char> blocks = CompressBC1(level, levelWidth, levelHeight, colorChannels);
+			data.insert(data.end(), blocks.begin(), blocks.end());
+		}
+		else
+		{
+			data.insert(data.end(), level.begin(), level.end());
+		}
+		entry.size = static_cast<uint32_t>(data.size()) - entry.offset;
+		levelTable.push_back(entry);
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		level = ReduceImage(level, levelWidth, levelHeight, colorChannels);
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+
+	TEXTURE_FILE_HEADER header;
+	memcpy(header.magic, g_TextureMagic, sizeof(header.magic));
+	header.version = g_TextureVersion;
+	header.sourceHash = sourceHash;
+	header.internalFormat = internalFormat;
+	header.levelCount = static_cast<uint32_t>(levelTable.size());
+	size_t tableEnd = sizeof(header) + levelTable.size() * sizeof(TEXTURE_FILE_LEVEL);
+	header.dataOffset = static_cast<uint32_t>((tableEnd + g_DataAlignment - 1) & ~(g_DataAlignment - 1));
+	header.dataSize = static_cast<uint32_t>(data.size());
+
+	std::vector<char> image(header.dataOffset + data.size(), 0);
+	memcpy(image.data(), &header, sizeof(header));
+	memcpy(image.data() + sizeof(header), levelTable.data(), levelTable.size() * sizeof(TEXTURE_FILE_LEVEL));
+	memcpy(image.data() + header.dataOffset, data.data(), data.size());
+
+	std::error_code error;
+	fs::create_directories(m_cacheDirectory, error);
+
+	std::string temporaryPath = containerPath + "." +
+		std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+		output.write(image.data(), static_cast<std::streamsize>(image.size()));
+		if (!output)
+		{
+			std::cout << "ERROR: COULD NOT WRITE TEXTURE CACHE: " << temporaryPath << std::endl;
+			return false;
+		}
+	}
+
+	// another thread may have placed the same container first
+	fs::rename(temporaryPath, containerPath, error);
+	if (error)
+	{
+		fs::remove(temporaryPath, error);
+	}
+
+	std::cout << "CACHED TEXTURE: " << sourcePath << " -> " << containerPath
+		<< " (" << header.levelCount << " levels" << (compress ? ", BC1" : "") << ")" << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  MapContainer()
+ *
+ *  This method maps a container and checks that the level
+ *  table fits inside it before the data is handed out.
+ ***********************************************************/
+bool TextureCache::MapContainer(
+	const std::string& containerPath,
+	uint64_t sourceHash,
+	CACHED_IMAGE& image) const
+{
+	MappedFile* pFile = new MappedFile();
+	if (!pFile->Open(containerPath.c_str()) || pFile->GetSize() < sizeof(TEXTURE_FILE_HEADER))
+	{
+		delete pFile;
+		return false;
+	}
+
+	const unsigned char* pData = pFile->GetData();
+	TEXTURE_FILE_HEADER header;
+	memcpy(&header, pData, sizeof(header));
+
+	size_t tableEnd = sizeof(header) + static_cast<size_t>(header.levelCount) * sizeof(TEXTURE_FILE_LEVEL);
+	bool valid =
+		memcmp(header.magic, g_TextureMagic, sizeof(header.magic)) == 0 &&
+		header.version == g_TextureVersion &&
+		header.sourceHash == sourceHash &&
+		header.levelCount > 0 && header.levelCount <= g_MaxLevels &&
+		header.dataOffset >= tableEnd &&
+		static_cast<size_t>(header.dataOffset) + header.dataSize <= pFile->GetSize();
+
+	std::vector<TextureArrays::MIP_LEVEL> levels;
+	for (uint32_t i = 0; valid && i < header.levelCount; i++)
+	{
+		TEXTURE_FILE_LEVEL entry;
+		memcpy(&entry, pData + sizeof(header) + i * sizeof(TEXTURE_FILE_LEVEL), sizeof(entry));
+		if (entry.width == 0 || entry.height == 0 ||
+			static_cast<size_t>(entry.offset) + entry.size > header.dataSize)
+		{
+			valid = false;
+			break;
+		}
+
+		TextureArrays::MIP_LEVEL level;
+		level.width = static_cast<int>(entry.width);
+		level.height = static_cast<int>(entry.height);
+		level.offset = entry.offset;
+		level.size = entry.size;
+		levels.push_back(level);
+	}
+
+	if (!valid)
+	{
+		delete pFile;
+		return false;
+	}
+
+	image.internalFormat = header.internalFormat;
+	image.levels = levels;
+	image.pFile = pFile;
+	image.pData = pData + header.dataOffset;
+	image.dataSize = header.dataSize;
+	image.sourceHash = sourceHash;
+
+	return true;
+}
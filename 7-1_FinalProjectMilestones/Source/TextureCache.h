@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ==============
+// precompiled texture containers with prebuilt mip chains
+//
+//  The first time a source image is loaded it is decoded, flipped for
+//  OpenGL, reduced into its full mip chain and optionally compressed to
+//  BC1, then written to a container file named after the hash of the
+//  source bytes. Later loads map the container and hand its levels to
+//  the upload without decoding anything. Editing a source image changes
+//  its hash, so the stale container is simply no longer used.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+#include "TextureArrays.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class finds or builds the cached container for a
+ *  source image. Load() may be called from several threads
+ *  at once.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// constructor
+	TextureCache(const std::string& cacheDirectory, bool compressTextures);
+	// destructor
+	~TextureCache();
+
+	// image ready for upload, held in a mapped container file
+	struct CACHED_IMAGE
+	{
+		GLenum internalFormat;
+		std::vector<TextureArrays::MIP_LEVEL> levels;
+		// mapped container, owned by the caller once loaded
+		MappedFile* pFile;
+		// every level, back to back, inside the mapped file
+		const unsigned char* pData;
+		size_t dataSize;
+		// hash of the source file contents
+		uint64_t sourceHash;
+		// true when the container was found rather than built
+		bool fromCache;
+	};
+
+	// map the container for a source image, building it first
+	// when there is none for the current source contents
+	bool Load(const char* sourcePath, CACHED_IMAGE& image) const;
+
+	// 64-bit FNV-1a hash of a block of bytes
+	static uint64_t HashBytes(const unsigned char* pData, size_t size);
+
+private:
+	// decode a source image and write its container
+	bool BuildContainer(
+		const char* sourcePath,
+		uint64_t sourceHash,
+		const std::string& containerPath) const;
+	// map a container and check it against the source hash
+	bool MapContainer(
+		const std::string& containerPath,
+		uint64_t sourceHash,
+		CACHED_IMAGE& image) const;
+
+	std::string m_cacheDirectory;
+	bool m_compressTextures;
+};
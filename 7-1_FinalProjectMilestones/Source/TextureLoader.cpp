@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.cpp
+// =================
+// parallel texture decoding with uploads from a shared GL context
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <thread>
+
+namespace
+{
+	// how long to wait on the upload fence per attempt
+	const GLuint64 FENCE_WAIT_NANOSECONDS = 100000000;
+
+	// where the precompiled texture containers are kept
+	const char* const g_TextureCacheDirectory = "textures/cache";
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader(unsigned int threadCount, bool compressTextures)
+	: m_cache(g_TextureCacheDirectory, compressTextures)
+{
+	m_threadCount = threadCount;
+	m_finishedDecodes = 0;
+	m_cachedImages = 0;
+	m_uploadFence = NULL;
+	m_loadMilliseconds = 0.0;
+	m_decodeMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+}
+
+/***********************************************************
+ *  Queue()
+ ***********************************************************/
+void TextureLoader::Queue(const char* filename, const std::string& tag)
+{
+	REQUEST request;
+	request.filename = filename;
+	request.tag = tag;
+	m_requests.push_back(request);
+}
+
+/***********************************************************
+ *  LoadAll()
+ *
+ *  This method loads the queued files on the worker
+ *  threads while the upload thread stages them into pixel
+ *  buffers. When no shared context can be created the
+ *  staging runs on the calling thread instead, still
+ *  overlapping the decodes.
+ ***********************************************************/
+void TextureLoader::LoadAll(TextureArrays& textures)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	m_decodedImages.clear();
+	m_loadedTextures.clear();
+	m_finishedDecodes = 0;
+	m_cachedImages = 0;
+	m_decodeMilliseconds = 0.0;
+	m_uploadFence = NULL;
+
+	// hidden window whose context shares objects with the main one,
+	// created here because GLFW windows belong to the main thread
+	GLFWwindow* pMainWindow = glfwGetCurrentContext();
+	GLFWwindow* pUploadWindow = NULL;
+	if (NULL != pMainWindow)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		pUploadWindow = glfwCreateWindow(1, 1, "", NULL, pMainWindow);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	}
+
+	// the flip setting is global in stb_image, set it before
+	// any worker starts decoding
+	stbi_set_flip_vertically_on_load(true);
+
+	{
+		ThreadPool pool(m_threadCount);
+		m_threadCount = pool.GetThreadCount();
+
+		for (size_t i = 0; i < m_requests.size(); i++)
+		{
+			pool.Submit([this, i]() { DecodeImage(i); });
+		}
+
+		if (NULL != pUploadWindow)
+		{
+			std::thread uploadThread([this, &textures, pUploadWindow]()
+				{
+					glfwMakeContextCurrent(pUploadWindow);
+					UploadImages(&textures);
+					glfwMakeContextCurrent(NULL);
+				});
+			uploadThread.join();
+		}
+		else
+		{
+			std::cout << "ERROR: NO SHARED CONTEXT FOR TEXTURE UPLOADS, UPLOADING ON THE MAIN THREAD" << std::endl;
+			UploadImages(&textures);
+		}
+
+		pool.Wait();
+	}
+
+	if (NULL != pUploadWindow)
+	{
+		glfwDestroyWindow(pUploadWindow);
+		glfwMakeContextCurrent(pMainWindow);
+	}
+
+	// the textures are complete for this context once the
+	// upload fence has signaled
+	if (NULL != m_uploadFence)
+	{
+		GLenum result = GL_TIMEOUT_EXPIRED;
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(m_uploadFence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NANOSECONDS);
+		}
+		if (result == GL_WAIT_FAILED)
+		{
+			std::cout << "ERROR: TEXTURE UPLOAD FENCE WAIT FAILED" << std::endl;
+		}
+		glDeleteSync(m_uploadFence);
+		m_uploadFence = NULL;
+	}
+	textures.BindArrays();
+
+	m_loadMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "INFO: Loaded " << m_requests.size() << " textures in " << m_loadMilliseconds
+		<< " ms on " << m_threadCount << " decode threads (" << m_cachedImages << " from cache, "
+		<< m_decodeMilliseconds << " ms of loading)" << std::endl;
+
+	m_requests.clear();
+}
+
+/***********************************************************
+ *  DecodeImage()
+ *
+ *  This method maps the cache container of a requested
+ *  file, which decodes and builds it first when the cache
+ *  has none for the current file contents.
+ ***********************************************************/
+void TextureLoader::DecodeImage(size_t requestIndex)
+{
+	PROFILE_SCOPE("Load texture");
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	DECODED_IMAGE decoded;
+	decoded.requestIndex = requestIndex;
+	bool loaded = m_cache.Load(m_requests[requestIndex].filename.c_str(), decoded.image);
+
+	double milliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+
+	{
+		std::lock_guard<std::mutex> lock(m_decodedMutex);
+		if (loaded)
+		{
+			m_decodedImages.push_back(decoded);
+			if (decoded.image.fromCache)
+			{
+				m_cachedImages++;
+			}
+		}
+		m_decodeMilliseconds += milliseconds;
+		m_finishedDecodes++;
+	}
+	m_imageDecoded.notify_one();
+}
+
+/***********************************************************
+ *  UploadImages()
+ *
+ *  This method runs with the upload context current. Each
+ *  mapped container is copied into its own pixel buffer
+ *  right away, so the copies overlap the remaining loads.
+ *  Images whose source contents were already staged are
+ *  not copied again, and the containers of staged images
+ *  stay mapped for the arrays. The images are then added in request
+ *  order, which keeps the array layout the same from run
+ *  to run.
+ ***********************************************************/
+void TextureLoader::UploadImages(TextureArrays* pTextures)
+{
+	PROFILE_SCOPE("Upload textures");
+
+	// one staged copy per distinct source content
+	std::map<uint64_t, STAGED_IMAGE> staged;
+	std::vector<uint64_t> requestHashes(m_requests.size(), 0);
+	std::vector<bool> requestLoaded(m_requests.size(), false);
+
+	for (;;)
+	{
+		DECODED_IMAGE decoded;
+		{
+			std::unique_lock<std::mutex> lock(m_decodedMutex);
+			m_imageDecoded.wait(lock, [this]()
+				{
+					return !m_decodedImages.empty() || m_finishedDecodes == m_requests.size();
+				});
+			if (m_decodedImages.empty())
+			{
+				break;
+			}
+			decoded = m_decodedImages.front();
+			m_decodedImages.pop_front();
+		}
+
+		const TextureCache::CACHED_IMAGE& image = decoded.image;
+		requestLoaded[decoded.requestIndex] = true;
+		requestHashes[decoded.requestIndex] = image.sourceHash;
+		if (staged.count(image.sourceHash) != 0)
+		{
+			delete image.pFile;
+			continue;
+		}
+
+		GLsizeiptr bytes = static_cast<GLsizeiptr>(image.dataSize);
+		GLuint pixelBuffer = 0;
+		glGenBuffers(1, &pixelBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		void* pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (NULL != pMapped)
+		{
+			memcpy(pMapped, image.pData, image.dataSize);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		else
+		{
+			glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, bytes, image.pData);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		STAGED_IMAGE& stagedImage = staged[image.sourceHash];
+		stagedImage.internalFormat = image.internalFormat;
+		stagedImage.levels = image.levels;
+		stagedImage.pixelBuffer = pixelBuffer;
+		stagedImage.pFile = image.pFile;
+		stagedImage.pData = image.pData;
+	}
+
+	// texture index of each content added so far
+	std::map<uint64_t, int> contentTextures;
+	for (size_t i = 0; i < m_requests.size(); i++)
+	{
+		if (!requestLoaded[i])
+		{
+			continue;
+		}
+
+		LOADED_TEXTURE loaded;
+		loaded.tag = m_requests[i].tag;
+		loaded.contentHash = requestHashes[i];
+		loaded.textureIndex = -1;
+
+		std::map<uint64_t, int>::const_iterator found = contentTextures.find(loaded.contentHash);
+		if (found != contentTextures.end())
+		{
+			loaded.textureIndex = found->second;
+		}
+		else
+		{
+			// the arrays keep the container to restore dropped levels
+			const STAGED_IMAGE& image = staged[loaded.contentHash];
+			if (pTextures->AddTexture(loaded.tag, image.internalFormat, image.levels, image.pixelBuffer,
+				image.pFile, image.pData))
+			{
+				loaded.textureIndex = static_cast<int>(pTextures->GetTextureCount()) - 1;
+			}
+			contentTextures[loaded.contentHash] = loaded.textureIndex;
+		}
+		m_loadedTextures.push_back(loaded);
+	}
+	pTextures->Build();
+
+	// the texture uploads already reference the buffers, so
+	// they are only released once the copies are done
+	for (std::pair<const uint64_t, STAGED_IMAGE>& image : staged)
+	{
+		glDeleteBuffers(1, &image.second.pixelBuffer);
+	}
+
+	m_uploadFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+}
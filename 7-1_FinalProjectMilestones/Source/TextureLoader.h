@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.h
+// ===============
+// parallel texture decoding with uploads from a shared GL context
+//
+//  Queued image files are fetched from the texture cache on a pool of
+//  worker threads, which only decode the ones without a current cache
+//  container. A separate upload thread, current on a hidden window whose
+//  context shares objects with the main one, copies each image's mip
+//  chain into a pixel buffer object as soon as it is ready, builds the
+//  texture arrays from those buffers and signals completion with a fence
+//  that the main context waits on before the textures are used. Files
+//  with identical contents are uploaded once and share one texture. The
+//  mapped containers are handed to the arrays, which upload dropped
+//  levels again from them.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureArrays.h"
+#include "TextureCache.h"
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class loads a set of texture files into texture
+ *  arrays using worker threads for the decoding.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// constructor, 0 threads uses one per hardware core
+	TextureLoader(unsigned int threadCount, bool compressTextures);
+	// destructor
+	~TextureLoader();
+
+	// queue an image file to be loaded under a tag
+	void Queue(const char* filename, const std::string& tag);
+	// texture each queued file ended up in
+	struct LOADED_TEXTURE
+	{
+		std::string tag;
+		uint64_t contentHash;
+		// index in the texture arrays, shared by equal contents
+		int textureIndex;
+	};
+
+	// decode and upload every queued image into the texture
+	// arrays, returning once they are usable by the current
+	// context; the current context must be the main one
+	void LoadAll(TextureArrays& textures);
+	// files of the last LoadAll that loaded, in queue order
+	const std::vector<LOADED_TEXTURE>& GetLoadedTextures() const { return(m_loadedTextures); }
+
+	// timings of the last LoadAll, in milliseconds
+	double GetLoadMilliseconds() const { return(m_loadMilliseconds); }
+	double GetDecodeMilliseconds() const { return(m_decodeMilliseconds); }
+	unsigned int GetThreadCount() const { return(m_threadCount); }
+	// images of the last LoadAll that were found in the cache
+	size_t GetCachedImageCount() const { return(m_cachedImages); }
+
+private:
+	// image file waiting to be loaded
+	struct REQUEST
+	{
+		std::string filename;
+		std::string tag;
+	};
+
+	// cached image handed from a worker to the upload thread
+	struct DECODED_IMAGE
+	{
+		size_t requestIndex;
+		TextureCache::CACHED_IMAGE image;
+	};
+
+	// mip chain copied into a pixel buffer object, and the
+	// mapped container it was copied from
+	struct STAGED_IMAGE
+	{
+		GLenum internalFormat;
+		std::vector<TextureArrays::MIP_LEVEL> levels;
+		GLuint pixelBuffer;
+		MappedFile* pFile;
+		const unsigned char* pData;
+	};
+
+	// load one requested file on a worker thread
+	void DecodeImage(size_t requestIndex);
+	// copy the loaded images into pixel buffers as they
+	// arrive, then build the texture arrays from them
+	void UploadImages(TextureArrays* pTextures);
+
+	unsigned int m_threadCount;
+	std::vector<REQUEST> m_requests;
+	// precompiled containers of the source images
+	TextureCache m_cache;
+
+	// decoded images waiting for the upload thread
+	std::deque<DECODED_IMAGE> m_decodedImages;
+	std::mutex m_decodedMutex;
+	std::condition_variable m_imageDecoded;
+	// decodes finished, including failed ones
+	size_t m_finishedDecodes;
+	// images found in the cache without decoding
+	size_t m_cachedImages;
+
+	// results of the last LoadAll
+	std::vector<LOADED_TEXTURE> m_loadedTextures;
+
+	// fence signaled when the uploads are complete
+	GLsync m_uploadFence;
+
+	double m_loadMilliseconds;
+	double m_decodeMilliseconds;
+};
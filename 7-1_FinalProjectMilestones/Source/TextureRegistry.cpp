@@ -0,0 +1,326 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureregistry.cpp
+// ===================
+// shared texture assets with a GPU memory budget
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureRegistry.h"
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// frames an array has to go undrawn before its levels are
+	// dropped to make room for an array in use
+	const uint64_t IDLE_FRAMES = 120;
+}
+
+/***********************************************************
+ *  TextureRegistry()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureRegistry::TextureRegistry()
+{
+	m_frame = 1;
+	m_memoryBudget = 0;
+	m_budgetExceeded = false;
+	m_loadThreadCount = 0;
+}
+
+/***********************************************************
+ *  ~TextureRegistry()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureRegistry::~TextureRegistry()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Register()
+ ***********************************************************/
+void TextureRegistry::Register(const char* filename, const std::string& tag)
+{
+	REGISTRATION registration;
+	registration.filename = filename;
+	registration.tag = tag;
+	m_registrations.push_back(registration);
+}
+
+/***********************************************************
+ *  LoadAll()
+ *
+ *  This method loads the registered files and groups their
+ *  tags into assets by content hash. The budget waits for
+ *  the end of the first frame, when the arrays it drew are
+ *  known.
+ ***********************************************************/
+void TextureRegistry::LoadAll(unsigned int threadCount, bool compressTextures)
+{
+	TextureLoader loader(threadCount, compressTextures);
+	for (const REGISTRATION& registration : m_registrations)
+	{
+		loader.Queue(registration.filename.c_str(), registration.tag);
+	}
+	m_registrations.clear();
+
+	loader.LoadAll(m_arrays);
+	m_loadThreadCount = loader.GetThreadCount();
+
+	size_t tagCount = 0;
+	for (const TextureLoader::LOADED_TEXTURE& loaded : loader.GetLoadedTextures())
+	{
+		if (loaded.textureIndex == -1)
+		{
+			continue;
+		}
+
+		TEXTURE_ASSET* pAsset = NULL;
+		for (TEXTURE_ASSET& asset : m_assets)
+		{
+			if (asset.contentHash == loaded.contentHash)
+			{
+				pAsset = &asset;
+				break;
+			}
+		}
+		if (NULL == pAsset)
+		{
+			TEXTURE_ASSET asset;
+			asset.contentHash = loaded.contentHash;
+			asset.texture = loaded.textureIndex;
+			asset.refCount = 0;
+			m_assets.push_back(asset);
+			pAsset = &m_assets.back();
+		}
+		pAsset->tags.push_back(loaded.tag);
+		tagCount++;
+	}
+
+	m_arrayLastUsed.assign(m_arrays.GetArrayCount(), 0);
+
+	std::cout << "INFO: " << tagCount << " texture tags share " << m_assets.size()
+		<< " textures" << std::endl;
+}
+
+/***********************************************************
+ *  Destroy()
+ ***********************************************************/
+void TextureRegistry::Destroy()
+{
+	m_arrays.Destroy();
+	m_assets.clear();
+	m_registrations.clear();
+	m_arrayLastUsed.clear();
+}
+
+/***********************************************************
+ *  Acquire()
+ ***********************************************************/
+int TextureRegistry::Acquire(const std::string& tag)
+{
+	for (size_t i = 0; i < m_assets.size(); i++)
+	{
+		for (const std::string& assetTag : m_assets[i].tags)
+		{
+			if (assetTag == tag)
+			{
+				m_assets[i].refCount++;
+				return static_cast<int>(i);
+			}
+		}
+	}
+	return -1;
+}
+
+/***********************************************************
+ *  Release()
+ ***********************************************************/
+void TextureRegistry::Release(int asset)
+{
+	if (asset >= 0 && asset < static_cast<int>(m_assets.size()) && m_assets[asset].refCount > 0)
+	{
+		m_assets[asset].refCount--;
+	}
+}
+
+/***********************************************************
+ *  MarkArrayUsed()
+ ***********************************************************/
+void TextureRegistry::MarkArrayUsed(int arrayIndex)
+{
+	if (arrayIndex >= 0 && arrayIndex < static_cast<int>(m_arrayLastUsed.size()))
+	{
+		m_arrayLastUsed[arrayIndex] = m_frame;
+	}
+}
+
+/***********************************************************
+ *  EndFrame()
+ ***********************************************************/
+void TextureRegistry::EndFrame()
+{
+	if (m_memoryBudget > 0)
+	{
+		EnforceBudget();
+	}
+	m_frame++;
+}
+
+/***********************************************************
+ *  GetResidentBytes()
+ ***********************************************************/
+size_t TextureRegistry::GetResidentBytes() const
+{
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < m_arrays.GetArrayCount(); i++)
+	{
+		bytes += m_arrays.GetArrayBytes(static_cast<int>(i));
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  EnforceBudget()
+ *
+ *  Over the budget, arrays are shrunk one level at a time,
+ *  least recently used first, drawn ones included when no
+ *  other is left, so the scene keeps rendering at lower
+ *  detail rather than running out of memory. Then at most
+ *  one level is restored per frame, to the array drawn this
+ *  frame with the cheapest level; room for it is only taken
+ *  from arrays idle for IDLE_FRAMES, so two arrays in use
+ *  never trade levels back and forth. An idle array may
+ *  lose a level even when the room is still too small, but
+ *  it gets it back once it is drawn again.
+ ***********************************************************/
+void TextureRegistry::EnforceBudget()
+{
+	bool dropped = false;
+	size_t residentBytes = GetResidentBytes();
+	while (residentBytes > m_memoryBudget)
+	{
+		int victim = FindEvictionCandidate(UINT64_MAX);
+		if (victim == -1)
+		{
+			if (!m_budgetExceeded)
+			{
+				std::cout << "ERROR: TEXTURES DO NOT FIT THE BUDGET OF " << m_memoryBudget
+					<< " BYTES, " << residentBytes << " BYTES RESIDENT" << std::endl;
+				m_budgetExceeded = true;
+			}
+			break;
+		}
+
+		m_arrays.DropTopLevel(victim);
+		dropped = true;
+		residentBytes = GetResidentBytes();
+	}
+
+	if (dropped)
+	{
+		ReportResidency();
+		return;
+	}
+
+	int restore = -1;
+	for (uint32_t i = 0; i < m_arrays.GetArrayCount(); i++)
+	{
+		int arrayIndex = static_cast<int>(i);
+		if (m_arrayLastUsed[i] == m_frame && m_arrays.CanRestoreTopLevel(arrayIndex) &&
+			(restore == -1 || m_arrays.GetRestoreBytes(arrayIndex) < m_arrays.GetRestoreBytes(restore)))
+		{
+			restore = arrayIndex;
+		}
+	}
+	if (restore == -1)
+	{
+		return;
+	}
+
+	const size_t restoreBytes = m_arrays.GetRestoreBytes(restore);
+	const uint64_t idleBefore = m_frame - std::min(m_frame, IDLE_FRAMES);
+	while (residentBytes + restoreBytes > m_memoryBudget)
+	{
+		int victim = FindEvictionCandidate(idleBefore);
+		if (victim == -1)
+		{
+			return;
+		}
+
+		m_arrays.DropTopLevel(victim);
+		residentBytes = GetResidentBytes();
+		std::cout << "INFO: Texture array " << victim << " idle, dropped to "
+			<< m_arrays.GetArray(victim).width << "x" << m_arrays.GetArray(victim).height << std::endl;
+	}
+
+	m_arrays.RestoreTopLevel(restore);
+	std::cout << "INFO: Texture array " << restore << " in use, restored to "
+		<< m_arrays.GetArray(restore).width << "x" << m_arrays.GetArray(restore).height
+		<< ", " << GetResidentBytes() << " of " << m_memoryBudget << " bytes resident" << std::endl;
+}
+
+/***********************************************************
+ *  FindEvictionCandidate()
+ ***********************************************************/
+int TextureRegistry::FindEvictionCandidate(uint64_t usedBefore) const
+{
+	int victim = -1;
+	for (uint32_t i = 0; i < m_arrays.GetArrayCount(); i++)
+	{
+		int arrayIndex = static_cast<int>(i);
+		if (m_arrayLastUsed[i] >= usedBefore || !m_arrays.CanDropTopLevel(arrayIndex))
+		{
+			continue;
+		}
+		if (victim == -1 ||
+			m_arrayLastUsed[i] < m_arrayLastUsed[victim] ||
+			(m_arrayLastUsed[i] == m_arrayLastUsed[victim] &&
+				m_arrays.GetArrayBytes(arrayIndex) > m_arrays.GetArrayBytes(victim)))
+		{
+			victim = arrayIndex;
+		}
+	}
+	return(victim);
+}
+
+/***********************************************************
+ *  ReportResidency()
+ ***********************************************************/
+void TextureRegistry::ReportResidency() const
+{
+	std::cout << "TEXTURE RESIDENCY:" << std::endl;
+	for (const TEXTURE_ASSET& asset : m_assets)
+	{
+		std::cout << "  ";
+		for (size_t i = 0; i < asset.tags.size(); i++)
+		{
+			std::cout << (i > 0 ? ", " : "") << "\"" << asset.tags[i] << "\"";
+		}
+
+		const TextureArrays::TEXTURE_LAYER& layer = m_arrays.GetTexture(asset.texture);
+		if (layer.arrayIndex == -1)
+		{
+			std::cout << ": not resident" << std::endl;
+			continue;
+		}
+
+		const TextureArrays::TEXTURE_ARRAY& textureArray = m_arrays.GetArray(layer.arrayIndex);
+		std::cout << ": array " << layer.arrayIndex << " layer " << layer.layer << ", "
+			<< textureArray.width << "x" << textureArray.height << ", levels "
+			<< textureArray.levelCount << " (" << textureArray.droppedLevels << " dropped), users "
+			<< asset.refCount << ", " << m_arrays.GetArrayBytes(layer.arrayIndex) / textureArray.layerCount
+			<< " bytes" << std::endl;
+	}
+
+	std::cout << "  total: " << GetResidentBytes() << " bytes";
+	if (m_memoryBudget > 0)
+	{
+		std::cout << " of " << m_memoryBudget << " budget";
+	}
+	std::cout << std::endl;
+}
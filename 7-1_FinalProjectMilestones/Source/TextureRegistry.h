@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureregistry.h
+// =================
+// shared texture assets with a GPU memory budget
+//
+//  Texture files are registered under tags and loaded together. Tags
+//  whose files have the same contents resolve to one asset, so they take
+//  a single layer. Users acquire assets by tag and the registry counts
+//  them. Every frame records the texture arrays it drew, and at its end,
+//  while the resident textures exceed the budget, the least recently
+//  used array gives up its top mip level. An array drawn again gets its
+//  dropped levels back, uploaded from its cache container, when they fit
+//  the budget, if need be after arrays left undrawn for a while give up
+//  levels in turn. Layers of an array share one mip chain, so the budget
+//  works on whole arrays.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureArrays.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureRegistry
+ *
+ *  This class owns the loaded texture arrays and tracks
+ *  who uses them and how much memory they hold.
+ ***********************************************************/
+class TextureRegistry
+{
+public:
+	// constructor
+	TextureRegistry();
+	// destructor
+	~TextureRegistry();
+
+	// texture shared by every tag whose file has the same contents
+	struct TEXTURE_ASSET
+	{
+		uint64_t contentHash;
+		// tags that resolve to this asset
+		std::vector<std::string> tags;
+		// index in the texture arrays
+		int texture;
+		// users currently holding the asset
+		int refCount;
+	};
+
+	// register a texture file to be loaded under a tag
+	void Register(const char* filename, const std::string& tag);
+	// load every registered file, 0 threads uses one per core
+	void LoadAll(unsigned int threadCount, bool compressTextures);
+	// release every asset and texture array
+	void Destroy();
+
+	// take a reference to the asset of a tag, -1 when not found
+	int Acquire(const std::string& tag);
+	// drop a reference taken with Acquire
+	void Release(int asset);
+
+	uint32_t GetAssetCount() const { return(static_cast<uint32_t>(m_assets.size())); }
+	const TEXTURE_ASSET& GetAsset(int asset) const { return(m_assets[asset]); }
+	// array and layer holding an asset
+	const TextureArrays::TEXTURE_LAYER& GetLayer(int asset) const { return(m_arrays.GetTexture(m_assets[asset].texture)); }
+	int GetArrayUnit(int arrayIndex) const { return(m_arrays.GetArrayUnit(arrayIndex)); }
+	// decode threads used by the last LoadAll
+	unsigned int GetLoadThreadCount() const { return(m_loadThreadCount); }
+
+	// resident texture memory limit in bytes, 0 for no limit
+	void SetMemoryBudget(size_t bytes) { m_memoryBudget = bytes; }
+	size_t GetMemoryBudget() const { return(m_memoryBudget); }
+	// note that an array is sampled by the current frame
+	void MarkArrayUsed(int arrayIndex);
+	// finish the frame, fitting the arrays to the budget
+	void EndFrame();
+	// GPU memory held by the resident texture levels
+	size_t GetResidentBytes() const;
+	// print the resident bytes of every asset
+	void ReportResidency() const;
+
+private:
+	// texture file waiting to be loaded
+	struct REGISTRATION
+	{
+		std::string filename;
+		std::string tag;
+	};
+
+	// drop top levels of the least recently used arrays until
+	// the resident textures fit the budget, then restore a level
+	// of an array drawn this frame
+	void EnforceBudget();
+	// droppable array used longest ago, and the largest of
+	// equally old ones, among those last used before a frame;
+	// -1 when there is none
+	int FindEvictionCandidate(uint64_t usedBefore) const;
+
+	std::vector<REGISTRATION> m_registrations;
+	std::vector<TEXTURE_ASSET> m_assets;
+	TextureArrays m_arrays;
+	// frame each array was last sampled in
+	std::vector<uint64_t> m_arrayLastUsed;
+	uint64_t m_frame;
+	size_t m_memoryBudget;
+	// true once an unreachable budget has been reported
+	bool m_budgetExceeded;
+	unsigned int m_loadThreadCount;
+};
@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.cpp
+// ==============
+// fixed set of worker threads running queued tasks
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+
+/***********************************************************
+ *  ThreadPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	m_runningTasks = 0;
+	m_stopping = false;
+
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_threads.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+/***********************************************************
+ *  ~ThreadPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ThreadPool::~ThreadPool()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_taskQueued.notify_all();
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+/***********************************************************
+ *  Submit()
+ ***********************************************************/
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskQueued.notify_one();
+}
+
+/***********************************************************
+ *  Wait()
+ ***********************************************************/
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_tasksFinished.wait(lock, [this]() { return m_tasks.empty() && m_runningTasks == 0; });
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ ***********************************************************/
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskQueued.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			if (m_tasks.empty())
+			{
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			m_runningTasks++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_runningTasks--;
+			if (m_runningTasks == 0 && m_tasks.empty())
+			{
+				m_tasksFinished.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.h
+// ============
+// fixed set of worker threads running queued tasks
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  ThreadPool
+ *
+ *  This class runs submitted tasks on a fixed number of
+ *  worker threads, in submission order.
+ ***********************************************************/
+class ThreadPool
+{
+public:
+	// constructor, 0 uses one thread per hardware core
+	ThreadPool(unsigned int threadCount);
+	// destructor, waits for the queued tasks to finish
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// queue a task to run on a worker thread
+	void Submit(std::function<void()> task);
+	// block until every submitted task has finished
+	void Wait();
+
+	// number of worker threads
+	unsigned int GetThreadCount() const { return(static_cast<unsigned int>(m_threads.size())); }
+
+private:
+	// run queued tasks until the pool is destroyed
+	void WorkerLoop();
+
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	// signaled when a task is queued or the pool stops
+	std::condition_variable m_taskQueued;
+	// signaled when the last running task finishes
+	std::condition_variable m_tasksFinished;
+	// tasks taken from the queue and still running
+	unsigned int m_runningTasks;
+	bool m_stopping;
+};
@@ -37,8 +37,12 @@ namespace
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
+	// distances to the near and far clipping planes
+	const float NEAR_PLANE = 0.1f;
+	const float FAR_PLANE = 100.0f;
 	const char* g_ViewName = "view";
 	const char* g_ProjectionName = "projection";
+	const char* g_ViewPositionName = "viewPosition";
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -52,6 +56,17 @@ namespace
 	// time between current frame and last frame
 	float gDeltaTime = 0.0f;
 	float gLastFrame = 0.0f;
+	// fixed time between frames, 0 to use the wall clock
+	float gFixedTimeStep = 0.0f;
+
+	// false while the camera is driven by a replayed path
+	bool gInputEnabled = true;
+
+	// scene bounds the camera collides with, NULL for none
+	const SceneBVH* g_pCollisionIndex = NULL;
+	// radius of the sphere kept clear around the camera, larger
+	// than the near plane so surfaces are never clipped
+	const float CAMERA_COLLISION_RADIUS = 0.3f;
 
 	// if orthographic projection is on, this value will be
 	// true
@@ -64,11 +79,23 @@ namespace
  *  The constructor for the class
  ***********************************************************/
 ViewManager::ViewManager(
-	ShaderManager* pShaderManager)
+	ShaderUniformManager* pShaderManager)
 {
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_sceneView = SCENE_VIEW();
+	m_recording = false;
+	m_recordStartTime = 0.0;
+
+	// the handles are resolved when the shaders are linked
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->RegisterUniform(&m_viewHandle, g_ViewName);
+		m_pShaderManager->RegisterUniform(&m_projectionHandle, g_ProjectionName);
+		m_pShaderManager->RegisterUniform(&m_viewPositionHandle, g_ViewPositionName);
+	}
+
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.5f, 5.5f, 10.0f);
@@ -125,6 +152,7 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	//SCROLL CALLBACK FOR THE MOVEMENT SPEED
 
 	glfwSetScrollCallback(window, [](GLFWwindow* w, double xoffset, double yoffset) {
+		if (!gInputEnabled) return;
 		if (yoffset > 0) g_pCamera->MovementSpeed += 1.0f;
 		if (yoffset < 0 && g_pCamera->MovementSpeed > 1.0f) g_pCamera->MovementSpeed -= 1.0f;
 		});
@@ -149,6 +177,12 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
  ***********************************************************/
 void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
 {
+	// replayed paths own the camera
+	if (!gInputEnabled)
+	{
+		return;
+	}
+
 	// when the first mouse move event is received, this needs to be recorded so that
 	// all subsequent mouse moves can correctly calculate the X position offset and Y
 	// position offset for proper operation
@@ -187,12 +221,15 @@ void ViewManager::ProcessKeyboardEvents()
 		glfwSetWindowShouldClose(m_pWindow, true);
 	}
 
-	// if the camera object is null, then exit this method
-	if (NULL == g_pCamera)
+	// if the camera object is null, or a replayed path owns
+	// the camera, then exit this method
+	if (NULL == g_pCamera || !gInputEnabled)
 	{
 		return;
 	}
 
+	glm::vec3 previousPosition = g_pCamera->Position;
+
 	//FORWARD AND BACKWARDS MOVEMENT
 
 	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
@@ -225,6 +262,45 @@ void ViewManager::ProcessKeyboardEvents()
 	{
 		g_pCamera->ProcessKeyboard(DOWN, gDeltaTime);
 	}
+
+	ResolveCameraCollision(previousPosition);
+}
+
+/***********************************************************
+ *  ResolveCameraCollision()
+ *
+ *  When the moved camera overlaps an object, the movement
+ *  is retried one axis at a time from the old position,
+ *  keeping each axis that stays clear, so the camera slides
+ *  along walls instead of stopping dead. A camera that was
+ *  already inside an object is left free to move out.
+ ***********************************************************/
+void ViewManager::ResolveCameraCollision(const glm::vec3& previousPosition)
+{
+	if (NULL == g_pCollisionIndex)
+	{
+		return;
+	}
+
+	glm::vec3 target = g_pCamera->Position;
+	if (target == previousPosition ||
+		!g_pCollisionIndex->AnyOverlapSphere(target, CAMERA_COLLISION_RADIUS) ||
+		g_pCollisionIndex->AnyOverlapSphere(previousPosition, CAMERA_COLLISION_RADIUS))
+	{
+		return;
+	}
+
+	glm::vec3 position = previousPosition;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::vec3 candidate = position;
+		candidate[axis] = target[axis];
+		if (!g_pCollisionIndex->AnyOverlapSphere(candidate, CAMERA_COLLISION_RADIUS))
+		{
+			position = candidate;
+		}
+	}
+	g_pCamera->Position = position;
 }
 
 /***********************************************************
@@ -241,27 +317,141 @@ void ViewManager::PrepareSceneView()
 
 	// per-frame timing
 	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
+	gDeltaTime = (gFixedTimeStep > 0.0f) ? gFixedTimeStep : currentFrame - gLastFrame;
 	gLastFrame = currentFrame;
 
 	// process any keyboard events that may be waiting in the 
 	// event queue
 	ProcessKeyboardEvents();
 
+	if (m_recording)
+	{
+		m_recordedPath.AddKey(static_cast<float>(glfwGetTime() - m_recordStartTime), GetCameraPose());
+	}
+
 	// get the current view matrix from the camera
 	view = g_pCamera->GetViewMatrix();
 
 	// define the current projection matrix
-	projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+	projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
+
+	// keep the view settings for the scene manager
+	m_sceneView.view = view;
+	m_sceneView.projection = projection;
+	m_sceneView.position = g_pCamera->Position;
+	m_sceneView.nearPlane = NEAR_PLANE;
+	m_sceneView.farPlane = FAR_PLANE;
+	m_sceneView.viewportWidth = WINDOW_WIDTH;
+	m_sceneView.viewportHeight = WINDOW_HEIGHT;
 
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
 	{
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
+		m_pShaderManager->setMat4Value(m_viewHandle, view);
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
+		m_pShaderManager->setMat4Value(m_projectionHandle, projection);
 		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		m_pShaderManager->setVec3Value(m_viewPositionHandle, g_pCamera->Position);
 	}
 }
+
+/***********************************************************
+ *  SetFixedTimeStep()
+ ***********************************************************/
+void ViewManager::SetFixedTimeStep(float seconds)
+{
+	gFixedTimeStep = seconds;
+}
+
+/***********************************************************
+ *  SetInputEnabled()
+ *
+ *  The first mouse event after enabling input is taken as
+ *  the new reference position, so the camera does not jump.
+ ***********************************************************/
+void ViewManager::SetInputEnabled(bool enabled)
+{
+	gInputEnabled = enabled;
+	gFirstMouse = true;
+}
+
+/***********************************************************
+ *  SetCameraPose()
+ *
+ *  The camera vectors are rebuilt from the angles the same
+ *  way mouse movement rebuilds them.
+ ***********************************************************/
+void ViewManager::SetCameraPose(const CameraPath::CAMERA_POSE& pose)
+{
+	if (NULL == g_pCamera)
+	{
+		return;
+	}
+
+	float yaw = glm::radians(pose.yaw);
+	float pitch = glm::radians(pose.pitch);
+	glm::vec3 front(cos(yaw) * cos(pitch), sin(pitch), sin(yaw) * cos(pitch));
+
+	g_pCamera->Position = pose.position;
+	g_pCamera->Yaw = pose.yaw;
+	g_pCamera->Pitch = pose.pitch;
+	g_pCamera->Front = glm::normalize(front);
+	g_pCamera->Right = glm::normalize(glm::cross(g_pCamera->Front, glm::vec3(0.0f, 1.0f, 0.0f)));
+	g_pCamera->Up = glm::normalize(glm::cross(g_pCamera->Right, g_pCamera->Front));
+}
+
+/***********************************************************
+ *  GetCameraPose()
+ *
+ *  The angles are taken from the front vector, which the
+ *  initial camera sets without them.
+ ***********************************************************/
+CameraPath::CAMERA_POSE ViewManager::GetCameraPose() const
+{
+	CameraPath::CAMERA_POSE pose = CameraPath::CAMERA_POSE();
+	if (NULL == g_pCamera)
+	{
+		return(pose);
+	}
+
+	glm::vec3 front = glm::normalize(g_pCamera->Front);
+	pose.position = g_pCamera->Position;
+	pose.yaw = glm::degrees(atan2(front.z, front.x));
+	pose.pitch = glm::degrees(asin(front.y));
+	return(pose);
+}
+
+/***********************************************************
+ *  StartRecording()
+ ***********************************************************/
+void ViewManager::StartRecording()
+{
+	m_recordedPath.Clear();
+	m_recordStartTime = glfwGetTime();
+	m_recording = true;
+}
+
+/***********************************************************
+ *  SetCollisionIndex()
+ ***********************************************************/
+void ViewManager::SetCollisionIndex(const SceneBVH* pSpatialIndex)
+{
+	g_pCollisionIndex = pSpatialIndex;
+}
+
+/***********************************************************
+ *  GetViewRay()
+ *
+ *  The point is taken back through the projection and
+ *  view of the last prepared frame at the near and far
+ *  planes.
+ ***********************************************************/
+void ViewManager::GetViewRay(float ndcX, float ndcY, glm::vec3& origin, glm::vec3& direction) const
+{
+	glm::mat4 inverseViewProjection = glm::inverse(m_sceneView.projection * m_sceneView.view);
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+}
@@ -9,7 +9,10 @@
 
 #pragma once
 
-#include "ShaderManager.h"
+#include "ShaderUniformManager.h"
+#include "SceneView.h"
+#include "CameraPath.h"
+#include "SceneBVH.h"
 #include "camera.h"
 
 // GLFW library
@@ -20,7 +23,7 @@ class ViewManager
 public:
 	// constructor
 	ViewManager(
-		ShaderManager* pShaderManager);
+		ShaderUniformManager* pShaderManager);
 	// destructor
 	~ViewManager();
 
@@ -29,12 +32,25 @@ public:
 
 private:
 	// pointer to shader manager object
-	ShaderManager* m_pShaderManager;
+	ShaderUniformManager* m_pShaderManager;
+	// uniform handles for the view settings
+	UniformHandle m_viewHandle;
+	UniformHandle m_projectionHandle;
+	UniformHandle m_viewPositionHandle;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// view settings of the current frame
+	SCENE_VIEW m_sceneView;
+	// camera poses of the live session, when recording
+	CameraPath m_recordedPath;
+	bool m_recording;
+	double m_recordStartTime;
 
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
+	// move the camera back from a position inside scene objects,
+	// sliding along them where possible
+	void ResolveCameraCollision(const glm::vec3& previousPosition);
 
 public:
 	// create the initial OpenGL display window
@@ -42,4 +58,27 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// view settings computed by the last PrepareSceneView()
+	const SCENE_VIEW& GetSceneView() const { return(m_sceneView); }
+
+	// advance the camera by a fixed time per frame instead of the
+	// wall clock, 0 returns to the wall clock
+	void SetFixedTimeStep(float seconds);
+	// turn keyboard and mouse camera movement on or off
+	void SetInputEnabled(bool enabled);
+	// place the camera directly, as when replaying a path
+	void SetCameraPose(const CameraPath::CAMERA_POSE& pose);
+	CameraPath::CAMERA_POSE GetCameraPose() const;
+
+	// stop keyboard movement at the bounds held by the index,
+	// NULL lets the camera pass through everything
+	void SetCollisionIndex(const SceneBVH* pSpatialIndex);
+	// world space ray through a point of the viewport in
+	// normalized device coordinates, (0, 0) is the center
+	void GetViewRay(float ndcX, float ndcY, glm::vec3& origin, glm::vec3& direction) const;
+
+	// record the camera pose of every following frame
+	void StartRecording();
+	const CameraPath& GetRecordedPath() const { return(m_recordedPath); }
 };
\ No newline at end of file
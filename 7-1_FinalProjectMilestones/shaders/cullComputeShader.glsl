@@ -0,0 +1,114 @@
+#version 430 core
+// frustum culls every scene object and appends the visible ones to the
+// instance range of their draw command, at the level of detail their
+// size on screen asks for
+layout (local_size_x = 64) in;
+
+// per-instance values as read by the vertex shader
+struct InstanceData
+{
+    mat4 model;
+    vec4 color;
+    // material index, texture layer and two unused
+    ivec4 material;
+};
+
+// object as stored in the object buffer
+//  boundsCenter.xyz    world space box center
+//  boundsExtents.xyz   world space box half size
+//  draw.x              command of the finest level, one per level after it
+//  draw.y              number of levels
+struct CullObject
+{
+    InstanceData instance;
+    vec4 boundsCenter;
+    vec4 boundsExtents;
+    uvec4 draw;
+};
+
+// DrawElementsIndirectCommand
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 3) readonly buffer ObjectBuffer
+{
+    CullObject objects[];
+};
+
+// reset to zero instances before every dispatch
+layout(std430, binding = 4) buffer CommandBuffer
+{
+    DrawCommand commands[];
+};
+
+layout(std430, binding = 5) writeonly buffer InstanceBuffer
+{
+    InstanceData instances[];
+};
+
+// level each object was last drawn at
+layout(std430, binding = 6) buffer LodBuffer
+{
+    uint objectLods[];
+};
+
+uniform uint objectCount;
+// left, right, bottom, top, near and far, normals pointing inwards
+uniform vec4 frustumPlanes[6];
+uniform vec3 cameraPosition;
+// pixels across per unit of size at unit distance, 0 draws
+// every object at its finest level
+uniform float pixelScale;
+uniform float lodSwitchPixels[3];
+uniform float lodHysteresis;
+
+void main()
+{
+   uint index = gl_GlobalInvocationID.x;
+   if(index >= objectCount)
+   {
+      return;
+   }
+
+   vec3 center = objects[index].boundsCenter.xyz;
+   vec3 extents = objects[index].boundsExtents.xyz;
+   for(int i = 0; i < 6; i++)
+   {
+      vec4 plane = frustumPlanes[i];
+      if(dot(plane.xyz, center) + plane.w + dot(abs(plane.xyz), extents) < 0.0)
+      {
+         return;
+      }
+   }
+
+   // the same hysteresis as the CPU selection
+   uint lastLod = objects[index].draw.y - 1u;
+   uint lod = 0u;
+   if(pixelScale > 0.0 && lastLod > 0u)
+   {
+      float diameter = 2.0 * length(extents);
+      float distance = length(center - cameraPosition);
+      // the camera inside the sphere sees the object up close
+      float screenDiameter = (distance > diameter * 0.5) ? diameter * pixelScale / distance : 3.0e38;
+      lod = min(objectLods[index], lastLod);
+      while(lod > 0u && screenDiameter > lodSwitchPixels[lod - 1u] * (1.0 + lodHysteresis))
+      {
+         lod--;
+      }
+      while(lod < lastLod && screenDiameter < lodSwitchPixels[lod] * (1.0 - lodHysteresis))
+      {
+         lod++;
+      }
+   }
+   objectLods[index] = lod;
+
+   uint command = objects[index].draw.x + lod;
+   uint slot = atomicAdd(commands[command].instanceCount, 1u);
+   instances[commands[command].baseInstance + slot] = objects[index].instance;
+}
@@ -0,0 +1,280 @@
+#version 430 core
+// lights the G-buffer once per pixel; each tile lists the point lights
+// reaching into the depth range of its pixels and only those are evaluated
+layout (local_size_x = 16, local_size_y = 16) in;
+
+// material as stored in the material buffer
+//  ambientColor.w      ambient strength
+//  specularColor.w     shininess
+struct MaterialRecord
+{
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
+};
+
+#define MAX_MATERIALS 64
+// point lights one tile can list, the rest are dropped
+#define MAX_TILE_LIGHTS 256
+
+// light source as stored in the light buffer
+//  position.w          range, 0 for a light reaching the whole scene
+//  ambientColor.w      focal strength
+//  diffuseColor.w      specular intensity
+//  specularColor.w     cube shadow map layer, -1 for none
+struct LightSource
+{
+    vec4 position;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
+};
+
+layout(std140, binding = 0) uniform MaterialBuffer
+{
+    MaterialRecord materials[MAX_MATERIALS];
+};
+
+// scene lights with the global lights first
+layout(std430, binding = 0) readonly buffer LightBuffer
+{
+    LightSource lightSources[];
+};
+
+// G-buffer as written by the scene fragment shader
+//  albedoImage.a       material index / 255
+//  normalImage         shading and face normal, octahedral
+//  viewDepthImage      linear view depth, 0 where nothing was drawn
+layout(binding = 0, rgba8) uniform readonly image2D albedoImage;
+layout(binding = 1, rgba16f) uniform readonly image2D normalImage;
+layout(binding = 2, r32f) uniform readonly image2D viewDepthImage;
+layout(binding = 3, rgba8) uniform writeonly image2D lightingImage;
+
+uniform ivec2 screenSize;
+uniform mat4 view;
+uniform mat4 inverseView;
+uniform mat4 inverseProjection;
+uniform vec3 viewPosition;
+uniform int globalLightCount;
+uniform int lightCount;
+
+// the same shadow maps and settings as the scene fragment shader
+uniform samplerCubeArrayShadow shadowMaps;
+uniform float shadowFarPlane;
+uniform float shadowBias;
+
+struct Material
+{
+    vec3 ambientColor;
+    float ambientStrength;
+    vec3 diffuseColor;
+    vec3 specularColor;
+    float shininess;
+};
+
+// material of the current pixel
+Material material;
+
+// depth range of the tile's pixels, as float bits, and its light list
+shared uint tileMinDepth;
+shared uint tileMaxDepth;
+shared uint tileLightCount;
+shared uint tileLights[MAX_TILE_LIGHTS];
+
+// function prototypes
+vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 faceNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcPointLight(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcShadow(int shadowMap, vec3 faceNormal, vec3 lightPosition, vec3 vertexPosition);
+vec3 DecodeNormal(vec2 encoded);
+vec3 ViewRay(vec2 ndc);
+
+void main()
+{
+   ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+   bool inside = pixel.x < screenSize.x && pixel.y < screenSize.y;
+   float viewDepth = inside ? imageLoad(viewDepthImage, pixel).r : 0.0;
+
+   if(gl_LocalInvocationIndex == 0u)
+   {
+      tileMinDepth = floatBitsToUint(3.0e38);
+      tileMaxDepth = 0u;
+      tileLightCount = 0u;
+   }
+   barrier();
+
+   // positive floats order the same as their bits
+   if(viewDepth > 0.0)
+   {
+      atomicMin(tileMinDepth, floatBitsToUint(viewDepth));
+      atomicMax(tileMaxDepth, floatBitsToUint(viewDepth));
+   }
+   barrier();
+
+   float minDepth = uintBitsToFloat(tileMinDepth);
+   float maxDepth = uintBitsToFloat(tileMaxDepth);
+
+   // side planes of the tile through the camera, normals pointing in;
+   // the corners go counterclockwise as seen from the camera
+   vec2 tileStart = vec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy) / vec2(screenSize) * 2.0 - 1.0;
+   vec2 tileEnd = vec2((gl_WorkGroupID.xy + 1u) * gl_WorkGroupSize.xy) / vec2(screenSize) * 2.0 - 1.0;
+   vec3 corners[4];
+   corners[0] = ViewRay(tileStart);
+   corners[1] = ViewRay(vec2(tileEnd.x, tileStart.y));
+   corners[2] = ViewRay(tileEnd);
+   corners[3] = ViewRay(vec2(tileStart.x, tileEnd.y));
+   vec3 planes[4];
+   for(int i = 0; i < 4; i++)
+   {
+      planes[i] = normalize(cross(corners[(i + 1) % 4], corners[i]));
+   }
+
+   // the tile's threads split the point lights between them
+   if(maxDepth > 0.0)
+   {
+      uint threadCount = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+      for(uint i = uint(globalLightCount) + gl_LocalInvocationIndex; i < uint(lightCount); i += threadCount)
+      {
+         vec3 center = (view * vec4(lightSources[i].position.xyz, 1.0)).xyz;
+         float range = lightSources[i].position.w;
+         bool visible = -center.z + range >= minDepth && -center.z - range <= maxDepth;
+         for(int p = 0; p < 4 && visible; p++)
+         {
+            visible = dot(planes[p], center) >= -range;
+         }
+         if(visible)
+         {
+            uint slot = atomicAdd(tileLightCount, 1u);
+            if(slot < MAX_TILE_LIGHTS)
+            {
+               tileLights[slot] = i;
+            }
+         }
+      }
+   }
+   barrier();
+
+   if(!inside)
+   {
+      return;
+   }
+   if(viewDepth <= 0.0)
+   {
+      imageStore(lightingImage, pixel, vec4(0.0, 0.0, 0.0, 1.0));
+      return;
+   }
+
+   vec4 albedo = imageLoad(albedoImage, pixel);
+   vec4 normals = imageLoad(normalImage, pixel);
+   vec3 lightNormal = DecodeNormal(normals.xy);
+   vec3 faceNormal = DecodeNormal(normals.zw);
+
+   MaterialRecord record = materials[int(albedo.a * 255.0 + 0.5)];
+   material.ambientColor = record.ambientColor.xyz;
+   material.ambientStrength = record.ambientColor.w;
+   material.diffuseColor = record.diffuseColor.xyz;
+   material.specularColor = record.specularColor.xyz;
+   material.shininess = record.specularColor.w;
+
+   // world position from the view ray through the pixel center
+   vec3 ray = ViewRay((vec2(pixel) + 0.5) / vec2(screenSize) * 2.0 - 1.0);
+   vec3 viewSpacePosition = ray * (viewDepth / -ray.z);
+   vec3 vertexPosition = (inverseView * vec4(viewSpacePosition, 1.0)).xyz;
+   vec3 viewDirection = normalize(viewPosition - vertexPosition);
+   vec3 phongResult = vec3(0.0);
+
+   for(int i = 0; i < globalLightCount; i++)
+   {
+      phongResult += CalcLightSource(lightSources[i], lightNormal, faceNormal, vertexPosition, viewDirection);
+   }
+
+   uint tileLightTotal = min(tileLightCount, uint(MAX_TILE_LIGHTS));
+   for(uint i = 0u; i < tileLightTotal; i++)
+   {
+      phongResult += CalcPointLight(lightSources[tileLights[i]], lightNormal, vertexPosition, viewDirection);
+   }
+
+   imageStore(lightingImage, pixel, vec4(phongResult * albedo.xyz, 1.0));
+}
+
+// calculates the color when using a directional light, as the scene
+// fragment shader does.
+vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 faceNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   vec3 ambient = light.ambientColor.xyz + (material.ambientColor * material.ambientStrength);
+
+   vec3 lightDirection = normalize(light.position.xyz - vertexPosition);
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   vec3 diffuse = impact * material.diffuseColor;
+
+   vec3 reflectDir = reflect(-lightDirection, lightNormal);
+   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.ambientColor.w);
+   vec3 specular = (light.diffuseColor.w * material.shininess) * specularComponent * material.specularColor;
+
+   float lit = 1.0;
+   if(light.specularColor.w >= 0.0)
+   {
+      lit = CalcShadow(int(light.specularColor.w), faceNormal, light.position.xyz, vertexPosition);
+   }
+
+   return(ambient + lit * (diffuse + specular));
+}
+
+// calculates the color from a point light with a limited range, as the
+// scene fragment shader does.
+vec3 CalcPointLight(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   vec3 toLight = light.position.xyz - vertexPosition;
+   float distanceSquared = dot(toLight, toLight);
+   float range = light.position.w;
+
+   float window = clamp(1.0 - distanceSquared / (range * range), 0.0, 1.0);
+   float attenuation = window * window;
+   if(attenuation <= 0.0)
+   {
+      return(vec3(0.0));
+   }
+
+   vec3 lightDirection = toLight * inversesqrt(distanceSquared);
+   vec3 ambient = light.ambientColor.xyz * material.ambientColor;
+
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   vec3 diffuse = impact * light.diffuseColor.xyz * material.diffuseColor;
+
+   vec3 reflectDir = reflect(-lightDirection, lightNormal);
+   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.ambientColor.w);
+   vec3 specular = (light.diffuseColor.w * material.shininess) * specularComponent * light.specularColor.xyz * material.specularColor;
+
+   return((ambient + diffuse + specular) * attenuation);
+}
+
+// fraction of a shadowed light reaching the pixel, with the face normal
+// the G-buffer kept for the slope bias.
+float CalcShadow(int shadowMap, vec3 faceNormal, vec3 lightPosition, vec3 vertexPosition)
+{
+   vec3 fromLight = vertexPosition - lightPosition;
+   float distance = length(fromLight);
+
+   float cosine = clamp(abs(dot(faceNormal, fromLight / distance)), 0.2, 1.0);
+   float bias = shadowBias * distance * (1.0 + sqrt(1.0 - cosine * cosine) / cosine);
+
+   float reference = min((distance - bias) / shadowFarPlane, 1.0);
+   return(texture(shadowMaps, vec4(fromLight, float(shadowMap)), reference));
+}
+
+// unit vector from its octahedral encoding.
+vec3 DecodeNormal(vec2 encoded)
+{
+   vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+   if(normal.z < 0.0)
+   {
+      normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+   }
+   return(normalize(normal));
+}
+
+// view space point on the far plane seen through a point of the screen.
+vec3 ViewRay(vec2 ndc)
+{
+   vec4 point = inverseProjection * vec4(ndc, 1.0, 1.0);
+   return(point.xyz / point.w);
+}
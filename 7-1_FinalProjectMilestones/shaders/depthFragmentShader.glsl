@@ -0,0 +1,6 @@
+#version 330 core
+// writes nothing but the depth of the fixed function pipeline
+
+void main()
+{
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// draws the scene depth only, for the depth pre-pass
+layout (location = 0) in vec3 inVertexPosition;
+// per-instance model matrix, the other instance values are unused
+layout (location = 3) in mat4 inInstanceModel;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// the scene pass tests against this depth with GL_EQUAL, so both
+// vertex shaders compute the position with the same invariant expression
+invariant gl_Position;
+
+void main()
+{
+   gl_Position = projection * view * inInstanceModel * vec4(inVertexPosition, 1.0f);
+}
@@ -9,69 +9,168 @@ struct Material
     float shininess;
 }; 
 
-struct LightSource 
+// material as stored in the material buffer
+//  ambientColor.w      ambient strength
+//  specularColor.w     shininess
+struct MaterialRecord
 {
-    vec3 position;	
-    vec3 ambientColor;
-    vec3 diffuseColor;
-    vec3 specularColor;
-    float focalStrength;
-    float specularIntensity;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
 };
 
-#define TOTAL_LIGHTS 4
+#define MAX_MATERIALS 64
+
+// light source as stored in the light buffer
+//  position.w          range, 0 for a light reaching the whole scene
+//  ambientColor.w      focal strength
+//  diffuseColor.w      specular intensity
+//  specularColor.w     cube shadow map layer, -1 for none
+struct LightSource 
+{
+    vec4 position;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
+};
 
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+in vec4 fragmentColor;
+flat in int fragmentMaterialIndex;
+flat in int fragmentTextureLayer;
 
-out vec4 outFragmentColor;
+// depth test before shading even with the overdraw image written; nothing
+// here discards or writes depth, so the result is the same
+layout(early_fragment_tests) in;
+
+layout(location = 0) out vec4 outFragmentColor;
+// G-buffer targets, written along with the albedo instead of the lit color
+//  outNormals.xy       shading normal, octahedral
+//  outNormals.zw       face normal, octahedral
+//  outViewDepth        linear view depth, 0 where nothing was drawn
+layout(location = 1) out vec4 outNormals;
+layout(location = 2) out float outViewDepth;
 
-uniform bool bUseTexture=false;
 uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
-uniform sampler2D objectTexture;
+// write the G-buffer for the deferred lighting pass
+uniform bool bWriteGBuffer = false;
+// count the fragments shaded per pixel for the overdraw heatmap
+uniform bool bCountOverdraw = false;
+layout(r32ui, binding = 4) uniform uimage2D overdrawCounts;
+// texture array of the current draw, layer chosen per instance
+uniform sampler2DArray objectTexture;
 uniform vec3 viewPosition;
 uniform vec2 UVscale = vec2(1.0f, 1.0f);
-uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
+// every scene material, selected per instance
+layout(std140, binding = 0) uniform MaterialBuffer
+{
+    MaterialRecord materials[MAX_MATERIALS];
+};
+
+// material of the current draw
+Material material;
+
+// scene lights with the global lights first
+layout(std430, binding = 0) readonly buffer LightBuffer
+{
+    LightSource lightSources[];
+};
+
+// offset and count of each cluster's light list
+layout(std430, binding = 1) readonly buffer ClusterBuffer
+{
+    uvec2 clusters[];
+};
+
+// light indices of all clusters
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer
+{
+    uint clusterLightIndices[];
+};
+
+uniform int globalLightCount = 0;
+uniform ivec3 clusterCount;
+uniform vec2 clusterTileSize;
+// exponential depth slice scale and bias
+uniform vec2 clusterDepthParams;
+// near and far plane distances
+uniform vec2 clusterPlanes;
+
+// cube shadow maps of the shadowed global lights, one cube per layer
+uniform samplerCubeArrayShadow shadowMaps;
+// distance the stored depths are scaled by, and the depth bias per
+// unit of distance to the light
+uniform float shadowFarPlane = 50.0;
+uniform float shadowBias = 0.004;
 
 // function prototypes
 vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcPointLight(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+uint FindCluster();
+float ViewDepth();
+float CalcShadow(int shadowMap, vec3 lightPosition, vec3 vertexPosition);
+vec2 EncodeNormal(vec3 normal);
+void WriteGBuffer();
 
 void main()
 {
-   if(bUseLighting == true)
+   if(bCountOverdraw == true)
+   {
+      imageAtomicAdd(overdrawCounts, ivec2(gl_FragCoord.xy), 1u);
+   }
+
+   if(bWriteGBuffer == true)
+   {
+      WriteGBuffer();
+   }
+   else if(bUseLighting == true)
    {
+      MaterialRecord record = materials[fragmentMaterialIndex];
+      material.ambientColor = record.ambientColor.xyz;
+      material.ambientStrength = record.ambientColor.w;
+      material.diffuseColor = record.diffuseColor.xyz;
+      material.specularColor = record.specularColor.xyz;
+      material.shininess = record.specularColor.w;
+
       // properties
       vec3 lightNormal = normalize(fragmentVertexNormal);
       vec3 viewDirection = normalize(viewPosition - fragmentPosition);
       vec3 phongResult = vec3(0.0f);
 
-      for(int i = 0; i < TOTAL_LIGHTS; i++)
+      for(int i = 0; i < globalLightCount; i++)
       {
          phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
       }   
+
+      // only the point lights listed for this fragment's cluster
+      uvec2 cluster = clusters[FindCluster()];
+      for(uint i = 0u; i < cluster.y; i++)
+      {
+         uint lightIndex = clusterLightIndices[cluster.x + i];
+         phongResult += CalcPointLight(lightSources[lightIndex], lightNormal, fragmentPosition, viewDirection);
+      }
     
-      if(bUseTexture == true)
+      if(fragmentTextureLayer >= 0)
       {
-         vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         vec4 textureColor = texture(objectTexture, vec3(fragmentTextureCoordinate * UVscale, fragmentTextureLayer));
          outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
       }
       else
       {
-         outFragmentColor = vec4(phongResult * objectColor.xyz, objectColor.w);
+         outFragmentColor = vec4(phongResult * fragmentColor.xyz, fragmentColor.w);
       }
    }
    else 
    {
-      if(bUseTexture == true)
+      if(fragmentTextureLayer >= 0)
       {
-         outFragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         outFragmentColor = texture(objectTexture, vec3(fragmentTextureCoordinate * UVscale, fragmentTextureLayer));
       }
       else
       {
-         outFragmentColor = objectColor;
+         outFragmentColor = fragmentColor;
       }
    }
 }
@@ -85,12 +184,12 @@ vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, v
 
    //**Calculate Ambient lighting**
 
-   ambient = light.ambientColor + (material.ambientColor * material.ambientStrength);
+   ambient = light.ambientColor.xyz + (material.ambientColor * material.ambientStrength);
 
    //**Calculate Diffuse lighting**
 
    // Calculate distance (light direction) between light source and fragments/pixels
-   vec3 lightDirection = normalize(light.position - vertexPosition); 
+   vec3 lightDirection = normalize(light.position.xyz - vertexPosition); 
    // Calculate diffuse impact by generating dot product of normal and light
    float impact = max(dot(lightNormal, lightDirection), 0.0);
    // Generate diffuse material color   
@@ -101,8 +200,110 @@ vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, v
    // Calculate reflection vector
    vec3 reflectDir = reflect(-lightDirection, lightNormal);
    // Calculate specular component
-   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength);
-   specular = (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
+   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.ambientColor.w);
+   specular = (light.diffuseColor.w * material.shininess) * specularComponent * material.specularColor;
+
+   //**Shadowing of the diffuse and specular lighting**
+
+   float lit = 1.0;
+   if(light.specularColor.w >= 0.0)
+   {
+      lit = CalcShadow(int(light.specularColor.w), light.position.xyz, vertexPosition);
+   }
   
-   return(ambient + diffuse + specular);
-}
\ No newline at end of file
+   return(ambient + lit * (diffuse + specular));
+}
+
+// calculates the color from a point light with a limited range.
+vec3 CalcPointLight(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   vec3 toLight = light.position.xyz - vertexPosition;
+   float distanceSquared = dot(toLight, toLight);
+   float range = light.position.w;
+
+   // smooth window that reaches zero at the light range
+   float window = clamp(1.0 - distanceSquared / (range * range), 0.0, 1.0);
+   float attenuation = window * window;
+   if(attenuation <= 0.0)
+   {
+      return(vec3(0.0));
+   }
+
+   vec3 lightDirection = toLight * inversesqrt(distanceSquared);
+   vec3 ambient = light.ambientColor.xyz * material.ambientColor;
+
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   vec3 diffuse = impact * light.diffuseColor.xyz * material.diffuseColor;
+
+   vec3 reflectDir = reflect(-lightDirection, lightNormal);
+   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.ambientColor.w);
+   vec3 specular = (light.diffuseColor.w * material.shininess) * specularComponent * light.specularColor.xyz * material.specularColor;
+
+   return((ambient + diffuse + specular) * attenuation);
+}
+
+// finds the cluster holding the current fragment.
+uint FindCluster()
+{
+   int slice = int(floor(log(ViewDepth()) * clusterDepthParams.x - clusterDepthParams.y));
+   ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy / clusterTileSize), slice);
+   cluster = clamp(cluster, ivec3(0), clusterCount - 1);
+
+   return(uint(cluster.x + clusterCount.x * (cluster.y + clusterCount.y * cluster.z)));
+}
+
+// linear view depth of the current fragment from the window depth.
+float ViewDepth()
+{
+   float nearPlane = clusterPlanes.x;
+   float farPlane = clusterPlanes.y;
+   float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+   return((2.0 * nearPlane * farPlane) / (farPlane + nearPlane - ndcDepth * (farPlane - nearPlane)));
+}
+
+
+// fraction of a shadowed light reaching the fragment, filtered over the
+// nearest four texels of its cube.
+float CalcShadow(int shadowMap, vec3 lightPosition, vec3 vertexPosition)
+{
+   vec3 fromLight = vertexPosition - lightPosition;
+   float distance = length(fromLight);
+
+   // the face normal from the screen derivatives, the vertex normals are
+   // not in world space; surfaces at a grazing angle to the light need
+   // a larger bias to stay out of their own shadow
+   vec3 faceNormal = normalize(cross(dFdx(vertexPosition), dFdy(vertexPosition)));
+   float cosine = clamp(abs(dot(faceNormal, fromLight / distance)), 0.2, 1.0);
+   float bias = shadowBias * distance * (1.0 + sqrt(1.0 - cosine * cosine) / cosine);
+
+   float reference = min((distance - bias) / shadowFarPlane, 1.0);
+   return(texture(shadowMaps, vec4(fromLight, float(shadowMap)), reference));
+}
+
+// octahedral encoding of a unit vector in [-1, 1].
+vec2 EncodeNormal(vec3 normal)
+{
+   vec2 encoded = normal.xy / (abs(normal.x) + abs(normal.y) + abs(normal.z));
+   if(normal.z < 0.0)
+   {
+      encoded = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+   }
+   return(encoded);
+}
+
+// writes the surface values the deferred lighting pass needs; the color
+// target keeps the albedo and the material index.
+void WriteGBuffer()
+{
+   vec3 albedo = fragmentColor.xyz;
+   if(fragmentTextureLayer >= 0)
+   {
+      albedo = texture(objectTexture, vec3(fragmentTextureCoordinate * UVscale, fragmentTextureLayer)).xyz;
+   }
+   outFragmentColor = vec4(albedo, float(fragmentMaterialIndex) / 255.0);
+
+   // the face normal is taken here, the lighting pass has no derivatives
+   vec3 faceNormal = normalize(cross(dFdx(fragmentPosition), dFdy(fragmentPosition)));
+   outNormals = vec4(EncodeNormal(normalize(fragmentVertexNormal)), EncodeNormal(faceNormal));
+   outViewDepth = ViewDepth();
+}
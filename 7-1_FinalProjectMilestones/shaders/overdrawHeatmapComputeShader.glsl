@@ -0,0 +1,32 @@
+#version 430 core
+// colors the fragments shaded per pixel: black for none, then blue, green,
+// yellow and red for one to four, and white for five or more
+layout (local_size_x = 16, local_size_y = 16) in;
+
+#define HEATMAP_LEVELS 6
+
+layout(r32ui, binding = 0) readonly uniform uimage2D overdrawCounts;
+layout(rgba8, binding = 1) writeonly uniform image2D heatmapImage;
+
+uniform ivec2 screenSize;
+
+const vec3 heatColors[HEATMAP_LEVELS] = vec3[](
+   vec3(0.0, 0.0, 0.0),
+   vec3(0.0, 0.2, 1.0),
+   vec3(0.0, 0.8, 0.2),
+   vec3(1.0, 0.9, 0.0),
+   vec3(1.0, 0.1, 0.0),
+   vec3(1.0, 1.0, 1.0));
+
+void main()
+{
+   ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+   if(pixel.x >= screenSize.x || pixel.y >= screenSize.y)
+   {
+      return;
+   }
+
+   uint count = imageLoad(overdrawCounts, pixel).r;
+   vec3 color = heatColors[min(count, uint(HEATMAP_LEVELS - 1))];
+   imageStore(heatmapImage, pixel, vec4(color, 1.0));
+}
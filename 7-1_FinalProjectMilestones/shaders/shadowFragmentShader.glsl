@@ -0,0 +1,22 @@
+#version 330 core
+// stores the distance from the light, scaled by the far plane, as depth
+
+in vec3 worldPosition;
+in vec3 worldNormal;
+
+uniform vec3 lightPosition;
+uniform float shadowFarPlane;
+
+void main()
+{
+   vec3 fromLight = worldPosition - lightPosition;
+
+   // only surfaces facing the light cast shadows, so the single sided
+   // walls and ceiling let in the lights placed behind them
+   if(dot(worldNormal, fromLight) > 0.0)
+   {
+      discard;
+   }
+
+   gl_FragDepth = length(fromLight) / shadowFarPlane;
+}
@@ -0,0 +1,19 @@
+#version 330 core
+// draws shadow casters into one face of a light's cube shadow map
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+// per-instance model matrix, the other instance values are unused
+layout (location = 3) in mat4 inInstanceModel;
+
+out vec3 worldPosition;
+out vec3 worldNormal;
+
+uniform mat4 faceViewProjection;
+
+void main()
+{
+   vec4 position = inInstanceModel * vec4(inVertexPosition, 1.0);
+   worldPosition = position.xyz;
+   worldNormal = transpose(inverse(mat3(inInstanceModel))) * inVertexNormal;
+   gl_Position = faceViewProjection * position;
+}
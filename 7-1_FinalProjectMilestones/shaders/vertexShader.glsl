@@ -2,19 +2,32 @@
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
+// per-instance values, one set per drawn object
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceColor;
+// material index and texture layer, -1 for color only
+layout (location = 8) in ivec2 inInstanceMaterial;
 
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+out vec4 fragmentColor;
+flat out int fragmentMaterialIndex;
+flat out int fragmentTextureLayer;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// matches the depth pre-pass, which the scene is tested against with GL_EQUAL
+invariant gl_Position;
+
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
+   fragmentPosition = vec3(inInstanceModel * vec4(inVertexPosition, 1.0));
+   gl_Position = projection * view * inInstanceModel * vec4(inVertexPosition, 1.0f);
    fragmentVertexNormal = inVertexNormal;
    fragmentTextureCoordinate = inTextureCoordinate;
+   fragmentColor = inInstanceColor;
+   fragmentMaterialIndex = inInstanceMaterial.x;
+   fragmentTextureLayer = inInstanceMaterial.y;
 }
\ No newline at end of file